@@ -0,0 +1,38 @@
+#include "bench.h"
+
+/**
+ * Parses a single arithmetic expression spanning the whole corpus, with
+ * the same grammar as `test/c-parser-expr.c`.
+*/
+Grammar* createGrammar() {
+	Grammar* g = Grammar_new();
+
+	SYMBOL (WS,             TOKEN("\\s+"));
+	SYMBOL (NUMBER,         TOKEN("\\d+(\\.\\d+)?"));
+	SYMBOL (VARIABLE,       TOKEN("\\w+"));
+	SYMBOL (OPERATOR,       TOKEN("[\\+\\-\\*/]"));
+
+	SYMBOL (Value,          GROUP( _S(NUMBER), _S(VARIABLE)));
+	SYMBOL (Suffix,         RULE ( _AS(_S(OPERATOR), "operator"), _AS(_S(Value), "value")));
+	SYMBOL (Expression,     RULE ( _S(Value), MANY_OPTIONAL(_S(Suffix))));
+
+	AXIOM(Expression);
+	SKIP(WS);
+
+	return g;
+}
+
+const char* VALUES[]    = {"1", "20", "300", "4.5", "0.25", "x", "y1", "total", "count_2"};
+const char* OPERATORS[] = {"+", "-", "*", "/"};
+
+void generate(Corpus* corpus) {
+	if (corpus->length > 0) {
+		Corpus_add(corpus, Corpus_random(corpus, 8) == 0 ? "\n%s " : " %s ", Corpus_pick(corpus, OPERATORS, 4));
+	}
+	Corpus_add(corpus, "%s", Corpus_pick(corpus, VALUES, 9));
+}
+
+int main (int argc, char** argv) {
+	Benchmark benchmark = {"expr", createGrammar(), generate, FALSE};
+	return Benchmark_main(&benchmark, argc, argv);
+}
@@ -0,0 +1,51 @@
+#include "bench.h"
+
+/**
+ * Parses a stream of HTTP requests, like nom's HTTP benchmarks.
+ *
+ * SEE: https://github.com/Geal/nom_benchmarks/tree/master/http/nom-http/src
+*/
+Grammar* createGrammar() {
+	Grammar* g = Grammar_new();
+
+	SYMBOL (METHOD,         TOKEN("[A-Z]+"));
+	SYMBOL (SP,             WORD(" "));
+	SYMBOL (URI,            TOKEN("[^ \\r\\n]+"));
+	SYMBOL (VERSION,        TOKEN("HTTP/1\\.[01]"));
+	SYMBOL (EOL,            TOKEN("\\r?\\n"));
+	SYMBOL (HEADER_NAME,    TOKEN("[A-Za-z0-9\\-]+"));
+	SYMBOL (COLON,          TOKEN(":[ \\t]*"));
+	SYMBOL (HEADER_VALUE,   TOKEN("[^\\r\\n]*"));
+	SYMBOL (RequestLine,    RULE ( _S(METHOD), _S(SP), _S(URI), _S(SP), _S(VERSION), _S(EOL)));
+	SYMBOL (Header,         RULE ( _S(HEADER_NAME), _S(COLON), _S(HEADER_VALUE), _S(EOL)));
+	SYMBOL (Request,        RULE ( _S(RequestLine), _MO(Header), _S(EOL)));
+
+	AXIOM(Request);
+
+	return g;
+}
+
+const char* METHODS[] = {"GET", "GET", "GET", "POST", "PUT", "DELETE", "HEAD"};
+const char* PATHS[]   = {"/", "/index.html", "/static/app.js", "/api/v1/users", "/search"};
+const char* AGENTS[]  = {
+	"Mozilla/5.0 (X11; Linux x86_64; rv:109.0) Gecko/20100101 Firefox/115.0",
+	"curl/8.4.0",
+	"Wget/1.21.4"
+};
+
+void generate(Corpus* corpus) {
+	Corpus_add(corpus, "%s %s?id=%u HTTP/1.1\r\n", Corpus_pick(corpus, METHODS, 7), Corpus_pick(corpus, PATHS, 5), Corpus_random(corpus, 100000));
+	Corpus_add(corpus, "Host: www.example.com\r\n");
+	Corpus_add(corpus, "User-Agent: %s\r\n", Corpus_pick(corpus, AGENTS, 3));
+	Corpus_add(corpus, "Accept: text/html,application/xhtml+xml;q=0.9,*/*;q=0.8\r\n");
+	Corpus_add(corpus, "Accept-Language: en-US,en;q=0.5\r\n");
+	if (Corpus_random(corpus, 2)) {
+		Corpus_add(corpus, "Cookie: session=%08x%08x\r\n", Corpus_random(corpus, 0xFFFFFFFF), Corpus_random(corpus, 0xFFFFFFFF));
+	}
+	Corpus_add(corpus, "Connection: keep-alive\r\n\r\n");
+}
+
+int main (int argc, char** argv) {
+	Benchmark benchmark = {"http", createGrammar(), generate, TRUE};
+	return Benchmark_main(&benchmark, argc, argv);
+}
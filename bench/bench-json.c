@@ -0,0 +1,83 @@
+#include "bench.h"
+
+/**
+ * Parses JSON documents, one per line, as a stream of values.
+*/
+Grammar* createGrammar() {
+	Grammar* g = Grammar_new();
+
+	SYMBOL (WS,             TOKEN("\\s+"));
+	SYMBOL (STRING,         TOKEN("\"(\\\\.|[^\"\\\\])*\""));
+	SYMBOL (NUMBER,         TOKEN("-?(0|[1-9][0-9]*)(\\.[0-9]+)?([eE][\\+\\-]?[0-9]+)?"));
+	SYMBOL (TRUE_,          WORD("true"));
+	SYMBOL (FALSE_,         WORD("false"));
+	SYMBOL (NULL_,          WORD("null"));
+	SYMBOL (LBRACE,         WORD("{"));
+	SYMBOL (RBRACE,         WORD("}"));
+	SYMBOL (LBRACKET,       WORD("["));
+	SYMBOL (RBRACKET,       WORD("]"));
+	SYMBOL (COLON,          WORD(":"));
+	SYMBOL (COMMA,          WORD(","));
+
+	SYMBOL (Value,          GROUP(NULL));
+	SYMBOL (Member,         RULE ( _S(STRING), _S(COLON), _S(Value)));
+	SYMBOL (Members,        RULE ( _S(Member), MANY_OPTIONAL(RULE(_S(COMMA), _S(Member)))));
+	SYMBOL (Object,         RULE ( _S(LBRACE), _O(Members), _S(RBRACE)));
+	SYMBOL (Elements,       RULE ( _S(Value), MANY_OPTIONAL(RULE(_S(COMMA), _S(Value)))));
+	SYMBOL (Array,          RULE ( _S(LBRACKET), _O(Elements), _S(RBRACKET)));
+
+	ParsingElement_add(s_Value, _S(Object));
+	ParsingElement_add(s_Value, _S(Array));
+	ParsingElement_add(s_Value, _S(STRING));
+	ParsingElement_add(s_Value, _S(NUMBER));
+	ParsingElement_add(s_Value, _S(TRUE_));
+	ParsingElement_add(s_Value, _S(FALSE_));
+	ParsingElement_add(s_Value, _S(NULL_));
+
+	AXIOM(Value);
+	SKIP(WS);
+
+	return g;
+}
+
+const char* NAMES[]  = {"id", "name", "email", "tags", "score", "active", "parent"};
+const char* WORDS[]  = {"alpha", "beta", "gamma", "delta", "epsilon \\\"quoted\\\""};
+
+void generateValue(Corpus* corpus, int depth) {
+	switch (Corpus_random(corpus, depth > 2 ? 4 : 6)) {
+		case 0: Corpus_add(corpus, "\"%s\"", Corpus_pick(corpus, WORDS, 5)); break;
+		case 1: Corpus_add(corpus, "%u.%u", Corpus_random(corpus, 10000), Corpus_random(corpus, 100)); break;
+		case 2: Corpus_add(corpus, "%s", Corpus_random(corpus, 2) ? "true" : "null"); break;
+		case 3: Corpus_add(corpus, "%d", (int)Corpus_random(corpus, 2000) - 1000); break;
+		case 4: {
+			unsigned int count = Corpus_random(corpus, 4);
+			Corpus_add(corpus, "[");
+			for (unsigned int i=0 ; i<count ; i++) {
+				if (i > 0) {Corpus_add(corpus, ", ");}
+				generateValue(corpus, depth + 1);
+			}
+			Corpus_add(corpus, "]");
+			break;
+		}
+		default: {
+			unsigned int count = 1 + Corpus_random(corpus, 4);
+			Corpus_add(corpus, "{");
+			for (unsigned int i=0 ; i<count ; i++) {
+				Corpus_add(corpus, i > 0 ? ", \"%s\": " : "\"%s\": ", Corpus_pick(corpus, NAMES, 7));
+				generateValue(corpus, depth + 1);
+			}
+			Corpus_add(corpus, "}");
+		}
+	}
+}
+
+void generate(Corpus* corpus) {
+	Corpus_add(corpus, "{\"id\": %u, \"data\": ", Corpus_random(corpus, 1000000));
+	generateValue(corpus, 0);
+	Corpus_add(corpus, "}\n");
+}
+
+int main (int argc, char** argv) {
+	Benchmark benchmark = {"json", createGrammar(), generate, TRUE};
+	return Benchmark_main(&benchmark, argc, argv);
+}
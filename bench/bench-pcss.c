@@ -0,0 +1,30 @@
+#include "bench.h"
+
+/**
+ * Parses blocks of nested PCSS rules, with the grammar of
+ * `test/c-parser-pcss.c`. The grammar tracks the indentation, and recurses
+ * for each block of the input, so that large corpora need a large stack
+ * (`make bench` runs with `ulimit -s unlimited`).
+*/
+#define main c_parser_pcss_main
+#include "../test/c-parser-pcss.c"
+#undef main
+
+const char* NODES[]      = {"div", "span", "ul", "li", "a", "*"};
+const char* PROPERTIES[] = {"float", "display", "color", "position"};
+const char* KEYWORDS[]   = {"left", "right", "block", "inherit", "relative"};
+
+void generate(Corpus* corpus) {
+	Corpus_add(corpus, "%s:\n", Corpus_pick(corpus, NODES, 6));
+	unsigned int rules = 1 + Corpus_random(corpus, 4);
+	for (unsigned int i=0 ; i<rules ; i++) {
+		Corpus_add(corpus, "\t.by-%u > %s :\n", Corpus_random(corpus, 100), Corpus_pick(corpus, NODES, 6));
+		Corpus_add(corpus, "\t\t%s: %s\n", Corpus_pick(corpus, PROPERTIES, 4), Corpus_pick(corpus, KEYWORDS, 5));
+		Corpus_add(corpus, "\t\twidth: %u.%u%%\n\n", Corpus_random(corpus, 100), Corpus_random(corpus, 1000));
+	}
+}
+
+int main (int argc, char** argv) {
+	Benchmark benchmark = {"pcss", createGrammar(), generate, FALSE};
+	return Benchmark_main(&benchmark, argc, argv);
+}
@@ -0,0 +1,41 @@
+#include "bench.h"
+
+/**
+ * Parses a sequence of keywords, which exercises the groups of words and
+ * the skipping of whitespace.
+*/
+Grammar* createGrammar() {
+	Grammar* g = Grammar_new();
+
+	SYMBOL (WS,             TOKEN("\\s+"));
+	SYMBOL (IF,             WORD("if"));
+	SYMBOL (ELSE,           WORD("else"));
+	SYMBOL (WHILE,          WORD("while"));
+	SYMBOL (FOR,            WORD("for"));
+	SYMBOL (FUNCTION,       WORD("function"));
+	SYMBOL (RETURN,         WORD("return"));
+	SYMBOL (BREAK,          WORD("break"));
+	SYMBOL (CONTINUE,       WORD("continue"));
+	SYMBOL (CONST,          WORD("const"));
+	SYMBOL (CLASS,          WORD("class"));
+	SYMBOL (Keyword,        GROUP( _S(IF), _S(ELSE), _S(WHILE), _S(FOR), _S(FUNCTION),
+	                               _S(RETURN), _S(BREAK), _S(CONTINUE), _S(CONST), _S(CLASS)));
+	SYMBOL (Keywords,       RULE ( _MO(Keyword)));
+
+	AXIOM(Keywords);
+	SKIP(WS);
+
+	return g;
+}
+
+const char* KEYWORDS[] = {"if", "else", "while", "for", "function", "return", "break", "continue", "const", "class"};
+
+void generate(Corpus* corpus) {
+	if (corpus->length > 0) {Corpus_add(corpus, Corpus_random(corpus, 10) == 0 ? "\n" : " ");}
+	Corpus_add(corpus, "%s", Corpus_pick(corpus, KEYWORDS, 10));
+}
+
+int main (int argc, char** argv) {
+	Benchmark benchmark = {"word", createGrammar(), generate, FALSE};
+	return Benchmark_main(&benchmark, argc, argv);
+}
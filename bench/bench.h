@@ -0,0 +1,255 @@
+#ifndef __PARSING_BENCH__
+#define __PARSING_BENCH__
+#include "parsing.h"
+#include <stdarg.h>
+#include <stdint.h>
+#include <time.h>
+#include <sys/resource.h>
+
+/**
+ * Benchmarks
+ * ==========
+ *
+ * Each benchmark is a driver in `bench/` that creates a grammar along with
+ * a corpus generator, and calls `Benchmark_main`. The driver is given the
+ * corpus sizes as arguments (`1K`, `64M`, `1G`, ...), and prints one JSON
+ * object per size on stdout:
+ *
+ * ```
+ * {"benchmark":"expr","size":1048576,"seed":1,"status":"S",...}
+ * ```
+ *
+ * The corpora are generated from a fixed seed, so that the same size always
+ * yields the same input. The parse is timed on its own, and repeated
+ * `BENCH_REPEAT` times (3 by default), keeping the fastest run.
+ *
+ * The grammars are parsed with their default settings, so without
+ * memoization, unless the `BENCH_MEMO` environment variable is set to `1`.
+ * The `memo` field of each object tells which.
+ *
+ * Allocations are counted by wrapping `malloc`, `calloc` and `realloc` at
+ * link time (`-Wl,--wrap=malloc,...`), which is why the drivers are linked
+ * with the library's objects rather than its shared library. As the peak
+ * RSS is the process's, `make bench` runs each size in its own process.
+*/
+
+#define BENCH_SEED    1
+#define BENCH_REPEAT  3
+
+// ----------------------------------------------------------------------------
+//
+// ALLOCATIONS
+//
+// ----------------------------------------------------------------------------
+
+size_t Benchmark_allocations = 0;
+
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+
+void* __wrap_malloc(size_t size) {
+	Benchmark_allocations += 1;
+	return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t count, size_t size) {
+	Benchmark_allocations += 1;
+	return __real_calloc(count, size);
+}
+
+void* __wrap_realloc(void* ptr, size_t size) {
+	Benchmark_allocations += 1;
+	return __real_realloc(ptr, size);
+}
+
+// ----------------------------------------------------------------------------
+//
+// CORPUS
+//
+// ----------------------------------------------------------------------------
+
+// @type Corpus
+typedef struct Corpus {
+	char*    text;       // The generated text, always NUL-terminated
+	size_t   length;     // The length of the text
+	size_t   capacity;   // The allocated size of `text`
+	uint64_t seed;       // The state of the random generator
+} Corpus;
+
+// @constructor
+Corpus* Corpus_new(size_t capacity) {
+	Corpus* this   = (Corpus*)malloc(sizeof(Corpus));
+	this->capacity = capacity + 1;
+	this->text     = (char*)malloc(this->capacity);
+	this->length   = 0;
+	this->seed     = BENCH_SEED;
+	this->text[0]  = '\0';
+	return this;
+}
+
+// @destructor
+void Corpus_free(Corpus* this) {
+	if (this == NULL) {return;}
+	free(this->text);
+	free(this);
+}
+
+// @method
+// Returns a pseudo-random number in `[0, n)`, from a linear congruential
+// generator so that corpora are the same on every platform.
+unsigned int Corpus_random(Corpus* this, unsigned int n) {
+	this->seed = this->seed * 6364136223846793005ULL + 1442695040888963407ULL;
+	return n == 0 ? 0 : (unsigned int)(this->seed >> 33) % n;
+}
+
+// @method
+// Returns one of the `count` given strings, at random.
+const char* Corpus_pick(Corpus* this, const char** strings, unsigned int count) {
+	return strings[Corpus_random(this, count)];
+}
+
+// @method
+// Appends the formatted string to the corpus.
+void Corpus_add(Corpus* this, const char* format, ...) {
+	va_list args;
+	va_start(args, format);
+	size_t  available = this->capacity - this->length;
+	int     written   = vsnprintf(this->text + this->length, available, format, args);
+	va_end(args);
+	if (written < 0) {return;}
+	if ((size_t)written >= available) {
+		this->capacity = (this->capacity + written) * 2;
+		this->text     = (char*)realloc(this->text, this->capacity);
+		va_start(args, format);
+		vsnprintf(this->text + this->length, this->capacity - this->length, format, args);
+		va_end(args);
+	}
+	this->length += written;
+}
+
+// @callback
+// Appends one record (a statement, a request, a block...) to the corpus,
+// the generator is called until the corpus is big enough.
+typedef void (*CorpusGenerator)(Corpus* corpus);
+
+// ----------------------------------------------------------------------------
+//
+// BENCHMARK
+//
+// ----------------------------------------------------------------------------
+
+// @type Benchmark
+typedef struct Benchmark {
+	const char*     name;
+	Grammar*        grammar;
+	CorpusGenerator generate;
+	// When set, the input is parsed as a stream of axiom records with
+	// `Grammar_parseStream`, which is how large inputs are parsed.
+	bool            isStream;
+} Benchmark;
+
+typedef struct BenchmarkRun {
+	size_t matches;
+	size_t records;
+} BenchmarkRun;
+
+// Returns the time in seconds, from a monotonic clock
+double Benchmark_now(void) {
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (double)t.tv_sec + (double)t.tv_nsec / 1e9;
+}
+
+// Parses a size like `64K`, `16M` or `1G`
+size_t Benchmark_size(const char* text) {
+	char*  end  = NULL;
+	size_t size = (size_t)strtoull(text, &end, 10);
+	switch (end == NULL ? '\0' : *end) {
+		case 'k': case 'K': return size << 10;
+		case 'm': case 'M': return size << 20;
+		case 'g': case 'G': return size << 30;
+		default           : return size;
+	}
+}
+
+int Benchmark__countRecord(Match* match, int step, void* data) {
+	BenchmarkRun* run = (BenchmarkRun*)data;
+	run->matches += Match_countAll(match);
+	run->records += 1;
+	return step;
+}
+
+// Parses the corpus once, returning the result and filling the run. The
+// matches are counted after the parse, unless the input is a stream.
+ParsingResult* Benchmark_parse(Benchmark* this, Corpus* corpus, BenchmarkRun* run, double* elapsed) {
+	run->matches = 0;
+	run->records = 0;
+	ParsingResult* result = NULL;
+	double start = Benchmark_now();
+	if (this->isStream) {
+		result   = Grammar_parseStream(this->grammar, Iterator_FromString(corpus->text), Benchmark__countRecord, run);
+		*elapsed = Benchmark_now() - start;
+		result->context->freeIterator = TRUE;
+	} else {
+		result   = Grammar_parseString(this->grammar, corpus->text);
+		*elapsed = Benchmark_now() - start;
+		run->matches = Match_isSuccess(result->match) ? Match_countAll(result->match) : 0;
+		run->records = Match_isSuccess(result->match) ? 1 : 0;
+	}
+	return result;
+}
+
+// Generates a corpus of the given size, parses it and prints the
+// measurements as a JSON object.
+void Benchmark_run(Benchmark* this, size_t size) {
+	Corpus* corpus = Corpus_new(size);
+	while (corpus->length < size) {this->generate(corpus);}
+
+	BenchmarkRun run;
+	double       best     = -1;
+	size_t       allocated = 0;
+	size_t       parsed   = 0;
+	char         status   = STATUS_FAILED;
+	for (int i=0 ; i<BENCH_REPEAT ; i++) {
+		double elapsed      = 0;
+		size_t allocations  = Benchmark_allocations;
+		ParsingResult* result = Benchmark_parse(this, corpus, &run, &elapsed);
+		allocated = Benchmark_allocations - allocations;
+		parsed    = result->context->iterator->offset;
+		status    = result->status;
+		ParsingResult_free(result);
+		if (best < 0 || elapsed < best) {best = elapsed;}
+	}
+
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	double megabytes = (double)corpus->length / (1024.0 * 1024.0);
+	printf("{\"benchmark\":\"%s\",\"size\":%zu,\"seed\":%d,\"status\":\"%c\",\"parsed\":%zu,\"memo\":%s,"
+		"\"seconds\":%.6f,\"mb_per_s\":%.3f,\"records\":%zu,\"matches\":%zu,\"matches_per_s\":%.0f,"
+		"\"allocations\":%zu,\"allocations_per_byte\":%.4f,\"peak_rss_kb\":%ld}\n",
+		this->name, corpus->length, BENCH_SEED, status, parsed, this->grammar->isMemoized ? "true" : "false",
+		best, best > 0 ? megabytes / best : 0, run.records, run.matches, best > 0 ? run.matches / best : 0,
+		allocated, corpus->length > 0 ? (double)allocated / corpus->length : 0, usage.ru_maxrss
+	);
+	fflush(stdout);
+	Corpus_free(corpus);
+}
+
+// Runs the benchmark for each size given as argument, or for `1M`.
+int Benchmark_main(Benchmark* this, int argc, char** argv) {
+	const char* memo = getenv("BENCH_MEMO");
+	if (memo != NULL && strcmp(memo, "1") == 0) {Grammar_enableMemoize(this->grammar);}
+	if (argc <= 1) {
+		Benchmark_run(this, Benchmark_size("1M"));
+	} else {
+		for (int i=1 ; i<argc ; i++) {
+			Benchmark_run(this, Benchmark_size(argv[i]));
+		}
+	}
+	Grammar_free(this->grammar);
+	return 0;
+}
+
+#endif
+// EOF
@@ -12,7 +12,8 @@
 #include "gc.h"
 #include "oo.h"
 
-#define MATCH_STATS(m) ParsingContext_registerMatch(context, (Element*)this, m)
+#define MATCH_STATS(m)  (trace ? ParsingContext_registerMatch(context, (Element*)this, m) : (m))
+#define MATCH_DEEPEST(m) ParsingContext__registerMatch(context, m)
 #define ANONYMOUS      "unnamed"
 
 // SEE: https://en.wikipedia.org/wiki/C_data_types
@@ -41,8 +42,48 @@ const char* INDENT       = "
 #define     INDENT_WIDTH  2
 #define     INDENT_MAX    40
 
-#define     OUT_STEP(msg,...)          OUT_IF(context->grammar->isVerbose && !HAS_FLAG(context->flags, FLAG_SKIPPING), msg, __VA_ARGS__)
-#define     OUT_STEP_IF(cond,msg,...)  OUT_IF(context->grammar->isVerbose && !HAS_FLAG(context->flags, FLAG_SKIPPING) && cond, msg, __VA_ARGS__)
+#define     OUT_STEP(msg,...)          OUT_IF(trace && context->grammar->isVerbose && !HAS_FLAG(context->flags, FLAG_SKIPPING), msg, __VA_ARGS__)
+#define     OUT_STEP_IF(cond,msg,...)  OUT_IF(trace && context->grammar->isVerbose && !HAS_FLAG(context->flags, FLAG_SKIPPING) && cond, msg, __VA_ARGS__)
+
+// ----------------------------------------------------------------------------
+//
+// RECOGNIZERS
+//
+// ----------------------------------------------------------------------------
+
+// The built-in recognizers are written once, as a `RECOGNIZER` body that
+// takes a constant `trace` argument. `RECOGNIZER_VARIANTS` specializes
+// each body into the tracing `*_recognize` callback, which logs the steps
+// of verbose grammars and registers every match (`MATCH_STATS`), and a
+// lean `*__recognizeLean` variant where all of it is compiled out. The
+// lean variant still registers the matches of terminals (`MATCH_DEEPEST`),
+// which is enough to find the deepest match, as composites never end
+// further than their last child.
+//
+// Contexts use the lean variants unless they have `FLAG_TRACING`, see
+// `ParsingElement_recognize`.
+#define     RECOGNIZER                 static inline __attribute__((always_inline))
+#define     RECOGNIZER_VARIANTS(name,type) \
+	Match* name##_recognize(type* this, ParsingContext* context) {return name##__recognize(this, context, TRUE);} \
+	static Match* name##__recognizeLean(type* this, ParsingContext* context) {return name##__recognize(this, context, FALSE);}
+
+// Registers the match as the context's deepest match, if it ends further
+// than the current one. See `ParsingContext_registerMatch`.
+static inline Match* ParsingContext__registerMatch(ParsingContext* this, Match* m) {
+	// We don't register skipping matches, as they'll be discarded right away
+	if (HAS_FLAG(this->flags, FLAG_SKIPPING)) {return m;}
+	// NOTE: We make sure to only register the deepest match, as the grammar
+	// is likely to backtack and yield a partial match, erasing where the error
+	// actually lies. We skip empty matches.
+	if (m != NULL && Match_isSuccess(m)) {
+		if ( (this->lastMatchOffset + this->lastMatchLength) < (m->offset + m->length) && m->length > 0) {
+			this->lastMatchOffset    = m->offset;
+			this->lastMatchLength    = m->length;
+			this->lastMatchElementID = m->element->id;
+		}
+	}
+	return m;
+}
 
 // ----------------------------------------------------------------------------
 //
@@ -101,6 +142,138 @@ char* String_escape(const char* string) {
 
 
 
+// ----------------------------------------------------------------------------
+//
+// WRITER
+//
+// ----------------------------------------------------------------------------
+
+static bool Writer__writeFD( const char* data, size_t length, void* context ) {
+	int fd = (int)(intptr_t)context;
+	while (length > 0) {
+		ssize_t written = write(fd, data, length);
+		if (written < 0) {
+			if (errno == EINTR) {continue;}
+			return FALSE;
+		}
+		data   += written;
+		length -= (size_t)written;
+	}
+	return TRUE;
+}
+
+static bool Writer__writeFile( const char* data, size_t length, void* context ) {
+	return fwrite(data, 1, length, (FILE*)context) == length;
+}
+
+Writer* Writer_new( void ) {
+	return Writer_FromCallback(NULL, NULL);
+}
+
+Writer* Writer_FromCallback( WriterCallback callback, void* context ) {
+	__NEW(Writer, this);
+	__ARRAY_NEW(data, char, WRITER_CAPACITY + 1);
+	this->data     = data;
+	this->data[0]  = '\0';
+	this->length   = 0;
+	this->flushed  = 0;
+	this->capacity = WRITER_CAPACITY;
+	this->callback = callback;
+	this->context  = context;
+	this->failed   = FALSE;
+	return this;
+}
+
+Writer* Writer_FromFD( int fd ) {
+	return Writer_FromCallback(Writer__writeFD, (void*)(intptr_t)fd);
+}
+
+Writer* Writer_FromFile( FILE* file ) {
+	return Writer_FromCallback(Writer__writeFile, (void*)file);
+}
+
+void Writer_free( Writer* this ) {
+	if (this == NULL) {return;}
+	Writer_flush(this);
+	__FREE(this->data);
+	__FREE(this);
+}
+
+bool Writer_flush( Writer* this ) {
+	if (this->callback != NULL && this->length > 0) {
+		if (!this->failed && !this->callback(this->data, this->length, this->context)) {
+			this->failed = TRUE;
+		}
+		this->flushed += this->length;
+		this->length   = 0;
+		this->data[0]  = '\0';
+	}
+	return !this->failed;
+}
+
+// Makes room for `length` more bytes, flushing the buffer when it goes
+// to a callback, and growing it otherwise (or when it's too small anyway).
+static inline void Writer__reserve( Writer* this, size_t length ) {
+	if (this->length + length <= this->capacity) {return;}
+	if (this->callback != NULL) {Writer_flush(this);}
+	if (this->length + length > this->capacity) {
+		this->capacity = MAX(this->capacity * 2, this->length + length);
+		__ARRAY_RESIZE(this->data, char, this->capacity + 1);
+	}
+}
+
+void Writer_write( Writer* this, const char* data, size_t length ) {
+	Writer__reserve(this, length);
+	memcpy(this->data + this->length, data, length);
+	this->length += length;
+	this->data[this->length] = '\0';
+}
+
+void Writer_print( Writer* this, const char* text ) {
+	Writer_write(this, text, strlen(text));
+}
+
+void Writer_printf( Writer* this, const char* format, ... ) {
+	va_list args;
+	va_start(args, format);
+	int length = vsnprintf(this->data + this->length, this->capacity - this->length + 1, format, args);
+	va_end(args);
+	if (length < 0) {return;}
+	if (this->length + (size_t)length > this->capacity) {
+		// The text did not fit, so we make room and format it again
+		this->data[this->length] = '\0';
+		Writer__reserve(this, (size_t)length);
+		va_start(args, format);
+		vsnprintf(this->data + this->length, this->capacity - this->length + 1, format, args);
+		va_end(args);
+	}
+	this->length += (size_t)length;
+}
+
+void Writer_printEscaped( Writer* this, const char* text, size_t length ) {
+	// An escaped byte takes at most 6 bytes (`\u00XX`)
+	Writer__reserve(this, length * 6);
+	char* out = this->data + this->length;
+	for (size_t i=0 ; i<length ; i++) {
+		unsigned char c = (unsigned char)text[i];
+		switch (c) {
+			case '\n': *out++ = '\\'; *out++ = 'n';  break;
+			case '\t': *out++ = '\\'; *out++ = 't';  break;
+			case '\r': *out++ = '\\'; *out++ = 'r';  break;
+			case '"':  *out++ = '\\'; *out++ = '"';  break;
+			case '\\': *out++ = '\\'; *out++ = '\\'; break;
+			default:
+				if (c < 0x20) {
+					out += sprintf(out, "\\u%04x", c);
+				} else {
+					*out++ = (char)c;
+				}
+		}
+	}
+	this->length = (size_t)(out - this->data);
+	this->data[this->length] = '\0';
+}
+
 // ----------------------------------------------------------------------------
 //
 // ITERATOR
@@ -119,17 +292,43 @@ Iterator* Iterator_Open(const char* path) {
 }
 
 Iterator* Iterator_FromString(const char* text) {
+	return Iterator_FromBuffer(text, strlen(text));
+}
+
+Iterator* Iterator_FromBuffer(const char* data, size_t length) {
 	NEW(Iterator, this);
 	if (this!=NULL) {
-		this->buffer     = (char*)text;
-		this->current    = (char*)text;
-		this->capacity   = strlen(text);
+		this->buffer     = (char*)data;
+		this->current    = (char*)data;
+		this->capacity   = length;
 		this->available  = this->capacity;
 		this->move       = String_move;
 	}
 	return this;
 }
 
+static Iterator* Iterator__fromReaderInput(ReaderInput* input) {
+	NEW(Iterator, this);
+	this->input      = (void*)input;
+	this->freeInput  = ReaderInput_free;
+	this->status     = STATUS_PROCESSING;
+	this->freeBuffer = TRUE;
+	this->move       = ReaderInput_move;
+	ReaderInput_preload(this);
+	return this;
+}
+
+Iterator* Iterator_FromReader(ReaderCallback read, void* context) {
+	return Iterator__fromReaderInput(ReaderInput_new(read, context));
+}
+
+Iterator* Iterator_FromFD(int fd, bool close) {
+	ReaderInput* input = ReaderInput_new(NULL, NULL);
+	input->fd      = fd;
+	input->closeFD = close;
+	return Iterator__fromReaderInput(input);
+}
+
 Iterator* Iterator_new( void ) {
 	__NEW(Iterator, this);
 	this->status        = STATUS_INIT;
@@ -137,13 +336,18 @@ Iterator* Iterator_new( void ) {
 	this->buffer        = NULL;
 	this->current       = NULL;
 	this->offset        = 0;
-	this->lines         = 0;
 	this->available     = 0;
+	this->released      = 0;
 	this->capacity      = 0;
 	this->input         = NULL;
 	this->freeInput     = NULL;
 	this->move          = NULL;
 	this->freeBuffer    = FALSE;
+	this->lines.offsets  = NULL;
+	this->lines.count    = 0;
+	this->lines.capacity = 0;
+	this->lines.dropped  = 0;
+	this->lines.end      = 0;
 	return this;
 }
 
@@ -155,6 +359,29 @@ void Iterator__freeInput( Iterator* this ) {
 	this->input = NULL;
 }
 
+// Makes the iterator go through the given text, which it then owns, from
+// the start. The iterator object stays the same, so that the matches
+// that refer to it (like tokens) read the new text.
+static void Iterator__replaceText( Iterator* this, char* text, size_t length ) {
+	Iterator__freeInput(this);
+	if (this->freeBuffer) {__FREE(this->buffer);}
+	__FREE(this->lines.offsets);
+	this->status         = STATUS_INIT;
+	this->buffer         = text;
+	this->current        = text;
+	this->offset         = 0;
+	this->capacity       = length;
+	this->available      = length;
+	this->released       = 0;
+	this->freeBuffer     = TRUE;
+	this->move           = String_move;
+	this->lines.offsets  = NULL;
+	this->lines.count    = 0;
+	this->lines.capacity = 0;
+	this->lines.dropped  = 0;
+	this->lines.end      = 0;
+}
+
 void Iterator_free( Iterator* this ) {
 	TRACE("Iterator_free: %p", this)
 	if (this != NULL) {
@@ -163,6 +390,7 @@ void Iterator_free( Iterator* this ) {
 	if (this->freeBuffer) {
 		__FREE(this->buffer);
 	}
+	__FREE(this->lines.offsets);
 	__FREE(this);
 }
 
@@ -175,6 +403,17 @@ bool Iterator_open( Iterator* this, const char *path ) {
 		this->freeInput = FileInput_free;
 		this->status = STATUS_PROCESSING;
 		this->offset = 0;
+		if (FileInput_map(input)) {
+			// The whole file is available from the start, so we can move
+			// within it as within a string. The mapping belongs to the input.
+			this->buffer     = input->data;
+			this->current    = input->data;
+			this->capacity   = input->size;
+			this->available  = input->size;
+			this->freeBuffer = FALSE;
+			this->move       = String_move;
+			return TRUE;
+		}
 		// We allocate a buffer that's twice the size of ITERATOR_BUFFER_AHEAD
 		// so that we ensure that the current position always has ITERATOR_BUFFER_AHEAD
 		// bytes ahead (if the input source has the data)
@@ -207,29 +446,104 @@ bool Iterator_hasMore( Iterator* this ) {
 }
 
 size_t Iterator_remaining( Iterator* this ) {
-	int buffer_offset = ((char*)this->current - this->buffer);
+	// The offset is computed in `size_t`, as mapped files can be larger
+	// than what an `int` holds.
+	size_t buffer_offset = ((char*)this->current - this->buffer);
 	// FIXME: Does not work if char is not the same as char
-	int remaining = this->available - buffer_offset;
-	assert(remaining >= 0);
-	//DEBUG("Iterator_remaining: %d, offset=%zu available=%zu capacity=%zu", remaining, this->offset, this->available, this->capacity)
-	return (size_t)remaining;
+	assert(buffer_offset <= this->available);
+	size_t remaining = this->available - buffer_offset;
+	//DEBUG("Iterator_remaining: %zu, offset=%zu available=%zu capacity=%zu", remaining, this->offset, this->available, this->capacity)
+	return remaining;
 }
 
 bool Iterator_moveTo ( Iterator* this, size_t offset ) {
-	return this->move(this, offset - this->offset );
+	// Moves are given as an `int`, so offsets that are further away, as
+	// they can be in mapped files, are reached in steps.
+	while (offset > this->offset && offset - this->offset > INT_MAX) {
+		if (!this->move(this, INT_MAX)) {return FALSE;}
+	}
+	while (offset < this->offset && this->offset - offset > INT_MAX) {
+		if (!this->move(this, -INT_MAX)) {return FALSE;}
+	}
+	return this->move(this, (int)((ssize_t)offset - (ssize_t)this->offset));
+}
+
+// Returns the number of indexed separators before the given offset
+static size_t LineIndex__count( LineIndex* this, size_t offset ) {
+	size_t lo = 0;
+	size_t hi = this->count;
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		if (this->offsets[mid] < offset) {lo = mid + 1;} else {hi = mid;}
+	}
+	return lo;
+}
+
+// Indexes the separators in the buffer up to the given offset. The
+// separators are looked for with `memchr`, which goes over many bytes at
+// once rather than comparing them one by one.
+static void Iterator__indexLines( Iterator* this, size_t offset ) {
+	LineIndex* index = &(this->lines);
+	size_t     base  = Iterator_textOffset(this);
+	size_t     end   = MIN(offset, (base + this->available));
+	if (index->end >= end) {return;}
+	const char* start = this->buffer + ((MAX(index->end, base)) - base);
+	const char* limit = this->buffer + (end - base);
+	while (start < limit && (start = memchr(start, this->separator, (size_t)(limit - start))) != NULL) {
+		if (index->count == index->capacity) {
+			index->capacity = index->capacity == 0 ? 256 : index->capacity * 2;
+			__ARRAY_RESIZE(index->offsets, size_t, index->capacity);
+		}
+		index->offsets[index->count++] = base + (size_t)(start - this->buffer);
+		start++;
+	}
+	index->end = end;
 }
 
-bool Iterator_backtrack ( Iterator* this, size_t offset, size_t lines ) {
+bool Iterator_backtrack ( Iterator* this, size_t offset ) {
 	assert(offset <= this->offset);
-	assert(lines  <= this->lines);
-	this->lines = lines;
-	return this->move(this, offset - this->offset );
+	return Iterator_moveTo(this, offset);
 }
 
 char Iterator_charAt ( Iterator* this, size_t offset ) {
-	assert(this->offset == (this->current - this->buffer));
-	assert(offset <= this->available);
-	return (char)(this->buffer[offset]);
+	size_t base = Iterator_textOffset(this);
+	assert(offset >= base);
+	assert(offset - base <= this->available);
+	return (char)(this->buffer[offset - base]);
+}
+
+size_t Iterator_textOffset ( Iterator* this ) {
+	return this->offset - (size_t)(this->current - this->buffer);
+}
+
+void Iterator_release ( Iterator* this, size_t offset ) {
+	// We can't release the input we haven't reached yet
+	offset = MIN(offset, this->offset);
+	if (offset <= this->released) {return;}
+	this->released = offset;
+	// The separators of the released input are indexed before it's gone,
+	// and once they're the bigger part of the index, we only keep their
+	// count.
+	LineIndex* index = &(this->lines);
+	Iterator__indexLines(this, offset);
+	size_t dropped = LineIndex__count(index, offset);
+	if (dropped > 0 && dropped * 2 >= index->count) {
+		memmove(index->offsets, index->offsets + dropped, (index->count - dropped) * sizeof(size_t));
+		index->count   -= dropped;
+		index->dropped += dropped;
+	}
+	if (this->freeInput == FileInput_free) {
+		FileInput_release(this);
+	}
+}
+
+size_t Iterator_lineAt ( Iterator* this, size_t offset ) {
+	Iterator__indexLines(this, offset);
+	return this->lines.dropped + LineIndex__count(&(this->lines), offset);
+}
+
+size_t Iterator_line ( Iterator* this ) {
+	return Iterator_lineAt(this, this->offset);
 }
 
 
@@ -255,13 +569,10 @@ bool String_move ( Iterator* this, int n ) {
 		// `c` is the number of elements we're actually agoing to move, which
 		// is either `n` or the number of elements left.
 		size_t c    = n <= left ? n : left;
-		// This iterates throught the characters and counts line separators.
-		while (c > 0) {
-			this->current++;
-			this->offset++;
-			if (*(this->current) == this->separator) {this->lines++;}
-			c--;
-		}
+		// Lines are counted when they're queried, so moving is only
+		// a matter of updating the position.
+		this->current += c;
+		this->offset  += c;
 		// We then store the amount of available
 		left = this->available - this->offset;
 		// DEBUG("String_move: moved forward by c=%zu, n=%d offset=%zu capacity=%zu, available=%zu, current-buffer=%ld", c_copy, n, this->offset, this->capacity, this->available, this->current - this->buffer);
@@ -301,8 +612,12 @@ FileInput* FileInput_new(const char* path ) {
 	__NEW(FileInput, this);
 	assert(this != NULL);
 	// We open the file
-	this->path = path;
-	this->file = fopen(path, "r");
+	this->path   = path;
+	this->data   = NULL;
+	this->size    = 0;
+	this->mapped  = 0;
+	this->dropped = 0;
+	this->file    = fopen(path, "r");
 	if (this->file==NULL) {
 		ERROR("Cannot open file: %s", path);
 		__FREE(this);
@@ -315,10 +630,47 @@ FileInput* FileInput_new(const char* path ) {
 void FileInput_free(void* this) {
 	TRACE("FileInput_free: %p", this)
 	FileInput* self = (FileInput*) this;
+	if (self != NULL && self->data != NULL) { munmap(self->data, self->mapped); }
 	if (self != NULL && self->file != NULL) { fclose(self->file);   }
 	__FREE(this);
 }
 
+void FileInput_release( Iterator* this ) {
+	FileInput* input = (FileInput*)this->input;
+	if (input == NULL || input->data == NULL) {return;}
+	// We can only give back whole pages
+	size_t page = (size_t)sysconf(_SC_PAGESIZE);
+	size_t end  = (this->released / page) * page;
+	if (end > input->dropped) {
+		madvise(input->data + input->dropped, end - input->dropped, MADV_DONTNEED);
+		input->dropped = end;
+	}
+}
+
+bool FileInput_map( FileInput* this ) {
+	struct stat info;
+	int fd = fileno(this->file);
+	// Pipes and devices have no size, and empty files can't be mapped
+	if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode) || info.st_size == 0) {return FALSE;}
+	size_t size   = (size_t)info.st_size;
+	size_t page   = (size_t)sysconf(_SC_PAGESIZE);
+	size_t mapped = (size / page + 1) * page;
+	// We reserve zeroed pages for the file and at least one more byte,
+	// and map the file over them, so that the data is terminated by a
+	// zero byte even when the file ends on a page boundary.
+	char* data = (char*)mmap(NULL, mapped, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (data == MAP_FAILED) {return FALSE;}
+	if (mmap(data, size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+		munmap(data, mapped);
+		return FALSE;
+	}
+	madvise(data, size, MADV_SEQUENTIAL);
+	this->data   = data;
+	this->size   = size;
+	this->mapped = mapped;
+	return TRUE;
+}
+
 size_t FileInput_preload( Iterator* this ) {
 	// We want to know if there is at one more element
 	// in the file input.
@@ -327,31 +679,45 @@ size_t FileInput_preload( Iterator* this ) {
 	size_t       left          = this->available - read;
 	size_t       until_eob     = this->capacity  - read;
 	DEBUG("FileInput_preload: %zu read, %zu available/%zu buffer capacity [%c]", read, this->available, this->capacity, this->status);
-	assert (left < this->capacity);
+	// Once the released input is dropped, the buffer may be full of data
+	// that is left to read.
+	assert (left <= this->capacity);
 	// Do the number of bytes up until the end of the buffer is less than
 	// ITERATOR_BUFFER_AHEAD, then we need to expand the the buffer and make
 	// sure we have ITERATOR_BUFFER_AHEAD data, unless we reach the end of the
 	// input stream.
 	if ( (this->available == 0 || until_eob < ITERATOR_BUFFER_AHEAD) && this->status != STATUS_INPUT_ENDED) {
-		// We move buffer[current:] to the begining of the buffer
-		// FIXME: We should make sure we don't call preload each time
-		// memmove((void*)this->buffer, (void*)this->current, left);
+		// We first drop the released input by moving the rest of the data
+		// to the begining of the buffer. We only do so when that frees
+		// at least ITERATOR_BUFFER_AHEAD, so that the data is not moved
+		// over and over.
+		size_t base     = Iterator_textOffset(this);
+		size_t dropped  = this->released > base ? this->released - base : 0;
+		if (dropped >= ITERATOR_BUFFER_AHEAD) {
+			DEBUG("<<< FileInput: dropping %zu released bytes", dropped)
+			memmove(this->buffer, this->buffer + dropped, this->available - dropped);
+			this->current   -= dropped;
+			this->available -= dropped;
+			until_eob       += dropped;
+		}
 		size_t delta    = this->current - this->buffer;
-		// We want to grow the buffer size by ITERATOR_BUFFER_AHEAD
-		this->capacity += ITERATOR_BUFFER_AHEAD;
-		// This assertion is a bit weird, but it does not hurt
-		assert(this->capacity + 1 > 0);
-		DEBUG("<<< FileInput: growing buffer to %zu", this->capacity + 1)
-		// FIXME: Not sure that realloc is a good idea, as any previous pointer
-		// to the buffer would change...
-		__RESIZE(this->buffer, this->capacity + 1);
-		assert(this->buffer != NULL);
-		// We need to update the current pointer as the buffer has changed
-		this->current = this->buffer + delta;
+		if (until_eob < ITERATOR_BUFFER_AHEAD) {
+			// We want to grow the buffer size by ITERATOR_BUFFER_AHEAD
+			this->capacity += ITERATOR_BUFFER_AHEAD;
+			// This assertion is a bit weird, but it does not hurt
+			assert(this->capacity + 1 > 0);
+			DEBUG("<<< FileInput: growing buffer to %zu", this->capacity + 1)
+			// NOTE: Any pointer to the buffer changes, which is why offsets
+			// within the input are always relative to `Iterator_textOffset`.
+			__RESIZE(this->buffer, this->capacity + 1);
+			assert(this->buffer != NULL);
+			// We need to update the current pointer as the buffer has changed
+			this->current = this->buffer + delta;
+		}
 		// We make sure we add a trailing \0 to the buffer
 		this->buffer[this->capacity] = '\0';
 		// We want to read as much as possible so that we fill the buffer
-		size_t to_read         = this->capacity - left;
+		size_t to_read         = this->capacity - this->available;
 		size_t read            = fread((char*)this->buffer + this->available, sizeof(char), to_read, input->file);
 		this->available        += read;
 		left                   += read;
@@ -366,24 +732,21 @@ size_t FileInput_preload( Iterator* this ) {
 	return left;
 }
 
-bool FileInput_move   ( Iterator* this, int n ) {
+// Moves within an input that is loaded in the iterator's buffer by the
+// given preload function, which tells how many bytes are ahead.
+static inline bool Iterator__moveBuffered( Iterator* this, int n, size_t (*preload)(Iterator*) ) {
 	if ( n == 0) {
 		// We're not moving position
 		return TRUE;
 	} else if ( n >= 0 ) {
 		// We're moving forward, so we want to know if there is at one more element
 		// in the file input.
-		size_t left = FileInput_preload(this);
+		size_t left = preload(this);
 		if (left > 0) {
 			int c = n > left ? left : n;
 			// We have enough space left in the buffer to read at least one character.
-			// We increase the head, copy
-			while (c > 0) {
-				this->current++;
-				this->offset++;
-				if (*(this->current) == this->separator) {this->lines++;}
-				c--;
-			}
+			this->current += c;
+			this->offset  += c;
 			DEBUG("[>] %d+%d == %zu (%zu bytes left)", ((int)this->offset) - n, n, this->offset, left);
 			if (n>left) {
 				this->status = STATUS_INPUT_ENDED;
@@ -392,17 +755,16 @@ bool FileInput_move   ( Iterator* this, int n ) {
 				return TRUE;
 			}
 		} else {
-			DEBUG("FileInput_move: end of input stream reach at %zu", this->offset);
+			DEBUG("Iterator__moveBuffered: end of input stream reach at %zu", this->offset);
 			assert (this->status == STATUS_INPUT_ENDED || this->status == STATUS_ENDED);
 			this->status = STATUS_ENDED;
 			return FALSE;
 		}
 	} else {
-		// The assert below is temporary, once we figure out when to free the input data
-		// that we don't need anymore this would work.
-		ASSERT(this->capacity > this->offset, "FileInput_move: offset is greater than capacity (%zu > %zu)", this->offset, this->capacity)
-		// We make sure that `n` is not bigger than the length of the available buffer
-		n = ((int)this->capacity )+ n < 0 ? 0 - (int)this->capacity : n;
+		// We can't go back further than the start of the buffer, as the
+		// input before it was released.
+		ASSERT((size_t)(0 - n) <= (size_t)(this->current - this->buffer), "Iterator__moveBuffered: backtracking before the released input (%zu < %zu)", this->offset + n, Iterator_textOffset(this))
+		n = MAX(n, (int)(this->buffer - this->current));
 		this->current = (((char*)this->current) + n);
 		this->offset += n;
 		if (n!=0) {this->status  = STATUS_PROCESSING;}
@@ -412,6 +774,86 @@ bool FileInput_move   ( Iterator* this, int n ) {
 	}
 }
 
+bool FileInput_move   ( Iterator* this, int n ) {
+	return Iterator__moveBuffered(this, n, FileInput_preload);
+}
+
+// ----------------------------------------------------------------------------
+//
+// READER INPUT
+//
+// ----------------------------------------------------------------------------
+
+static ssize_t ReaderInput__readFD(char* data, size_t length, void* context) {
+	ReaderInput* input = (ReaderInput*)context;
+	ssize_t      count = -1;
+	do {
+		count = read(input->fd, data, length);
+	} while (count < 0 && errno == EINTR);
+	return count;
+}
+
+ReaderInput* ReaderInput_new(ReaderCallback read, void* context) {
+	__NEW(ReaderInput, this);
+	assert(this != NULL);
+	this->read    = read != NULL ? read    : ReaderInput__readFD;
+	this->context = read != NULL ? context : (void*)this;
+	this->fd      = -1;
+	this->closeFD = FALSE;
+	this->error   = 0;
+	return this;
+}
+
+void ReaderInput_free(void* this) {
+	TRACE("ReaderInput_free: %p", this)
+	ReaderInput* self = (ReaderInput*) this;
+	if (self != NULL && self->closeFD && self->fd >= 0) { close(self->fd); }
+	__FREE(this);
+}
+
+size_t ReaderInput_preload( Iterator* this ) {
+	ReaderInput* input = (ReaderInput*)this->input;
+	// Reads can be short (pipes, sockets), so we keep reading until
+	// there is ITERATOR_BUFFER_AHEAD ahead or the input ended.
+	while (Iterator_remaining(this) < ITERATOR_BUFFER_AHEAD && this->status != STATUS_INPUT_ENDED) {
+		// We drop the released input as the file input does, when
+		// that frees at least ITERATOR_BUFFER_AHEAD.
+		size_t base    = Iterator_textOffset(this);
+		size_t dropped = this->released > base ? this->released - base : 0;
+		if (dropped >= ITERATOR_BUFFER_AHEAD) {
+			DEBUG("<<< ReaderInput: dropping %zu released bytes", dropped)
+			memmove(this->buffer, this->buffer + dropped, this->available - dropped);
+			this->current   -= dropped;
+			this->available -= dropped;
+		}
+		// We make room for a whole chunk, doubling the buffer so that
+		// an input that is never released is not copied over and over.
+		if (this->capacity - this->available < READER_INPUT_CHUNK) {
+			size_t delta    = this->current - this->buffer;
+			this->capacity  = MAX(this->capacity * 2, this->available + READER_INPUT_CHUNK);
+			DEBUG("<<< ReaderInput: growing buffer to %zu", this->capacity + 1)
+			__RESIZE(this->buffer, this->capacity + 1);
+			assert(this->buffer != NULL);
+			this->current   = this->buffer + delta;
+		}
+		ssize_t read = input->read(this->buffer + this->available, this->capacity - this->available, input->context);
+		if (read > 0) {
+			this->available += (size_t)read;
+		} else {
+			// A failed read ends the input, with what was read so far.
+			if (read < 0) {input->error = errno;}
+			DEBUG("ReaderInput_preload: end of input reached with %zu bytes available (error %d)", this->available, input->error);
+			this->status = STATUS_INPUT_ENDED;
+		}
+		this->buffer[this->available] = '\0';
+	}
+	return Iterator_remaining(this);
+}
+
+bool ReaderInput_move ( Iterator* this, int n ) {
+	return Iterator__moveBuffered(this, n, ReaderInput_preload);
+}
+
 // ----------------------------------------------------------------------------
 //
 // GRAMMAR
@@ -426,6 +868,12 @@ Grammar* Grammar_new(void) {
 	this->skipCount  = 0;
 	this->elements   = NULL;
 	this->isVerbose  = FALSE;
+	this->isMemoized = FALSE;
+	this->isVM       = FALSE;
+	this->program    = NULL;
+	this->keys       = NULL;
+	this->keysCount  = 0;
+	this->stats      = NULL;
 	return this;
 }
 
@@ -437,6 +885,50 @@ void Grammar_setSilent ( Grammar* this ) {
 	this->isVerbose = FALSE;
 }
 
+void Grammar_enableMemoize ( Grammar* this ) {
+	this->isMemoized = TRUE;
+}
+
+void Grammar_disableMemoize ( Grammar* this ) {
+	this->isMemoized = FALSE;
+}
+
+void Grammar_enableVM ( Grammar* this ) {
+	this->isVM = TRUE;
+}
+
+void Grammar_disableVM ( Grammar* this ) {
+	this->isVM = FALSE;
+}
+
+void Grammar_enableProfiling ( Grammar* this ) {
+	if (this->stats != NULL) {return;}
+	this->stats = ParsingStats_new();
+	if (this->elements != NULL) {
+		ParsingStats_setSymbolsCount(this->stats, this->axiomCount + this->skipCount + 1);
+	}
+}
+
+void Grammar_disableProfiling ( Grammar* this ) {
+	ParsingStats_free(this->stats);
+	this->stats = NULL;
+}
+
+int Grammar_key ( Grammar* this, const char* name ) {
+	if (this->keys == NULL) {
+		__ARRAY_NEW(keys, char*, 1);
+		this->keys      = keys;
+		__STRING_COPY(this->keys[KEY_DEPTH], "depth");
+		this->keysCount = 1;
+	}
+	for (int i=0 ; i<this->keysCount ; i++) {
+		if (strcmp(this->keys[i], name) == 0) {return i;}
+	}
+	__ARRAY_RESIZE(this->keys, char*, (size_t)(this->keysCount + 1));
+	__STRING_COPY(this->keys[this->keysCount], name);
+	return this->keysCount++;
+}
+
 int Grammar_symbolsCount(Grammar* this) {
 	return this->axiomCount + this->skipCount;
 }
@@ -463,6 +955,8 @@ void Grammar_freeElements(Grammar* this) {
 			}
 		}
 	}
+	ParsingProgram_free(this->program);
+	this->program    = NULL;
 	this->axiomCount = 0;
 	this->skipCount  = 0;
 	this->skip       = NULL;
@@ -473,6 +967,11 @@ void Grammar_freeElements(Grammar* this) {
 
 void Grammar_free(Grammar* this) {
 	Grammar_freeElements(this);
+	for (int i=0 ; i<this->keysCount ; i++) {
+		__FREE(this->keys[i]);
+	}
+	__FREE(this->keys);
+	ParsingStats_free(this->stats);
 	__FREE(this);
 }
 
@@ -482,14 +981,29 @@ void Grammar_free(Grammar* this) {
 //
 // ----------------------------------------------------------------------------
 
+// Creates a new match, in the given arena unless it is NULL
+Match* Match__new(ParsingArena* arena) {
+	if (arena == NULL) {return Match_new();}
+	Match* this     = (Match*)ParsingArena_alloc(arena, sizeof(Match));
+	this->status    = STATUS_INIT;
+	this->flags     = FLAG_ARENA;
+	this->offset    = 0;
+	this->length    = 0;
+	this->element   = NULL;
+	this->data      = NULL;
+	this->next      = NULL;
+	this->children  = NULL;
+	this->parent    = NULL;
+	this->result    = NULL;
+	return this;
+}
+
 Match* Match__Success(size_t length, Element* element, ParsingContext* context) {
-	NEW(Match,this);
+	Match* this = Match__new(context->arena);
 	assert( element != NULL );
 	this->status   = STATUS_MATCHED;
 	this->offset   = context->iterator->offset;
 	this->length   = length;
-	// FIXME: This should be the original line offset
-	this->line     = context->iterator->lines;
 	this->element  = (Element*)element;
 	this->data     = NULL;
 	this->next     = NULL;
@@ -510,9 +1024,9 @@ Match* Match_new(void) {
 	__NEW(Match,this);
 	// DEBUG("Allocating match: %p", this);
 	this->status    = STATUS_INIT;
+	this->flags     = 0;
 	this->offset    = 0;
 	this->length    = 0;
-	this->line      = 0;
 	this->element   = NULL;
 	this->data      = NULL;
 	this->next      = NULL;
@@ -523,7 +1037,7 @@ Match* Match_new(void) {
 }
 
 inline void Match_free__specialized(Match* this, ParsingElement* element) {
-	assert(ParsingElement_Is(this->element));
+	assert(element == NULL || ParsingElement_Is(element));
 	if (element!=NULL && this!=NULL){
 		switch (element->type) {
 			case TYPE_TOKEN:
@@ -533,10 +1047,9 @@ inline void Match_free__specialized(Match* this, ParsingElement* element) {
 	}
 }
 
-// TODO: We might want to recycle the objects for better performance and
-// fewer allocs.
+// NOTE: Matches allocated in an arena are freed along with the arena.
 void* Match_free(Match* this) {
-	if (this!=NULL && this!=FAILURE) {
+	if (this!=NULL && this!=FAILURE && !HAS_FLAG(this->flags, FLAG_ARENA)) {
 		TRACE("Match_free(%c:%d@%s,%lu-%lu):%p", ((ParsingElement*)this->element)->type, ((ParsingElement*)this->element)->id, ((ParsingElement*)this->element)->name, this->offset, this->offset + this->length, this)
 
 		// We free the children
@@ -674,15 +1187,36 @@ int Match_countChildren(Match* this) {
 	return count;
 }
 
+// Returns a copy of the match's node that shares its data and children,
+// which is how memoized matches are returned (see `ParsingMemo`). The
+// copy's `next` is `NULL`, so that the caller can link it.
+static inline Match* Match__share(Match* this, ParsingArena* arena) {
+	Match* copy    = Match__new(arena);
+	copy->status   = this->status;
+	copy->offset   = this->offset;
+	copy->length   = this->length;
+	copy->element  = this->element;
+	copy->data     = this->data;
+	copy->children = this->children;
+	return copy;
+}
+
 // ============================================================================
 // JSON FORMATTING
 // ============================================================================
 
+// The serializers write to a buffered `Writer`, rather than to a file
+// descriptor for each fragment.
+#undef  WRITE
+#undef  WRITEF
+#define WRITE(m)        Writer_print(writer, m)
+#define WRITEF(m,...)   Writer_printf(writer, m, __VA_ARGS__)
+#define WRITE_ESCAPED(s,l) Writer_printEscaped(writer, s, l)
 
 #define JSON_ELEMENT_START(e) if (e->name) {WRITE("{\"name\":\"");WRITE(e->name);WRITE("\"");} else {WRITE("{\"id\":");WRITEF("%d",e->id);}
 #define JSON_ELEMENT_END(e)   WRITE("}")
 
-void Match__childrenWriteJSON(Match* match, int fd, int flags) {
+void Match__childrenWriteJSON(Match* match, Writer* writer, int flags) {
 	int count = 0 ;
 	Match* child = match->children;
 	while (child != NULL) {
@@ -697,7 +1231,7 @@ void Match__childrenWriteJSON(Match* match, int fd, int flags) {
 	while (child != NULL) {
 		ParsingElement* element = ParsingElement_Ensure(child->element);
 		if (element->type != TYPE_PROCEDURE && element->type != TYPE_CONDITION) {
-			Match__writeJSON(child, fd, flags);
+			Match__writeJSON(child, writer, flags);
 			if ( (i+1) < count ) {
 				WRITE(",");
 			}
@@ -707,7 +1241,7 @@ void Match__childrenWriteJSON(Match* match, int fd, int flags) {
 	}
 }
 
-void Match__writeJSON(Match* match, int fd, int flags) {
+void Match__writeJSON(Match* match, Writer* writer, int flags) {
 	if (match == NULL || match->element == NULL) {
 		WRITE("null");
 		return;
@@ -718,10 +1252,10 @@ void Match__writeJSON(Match* match, int fd, int flags) {
 	if (element->type == TYPE_REFERENCE) {
 		Reference* ref = (Reference*)match->element;
 		if (ref->cardinality == CARDINALITY_ONE || ref->cardinality == CARDINALITY_NOT_EMPTY || ref->cardinality == CARDINALITY_OPTIONAL) {
-			Match__writeJSON(match->children, fd, flags);
+			Match__writeJSON(match->children, writer, flags);
 		} else {
 			WRITE("[");
-			Match__childrenWriteJSON(match, fd, flags);
+			Match__childrenWriteJSON(match, writer, flags);
 			WRITE("]");
 		}
 	}
@@ -729,14 +1263,14 @@ void Match__writeJSON(Match* match, int fd, int flags) {
 		//printf("{\"type\":\"%c\",\"name\":%s,\"start\":%l ,\"length\":%l ,\"value\":", element->type, element->name, match->offset, match->length);
 		int i     = 0;
 		int count = 0;
-		char* word = NULL;
+		size_t length = 0;
+		const char* slice = NULL;
 		switch(element->type) {
 			case TYPE_WORD:
-				word = String_escape(Word_word(element));
+				slice = Word_word(element);
 				JSON_ELEMENT_START(element);
-				WRITE(",\"value\":\"");WRITE(word);WRITE("\"");
+				WRITE(",\"value\":\"");WRITE_ESCAPED(slice, strlen(slice));WRITE("\"");
 				JSON_ELEMENT_END(element);
-				free(word);
 				break;
 			case TYPE_TOKEN:
 				count = TokenMatch_count(match);
@@ -745,18 +1279,17 @@ void Match__writeJSON(Match* match, int fd, int flags) {
 					JSON_ELEMENT_END(element);
 				} else if (count == 1) {
 					JSON_ELEMENT_START(element);
-					word = String_escape(TokenMatch_group(match, 0));
-					WRITE(",\"value\":\"");WRITE(word);WRITE("\"");
-					free(word);
+					// We write the groups straight from the input
+					slice = TokenMatch_slice(match, 0, &length);
+					WRITE(",\"value\":\"");WRITE_ESCAPED(slice, length);WRITE("\"");
 					JSON_ELEMENT_END(element);
 				} else {
 					JSON_ELEMENT_START(element);
 					WRITE(",\"content\":[");
 					for (i=0 ; i < count ; i++) {
-						word = String_escape(TokenMatch_group(match, i));
-						WRITE("\"");WRITE(word);WRITE("\"");
+						slice = TokenMatch_slice(match, i, &length);
+						WRITE("\"");WRITE_ESCAPED(slice, length);WRITE("\"");
 						if (i+1 < count) {WRITE(",");}
-						free(word);
 					}
 					WRITE("]");
 					JSON_ELEMENT_END(element);
@@ -770,7 +1303,7 @@ void Match__writeJSON(Match* match, int fd, int flags) {
 				} else {
 					JSON_ELEMENT_START(element);
 					WRITE(",\"content\":[");
-					Match__childrenWriteJSON(match, fd, flags);
+					Match__childrenWriteJSON(match, writer, flags);
 					WRITE("]");
 					JSON_ELEMENT_END(element);
 				}
@@ -787,8 +1320,14 @@ void Match__writeJSON(Match* match, int fd, int flags) {
 	}
 }
 
+void Match_dumpJSON(Match* this, Writer* writer) {
+	Match__writeJSON(this, writer, 0);
+}
+
 void Match_writeJSON(Match* this, int fd) {
-	Match__writeJSON(this, fd, 0);
+	Writer* writer = Writer_FromFD(fd);
+	Match__writeJSON(this, writer, 0);
+	Writer_free(writer);
 }
 
 
@@ -805,7 +1344,7 @@ void Match_printJSON(Match* this) {
 #define WRITE_ELEMENT_END(e)   if (e->name != NULL) {WRITE("</") ; WRITE_ELEMENT_NAME(e) ; WRITE(">");}
 #define WRITE_CDATA(s)         WRITE("<![CDATA[") ; WRITE(s) ; WRITE("]]>")
 
-void Match__childrenWriteXML(Match* match, int fd, int flags) {
+void Match__childrenWriteXML(Match* match, Writer* writer, int flags) {
 	int count = 0 ;
 	Match* child = match->children;
 	while (child != NULL) {
@@ -820,14 +1359,14 @@ void Match__childrenWriteXML(Match* match, int fd, int flags) {
 	while (child != NULL) {
 		ParsingElement* element = ParsingElement_Ensure(child->element);
 		if (element->type != TYPE_PROCEDURE && element->type != TYPE_CONDITION) {
-			Match__writeXML(child, fd, flags);
+			Match__writeXML(child, writer, flags);
 			i += 1;
 		}
 		child = child->next;
 	}
 }
 
-void Match__writeXML(Match* match, int fd, int flags) {
+void Match__writeXML(Match* match, Writer* writer, int flags) {
 	if (match == NULL || match->element == NULL) {
 		return;
 	}
@@ -836,15 +1375,17 @@ void Match__writeXML(Match* match, int fd, int flags) {
 	if (element->type == TYPE_REFERENCE) {
 		Reference* ref = (Reference*)match->element;
 		if (ref->cardinality == CARDINALITY_ONE || ref->cardinality == CARDINALITY_NOT_EMPTY || ref->cardinality == CARDINALITY_OPTIONAL) {
-			Match__writeXML(match->children, fd, flags);
+			Match__writeXML(match->children, writer, flags);
 		} else {
-			Match__childrenWriteXML(match, fd, flags);
+			Match__childrenWriteXML(match, writer, flags);
 		}
 	}
 
 	else if (element->type != TYPE_REFERENCE) {
-		int i     = 0;
-		int count = 0;
+		int         i      = 0;
+		int         count  = 0;
+		size_t      length = 0;
+		const char* slice  = NULL;
 		switch(element->type) {
 			case TYPE_WORD:
 				if (element->name != NULL) {
@@ -865,21 +1406,24 @@ void Match__writeXML(Match* match, int fd, int flags) {
 						WRITE("/>");
 					}
 				} else if (count == 1) {
+					// We write the groups straight from the input
+					slice = TokenMatch_slice(match, i, &length);
 					if (element->name != NULL) {
 						WRITE("<");
 						WRITE_ELEMENT_NAME(element);
 						WRITE(" t=\"");
-						WRITE(TokenMatch_group(match, i));
+						Writer_write(writer, slice, length);
 						WRITE("\"/>");
 					} else {
-						WRITE(TokenMatch_group(match, i));
+						Writer_write(writer, slice, length);
 					}
 				} else {
 					if (element->name != NULL) {
 						WRITE_ELEMENT_START(element);
 						for (i=0 ; i < count ; i++) {
+							slice = TokenMatch_slice(match, i, &length);
 							WRITE("<g t=\"");
-							WRITE(TokenMatch_group(match, i));
+							Writer_write(writer, slice, length);
 							WRITE("\"/>");
 						}
 						WRITE_ELEMENT_END(element);
@@ -894,10 +1438,10 @@ void Match__writeXML(Match* match, int fd, int flags) {
 				} else {
 					if (element->name != NULL) {
 						WRITE_ELEMENT_START(element);
-						Match__writeXML(match->children, fd, flags);
+						Match__writeXML(match->children, writer, flags);
 						WRITE_ELEMENT_END(element);
 					} else {
-						Match__writeXML(match->children, fd, flags);
+						Match__writeXML(match->children, writer, flags);
 					}
 				}
 				break;
@@ -906,10 +1450,10 @@ void Match__writeXML(Match* match, int fd, int flags) {
 				} else {
 					if (element->name != NULL) {
 						WRITE_ELEMENT_START(element);
-						Match__childrenWriteXML(match, fd, flags);
+						Match__childrenWriteXML(match, writer, flags);
 						WRITE_ELEMENT_END(element);
 					} else {
-						Match__childrenWriteXML(match, fd, flags);
+						Match__childrenWriteXML(match, writer, flags);
 					}
 				}
 				break;
@@ -929,77 +1473,645 @@ void Match_printXML(Match* this) {
 	Match_writeXML(this, 1);
 }
 
-void Match_writeXML(Match* this, int fd ) {
+void Match_dumpXML(Match* this, Writer* writer) {
 	WRITE("<?xml version=\"1.0\" encoding=\"UTF-8\" standalone=\"no\" ?>\n");
-	Match__writeXML(this, fd, 0);
+	Match__writeXML(this, writer, 0);
 }
 
-// ----------------------------------------------------------------------------
-//
-// PERSING ELEMENT
-//
-// ----------------------------------------------------------------------------
+void Match_writeXML(Match* this, int fd ) {
+	Writer* writer = Writer_FromFD(fd);
+	Match_dumpXML(this, writer);
+	Writer_free(writer);
+}
 
-bool ParsingElement_Is(void *this) {
-	if (this == NULL) { return FALSE; }
-	switch (((ParsingElement*)this)->type) {
-		// It is not a parsing element if it is a refernence
-		case TYPE_ELEMENT:
-		case TYPE_WORD:
-		case TYPE_TOKEN:
-		case TYPE_GROUP:
-		case TYPE_RULE:
-		case TYPE_CONDITION:
-		case TYPE_PROCEDURE:
+// ============================================================================
+// BINARY FORMAT
+// ============================================================================
+
+#define BINARY_FOOTER 8
+
+static inline void Writer__varint( Writer* this, uint64_t value ) {
+	char  bytes[10];
+	int   n = 0;
+	while (value >= 0x80) {
+		bytes[n++] = (char)((value & 0x7F) | 0x80);
+		value    >>= 7;
+	}
+	bytes[n++] = (char)value;
+	Writer_write(this, bytes, n);
+}
+
+// Signed values are zig-zag encoded, so that small negative values stay small
+static inline void Writer__svarint( Writer* this, int64_t value ) {
+	Writer__varint(this, ((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+}
+
+static inline bool Binary__varint( const char** data, const char* end, uint64_t* value ) {
+	const unsigned char* p = (const unsigned char*)*data;
+	uint64_t result = 0;
+	int      shift  = 0;
+	while ((const char*)p < end && shift < 64) {
+		unsigned char c = *p++;
+		result |= ((uint64_t)(c & 0x7F)) << shift;
+		if ((c & 0x80) == 0) {
+			*data  = (const char*)p;
+			*value = result;
 			return TRUE;
-		default:
-			return FALSE;
+		}
+		shift += 7;
 	}
+	return FALSE;
 }
 
-ParsingElement* ParsingElement_Ensure(void* elementOrReference) {
-	void * element = elementOrReference;
-	assert(element!=NULL);
-	assert(Reference_Is(element) || ParsingElement_Is(element));
-	return Reference_Is(element) ? ((Reference*)element)->element : (ParsingElement*)element;
+static inline bool Binary__svarint( const char** data, const char* end, int64_t* value ) {
+	uint64_t v = 0;
+	if (!Binary__varint(data, end, &v)) {return FALSE;}
+	*value = (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+	return TRUE;
 }
 
-ParsingElement* ParsingElement_new(Reference* children[]) {
-	__NEW(ParsingElement, this);
-	this->type      = TYPE_ELEMENT;
-	this->id        = ID_UNBOUND;
-	this->name      = NULL;
-	this->config    = NULL;
-	this->children  = NULL;
-	this->recognize = NULL;
-	this->process   = NULL;
-	if (children != NULL && *children != NULL) {
-		Reference* r = Reference_Ensure(*children);
-		while ( r != NULL ) {
-			DEBUG("ParsingElement: %s adding child: %s", this->name, r->element->name)
-			// FIXME: Make sure how memory is managed here
-			ParsingElement_add(this, r);
-			r = *(++children);
+static void Match__writeBinaryNode( Match* this, Writer* writer, size_t previous ) {
+	Element* element  = this->element;
+	size_t   children = 0;
+	for (Match* child = this->children ; child != NULL ; child = child->next) {children++;}
+	bool     groups   = element->type == TYPE_TOKEN && this->data != NULL;
+	Writer__varint(writer, (uint64_t)element->id);
+	Writer__svarint(writer, (int64_t)this->offset - (int64_t)previous);
+	Writer__varint(writer, this->length);
+	Writer__varint(writer, (children << 1) | (groups ? 1 : 0));
+	if (groups) {
+		TokenMatch* token = (TokenMatch*)this->data;
+		Writer__varint(writer, (uint64_t)token->count);
+		for (int i=0 ; i<token->count ; i++) {
+			int start = token->spans[i * 2];
+			int end   = token->spans[i * 2 + 1];
+			Writer__varint(writer, start < 0 ? 0 : (uint64_t)start + 1);
+			Writer__varint(writer, start < 0 ? 0 : (uint64_t)(end - start));
+		}
+	}
+}
+
+void Match_writeBinary(Match* this, Writer* writer) {
+	size_t start = writer->flushed + writer->length;
+	Writer_write(writer, BINARY_MAGIC, 4);
+	size_t nodes = 0;
+	// We walk the tree in pre-order without recursing, as trees can be
+	// deep, and keep the elements we came across for the names table.
+	Element** elements      = NULL;
+	int       elementsCount = 0;
+	Match**   stack         = NULL;
+	size_t    depth         = 0;
+	size_t    capacity      = 0;
+	size_t    previous      = 0;
+	Match*    match         = Match_isSuccess(this) ? this : NULL;
+	while (match != NULL) {
+		Element* element = match->element;
+		assert(element != NULL && element->id >= 0);
+		if (element->id >= elementsCount) {
+			int count = MAX(element->id + 1, elementsCount * 2);
+			__ARRAY_RESIZE(elements, Element*, count);
+			memset(elements + elementsCount, 0, sizeof(Element*) * (count - elementsCount));
+			elementsCount = count;
+		}
+		elements[element->id] = element;
+		Match__writeBinaryNode(match, writer, previous);
+		previous = match->offset;
+		nodes++;
+		// The next node is the first child, or the next sibling of the
+		// closest node that has one, the root having no siblings.
+		if (match->children != NULL) {
+			if (depth == capacity) {
+				capacity = capacity == 0 ? 64 : capacity * 2;
+				__ARRAY_RESIZE(stack, Match*, capacity);
+			}
+			stack[depth++] = match == this ? NULL : match->next;
+			match = match->children;
+		} else {
+			match = match == this ? NULL : match->next;
+			while (match == NULL && depth > 0) {match = stack[--depth];}
 		}
 	}
+	__FREE(stack);
+	// The table goes after the nodes, so that the tree is written in one
+	// pass, and its offset is in the footer.
+	size_t table = writer->flushed + writer->length - start;
+	Writer__varint(writer, nodes);
+	int names = 0;
+	for (int i=0 ; i<elementsCount ; i++) {if (elements[i] != NULL) {names++;}}
+	Writer__varint(writer, (uint64_t)names);
+	for (int i=0 ; i<elementsCount ; i++) {
+		Element* element = elements[i];
+		if (element == NULL) {continue;}
+		const char* name   = element->name == NULL ? "" : element->name;
+		size_t      length = strlen(name);
+		Writer__varint(writer, (uint64_t)i);
+		Writer_write(writer, &element->type, 1);
+		Writer__varint(writer, length);
+		// Names are zero-terminated, so that readers can point to them
+		Writer_write(writer, name, length + 1);
+	}
+	__FREE(elements);
+	unsigned char footer[BINARY_FOOTER];
+	for (int i=0 ; i<BINARY_FOOTER ; i++) {footer[i] = (unsigned char)(((uint64_t)table >> (i * 8)) & 0xFF);}
+	Writer_write(writer, (const char*)footer, BINARY_FOOTER);
+}
+
+MatchReader* MatchReader_new(const char* data, size_t length) {
+	if (data == NULL || length < 4 + BINARY_FOOTER || memcmp(data, BINARY_MAGIC, 4) != 0) {return NULL;}
+	uint64_t table = 0;
+	for (int i=0 ; i<BINARY_FOOTER ; i++) {table |= ((uint64_t)(unsigned char)data[length - BINARY_FOOTER + i]) << (i * 8);}
+	if (table < 4 || table > length - BINARY_FOOTER) {return NULL;}
+	const char* p     = data + table;
+	const char* end   = data + length - BINARY_FOOTER;
+	uint64_t    nodes = 0;
+	uint64_t    names = 0;
+	if (!Binary__varint(&p, end, &nodes) || !Binary__varint(&p, end, &names)) {return NULL;}
+	__NEW(MatchReader, this);
+	this->data        = data;
+	this->length      = length;
+	this->position    = 4;
+	this->end         = (size_t)table;
+	this->count       = (size_t)nodes;
+	this->read        = 0;
+	this->offset      = 0;
+	this->names       = NULL;
+	this->types       = NULL;
+	this->namesCount  = 0;
+	this->spans       = NULL;
+	this->spansCount  = 0;
+	for (uint64_t i=0 ; i<names ; i++) {
+		uint64_t id   = 0;
+		uint64_t size = 0;
+		if (!Binary__varint(&p, end, &id) || id > INT_MAX || p >= end) {MatchReader_free(this); return NULL;}
+		char type = *p++;
+		if (!Binary__varint(&p, end, &size) || size >= (uint64_t)(end - p) || p[size] != '\0') {MatchReader_free(this); return NULL;}
+		if ((int)id >= this->namesCount) {
+			int count = MAX((int)id + 1, this->namesCount * 2);
+			__ARRAY_RESIZE(this->names, const char*, count);
+			__ARRAY_RESIZE(this->types, char, count);
+			memset(this->names + this->namesCount, 0, sizeof(const char*) * (count - this->namesCount));
+			memset(this->types + this->namesCount, 0, sizeof(char) * (count - this->namesCount));
+			this->namesCount = count;
+		}
+		this->names[id] = p;
+		this->types[id] = type;
+		p += size + 1;
+	}
 	return this;
 }
 
-void ParsingElement_freeChildren( ParsingElement* this ) {
+void MatchReader_free(MatchReader* this) {
 	if (this == NULL) {return;}
-	Reference* child = this->children;
-	while (child != NULL) {
-		Reference* next = child->next;
-		assert(Reference_Is(child));
-		Reference_free(child);
-		child = next;
-	}
+	__FREE(this->names);
+	__FREE(this->types);
+	__FREE(this->spans);
+	__FREE(this);
 }
 
+bool MatchReader_next(MatchReader* this, MatchNode* node) {
+	if (this->read >= this->count) {return FALSE;}
+	const char* p     = this->data + this->position;
+	const char* end   = this->data + this->end;
+	uint64_t    id    = 0;
+	int64_t     delta = 0;
+	uint64_t    length   = 0;
+	uint64_t    children = 0;
+	if (!Binary__varint(&p, end, &id) || !Binary__svarint(&p, end, &delta) || !Binary__varint(&p, end, &length) || !Binary__varint(&p, end, &children)) {return FALSE;}
+	if (id >= (uint64_t)this->namesCount || this->names[id] == NULL) {return FALSE;}
+	if (delta < 0 && (uint64_t)(-delta) > this->offset) {return FALSE;}
+	if (delta > 0 && (uint64_t)delta > SIZE_MAX - this->offset) {return FALSE;}
+	// Only tokens have groups, and they always have some
+	if (((children & 1) != 0) != (this->types[id] == TYPE_TOKEN)) {return FALSE;}
+	node->id       = (int)id;
+	node->type     = this->types[id];
+	node->name     = this->names[id];
+	node->offset   = (size_t)((int64_t)this->offset + delta);
+	node->length   = (size_t)length;
+	node->children = (size_t)(children >> 1);
+	if (node->length > SIZE_MAX - node->offset) {return FALSE;}
+	node->groups   = 0;
+	node->spans    = NULL;
+	if (children & 1) {
+		uint64_t count = 0;
+		if (!Binary__varint(&p, end, &count) || count == 0 || count > (uint64_t)(end - p)) {return FALSE;}
+		if ((int)count * 2 > this->spansCount) {
+			this->spansCount = (int)count * 2;
+			__ARRAY_RESIZE(this->spans, int, this->spansCount);
+		}
+		for (uint64_t i=0 ; i<count ; i++) {
+			uint64_t start = 0;
+			uint64_t size  = 0;
+			if (!Binary__varint(&p, end, &start) || !Binary__varint(&p, end, &size)) {return FALSE;}
+			// The groups are within the node, whose spans are ints
+			if (start > 0 && (start - 1 > length || size > length - (start - 1) || length > INT_MAX)) {return FALSE;}
+			this->spans[i * 2]     = start == 0 ? -1 : (int)(start - 1);
+			this->spans[i * 2 + 1] = start == 0 ? -1 : (int)(start - 1 + size);
+		}
+		node->groups = (int)count;
+		node->spans  = this->spans;
+	}
+	this->offset   = node->offset;
+	this->position = (size_t)(p - this->data);
+	this->read++;
+	return TRUE;
+}
 
-void ParsingElement_free(ParsingElement* this) {
-	// NOTE: We don't want/need to free the children as the Grammar already
-	// holds a table of all elements.
+Match* Match_readBinary(ParsingContext* context, const char* data, size_t length) {
+	MatchReader* reader = MatchReader_new(data, length);
+	if (reader == NULL) {return NULL;}
+	Grammar* grammar  = context->grammar;
+	int      elements = grammar->axiomCount + grammar->skipCount + 1;
+	// The elements must be the ones the tree was written with
+	for (int i=0 ; i<reader->namesCount ; i++) {
+		if (reader->names[i] == NULL) {continue;}
+		Element* element = i < elements ? grammar->elements[i] : NULL;
+		if (element == NULL || element->type != reader->types[i] || strcmp(element->name == NULL ? "" : element->name, reader->names[i]) != 0) {
+			MatchReader_free(reader);
+			return NULL;
+		}
+	}
+	// The nodes come in pre-order, so we keep the nodes whose children
+	// are still to be read, along with their last child.
+	typedef struct {Match* match; size_t remaining; Match* last;} Parent;
+	Parent*   stack    = NULL;
+	size_t    depth    = 0;
+	size_t    capacity = 0;
+	Match*    root     = FAILURE;
+	MatchNode node;
+	size_t    read     = 0;
+	// The nodes must be within the input, as their text is read from it
+	Iterator* iterator = context->iterator;
+	size_t    input    = iterator == NULL ? SIZE_MAX : Iterator_textOffset(iterator) + iterator->available;
+	while (MatchReader_next(reader, &node)) {
+		if (node.offset + node.length > input) {break;}
+		Match* match   = Match__new(context->arena);
+		match->status  = STATUS_MATCHED;
+		match->offset  = node.offset;
+		match->length  = node.length;
+		match->element = grammar->elements[node.id];
+		if (node.spans != NULL) {
+			TokenMatch* token = TokenMatch__new(context->arena, context->iterator, node.groups);
+			memcpy(token->spans, node.spans, sizeof(int) * node.groups * 2);
+			match->data = token;
+		}
+		if (depth == 0) {
+			if (read > 0) {break;}
+			root = match;
+		} else {
+			Parent* parent = &stack[depth - 1];
+			if (parent->last == NULL) {parent->match->children = match;} else {parent->last->next = match;}
+			parent->last = match;
+			parent->remaining--;
+		}
+		read++;
+		if (node.children > 0) {
+			if (depth == capacity) {
+				capacity = capacity == 0 ? 64 : capacity * 2;
+				__ARRAY_RESIZE(stack, Parent, capacity);
+			}
+			stack[depth].match     = match;
+			stack[depth].remaining = node.children;
+			stack[depth].last      = NULL;
+			depth++;
+		}
+		while (depth > 0 && stack[depth - 1].remaining == 0) {depth--;}
+	}
+	bool complete = read == reader->count && depth == 0;
+	__FREE(stack);
+	MatchReader_free(reader);
+	return complete ? root : NULL;
+}
+
+ParsingResult* Grammar_readBinary( Grammar* this, Iterator* iterator, const char* data, size_t length ) {
+	if (this->elements == NULL) {Grammar_prepare(this);}
+	ParsingContext* context = ParsingContext_new(this, iterator);
+	Match*          match   = Match_readBinary(context, data, length);
+	if (match == NULL) {
+		ParsingContext_free(context);
+		return NULL;
+	}
+	if (Match_isSuccess(match)) {Iterator_moveTo(iterator, match->offset + match->length);}
+	return ParsingResult_new(match, context);
+}
+
+// ----------------------------------------------------------------------------
+//
+// MATCH TREE
+//
+// ----------------------------------------------------------------------------
+
+#define MATCH_TREE_CAPACITY 1024
+
+static void MatchTree__reserve( MatchTree* this ) {
+	if (this->count < this->capacity) {return;}
+	this->capacity = this->capacity == 0 ? MATCH_TREE_CAPACITY : this->capacity * 2;
+	__ARRAY_RESIZE(this->offsets,  uint32_t, (size_t)this->capacity);
+	__ARRAY_RESIZE(this->lengths,  uint32_t, (size_t)this->capacity);
+	__ARRAY_RESIZE(this->elements, int32_t,  (size_t)this->capacity);
+	__ARRAY_RESIZE(this->children, int32_t,  (size_t)this->capacity);
+	__ARRAY_RESIZE(this->next,     int32_t,  (size_t)this->capacity);
+}
+
+// Appends the node for the given match, returning its index, or -1 if it
+// does not fit in the tree.
+static inline int MatchTree__add( MatchTree* this, Match* match ) {
+	if (match->offset + match->length > UINT32_MAX || this->count == INT32_MAX) {return -1;}
+	MatchTree__reserve(this);
+	int node = this->count++;
+	this->offsets[node]  = (uint32_t)match->offset;
+	this->lengths[node]  = (uint32_t)match->length;
+	this->elements[node] = match->element->id;
+	this->children[node] = -1;
+	this->next[node]     = -1;
+	return node;
+}
+
+typedef struct MatchTreeFrame {
+	Match* match;     // The next match to add, among the parent's children
+	int    parent;
+	int    previous;  // The previously added sibling, -1 for the first child
+} MatchTreeFrame;
+
+MatchTree* MatchTree_new(Match* match, Grammar* grammar) {
+	if (!Match_isSuccess(match)) {return NULL;}
+	__NEW(MatchTree, this);
+	this->offsets  = NULL;
+	this->lengths  = NULL;
+	this->elements = NULL;
+	this->children = NULL;
+	this->next     = NULL;
+	this->count    = 0;
+	this->capacity = 0;
+	this->grammar  = grammar;
+	// The nodes are added in pre-order without recursing, as trees can be
+	// deep, each frame going through the children of a node.
+	MatchTreeFrame* stack    = NULL;
+	size_t          depth    = 0;
+	size_t          capacity = 0;
+	bool            valid    = MatchTree__add(this, match) == 0;
+	if (valid && match->children != NULL) {
+		capacity = 64;
+		__ARRAY_RESIZE(stack, MatchTreeFrame, capacity);
+		stack[depth++] = (MatchTreeFrame){match->children, 0, -1};
+	}
+	while (valid && depth > 0) {
+		MatchTreeFrame* frame = &stack[depth - 1];
+		Match*          child = frame->match;
+		if (child == NULL) {depth--; continue;}
+		int node = MatchTree__add(this, child);
+		if (node < 0) {valid = FALSE; break;}
+		if (frame->previous < 0) {this->children[frame->parent] = node;}
+		else                     {this->next[frame->previous]   = node;}
+		frame->previous = node;
+		frame->match    = child->next;
+		if (child->children != NULL) {
+			if (depth == capacity) {
+				capacity *= 2;
+				__ARRAY_RESIZE(stack, MatchTreeFrame, capacity);
+			}
+			stack[depth++] = (MatchTreeFrame){child->children, node, -1};
+		}
+	}
+	__FREE(stack);
+	if (!valid) {
+		MatchTree_free(this);
+		return NULL;
+	}
+	// The tree does not grow anymore, so we give back the spare capacity
+	this->capacity = this->count;
+	__ARRAY_RESIZE(this->offsets,  uint32_t, (size_t)this->capacity);
+	__ARRAY_RESIZE(this->lengths,  uint32_t, (size_t)this->capacity);
+	__ARRAY_RESIZE(this->elements, int32_t,  (size_t)this->capacity);
+	__ARRAY_RESIZE(this->children, int32_t,  (size_t)this->capacity);
+	__ARRAY_RESIZE(this->next,     int32_t,  (size_t)this->capacity);
+	return this;
+}
+
+void MatchTree_free(MatchTree* this) {
+	if (this == NULL) {return;}
+	__FREE(this->offsets);
+	__FREE(this->lengths);
+	__FREE(this->elements);
+	__FREE(this->children);
+	__FREE(this->next);
+	__FREE(this);
+}
+
+int MatchTree_getOffset(MatchTree* this, int node) {
+	return node >= 0 ? (int)this->offsets[node] : -1;
+}
+
+int MatchTree_getLength(MatchTree* this, int node) {
+	return node >= 0 ? (int)this->lengths[node] : 0;
+}
+
+int MatchTree_getEndOffset(MatchTree* this, int node) {
+	return node >= 0 ? (int)(this->offsets[node] + this->lengths[node]) : -1;
+}
+
+int MatchTree_getElementID(MatchTree* this, int node) {
+	return node >= 0 ? this->elements[node] : -1;
+}
+
+Element* MatchTree_getElement(MatchTree* this, int node) {
+	return node >= 0 ? this->grammar->elements[this->elements[node]] : NULL;
+}
+
+ParsingElement* MatchTree_getParsingElement(MatchTree* this, int node) {
+	Element* element = MatchTree_getElement(this, node);
+	return element != NULL ? ParsingElement_Ensure(element) : NULL;
+}
+
+const char* MatchTree_getElementName(MatchTree* this, int node) {
+	Element* element = MatchTree_getElement(this, node);
+	return element != NULL ? element->name : NULL;
+}
+
+bool MatchTree_hasNext(MatchTree* this, int node) {
+	return node >= 0 && this->next[node] >= 0;
+}
+
+int MatchTree_getNext(MatchTree* this, int node) {
+	return node >= 0 ? this->next[node] : -1;
+}
+
+bool MatchTree_hasChildren(MatchTree* this, int node) {
+	return node >= 0 && this->children[node] >= 0;
+}
+
+int MatchTree_getChildren(MatchTree* this, int node) {
+	return node >= 0 ? this->children[node] : -1;
+}
+
+int MatchTree_countChildren(MatchTree* this, int node) {
+	int count = 0;
+	for (int child = MatchTree_getChildren(this, node) ; child >= 0 ; child = this->next[child]) {
+		count++;
+	}
+	return count;
+}
+
+// ----------------------------------------------------------------------------
+//
+// MATCH BUFFER
+//
+// ----------------------------------------------------------------------------
+
+// Goes through the tree in pre-order, counting the records and the spans,
+// and filling them in once they are allocated. Returns FALSE if the tree
+// does not fit in the buffer.
+static bool MatchBuffer__walk( MatchBuffer* this, Match* match ) {
+	size_t capacity = 64;
+	size_t depth    = 0;
+	__ARRAY_NEW(stack, MatchTreeFrame, capacity);
+	stack[depth++] = (MatchTreeFrame){match, -1, -1};
+	int32_t count  = 0;
+	int32_t spans  = 0;
+	bool    valid  = TRUE;
+	while (depth > 0) {
+		MatchTreeFrame* frame = &stack[depth - 1];
+		Match*          node  = frame->match;
+		if (node == NULL) {depth--; continue;}
+		// The root's siblings are not part of the tree
+		frame->match = frame->parent < 0 ? NULL : node->next;
+		int groups   = node->element->type == TYPE_TOKEN && node->data != NULL ? ((TokenMatch*)node->data)->count : 0;
+		if (node->offset + node->length > INT32_MAX || count == INT32_MAX || spans > INT32_MAX - groups * 2) {
+			valid = FALSE;
+			break;
+		}
+		if (this->records != NULL) {
+			MatchRecord* record = &this->records[count];
+			record->type   = node->element->type;
+			record->id     = node->element->id;
+			record->offset = (int32_t)node->offset;
+			record->length = (int32_t)node->length;
+			record->parent = frame->parent;
+			record->next   = -1;
+			record->groups = groups;
+			record->spans  = spans;
+			if (frame->previous >= 0) {this->records[frame->previous].next = count;}
+			for (int i=0 ; i<groups ; i++) {
+				int start = ((TokenMatch*)node->data)->spans[i * 2];
+				int end   = ((TokenMatch*)node->data)->spans[i * 2 + 1];
+				this->spans[spans + i * 2]     = start < 0 ? -1 : record->offset + start;
+				this->spans[spans + i * 2 + 1] = start < 0 ? -1 : record->offset + end;
+			}
+		}
+		frame->previous = count;
+		count++;
+		spans += groups * 2;
+		if (node->children != NULL) {
+			if (depth == capacity) {
+				capacity *= 2;
+				__ARRAY_RESIZE(stack, MatchTreeFrame, capacity);
+			}
+			stack[depth++] = (MatchTreeFrame){node->children, count - 1, -1};
+		}
+	}
+	__FREE(stack);
+	this->count      = count;
+	this->spansCount = spans;
+	return valid;
+}
+
+MatchBuffer* MatchBuffer_new(Match* match) {
+	if (!Match_isSuccess(match)) {return NULL;}
+	__NEW(MatchBuffer, this);
+	this->data       = NULL;
+	this->size       = 0;
+	this->records    = NULL;
+	this->spans      = NULL;
+	this->count      = 0;
+	this->spansCount = 0;
+	// A first walk sizes the buffer, so that it is allocated at once, and
+	// a second one fills it.
+	if (!MatchBuffer__walk(this, match)) {
+		MatchBuffer_free(this);
+		return NULL;
+	}
+	this->size    = sizeof(MatchRecord) * (size_t)this->count + sizeof(int32_t) * (size_t)this->spansCount;
+	__ARRAY_NEW(data, char, this->size);
+	this->data    = data;
+	this->records = (MatchRecord*)data;
+	this->spans   = (int32_t*)(data + sizeof(MatchRecord) * (size_t)this->count);
+	MatchBuffer__walk(this, match);
+	return this;
+}
+
+void MatchBuffer_free(MatchBuffer* this) {
+	if (this == NULL) {return;}
+	__FREE(this->data);
+	__FREE(this);
+}
+
+// ----------------------------------------------------------------------------
+//
+// PERSING ELEMENT
+//
+// ----------------------------------------------------------------------------
+
+bool ParsingElement_Is(void *this) {
+	if (this == NULL) { return FALSE; }
+	switch (((ParsingElement*)this)->type) {
+		// It is not a parsing element if it is a refernence
+		case TYPE_ELEMENT:
+		case TYPE_WORD:
+		case TYPE_TOKEN:
+		case TYPE_GROUP:
+		case TYPE_RULE:
+		case TYPE_CONDITION:
+		case TYPE_PROCEDURE:
+			return TRUE;
+		default:
+			return FALSE;
+	}
+}
+
+ParsingElement* ParsingElement_Ensure(void* elementOrReference) {
+	void * element = elementOrReference;
+	assert(element!=NULL);
+	assert(Reference_Is(element) || ParsingElement_Is(element));
+	return Reference_Is(element) ? ((Reference*)element)->element : (ParsingElement*)element;
+}
+
+ParsingElement* ParsingElement_new(Reference* children[]) {
+	__NEW(ParsingElement, this);
+	this->type      = TYPE_ELEMENT;
+	this->id        = ID_UNBOUND;
+	this->name      = NULL;
+	this->config    = NULL;
+	this->children  = NULL;
+	this->recognize = NULL;
+	this->process   = NULL;
+	this->freeMatch = NULL;
+	this->flags     = 0;
+	if (children != NULL && *children != NULL) {
+		Reference* r = Reference_Ensure(*children);
+		while ( r != NULL ) {
+			DEBUG("ParsingElement: %s adding child: %s", this->name, r->element->name)
+			// FIXME: Make sure how memory is managed here
+			ParsingElement_add(this, r);
+			r = *(++children);
+		}
+	}
+	return this;
+}
+
+void ParsingElement_freeChildren( ParsingElement* this ) {
+	if (this == NULL) {return;}
+	Reference* child = this->children;
+	while (child != NULL) {
+		Reference* next = child->next;
+		assert(Reference_Is(child));
+		Reference_free(child);
+		child = next;
+	}
+}
+
+
+void ParsingElement_free(ParsingElement* this) {
+	// NOTE: We don't want/need to free the children as the Grammar already
+	// holds a table of all elements.
 	if (this == NULL) {return;}
 	switch (this->type) {
 		case TYPE_TOKEN:
@@ -1008,6 +2120,9 @@ void ParsingElement_free(ParsingElement* this) {
 		case TYPE_WORD:
 			Word_free(this);
 			break;
+		case TYPE_GROUP:
+			Group_free(this);
+			break;
 		default:
 			if (this!=NULL) {__FREE(this->name)};
 			__FREE(this);
@@ -1098,14 +2213,117 @@ Match* ParsingElement_process( ParsingElement* this, Match* match ) {
 	return match;
 }
 
+bool ParsingElement_isMemoizable( ParsingElement* this ) {
+	// Words are cheaper to recognize than to look up, and procedures
+	// and conditions depend on the context by definition.
+	if (this->id < 0) {return FALSE;}
+	if (HAS_FLAG(this->flags, FLAG_NOMEMOIZE) || HAS_FLAG(this->flags, FLAG_CONTEXTUAL) || HAS_FLAG(this->flags, FLAG_CUTTING)) {return FALSE;}
+	switch (this->type) {
+		case TYPE_TOKEN:
+		case TYPE_GROUP:
+		case TYPE_RULE:
+			return TRUE;
+		default:
+			return FALSE;
+	}
+}
+
+ParsingElement* ParsingElement_disableMemoize( ParsingElement* this ) {
+	SET_FLAG(this->flags, FLAG_NOMEMOIZE);
+	return this;
+}
+
+ParsingElement* ParsingElement_disableFailMemoize( ParsingElement* this ) {
+	SET_FLAG(this->flags, FLAG_NOFAILMEMOIZE);
+	return this;
+}
+
+static Match* ParsingElement__recognizeLean( ParsingElement* this, ParsingContext* context );
+
+// Recognizes the element, releasing whatever it allocated in the arena
+// if it fails.
+static inline Match* ParsingElement__recognize( ParsingElement* this, ParsingContext* context, const bool trace ) {
+	ParsingArenaMark mark  = ParsingArena_mark(context->arena);
+	Match*           match = trace ? this->recognize(this, context) : ParsingElement__recognizeLean(this, context);
+	if (!Match_isSuccess(match)) {ParsingArena_rewind(context->arena, mark);}
+	return match;
+}
+
+// Recognizes the element, or restores its memoized match.
+static inline Match* ParsingElement__memoize( ParsingElement* this, ParsingContext* context, const bool trace ) {
+	ParsingMemo* memo = context->memo;
+	if (memo == NULL || !ParsingElement_isMemoizable(this)) {
+		return ParsingElement__recognize(this, context, trace);
+	}
+	Iterator*         iterator = context->iterator;
+	size_t            offset   = iterator->offset;
+	ParsingMemoEntry* entry    = ParsingMemo_get(memo, this->id, offset);
+	if (entry != NULL) {
+		// We've already been there, so we restore the iterator to where
+		// the element left it and return the match, sharing its children.
+		// The match might have been memoized while skipping, so we
+		// register it again.
+		if (entry->match == NULL) {
+			OUT_STEP(" !  %s└ Memo %s#%d failed at %zu:%zu", context->indent, this->name, this->id, Iterator_line(iterator), offset);
+			return FAILURE;
+		} else {
+			Match* match = Match__share(entry->match, context->arena);
+			if (entry->end != offset) {Iterator_moveTo(iterator, entry->end);}
+			OUT_STEP("[✓] %s└ Memo %s#%d matched %zu:%zu-%zu", context->indent, this->name, this->id, Iterator_line(iterator), offset, entry->end);
+			return MATCH_DEEPEST(match);
+		}
+	}
+	Match* match = ParsingElement__recognize(this, context, trace);
+	if (Match_isSuccess(match) || !HAS_FLAG(this->flags, FLAG_NOFAILMEMOIZE)) {
+		ParsingMemo_set(memo, this->id, offset, iterator->offset, match);
+	}
+	return match;
+}
+
+// Recognizes the element, counting the attempt, its outcome, the bytes it
+// consumed and the time it took (including its children's) in the
+// context's stats.
+static Match* ParsingElement__profile( ParsingElement* this, ParsingContext* context ) {
+	ParsingStats* stats  = context->stats;
+	size_t        offset = context->iterator->offset;
+	double        start  = ParsingStats_now();
+	Match*        match  = ParsingElement__memoize(this, context, TRUE);
+	if (this->id >= 0 && (size_t)this->id < stats->symbolsCount) {
+		stats->attemptsBySymbol[this->id] += 1;
+		stats->timeBySymbol[this->id]     += ParsingStats_now() - start;
+		if (Match_isSuccess(match)) {
+			stats->bytesBySymbol[this->id] += context->iterator->offset - offset;
+		} else if (offset >= stats->failureOffset) {
+			// We register the deepest failure, as failures don't have
+			// an offset of their own.
+			stats->failureOffset  = offset;
+			stats->failureElement = (Element*)this;
+		}
+	}
+	return ParsingStats_registerMatch(stats, (Element*)this, match);
+}
+
+Match* ParsingElement_recognize( ParsingElement* this, ParsingContext* context ) {
+	if (HAS_FLAG(context->flags, FLAG_PROFILING)) {
+		return ParsingElement__profile(this, context);
+	} else if (HAS_FLAG(context->flags, FLAG_TRACING)) {
+		return ParsingElement__memoize(this, context, TRUE);
+	} else {
+		return ParsingElement__memoize(this, context, FALSE);
+	}
+}
+
 size_t ParsingElement_skip( ParsingElement* this, ParsingContext* context) {
 	if (this == NULL || context == NULL || context->grammar->skip == NULL || context->flags & FLAG_SKIPPING) {return 0;}
 	SET_FLAG(context->flags, FLAG_SKIPPING);
 	ParsingElement* skip = context->grammar->skip;
 	size_t offset        = context->iterator->offset;
-	// We don't care about the result, just the offset change.
-	Match* match = skip->recognize(skip, context);
+	// We don't care about the result, just the offset change, so we
+	// release the match from the arena straight away.
+	ParsingArenaMark mark = ParsingArena_mark(context->arena);
+	Match* match = ParsingElement_recognize(skip, context);
 	match = Match_free(match);
+	ParsingArena_rewind(context->arena, mark);
 	size_t skipped = context->iterator->offset - offset;
 	if (skipped > 0) {
 		OUT_IF(context->grammar->isVerbose, " %s   ►►►skipped %zu", context->indent, skipped)
@@ -1260,7 +2478,27 @@ int Reference__walk( Reference* this, ElementWalkingCallback callback, int step,
 	return step;
 }
 
-Match* Reference_recognize(Reference* this, ParsingContext* context) {
+// Choices are the alternatives of groups and the iterations of references
+// that are not `CARDINALITY_ONE`. A choice starts uncut, and returns
+// the cut flag of the enclosing choice, which is restored when it ends.
+static inline int ParsingContext__enterChoice( ParsingContext* context ) {
+	int cut = context->flags & FLAG_CUT;
+	UNSET_FLAG(context->flags, FLAG_CUT);
+	context->choices += 1;
+	return cut;
+}
+
+// Ends the current choice, telling if it was cut. A cut already
+// took the choice out of the uncut ones.
+static inline bool ParsingContext__leaveChoice( ParsingContext* context, int cut ) {
+	bool committed = HAS_FLAG(context->flags, FLAG_CUT) ? TRUE : FALSE;
+	if (!committed) {context->choices -= 1;}
+	UNSET_FLAG(context->flags, FLAG_CUT);
+	SET_FLAG(context->flags, cut);
+	return committed;
+}
+
+RECOGNIZER Match* Reference__recognize(Reference* this, ParsingContext* context, const bool trace) {
 
 	// References are pretty much always the root elements (at the exception of
 	// the axiom). They can match 0 or many elements (depending on their cardinality),
@@ -1270,9 +2508,10 @@ Match* Reference_recognize(Reference* this, ParsingContext* context) {
 	Match* result = FAILURE;
 	Match* tail   = NULL;
 	int    count  = 0;
-	int    offset = context->iterator->offset;
-	int    match_end_offset = offset;
-	size_t match_end_lines  = context->iterator->lines;
+	size_t offset = context->iterator->offset;
+	size_t match_end_offset = offset;
+	bool   is_choice        = this->cardinality != CARDINALITY_ONE;
+	bool   committed        = FALSE;
 
 	// If the wrapped element is a procedure, then the cardinality can only be one or optional, as a procedure does
 	// not consume input.
@@ -1291,15 +2530,15 @@ Match* Reference_recognize(Reference* this, ParsingContext* context) {
 		}
 
 		// We ask the element to recognize the current iterator's position
-		int iteration_offset = context->iterator->offset;
-		Match* match         = this->element->recognize(this->element, context);
-		int parsed           = context->iterator->offset - iteration_offset;
+		size_t iteration_offset = context->iterator->offset;
+		int    cut              = is_choice ? ParsingContext__enterChoice(context) : 0;
+		Match* match            = ParsingElement_recognize(this->element, context);
+		size_t parsed           = context->iterator->offset - iteration_offset;
+		bool   is_cut           = is_choice ? ParsingContext__leaveChoice(context, cut) : FALSE;
 
 		// Is the match successful ?
 		if (Match_isSuccess(match)) {
-			match_end_offset = Match_getEndOffset(match);
-			// NOTE: not 100% about this
-			match_end_lines  = context->iterator->lines;
+			match_end_offset = match->offset + match->length;
 			if (count == 0) {
 				// If it's the first match and we're in a ONE/OPTIONAL reference, we break
 				// the loop.
@@ -1328,6 +2567,11 @@ Match* Reference_recognize(Reference* this, ParsingContext* context) {
 		} else {
 			// We free the match (it's a FAILURE or NULL, anyway).
 			match = Match_free(match);
+			// An iteration that failed after a cut fails the reference
+			if (is_cut) {
+				committed = TRUE;
+				break;
+			}
 			// If the match is not a success, then we try to skip some input
 			// and see if we get a match.
 			size_t skipped = ParsingElement_skip((ParsingElement*)this, context);
@@ -1347,7 +2591,12 @@ Match* Reference_recognize(Reference* this, ParsingContext* context) {
 	// fail, while they would match if there had been no skipping.
 	if (context->iterator->offset != match_end_offset) {
 		// NOTE: It backtrack always right?
-		Iterator_backtrack(context->iterator, match_end_offset, match_end_lines);
+		Iterator_backtrack(context->iterator, match_end_offset);
+	}
+
+	if (committed) {
+		result = Match_fail(result);
+		return MATCH_STATS(FAILURE);
 	}
 
 	DEBUG_IF(count > 0, "        Reference %s#%d@%s matched %d times out of %c",  this->element->name, this->element->id, this->name, count, this->cardinality);
@@ -1389,7 +2638,7 @@ Match* Reference_recognize(Reference* this, ParsingContext* context) {
 		// as element. The data will be NULL, but the `child` (and actually,
 		// the children) will match the cardinality and will contain parsing
 		// element matches.
-		int    length   = context->iterator->offset - offset;
+		size_t length   = context->iterator->offset - offset;
 		Match* m        = Match_SuccessFromReference(length, this, context);
 		// We make sure that if we had a success, that we add
 		m->children     = result == FAILURE ? NULL : result;
@@ -1404,6 +2653,8 @@ Match* Reference_recognize(Reference* this, ParsingContext* context) {
 	}
 }
 
+RECOGNIZER_VARIANTS(Reference, Reference)
+
 // ----------------------------------------------------------------------------
 //
 // WORD
@@ -1421,7 +2672,6 @@ ParsingElement* Word_new(const char* word) {
 	// causing problems with PyPy, hinting at potential allocation issues
 	// elsewhere.
 	__STRING_COPY(config->word, word);
-	assert(config->length>0);
 	this->config         = config;
 	assert(this->config    != NULL);
 	assert(this->recognize != NULL);
@@ -1446,22 +2696,26 @@ const char* Word_word(ParsingElement* this) {
 	return ((WordConfig*)this->config)->word;
 }
 
-Match* Word_recognize(ParsingElement* this, ParsingContext* context) {
+RECOGNIZER Match* Word__recognize(ParsingElement* this, ParsingContext* context, const bool trace) {
 	WordConfig* config = ((WordConfig*)this->config);
-	if (strncmp(config->word, context->iterator->current, config->length) == 0) {
+	// The input might not be followed by a zero byte, so we don't compare
+	// past its end.
+	if (config->length <= Iterator_remaining(context->iterator) && memcmp(config->word, context->iterator->current, config->length) == 0) {
 		// NOTE: You can see here that the word actually consumes input
 		// and moves the iterator.
-		Match* success = MATCH_STATS(Match_Success(config->length, this, context));
+		Match* success = MATCH_DEEPEST(Match_Success(config->length, this, context));
 		ASSERT(config->length > 0, "Word: %s configuration length == 0", config->word)
 		context->iterator->move(context->iterator, config->length);
-		OUT_STEP("[✓] %s└ Word %s#%d:`" CYAN "%s" RESET "` matched %zu:%zu-%zu[→%d]", context->indent, this->name, this->id, ((WordConfig*)this->config)->word, context->iterator->lines, context->iterator->offset - config->length, context->iterator->offset, context->depth);
+		OUT_STEP("[✓] %s└ Word %s#%d:`" CYAN "%s" RESET "` matched %zu:%zu-%zu[→%d]", context->indent, this->name, this->id, ((WordConfig*)this->config)->word, Iterator_line(context->iterator), context->iterator->offset - config->length, context->iterator->offset, context->depth);
 		return success;
 	} else {
-		OUT_STEP(" !  %s└ Word %s#%d:" CYAN "`%s`" RESET " failed at %zu:%zu[→%d]", context->indent, this->name, this->id, ((WordConfig*)this->config)->word, context->iterator->lines, context->iterator->offset, context->depth);
-		return MATCH_STATS(FAILURE);
+		OUT_STEP(" !  %s└ Word %s#%d:" CYAN "`%s`" RESET " failed at %zu:%zu[→%d]", context->indent, this->name, this->id, ((WordConfig*)this->config)->word, Iterator_line(context->iterator), context->iterator->offset, context->depth);
+		return MATCH_DEEPEST(FAILURE);
 	}
 }
 
+RECOGNIZER_VARIANTS(Word, ParsingElement)
+
 const char* WordMatch_group(Match* match) {
 	return ((WordConfig*)((ParsingElement*)match->element)->config)->word;
 }
@@ -1531,7 +2785,27 @@ const char* Token_expr(ParsingElement* this) {
 	return ((TokenConfig*)this->config)->expr;
 }
 
-Match* Token_recognize(ParsingElement* this, ParsingContext* context) {
+// Allocates a token match with `count` groups, in the given arena unless
+// it is NULL. The groups' strings are only created on demand.
+TokenMatch* TokenMatch__new(ParsingArena* arena, Iterator* iterator, int count) {
+	TokenMatch* data = NULL;
+	if (arena == NULL) {
+		__NEW(TokenMatch, m);
+		__ARRAY_NEW(spans, int, count * 2);
+		data        = m;
+		data->spans = spans;
+	} else {
+		data        = (TokenMatch*)ParsingArena_alloc(arena, sizeof(TokenMatch));
+		data->spans = (int*)ParsingArena_alloc(arena, sizeof(int) * count * 2);
+	}
+	data->count    = count;
+	data->groups   = NULL;
+	data->iterator = iterator;
+	data->arena    = arena;
+	return data;
+}
+
+RECOGNIZER Match* Token__recognize(ParsingElement* this, ParsingContext* context, const bool trace) {
 	assert(this->config);
 	if(this->config == NULL) {return FAILURE;}
 	Match* result = NULL;
@@ -1541,11 +2815,15 @@ Match* Token_recognize(ParsingElement* this, ParsingContext* context) {
 	int vector_length = 30;
 	int vector[vector_length];
 	const char* line = (const char*)context->iterator->current;
+	// PCRE takes the length as an `int`, so tokens can't look further than
+	// `INT_MAX` bytes ahead in larger inputs.
+	size_t remaining = Iterator_remaining(context->iterator);
+	int length       = remaining > INT_MAX ? INT_MAX : (int)remaining;
 	// SEE: http://www.mitchr.me/SS/exampleCode/AUPG/pcre_example.c.html
 	int r = pcre_exec(
 		config->regexp, config->extra,     // Regex
 		line,                              // Line
-		context->iterator->available,      // Available data
+		length,                            // Available data
 		0,                                 // Offset
 		  PCRE_ANCHORED                    // OPTIONS -- we do not skip position
 		| PCRE_NO_UTF8_CHECK               // These following one are necessary
@@ -1564,7 +2842,7 @@ Match* Token_recognize(ParsingElement* this, ParsingContext* context) {
 			case PCRE_ERROR_NOMEMORY     : ERROR("Token:%s Ran out of memory", config->expr);                       break;
 			default                      : ERROR("Token:%s Unknown error", config->expr);                           break;
 		};
-		OUT_STEP("    %s└✘Token " BOLDRED "%s" RESET "#%d:`" CYAN "%s" RESET "` failed at %zu:%zu", context->indent, this->name, this->id, config->expr, context->iterator->lines, context->iterator->offset);
+		OUT_STEP("    %s└✘Token " BOLDRED "%s" RESET "#%d:`" CYAN "%s" RESET "` failed at %zu:%zu", context->indent, this->name, this->id, config->expr, Iterator_line(context->iterator), context->iterator->offset);
 	} else {
 		if(r == 0) {
 			ERROR("Token: %s many substrings matched\n", config->expr);
@@ -1577,32 +2855,23 @@ Match* Token_recognize(ParsingElement* this, ParsingContext* context) {
 		}
 		// FIXME: Make sure it is the length and not the end offset
 		result = Match_Success(vector[1], this, context);
-		OUT_STEP("[✓] %s└ Token " BOLDGREEN "%s" RESET "#%d:" CYAN "`%s`" RESET " matched " BOLDGREEN "%zu:%zu-%zu" RESET, context->indent, this->name, this->id, config->expr, context->iterator->lines, context->iterator->offset, context->iterator->offset + result->length);
-
-		// We create the token match
-		__NEW(TokenMatch, data);
-		data->count    = r;
-		__ARRAY_NEW(groups, const char*, r);
-		data->groups   = groups;
-		// NOTE: We do this here, but it's probably better to do it later
-		// once the token is recognized, although this poses the problem
-		// of preserving the input.
-		for (int j=0 ; j<r ; j++) {
-			const char* substring;
-			// This function copies the data into a freshly allocated
-			// substring.
-			pcre_get_substring(line, vector, r, j, &(substring));
-			data->groups[j] = substring;
-		}
+		OUT_STEP("[✓] %s└ Token " BOLDGREEN "%s" RESET "#%d:" CYAN "`%s`" RESET " matched " BOLDGREEN "%zu:%zu-%zu" RESET, context->indent, this->name, this->id, config->expr, Iterator_line(context->iterator), context->iterator->offset, context->iterator->offset + result->length);
+
+		// We create the token match, which only keeps the groups' offsets,
+		// as most of the groups' strings are never requested.
+		TokenMatch* data = TokenMatch__new(context->arena, context->iterator, r);
+		memcpy(data->spans, vector, sizeof(int) * r * 2);
 		result->data = data;
 		context->iterator->move(context->iterator,result->length);
 		assert (result->data != NULL);
 		assert(Match_isSuccess(result));
 	}
 #endif
-	return MATCH_STATS(result);
+	return MATCH_DEEPEST(result);
 }
 
+RECOGNIZER_VARIANTS(Token, ParsingElement)
+
 const char* TokenMatch_group(Match* match, int index) {
 	assert (match                != NULL);
 	assert (match->data          != NULL);
@@ -1611,12 +2880,58 @@ const char* TokenMatch_group(Match* match, int index) {
 	if (m) {
 		assert (index >= 0);
 		assert (index < m->count);
+		// The strings are created on first access. When the match is in
+		// an arena, they're pinned so that they survive any rewind.
+		if (m->groups == NULL) {
+			if (m->arena == NULL) {
+				__ARRAY_NEW(groups, const char*, m->count);
+				m->groups = groups;
+			} else {
+				m->groups = (const char**)ParsingArena_allocPinned(m->arena, sizeof(const char*) * m->count);
+			}
+		}
+		if (m->groups[index] == NULL) {
+			size_t      length = 0;
+			const char* slice  = TokenMatch_slice(match, index, &length);
+			char*       group  = NULL;
+			if (m->arena == NULL) {
+				__ARRAY_NEW(g, char, length + 1);
+				group = g;
+			} else {
+				group = (char*)ParsingArena_allocPinned(m->arena, length + 1);
+			}
+			memcpy(group, slice, length);
+			group[length] = '\0';
+			m->groups[index] = group;
+		}
 		return m->groups[index];
 	} else {
 		return NULL;
 	}
 }
 
+const char* TokenMatch_slice(Match* match, int index, size_t* length) {
+	assert (match                != NULL);
+	assert (match->data          != NULL);
+	assert (Match_getElementType(match) == TYPE_TOKEN);
+	TokenMatch* m = (TokenMatch*)match->data;
+	assert (index >= 0);
+	assert (index < m->count);
+	int start = m->spans[index * 2];
+	int end   = m->spans[index * 2 + 1];
+	// NOTE: The match's input must not have been released from the
+	// iterator. Groups that did not participate in the match are empty,
+	// as with `pcre_get_substring`.
+	const char* text = m->iterator->buffer + (match->offset - Iterator_textOffset(m->iterator));
+	if (start < 0) {
+		*length = 0;
+		return text;
+	} else {
+		*length = (size_t)(end - start);
+		return text + start;
+	}
+}
+
 
 int TokenMatch_count(Match* match) {
 	assert (match                != NULL);
@@ -1639,20 +2954,18 @@ void Token_print(ParsingElement* this) {
 void TokenMatch_free(Match* match) {
 	assert (match                != NULL);
 	assert (Match_getElementType(match) == TYPE_TOKEN);
-#ifdef WITH_PCRE
 	TRACE("TokenMatch_free: %p, match->data=%p", match, match->data);
-	if (match->data != NULL) {
-		TokenMatch* m = (TokenMatch*)match->data;
-		if (m != NULL ) {
+	TokenMatch* m = (TokenMatch*)match->data;
+	if (m != NULL) {
+		if (m->groups != NULL) {
 			for (int j=0 ; j<m->count ; j++) {
-				pcre_free_substring(m->groups[j]);
+				__FREE((char*)m->groups[j]);
 			}
 		}
 		__FREE(m->groups);
+		__FREE(m->spans);
 	}
-#endif
 	__FREE(match->data);
-
 }
 
 // ----------------------------------------------------------------------------
@@ -1668,24 +2981,136 @@ ParsingElement* Group_new(Reference* children[]) {
 	return this;
 }
 
-Match* Group_recognize(ParsingElement* this, ParsingContext* context){
+WordTrie* WordTrie_new(ParsingElement* group) {
+	// We count the children and the bytes of their words, which gives
+	// us an upper bound on the number of nodes and edges.
+	int        children = 0;
+	int        bytes    = 0;
+	Reference* child    = group->children;
+	while (child != NULL) {
+		assert(child->element->type == TYPE_WORD);
+		bytes    += (int)((WordConfig*)child->element->config)->length;
+		children += 1;
+		child     = child->next;
+	}
+	__NEW(WordTrie, this);
+	__ARRAY_NEW(words,     int,          bytes + 1);
+	__ARRAY_NEW(edges,     int,          bytes + 1);
+	__ARRAY_NEW(links,     WordTrieEdge, bytes + 1);
+	__ARRAY_NEW(references, Reference*,  children);
+	this->words    = words;
+	this->edges    = edges;
+	this->links    = links;
+	this->children = references;
+	this->count    = 1;
+	words[0]       = -1;
+	edges[0]       = -1;
+	int link_count = 0;
+	int index      = 0;
+	for (child = group->children ; child != NULL ; child = child->next, index++) {
+		WordConfig* config = (WordConfig*)child->element->config;
+		int         node   = 0;
+		references[index]  = child;
+		for (size_t i=0 ; i<config->length ; i++) {
+			unsigned char c    = (unsigned char)config->word[i];
+			int           edge = edges[node];
+			while (edge >= 0 && links[edge].byte != c) {edge = links[edge].next;}
+			if (edge < 0) {
+				// There's no edge for this byte yet, so we create a node
+				int target          = this->count++;
+				words[target]       = -1;
+				edges[target]       = -1;
+				links[link_count]   = (WordTrieEdge){c, target, edges[node]};
+				edges[node]         = link_count++;
+				node                = target;
+			} else {
+				node = links[edge].target;
+			}
+		}
+		// If the same word appears twice, the first one wins
+		if (words[node] < 0) {words[node] = index;}
+	}
+	return this;
+}
 
-	// The goal is to find ONE (and only one) matching element.
-	OUT_STEP("??? %s┌── Group " BOLDYELLOW "%s" RESET ":#%d at %zu:%zu[→%d]", context->indent, this->name, this->id, context->iterator->lines, context->iterator->offset, context->depth);
-	Match*     result           = NULL;
-	size_t     offset           = context->iterator->offset;
-	size_t     lines            = context->iterator->lines;
-	int        step             = 0;
+void WordTrie_free(WordTrie* this) {
+	if (this != NULL) {
+		__FREE(this->words);
+		__FREE(this->edges);
+		__FREE(this->links);
+		__FREE(this->children);
+	}
+	__FREE(this);
+}
 
-	// Note: we don't skip in groups, that,s the business of references
-	size_t     iteration_offset = context->iterator->offset;
-	Reference* child            = this->children;
-	Match*     match            = NULL;
+Reference* WordTrie_match(WordTrie* this, const char* text, size_t length) {
+	// Groups are ordered, so we're not looking for the longest word
+	// but for the first child whose word matches, which might be an
+	// empty word, at the root.
+	int best = this->words[0];
+	int node = 0;
+	for (size_t i=0 ; i<length ; i++) {
+		unsigned char c    = (unsigned char)text[i];
+		int           edge = this->edges[node];
+		while (edge >= 0 && this->links[edge].byte != c) {edge = this->links[edge].next;}
+		if (edge < 0) {break;}
+		node = this->links[edge].target;
+		int word = this->words[node];
+		if (word >= 0 && (best < 0 || word < best)) {best = word;}
+	}
+	return best < 0 ? NULL : this->children[best];
+}
+
+void Group__freeConfig(ParsingElement* this) {
+	GroupConfig* config = (GroupConfig*)this->config;
+	if (config != NULL) {
+		WordTrie_free(config->words);
+		__FREE(config->candidates);
+		__FREE(config);
+	}
+	this->config = NULL;
+}
+
+void Group_free(ParsingElement* this) {
+	Group__freeConfig(this);
+	__FREE(this->name);
+	__FREE(this);
+}
+
+RECOGNIZER Match* Group__recognize(ParsingElement* this, ParsingContext* context, const bool trace) {
+
+	// The goal is to find ONE (and only one) matching element.
+	OUT_STEP("??? %s┌── Group " BOLDYELLOW "%s" RESET ":#%d at %zu:%zu[→%d]", context->indent, this->name, this->id, Iterator_line(context->iterator), context->iterator->offset, context->depth);
+	Match*     result           = NULL;
+	size_t     offset           = context->iterator->offset;
+	int        step             = 0;
+
+	// Note: we don't skip in groups, that,s the business of references
+	size_t     iteration_offset = context->iterator->offset;
+	Reference* child            = this->children;
+	Match*     match            = NULL;
 	step                        = 0;
 
+	// If the group has a dispatch table, we only try the children that
+	// can start with the current byte.
+	GroupConfig* config         = (GroupConfig*)this->config;
+	Reference**  candidates     = NULL;
+	Reference*   word[2]        = {NULL, NULL};
+	if (config != NULL && Iterator_hasMore(context->iterator)) {
+		candidates = config->dispatch[(unsigned char)(*context->iterator->current)];
+		// For groups of words, the trie tells us which child will match, if any.
+		if (candidates != NULL && config->words != NULL) {
+			word[0]    = WordTrie_match(config->words, context->iterator->current, Iterator_remaining(context->iterator));
+			candidates = word;
+		}
+		if (candidates != NULL) {child = *candidates;}
+	}
+
 	while (child != NULL ) {
 		assert (match == NULL);
-		match = Reference_recognize(child, context);
+		int  cut       = ParsingContext__enterChoice(context);
+		match          = trace ? Reference_recognize(child, context) : Reference__recognizeLean(child, context);
+		bool committed = ParsingContext__leaveChoice(context, cut);
 
 		if (Match_isSuccess(match)) {
 			// The first succeeding child wins
@@ -1695,23 +3120,23 @@ Match* Group_recognize(ParsingElement* this, ParsingContext* context){
 			result->children = match;
 			child            = NULL;
 		} else {
-			// Otherwise we try the next child
+			// Otherwise we try the next child, unless the child was cut
 			match = Match_free(match);
-			child  = child->next;
+			child  = committed ? NULL : candidates != NULL ? *(++candidates) : child->next;
 			step  += 1;
 		}
 	}
 
 	// We've either found one element, or nothing
 	if (Match_isSuccess(result)) {
-		OUT_STEP( "[✓] %s╘═⇒ Group " BOLDGREEN "%s" RESET "#%d[%d] matched" BOLDGREEN "%zu:%zu-%zu" RESET "[%zu][→%d]", context->indent, this->name, this->id, step,  context->iterator->lines, result->offset, context->iterator->offset, result->length, context->depth)
+		OUT_STEP( "[✓] %s╘═⇒ Group " BOLDGREEN "%s" RESET "#%d[%d] matched" BOLDGREEN "%zu:%zu-%zu" RESET "[%zu][→%d]", context->indent, this->name, this->id, step,  Iterator_line(context->iterator), result->offset, context->iterator->offset, result->length, context->depth)
 		return MATCH_STATS(result);
 	} else {
 		// If no child has succeeded, the whole group fails
-		OUT_STEP(" !  %s╘═⇒ Group " BOLDRED "%s" RESET "#%d[%d] failed at %zu:%zu-%zu[→%d]", context->indent, this->name, this->id, step, context->iterator->lines, context->iterator->offset, offset, context->depth)
+		OUT_STEP(" !  %s╘═⇒ Group " BOLDRED "%s" RESET "#%d[%d] failed at %zu:%zu-%zu[→%d]", context->indent, this->name, this->id, step, Iterator_line(context->iterator), context->iterator->offset, offset, context->depth)
 		result = Match_fail(result);
 		if (context->iterator->offset != offset ) {
-			Iterator_backtrack(context->iterator, offset, lines);
+			Iterator_backtrack(context->iterator, offset);
 			assert( context->iterator->offset == offset );
 		}
 		return MATCH_STATS(FAILURE);
@@ -1719,6 +3144,8 @@ Match* Group_recognize(ParsingElement* this, ParsingContext* context){
 
 }
 
+RECOGNIZER_VARIANTS(Group, ParsingElement)
+
 
 // ----------------------------------------------------------------------------
 //
@@ -1734,7 +3161,15 @@ ParsingElement* Rule_new(Reference* children[]) {
 	return this;
 }
 
-Match* Rule_recognize (ParsingElement* this, ParsingContext* context){
+// Changes the context's depth by the given delta, and the indent of its
+// traces along with it, without touching the variable frames.
+static inline void ParsingContext__deepen( ParsingContext* this, int delta ) {
+	this->depth += delta;
+	int d = MAX(this->depth, 0) % INDENT_MAX;
+	this->indent = INDENT + (INDENT_MAX - d) * INDENT_WIDTH;
+}
+
+RECOGNIZER Match* Rule__recognize(ParsingElement* this, ParsingContext* context, const bool trace) {
 
 	// An empty rule will fail. Not sure if this is the right thing to do, but
 	// if we don't set the result, it will return NULL and break assertions
@@ -1743,13 +3178,14 @@ Match* Rule_recognize (ParsingElement* this, ParsingContext* context){
 	int         step      = 0;
 	const char* step_name = NULL;
 	size_t      offset    = context->iterator->offset;
-	size_t      lines     = context->iterator->lines;
 	Reference* child      = this->children;
 
-	OUT_STEP("??? %s┌── Rule:" BOLDYELLOW "%s" RESET " at %zu:%zu[→%d]", context->indent, this->name, context->iterator->lines, context->iterator->offset, context->depth);
+	OUT_STEP("??? %s┌── Rule:" BOLDYELLOW "%s" RESET " at %zu:%zu[→%d]", context->indent, this->name, Iterator_line(context->iterator), context->iterator->offset, context->depth);
 
-	// We create a new parsing variable context
-	ParsingContext_push(context);
+	// We create a new parsing variable context, unless the rule
+	// can't reach the variables. The traces still go one level deeper.
+	bool scoped = !HAS_FLAG(this->flags, FLAG_NOSCOPE);
+	if (scoped) {ParsingContext_push(context);} else if (trace) {ParsingContext__deepen(context, 1);}
 
 	// We don't need to care wether the parsing context has more
 	// data, the Reference_recognize will take care of it.
@@ -1763,7 +3199,7 @@ Match* Rule_recognize (ParsingElement* this, ParsingContext* context){
 
 		// We iterate over the children of the rule. We expect each child to
 		// match, and we might skip inbetween the children to find a match.
-		Match* match = Reference_recognize(child, context);
+		Match* match = trace ? Reference_recognize(child, context) : Reference__recognizeLean(child, context);
 
 		// If the match is not a success, we will try to skip some input
 		// and try the match again.
@@ -1779,7 +3215,7 @@ Match* Rule_recognize (ParsingElement* this, ParsingContext* context){
 
 				// If the rule failed, we try to skip characters. We free any
 				// failure match, as we won't need it anymore.
-				match = Reference_recognize(child, context);
+				match = trace ? Reference_recognize(child, context) : Reference__recognizeLean(child, context);
 
 				// If we haven't matched even after the skip, then we have a failure.
 				if (!Match_isSuccess(match)) {
@@ -1827,22 +3263,22 @@ Match* Rule_recognize (ParsingElement* this, ParsingContext* context){
 	}
 
 	// We pop the parsing context
-	ParsingContext_pop(context);
+	if (scoped) {ParsingContext_pop(context);} else if (trace) {ParsingContext__deepen(context, -1);}
 
 	// We process the result
 	if (Match_isSuccess(result)) {
 		OUT_STEP("[✓] %s╘═⇒ Rule " BOLDGREEN "%s" RESET "#%d[%d] matched " BOLDGREEN "%zu:%zu-%zu" RESET "[%zub][→%d]",
-				context->indent, this->name, this->id, step, context->iterator->lines,  offset, context->iterator->offset, result->length, context->depth)
+				context->indent, this->name, this->id, step, Iterator_line(context->iterator),  offset, context->iterator->offset, result->length, context->depth)
 		// In case of a success, we update the length based on the last
 		// match.
 		result->length = last->offset - result->offset + last->length;
 	} else {
 		OUT_STEP(" !  %s╘ Rule " BOLDRED "%s" RESET "#%d failed on step %d=%s at %zu:%zu-%zu[→%d]",
-				context->indent, this->name, this->id, step, step_name == NULL ? "-" : step_name, context->iterator->lines, offset, context->iterator->offset, context->depth)
+				context->indent, this->name, this->id, step, step_name == NULL ? "-" : step_name, Iterator_line(context->iterator), offset, context->iterator->offset, context->depth)
 		result = Match_fail(result);
 		// If we had a failure, then we backtrack the iterator
 		if (offset != context->iterator->offset) {
-			Iterator_backtrack(context->iterator, offset, lines);
+			Iterator_backtrack(context->iterator, offset);
 			assert( context->iterator->offset == offset );
 		}
 	}
@@ -1850,6 +3286,8 @@ Match* Rule_recognize (ParsingElement* this, ParsingContext* context){
 	return MATCH_STATS(result);
 }
 
+RECOGNIZER_VARIANTS(Rule, ParsingElement)
+
 // ----------------------------------------------------------------------------
 //
 // PROCEDURE
@@ -1864,7 +3302,7 @@ ParsingElement* Procedure_new(ProcedureCallback c) {
 	return this;
 }
 
-Match*  Procedure_recognize(ParsingElement* this, ParsingContext* context) {
+RECOGNIZER Match* Procedure__recognize(ParsingElement* this, ParsingContext* context, const bool trace) {
 	if (this->config != NULL) {
 		// FIXME: Executing handlers is still quite problematic
 		((ProcedureCallback)(this->config))(this, context);
@@ -1873,6 +3311,8 @@ Match*  Procedure_recognize(ParsingElement* this, ParsingContext* context) {
 	return MATCH_STATS(Match_Success(0, this, context));
 }
 
+RECOGNIZER_VARIANTS(Procedure, ParsingElement)
+
 // ----------------------------------------------------------------------------
 //
 // CONDITION
@@ -1887,12 +3327,12 @@ ParsingElement* Condition_new(ConditionCallback c) {
 	return this;
 }
 
-Match*  Condition_recognize(ParsingElement* this, ParsingContext* context) {
+RECOGNIZER Match* Condition__recognize(ParsingElement* this, ParsingContext* context, const bool trace) {
 	if (this->config != NULL) {
 		bool value    = ((ConditionCallback)this->config)(this, context);
 		Match* result = value == TRUE ? Match_Success(0, this, context) : FAILURE;
-		OUT_STEP_IF(Match_isSuccess(result), "[✓] %s└ Condition " BOLDGREEN "%s" RESET "#%d matched %zu:%zu-%zu[→%d]", context->indent, this->name, this->id, context->iterator->lines, context->iterator->offset - result->length, context->iterator->offset, context->depth)
-		OUT_STEP_IF(!Match_isSuccess(result), " !  %s└ Condition " BOLDRED "%s" RESET "#%d failed at %zu:%zu[→%d]",  context->indent, this->name, this->id, context->iterator->lines, context->iterator->offset, context->depth)
+		OUT_STEP_IF(Match_isSuccess(result), "[✓] %s└ Condition " BOLDGREEN "%s" RESET "#%d matched %zu:%zu-%zu[→%d]", context->indent, this->name, this->id, Iterator_line(context->iterator), context->iterator->offset - result->length, context->iterator->offset, context->depth)
+		OUT_STEP_IF(!Match_isSuccess(result), " !  %s└ Condition " BOLDRED "%s" RESET "#%d failed at %zu:%zu[→%d]",  context->indent, this->name, this->id, Iterator_line(context->iterator), context->iterator->offset, context->depth)
 		return  MATCH_STATS(result);
 	} else {
 		OUT_STEP("[✓] %s└ Condition %s#%d matched by default at %zu", context->indent, this->name, this->id, context->iterator->offset);
@@ -1902,110 +3342,388 @@ Match*  Condition_recognize(ParsingElement* this, ParsingContext* context) {
 	}
 }
 
+RECOGNIZER_VARIANTS(Condition, ParsingElement)
+
+// ----------------------------------------------------------------------------
+//
+// CUT
+//
+// ----------------------------------------------------------------------------
+
+ParsingElement* Cut_new(void) {
+	ParsingElement* this = ParsingElement_new(NULL);
+	this->type      = TYPE_PROCEDURE;
+	this->recognize = Cut_recognize;
+	return this;
+}
+
+RECOGNIZER Match* Cut__recognize(ParsingElement* this, ParsingContext* context, const bool trace) {
+	// The first cut of a choice commits it. When no uncut choice is left,
+	// nothing before the cut will be parsed again.
+	if (!HAS_FLAG(context->flags, FLAG_CUT)) {
+		SET_FLAG(context->flags, FLAG_CUT);
+		if (context->choices > 0) {context->choices -= 1;}
+	}
+	if (context->choices == 0 && context->memo != NULL) {
+		context->memo->committed = context->iterator->offset;
+	}
+	OUT_STEP("[✓] %sCut " BOLDGREEN "%s" RESET "#%d at %zu[%d]", context->indent, this->name, this->id, context->iterator->offset, context->choices)
+	return MATCH_STATS(Match_Success(0, this, context));
+}
+
+RECOGNIZER_VARIANTS(Cut, ParsingElement)
+
+// Runs the lean variant of the element's recognizer. Elements with a
+// recognizer of their own don't have one, and always trace.
+static Match* ParsingElement__recognizeLean( ParsingElement* this, ParsingContext* context ) {
+	switch (this->type) {
+		case TYPE_WORD:
+			if (this->recognize == Word_recognize)      {return Word__recognizeLean(this, context);}
+			break;
+		case TYPE_TOKEN:
+			if (this->recognize == Token_recognize)     {return Token__recognizeLean(this, context);}
+			break;
+		case TYPE_GROUP:
+			if (this->recognize == Group_recognize)     {return Group__recognizeLean(this, context);}
+			break;
+		case TYPE_RULE:
+			if (this->recognize == Rule_recognize)      {return Rule__recognizeLean(this, context);}
+			break;
+		case TYPE_CONDITION:
+			if (this->recognize == Condition_recognize) {return Condition__recognizeLean(this, context);}
+			break;
+		case TYPE_PROCEDURE:
+			if (this->recognize == Procedure_recognize) {return Procedure__recognizeLean(this, context);}
+			if (this->recognize == Cut_recognize)       {return Cut__recognizeLean(this, context);}
+			break;
+	}
+	return this->recognize(this, context);
+}
+
 // ----------------------------------------------------------------------------
 //
 // PARSING VARIABLE
 //
 // ----------------------------------------------------------------------------
 
-ParsingVariable* ParsingVariable_new(int depth, const char* key, void* value) {
-	__NEW(ParsingVariable, this);
-	this->depth    = depth;
-	__STRING_COPY(this->key, key);
-	this->value    = value;
-	this->previous = NULL;
+#define VARIABLES_INITIAL_CAPACITY 16
+
+ParsingVariables* ParsingVariables_new(Grammar* grammar) {
+	__NEW(ParsingVariables, this);
+	int count = grammar != NULL && grammar->keysCount > 0 ? grammar->keysCount : 1;
+	int capacity = MAX(count, VARIABLES_INITIAL_CAPACITY);
+	__ARRAY_NEW(keys,    char*,         (size_t)capacity);
+	__ARRAY_NEW(slots,   ParsingSlot,   (size_t)capacity);
+	__ARRAY_NEW(shadows, ParsingShadow, VARIABLES_INITIAL_CAPACITY);
+	__ARRAY_NEW(frames,  int,           VARIABLES_INITIAL_CAPACITY);
+	this->keys            = keys;
+	this->slots           = slots;
+	this->shadows         = shadows;
+	this->frames          = frames;
+	this->keysCapacity    = capacity;
+	this->shadowsCount    = 0;
+	this->shadowsCapacity = VARIABLES_INITIAL_CAPACITY;
+	this->framesCapacity  = VARIABLES_INITIAL_CAPACITY;
+	// The grammar's keys are shared, so that its keys are valid in
+	// every context.
+	if (grammar != NULL && grammar->keysCount > 0) {
+		for (int i=0 ; i<count ; i++) {this->keys[i] = grammar->keys[i];}
+		this->keysCount  = count;
+		this->keysShared = count;
+	} else {
+		__STRING_COPY(this->keys[KEY_DEPTH], "depth");
+		this->keysCount  = 1;
+		this->keysShared = 0;
+	}
+	for (int i=0 ; i<capacity ; i++) {
+		this->slots[i].value = NULL;
+		this->slots[i].depth = -1;
+	}
 	return this;
 }
 
-void ParsingVariable_free(ParsingVariable* this) {
-	if (this!=NULL) {
-		__FREE(this->key);
-		__FREE(this);
+void ParsingVariables_free(ParsingVariables* this) {
+	if (this != NULL) {
+		for (int i=this->keysShared ; i<this->keysCount ; i++) {
+			__FREE(this->keys[i]);
+		}
+		__FREE(this->keys);
+		__FREE(this->slots);
+		__FREE(this->shadows);
+		__FREE(this->frames);
 	}
+	__FREE(this);
 }
 
-void ParsingVariable_freeAll(ParsingVariable* this) {
-	ParsingVariable* current = this;
-	while (current!=NULL) {
-		ParsingVariable* to_free = current;
-		current = current->previous;
-		ParsingVariable_free(to_free);
+int ParsingVariables_key(ParsingVariables* this, const char* name, bool create) {
+	// There are usually only a handful of keys
+	for (int i=0 ; i<this->keysCount ; i++) {
+		if (strcmp(this->keys[i], name) == 0) {return i;}
+	}
+	if (!create) {return -1;}
+	if (this->keysCount == this->keysCapacity) {
+		this->keysCapacity *= 2;
+		__ARRAY_RESIZE(this->keys,  char*,       (size_t)this->keysCapacity);
+		__ARRAY_RESIZE(this->slots, ParsingSlot, (size_t)this->keysCapacity);
+		for (int i=this->keysCount ; i<this->keysCapacity ; i++) {
+			this->slots[i].value = NULL;
+			this->slots[i].depth = -1;
+		}
 	}
+	__STRING_COPY(this->keys[this->keysCount], name);
+	return this->keysCount++;
 }
 
-int ParsingVariable_getDepth(ParsingVariable* this) {
-	return this == NULL ? -1 : this->depth;
+// ----------------------------------------------------------------------------
+//
+// PARSING ARENA
+//
+// ----------------------------------------------------------------------------
+
+ParsingArenaChunk* ParsingArenaChunk__new(size_t capacity, ParsingArenaChunk* previous) {
+	__NEW(ParsingArenaChunk, this);
+	__ARRAY_NEW(data, char, capacity);
+	this->previous = previous;
+	this->capacity = capacity;
+	this->used     = 0;
+	this->data     = data;
+	return this;
 }
 
-const char* ParsingVariable_getName(ParsingVariable* this) {
-	return (const char*)this->key;
+void ParsingArenaChunk__free(ParsingArenaChunk* this) {
+	if (this != NULL) {__FREE(this->data);}
+	__FREE(this);
 }
 
-void* ParsingVariable_get(ParsingVariable* this, const char* name) {
-	ParsingVariable* found = ParsingVariable_find(this, name, FALSE);
-	return found != NULL ? found->value : NULL;
+ParsingArena* ParsingArena_new(void) {
+	__NEW(ParsingArena, this);
+	this->chunk     = NULL;
+	this->spare     = NULL;
+	this->pinned    = NULL;
+	this->allocated = 0;
+	this->kept      = ParsingArena_mark(NULL);
+	return this;
 }
 
-bool ParsingVariable_is(ParsingVariable* this, const char* key) {
-	if (this == NULL || key == NULL) {return FALSE;}
-	return (key == this->key || strcmp(this->key, key)) == 0 ? TRUE : FALSE;
+void ParsingArena_free(ParsingArena* this) {
+	if (this == NULL) {return;}
+	ParsingArenaChunk* chunk = this->chunk;
+	while (chunk != NULL) {
+		ParsingArenaChunk* previous = chunk->previous;
+		ParsingArenaChunk__free(chunk);
+		chunk = previous;
+	}
+	ParsingArenaChunk__free(this->spare);
+	void* pinned = this->pinned;
+	while (pinned != NULL) {
+		void* next = *((void**)pinned);
+		__FREE(pinned);
+		pinned = next;
+	}
+	__FREE(this);
 }
 
-ParsingVariable* ParsingVariable_find(ParsingVariable* this, const char* key, bool local) {
-	ParsingVariable* current=this;
-	while (current!=NULL) {
-		if (ParsingVariable_is(current, key)) {
-			return current;
+void* ParsingArena_alloc(ParsingArena* this, size_t size) {
+	size = (size + ARENA_ALIGNMENT - 1) & ~((size_t)ARENA_ALIGNMENT - 1);
+	ParsingArenaChunk* chunk = this->chunk;
+	if (chunk == NULL || chunk->used + size > chunk->capacity) {
+		// We need a new chunk, which might be the spare one.
+		if (this->spare != NULL && this->spare->capacity >= size) {
+			chunk              = this->spare;
+			chunk->previous    = this->chunk;
+			chunk->used        = 0;
+			this->spare        = NULL;
+		} else {
+			size_t capacity    = size > ARENA_CHUNK_SIZE ? size : ARENA_CHUNK_SIZE;
+			chunk              = ParsingArenaChunk__new(capacity, this->chunk);
+			this->allocated   += capacity;
 		}
-		if (current->previous!=NULL) {
-			// When local is TRUE, we stop the search when the depth changes
-			current = (local && current->previous->depth != current->depth) ? NULL : current->previous;
+		this->chunk = chunk;
+	}
+	void* data   = chunk->data + chunk->used;
+	chunk->used += size;
+	return data;
+}
+
+void* ParsingArena_allocPinned(ParsingArena* this, size_t size) {
+	// Pinned allocations are linked through their first bytes
+	__ARRAY_NEW(block, char, ARENA_ALIGNMENT + size);
+	*((void**)block) = this->pinned;
+	this->pinned     = block;
+	return block + ARENA_ALIGNMENT;
+}
+
+ParsingArenaMark ParsingArena_mark(ParsingArena* this) {
+	ParsingArenaMark mark = {NULL, 0};
+	if (this != NULL && this->chunk != NULL) {
+		mark.chunk = this->chunk;
+		mark.used  = this->chunk->used;
+	}
+	return mark;
+}
+
+void ParsingArena_rewind(ParsingArena* this, ParsingArenaMark mark) {
+	if (this == NULL) {return;}
+	// We don't go before what was kept, which is either in the mark's
+	// chunk or in one of the chunks after it.
+	if (this->kept.chunk == mark.chunk) {
+		mark.used = MAX(mark.used, this->kept.used);
+	} else if (this->kept.chunk != NULL) {
+		ParsingArenaChunk* chunk = this->chunk;
+		while (chunk != mark.chunk && chunk != this->kept.chunk) {chunk = chunk->previous;}
+		if (chunk == this->kept.chunk) {mark = this->kept;}
+	}
+	// We release the chunks that were created after the mark, keeping
+	// the last one as a spare so that backtracking around a chunk
+	// boundary does not allocate over and over.
+	while (this->chunk != mark.chunk) {
+		ParsingArenaChunk* chunk = this->chunk;
+		this->chunk = chunk->previous;
+		if (this->spare == NULL || this->spare->capacity < chunk->capacity) {
+			if (this->spare != NULL) {this->allocated -= this->spare->capacity;}
+			ParsingArenaChunk__free(this->spare);
+			this->spare = chunk;
 		} else {
-			current = NULL;
+			this->allocated -= chunk->capacity;
+			ParsingArenaChunk__free(chunk);
 		}
 	}
-	return current;
+	if (this->chunk != NULL) {this->chunk->used = mark.used;}
 }
 
-ParsingVariable* ParsingVariable_set(ParsingVariable* this, const char* key, void* value) {
-	ParsingVariable* found = ParsingVariable_find(this, key, TRUE);
-	if (found == NULL) {
-		found = ParsingVariable_new( this->depth, key, value );
-		found->previous = this;
-		return found;
-	} else {
-		found->value = value;
-		return found;
+void ParsingArena_keep(ParsingArena* this) {
+	if (this != NULL) {this->kept = ParsingArena_mark(this);}
+}
+
+void ParsingArena_reset(ParsingArena* this) {
+	if (this == NULL) {return;}
+	ParsingArenaMark empty = {NULL, 0};
+	this->kept = empty;
+	ParsingArena_rewind(this, empty);
+	void* pinned = this->pinned;
+	while (pinned != NULL) {
+		void* next = *((void**)pinned);
+		__FREE(pinned);
+		pinned = next;
 	}
+	this->pinned = NULL;
 }
 
-ParsingVariable* ParsingVariable_push(ParsingVariable* this) {
-	int depth            = this == NULL ? 0 : ParsingVariable_getDepth(this) + 1;
-	ParsingVariable* res = ParsingVariable_new(depth, "depth", (void*)(long)depth);
-	res->previous        = this;
-	return res;
+// ----------------------------------------------------------------------------
+//
+// PARSING MEMO
+//
+// ----------------------------------------------------------------------------
+
+#define MEMO_INITIAL_CAPACITY 1024
+
+static inline size_t ParsingMemo__slot( ParsingMemo* this, int id, size_t offset ) {
+	size_t h = (offset * 2654435761u) ^ ((size_t)id * 40503u);
+	return h & (this->capacity - 1);
+}
+
+static void ParsingMemo__allocate( ParsingMemo* this, size_t capacity ) {
+	__ARRAY_NEW(entries, ParsingMemoEntry, capacity);
+	for (size_t i=0 ; i<capacity ; i++) {entries[i].id = -1;}
+	this->entries  = entries;
+	this->capacity = capacity;
+	this->count    = 0;
+}
+
+ParsingMemo* ParsingMemo_new(ParsingArena* arena) {
+	__NEW(ParsingMemo, this);
+	this->hits       = 0;
+	this->committed  = 0;
+	this->generation = 0;
+	this->arena      = arena;
+	ParsingMemo__allocate(this, MEMO_INITIAL_CAPACITY);
+	return this;
 }
 
-ParsingVariable* ParsingVariable_pop(ParsingVariable* this) {
-	if (this == NULL) {return NULL;}
-	ParsingVariable* current  = this;
-	int depth = this->depth;
-	while (current != NULL && current->depth >= depth) {
-		ParsingVariable* to_free  = current;
-		current = current->previous;
-		ParsingVariable_free(to_free);
+// The matches are in the arena, so the entries only need to be emptied.
+void ParsingMemo_clear(ParsingMemo* this) {
+	for (size_t i=0 ; i<this->capacity ; i++) {
+		this->entries[i].match = NULL;
+		this->entries[i].id    = -1;
 	}
-	return current;
+	this->count = 0;
 }
 
-int  ParsingVariable_count(ParsingVariable* this) {
-	ParsingVariable* current = this;
-	int count = 0;
-	while (current!=NULL) {
-		current = current->previous;
-		count++;
+void ParsingMemo_forget(ParsingMemo* this) {
+	if (this != NULL) {this->generation += 1;}
+}
+
+void ParsingMemo_free(ParsingMemo* this) {
+	if (this != NULL) {
+		__FREE(this->entries);
 	}
-	return count;
+	__FREE(this);
+}
+
+ParsingMemoEntry* ParsingMemo_get(ParsingMemo* this, int id, size_t offset) {
+	size_t mask = this->capacity - 1;
+	size_t i    = ParsingMemo__slot(this, id, offset);
+	// Linear probing, the table is never full so we always hit an empty slot
+	while (this->entries[i].id >= 0) {
+		ParsingMemoEntry* e = &(this->entries[i]);
+		if (e->id == id && e->offset == offset) {
+			if (e->generation != this->generation) {return NULL;}
+			this->hits += 1;
+			return e;
+		}
+		i = (i + 1) & mask;
+	}
+	return NULL;
+}
+
+static ParsingMemoEntry* ParsingMemo__insert( ParsingMemo* this, int id, size_t offset ) {
+	size_t mask = this->capacity - 1;
+	size_t i    = ParsingMemo__slot(this, id, offset);
+	while (this->entries[i].id >= 0) {
+		if (this->entries[i].id == id && this->entries[i].offset == offset) {
+			return &(this->entries[i]);
+		}
+		i = (i + 1) & mask;
+	}
+	this->entries[i].id         = id;
+	this->entries[i].generation = this->generation;
+	this->entries[i].offset     = offset;
+	this->entries[i].match      = NULL;
+	this->count += 1;
+	return &(this->entries[i]);
+}
+
+ParsingMemoEntry* ParsingMemo_set(ParsingMemo* this, int id, size_t offset, size_t end, Match* match) {
+	// We keep the load factor under 3/4, rehashing the entries. The
+	// entries before the committed offset won't be looked up anymore, nor
+	// will the forgotten ones, so they're dropped, and the table only
+	// doubles if it would still be more than half full.
+	if ((this->count + 1) * 4 > this->capacity * 3) {
+		ParsingMemoEntry* previous = this->entries;
+		size_t            capacity = this->capacity;
+		size_t            kept     = 0;
+		#define MEMO_KEEPS(e) ((e).id >= 0 && (e).generation == this->generation && (e).offset >= this->committed)
+		for (size_t i=0 ; i<capacity ; i++) {
+			if (MEMO_KEEPS(previous[i])) {kept++;}
+		}
+		ParsingMemo__allocate(this, (kept + 1) * 2 > capacity ? capacity * 2 : capacity);
+		for (size_t i=0 ; i<capacity ; i++) {
+			if (MEMO_KEEPS(previous[i])) {
+				*ParsingMemo__insert(this, previous[i].id, previous[i].offset) = previous[i];
+			}
+		}
+		#undef MEMO_KEEPS
+		__FREE(previous);
+	}
+	ParsingMemoEntry* entry = ParsingMemo__insert(this, id, offset);
+	if (entry->match == NULL || entry->generation != this->generation) {
+		entry->generation = this->generation;
+		entry->end        = end;
+		entry->match      = Match_isSuccess(match) ? match : NULL;
+		// The match must outlive the elements that might fail around it
+		if (entry->match != NULL) {ParsingArena_keep(this->arena);}
+	}
+	return entry;
 }
 
 // ----------------------------------------------------------------------------
@@ -2020,25 +3738,38 @@ ParsingContext* ParsingContext_new( Grammar* g, Iterator* iterator ) {
 	this->iterator     = iterator;
 	this->stats        = ParsingStats_new();
 	this->freeIterator = FALSE;
-	if (g != NULL) {
-		ParsingStats_setSymbolsCount(this->stats, g->axiomCount + g->skipCount);
+	this->flags        = 0;
+	// The per-symbol counters are only kept when the grammar is profiled
+	if (g != NULL && g->stats != NULL) {
+		ParsingStats_setSymbolsCount(this->stats, g->axiomCount + g->skipCount + 1);
+		SET_FLAG(this->flags, FLAG_PROFILING);
+	}
+	// Only verbose and profiled grammars need the tracing recognizers
+	if (g != NULL && (g->isVerbose || g->stats != NULL)) {
+		SET_FLAG(this->flags, FLAG_TRACING);
 	}
 	this->depth     = 0;
-	this->variables = ParsingVariable_new(0, "depth", 0);
+	this->variables = ParsingVariables_new(g);
+	this->arena     = ParsingArena_new();
+	this->memo      = (g != NULL && g->isMemoized) ? ParsingMemo_new(this->arena) : NULL;
 	this->callback  = NULL;
 	this->indent    = INDENT + (INDENT_MAX * INDENT_WIDTH);
-	this->flags     = 0;
+	this->choices   = 0;
 	this->lastMatchOffset = 0;
 	this->lastMatchLength = 0;
 	this->lastMatchElementID = -1;
+	this->parts     = NULL;
 	return this;
 }
 
 void ParsingContext_free( ParsingContext* this ) {
 	// NOTE: We don't need to free the last match, the grammar;
 	if (this!=NULL) {
+		ParsingContext_free(this->parts);
 		if (this->freeIterator) {Iterator_free(this->iterator);}
-		ParsingVariable_freeAll(this->variables);
+		ParsingVariables_free(this->variables);
+		ParsingMemo_free(this->memo);
+		ParsingArena_free(this->arena);
 		ParsingStats_free(this->stats);
 		__FREE(this);
 	}
@@ -2054,41 +3785,71 @@ char ParsingContext_charAt ( ParsingContext* this, size_t offset ) {
 
 
 void ParsingContext_push     ( ParsingContext* this ) {
-	this->variables = ParsingVariable_push(this->variables);
 	if (this->callback != NULL) {this->callback(this, '+');}
-	this->depth += 1;
-	if (this->depth >= 0) {
-		int d = this->depth % INDENT_MAX;
-		this->indent = INDENT + (INDENT_MAX - d) * INDENT_WIDTH;
+	ParsingContext__deepen(this, 1);
+	// We only remember where the frame's shadows start
+	ParsingVariables* variables = this->variables;
+	if (this->depth > 0) {
+		if (this->depth >= variables->framesCapacity) {
+			variables->framesCapacity *= 2;
+			__ARRAY_RESIZE(variables->frames, int, (size_t)variables->framesCapacity);
+		}
+		variables->frames[this->depth] = variables->shadowsCount;
 	}
 }
 
 void ParsingContext_pop      ( ParsingContext* this ) {
 	if (this->callback != NULL) {this->callback(this, '-');}
-	this->variables = ParsingVariable_pop(this->variables);
-	this->depth -= 1;
-	if (this->depth <= 0) {
-		this->indent = INDENT + INDENT_MAX * INDENT_WIDTH;
-	} else {
-		int d = this->depth % INDENT_MAX;
-		this->indent = INDENT + (INDENT_MAX - d) * INDENT_WIDTH;
+	// We restore the values that the frame's variables shadowed
+	ParsingVariables* variables = this->variables;
+	int               start     = this->depth > 0 ? variables->frames[this->depth] : 0;
+	while (variables->shadowsCount > start) {
+		ParsingShadow* shadow = &(variables->shadows[--variables->shadowsCount]);
+		variables->slots[shadow->key] = shadow->previous;
+	}
+	ParsingContext__deepen(this, -1);
+}
+
+void* ParsingContext_getKey(ParsingContext* this, int key) {
+	if (key == KEY_DEPTH) {return (void*)(long)this->depth;}
+	if (key < 0 || key >= this->variables->keysCount) {return NULL;}
+	return this->variables->slots[key].value;
+}
+
+void ParsingContext_setKey(ParsingContext*  this, int key, void* value) {
+	ParsingVariables* variables = this->variables;
+	if (key <= KEY_DEPTH || key >= variables->keysCount) {return;}
+	int          depth = MAX(this->depth, 0);
+	ParsingSlot* slot  = &(variables->slots[key]);
+	// The first time a variable is set in a frame, we save the value
+	// it had in the parent frames.
+	if (slot->depth != depth) {
+		if (variables->shadowsCount == variables->shadowsCapacity) {
+			variables->shadowsCapacity *= 2;
+			__ARRAY_RESIZE(variables->shadows, ParsingShadow, (size_t)variables->shadowsCapacity);
+		}
+		ParsingShadow* shadow = &(variables->shadows[variables->shadowsCount++]);
+		shadow->key      = key;
+		shadow->previous = *slot;
+		slot->depth      = depth;
 	}
+	slot->value = value;
 }
 
 void* ParsingContext_get(ParsingContext* this, const char* name) {
-	return ParsingVariable_get(this->variables, name);
+	return ParsingContext_getKey(this, ParsingVariables_key(this->variables, name, FALSE));
 }
 
 int ParsingContext_getInt(ParsingContext* this, const char* name) {
-	return (int)(long)(ParsingVariable_get(this->variables, name));
+	return (int)(long)(ParsingContext_get(this, name));
 }
 
 void ParsingContext_set(ParsingContext*  this, const char* name, void* value) {
-	this->variables = ParsingVariable_set(this->variables, name, value);
+	ParsingContext_setKey(this, ParsingVariables_key(this->variables, name, TRUE), value);
 }
 
 void ParsingContext_setInt(ParsingContext*  this, const char* name, int value) {
-	this->variables = ParsingVariable_set(this->variables, name, (void*)(long)value);
+	ParsingContext_set(this, name, (void*)(long)value);
 }
 
 void ParsingContext_on(ParsingContext* this, ContextCallback callback) {
@@ -2096,7 +3857,8 @@ void ParsingContext_on(ParsingContext* this, ContextCallback callback) {
 }
 
 int  ParsingContext_getVariableCount(ParsingContext* this) {
-	return ParsingVariable_count(this->variables);
+	// Each frame has its depth, along with the variables set in it
+	return (this->depth >= 0 ? this->depth + 1 : 0) + this->variables->shadowsCount;
 }
 
 size_t ParsingContext_getOffset(ParsingContext* this) {
@@ -2104,20 +3866,7 @@ size_t ParsingContext_getOffset(ParsingContext* this) {
 }
 
 Match* ParsingContext_registerMatch(ParsingContext* this, Element* e, Match* m) {
-	// We don't register skipping matches, as they'll be discarded right away
-	if (HAS_FLAG(this->flags, FLAG_SKIPPING)) {return m;}
-	ParsingStats_registerMatch(this->stats, e, m);
-	// NOTE: We make sure to only register the deepest match, as the grammar
-	// is likely to backtack and yield a partial match, erasing where the error
-	// actually lies. We skip empty matches.
-	if (m != NULL && Match_isSuccess(m)) {
-		if ( (this->lastMatchOffset + this->lastMatchLength) < (m->offset + m->length) && m->length > 0) {
-			this->lastMatchOffset    = m->offset;
-			this->lastMatchLength    = m->length;
-			this->lastMatchElementID = m->element->id;
-		}
-	}
-	return m;
+	return ParsingContext__registerMatch(this, m);
 }
 
 // ----------------------------------------------------------------------------
@@ -2130,8 +3879,12 @@ ParsingStats* ParsingStats_new(void) {
 	__NEW(ParsingStats,this);
 	this->bytesRead = 0;
 	this->parseTime = 0;
-	this->successBySymbol = NULL;
-	this->failureBySymbol = NULL;
+	this->symbolsCount     = 0;
+	this->attemptsBySymbol = NULL;
+	this->successBySymbol  = NULL;
+	this->failureBySymbol  = NULL;
+	this->bytesBySymbol    = NULL;
+	this->timeBySymbol     = NULL;
 	this->failureOffset   = 0;
 	this->matchOffset     = 0;
 	this->matchLength     = 0;
@@ -2141,40 +3894,65 @@ ParsingStats* ParsingStats_new(void) {
 
 void ParsingStats_free(ParsingStats* this) {
 	if (this != NULL) {
+		__FREE(this->attemptsBySymbol);
 		__FREE(this->successBySymbol);
 		__FREE(this->failureBySymbol);
+		__FREE(this->bytesBySymbol);
+		__FREE(this->timeBySymbol);
 	}
 	__FREE(this);
 }
 
 void ParsingStats_setSymbolsCount(ParsingStats* this, size_t t) {
-	__ARRAY_RESIZE(this->successBySymbol, size_t, t);
-	__ARRAY_RESIZE(this->failureBySymbol, size_t, t);
-	this->symbolsCount    = t;
+	__ARRAY_RESIZE(this->attemptsBySymbol, size_t, t);
+	__ARRAY_RESIZE(this->successBySymbol,  size_t, t);
+	__ARRAY_RESIZE(this->failureBySymbol,  size_t, t);
+	__ARRAY_RESIZE(this->bytesBySymbol,    size_t, t);
+	__ARRAY_RESIZE(this->timeBySymbol,     double, t);
+	// The symbols added to the stats start with empty counters
+	for (size_t i=this->symbolsCount ; i<t ; i++) {
+		this->attemptsBySymbol[i] = 0;
+		this->successBySymbol[i]  = 0;
+		this->failureBySymbol[i]  = 0;
+		this->bytesBySymbol[i]    = 0;
+		this->timeBySymbol[i]     = 0;
+	}
+	this->symbolsCount = t;
 }
 
 Match* ParsingStats_registerMatch(ParsingStats* this, Element* e, Match* m) {
-	// FIXME: This is broken!
-	// We can convert ParsingElements to Reference and vice-versa as they
-	// have the same start sequence (char type, int id).
-	// Reference* r = (Reference*)e;
-	// if (m!=NULL && Match_isSuccess(m)) {
-	// 	this->successBySymbol[r->id] += 1;
-	// 	if (m->offset >= this->matchOffset) {
-	// 		this->matchOffset = m->offset;
-	// 		this->matchLength = m->length;
-	// 	}
-	// } else {
-	// 	this->failureBySymbol[r->id] += 1;
-	// 	// We register the deepest failure
-	// 	if(m != NULL && m->offset >= this->failureOffset) {
-	// 		this->failureOffset  = m->offset;
-	// 		this->failureElement = m->element;
-	// 	}
-	// }
+	if (e->id < 0 || (size_t)e->id >= this->symbolsCount) {return m;}
+	if (m!=NULL && Match_isSuccess(m)) {
+		this->successBySymbol[e->id] += 1;
+		if (m->offset >= this->matchOffset) {
+			this->matchOffset = m->offset;
+			this->matchLength = m->length;
+		}
+	} else {
+		this->failureBySymbol[e->id] += 1;
+	}
 	return m;
 }
 
+void ParsingStats_merge(ParsingStats* this, ParsingStats* other) {
+	size_t count = MIN(this->symbolsCount, other->symbolsCount);
+	for (size_t i=0 ; i<count ; i++) {
+		this->attemptsBySymbol[i] += other->attemptsBySymbol[i];
+		this->successBySymbol[i]  += other->successBySymbol[i];
+		this->failureBySymbol[i]  += other->failureBySymbol[i];
+		this->bytesBySymbol[i]    += other->bytesBySymbol[i];
+		this->timeBySymbol[i]     += other->timeBySymbol[i];
+	}
+	this->bytesRead += other->bytesRead;
+	this->parseTime += other->parseTime;
+}
+
+double ParsingStats_now(void) {
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (double)t.tv_sec + (double)t.tv_nsec / 1e9;
+}
+
 // ----------------------------------------------------------------------------
 //
 // PARSING RESULT
@@ -2188,6 +3966,7 @@ ParsingResult* ParsingResult_new(Match* match, ParsingContext* context) {
 	assert(context->iterator != NULL);
 	this->match   = match;
 	this->context = context;
+	this->tree    = NULL;
 	if (match != FAILURE && context->iterator->offset > 0) {
 		if (Iterator_hasMore(context->iterator) && Iterator_remaining(context->iterator) > 0) {
 			LOG_IF(context->grammar->isVerbose, "Partial success, parsed %zu bytes, %zu remaining", context->iterator->offset, Iterator_remaining(context->iterator));
@@ -2225,18 +4004,63 @@ size_t ParsingResult_remaining(ParsingResult* this) {
 }
 
 int ParsingResult_textOffset(ParsingResult* this) {
-	int buffer_offset = this->context->iterator->current - this->context->iterator->buffer;
-	return this->context->iterator->offset - buffer_offset;
+	return (int)Iterator_textOffset(this->context->iterator);
+}
+
+size_t ParsingResult_lineForOffset(ParsingResult* this, size_t offset) {
+	return Iterator_lineAt(this->context->iterator, offset);
+}
+
+size_t ParsingResult_columnForOffset(ParsingResult* this, size_t offset) {
+	size_t start = Iterator_textOffset(this->context->iterator);
+	ParsingResult_lineRange(this, ParsingResult_lineForOffset(this, offset), &start, NULL);
+	return offset - start;
+}
+
+bool ParsingResult_lineRange(ParsingResult* this, size_t line, size_t* start, size_t* end) {
+	Iterator*  iterator = this->context->iterator;
+	LineIndex* index    = &(iterator->lines);
+	size_t     base     = Iterator_textOffset(iterator);
+	// We index the whole buffer so that we know where the last line ends.
+	// The start of the first line that was kept is only known if no
+	// separator was dropped.
+	Iterator__indexLines(iterator, base + iterator->available);
+	if (line > index->dropped + index->count || (line <= index->dropped && index->dropped > 0)) {return FALSE;}
+	size_t i = line - index->dropped;
+	if (start != NULL) {*start = i == 0 ? 0 : index->offsets[i - 1] + 1;}
+	if (end   != NULL) {*end   = i < index->count ? index->offsets[i] : base + iterator->available;}
+	return TRUE;
 }
 
 void ParsingResult_free(ParsingResult* this) {
 	if (this != NULL) {
 		this->match = Match_free(this->match);
+		MatchTree_free(this->tree);
 		ParsingContext_free(this->context);
 	}
 	__FREE(this);
 }
 
+MatchTree* ParsingResult_compact(ParsingResult* this) {
+	if (this->tree != NULL) {return this->tree;}
+	if (this->status == STATUS_FAILED) {return NULL;}
+	MatchTree* tree = MatchTree_new(this->match, this->context->grammar);
+	if (tree == NULL) {return NULL;}
+	// The matches are either in the arena of the context (and of its
+	// parts, for parallel parses), or allocated on their own.
+	ParsingContext* context = this->context;
+	Match_free(this->match);
+	ParsingMemo_free(context->memo);
+	context->memo = NULL;
+	ParsingArena_free(context->arena);
+	context->arena = ParsingArena_new();
+	ParsingContext_free(context->parts);
+	context->parts = NULL;
+	this->match = NULL;
+	this->tree  = tree;
+	return tree;
+}
+
 // ----------------------------------------------------------------------------
 //
 // GRAMMAR
@@ -2301,6 +4125,301 @@ int Grammar__registerElement(Element* e, int step, void* grammar) {
 	}
 }
 
+// Flags the parsing elements that can reach a procedure or a condition,
+// directly or through references, as `FLAG_CONTEXTUAL`, iterating until
+// a fixed point is reached (the grammar might be recursive).
+void Grammar__markContextual( Grammar* this ) {
+	int  count   = this->axiomCount + this->skipCount + 1;
+	bool changed = TRUE;
+	for (int i=0 ; i<count ; i++) {
+		Element* e = this->elements[i];
+		if (e != NULL && ParsingElement_Is(e)) {
+			ParsingElement* pe = (ParsingElement*)e;
+			UNSET_FLAG(pe->flags, FLAG_CONTEXTUAL);
+			// Cuts don't use the context variables
+			if ((pe->type == TYPE_PROCEDURE && pe->recognize != Cut_recognize) || pe->type == TYPE_CONDITION) {
+				SET_FLAG(pe->flags, FLAG_CONTEXTUAL);
+			}
+		}
+	}
+	while (changed) {
+		changed = FALSE;
+		for (int i=0 ; i<count ; i++) {
+			Element* e = this->elements[i];
+			if (e == NULL || !ParsingElement_Is(e)) {continue;}
+			ParsingElement* pe = (ParsingElement*)e;
+			if (HAS_FLAG(pe->flags, FLAG_CONTEXTUAL)) {continue;}
+			Reference* child = pe->children;
+			while (child != NULL) {
+				if (HAS_FLAG(child->element->flags, FLAG_CONTEXTUAL)) {
+					SET_FLAG(pe->flags, FLAG_CONTEXTUAL);
+					changed = TRUE;
+					break;
+				}
+				child = child->next;
+			}
+		}
+	}
+	// The rules that can't reach the variables don't need a scope
+	for (int i=0 ; i<count ; i++) {
+		Element* e = this->elements[i];
+		if (e == NULL || !ParsingElement_Is(e)) {continue;}
+		ParsingElement* pe = (ParsingElement*)e;
+		UNSET_FLAG(pe->flags, FLAG_NOSCOPE);
+		if (pe->type == TYPE_RULE && !HAS_FLAG(pe->flags, FLAG_CONTEXTUAL)) {
+			SET_FLAG(pe->flags, FLAG_NOSCOPE);
+		}
+	}
+}
+
+// Flags the cuts and the rules that pass a cut outside of any choice as
+// `FLAG_CUTTING`, iterating until a fixed point is reached. Groups and
+// the references that iterate are choices, which stop the cut.
+void Grammar__markCutting( Grammar* this ) {
+	int  count   = this->axiomCount + this->skipCount + 1;
+	bool changed = TRUE;
+	for (int i=0 ; i<count ; i++) {
+		Element* e = this->elements[i];
+		if (e != NULL && ParsingElement_Is(e)) {
+			ParsingElement* pe = (ParsingElement*)e;
+			UNSET_FLAG(pe->flags, FLAG_CUTTING);
+			if (pe->recognize == Cut_recognize) {
+				SET_FLAG(pe->flags, FLAG_CUTTING);
+			}
+		}
+	}
+	while (changed) {
+		changed = FALSE;
+		for (int i=0 ; i<count ; i++) {
+			Element* e = this->elements[i];
+			if (e == NULL || !ParsingElement_Is(e)) {continue;}
+			ParsingElement* pe = (ParsingElement*)e;
+			if (pe->type != TYPE_RULE || HAS_FLAG(pe->flags, FLAG_CUTTING)) {continue;}
+			Reference* child = pe->children;
+			while (child != NULL) {
+				if (child->cardinality == CARDINALITY_ONE && HAS_FLAG(child->element->flags, FLAG_CUTTING)) {
+					SET_FLAG(pe->flags, FLAG_CUTTING);
+					changed = TRUE;
+					break;
+				}
+				child = child->next;
+			}
+		}
+	}
+}
+
+// The set of bytes that can start a match of a parsing element, and
+// whether the element can succeed without consuming any input.
+typedef struct FirstSet {
+	unsigned char bytes[32];
+	bool          nullable;
+} FirstSet;
+
+static inline bool FirstSet_has( FirstSet* this, unsigned char c ) {
+	return (this->bytes[c >> 3] & (1 << (c & 7))) != 0;
+}
+
+static inline void FirstSet_add( FirstSet* this, unsigned char c ) {
+	this->bytes[c >> 3] |= (1 << (c & 7));
+}
+
+static void FirstSet_fill( FirstSet* this, int from, int to ) {
+	for (int c=from ; c<=to ; c++) {FirstSet_add(this, (unsigned char)c);}
+}
+
+// Merges the other set's bytes into this one, returning TRUE if this
+// set has changed.
+static bool FirstSet_merge( FirstSet* this, FirstSet* other ) {
+	bool changed = FALSE;
+	for (int i=0 ; i<32 ; i++) {
+		unsigned char b = this->bytes[i] | other->bytes[i];
+		if (b != this->bytes[i]) {this->bytes[i] = b; changed = TRUE;}
+	}
+	return changed;
+}
+
+// Extracts the first bytes of a token from PCRE's study data. Whenever
+// we don't know, we assume the token can start with any byte.
+void Grammar__tokenFirstSet( ParsingElement* token, FirstSet* set ) {
+#ifdef WITH_PCRE
+	TokenConfig*         config     = (TokenConfig*)token->config;
+	int                  min_length = -1;
+	int                  first_byte = -2;
+	const unsigned char* table      = NULL;
+	if (config->extra != NULL) {
+		pcre_fullinfo(config->regexp, config->extra, PCRE_INFO_MINLENGTH, &min_length);
+	}
+	if (min_length <= 0) {
+		// The token might match the empty string
+		set->nullable = TRUE;
+		FirstSet_fill(set, 0, 255);
+		return;
+	}
+	pcre_fullinfo(config->regexp, config->extra, PCRE_INFO_FIRSTBYTE,  &first_byte);
+	pcre_fullinfo(config->regexp, config->extra, PCRE_INFO_FIRSTTABLE, &table);
+	if (first_byte >= 0x80) {
+		// PCRE does not tell us if the first byte is caseless, which might
+		// change the leading byte of UTF-8 sequences.
+		FirstSet_fill(set, 0x80, 255);
+	} else if (first_byte >= 0) {
+		FirstSet_add(set, (unsigned char)first_byte);
+		if (first_byte >= 'a' && first_byte <= 'z') {FirstSet_add(set, (unsigned char)(first_byte - 'a' + 'A'));}
+		if (first_byte >= 'A' && first_byte <= 'Z') {FirstSet_add(set, (unsigned char)(first_byte - 'A' + 'a'));}
+	} else if (table != NULL) {
+		for (int i=0 ; i<32 ; i++) {set->bytes[i] |= table[i];}
+	} else {
+		FirstSet_fill(set, 0, 255);
+	}
+#else
+	FirstSet_fill(set, 0, 255);
+#endif
+}
+
+// Tells if the reference can succeed without consuming input
+static inline bool Grammar__isNullable( Reference* ref, FirstSet* sets ) {
+	return ref->cardinality == CARDINALITY_OPTIONAL
+	    || ref->cardinality == CARDINALITY_MANY_OPTIONAL
+	    || sets[ref->element->id].nullable;
+}
+
+// Computes the first set of every parsing element of the grammar, iterating
+// over groups and rules until a fixed point is reached.
+void Grammar__computeFirstSets( Grammar* this, FirstSet* sets, int count ) {
+	for (int i=0 ; i<count ; i++) {
+		Element* e = this->elements[i];
+		if (e == NULL || !ParsingElement_Is(e)) {continue;}
+		ParsingElement* pe = (ParsingElement*)e;
+		switch (pe->type) {
+			case TYPE_WORD:
+				if (((WordConfig*)pe->config)->length > 0) {
+					FirstSet_add(&sets[i], (unsigned char)((WordConfig*)pe->config)->word[0]);
+				} else {
+					sets[i].nullable = TRUE;
+				}
+				break;
+			case TYPE_TOKEN:
+				Grammar__tokenFirstSet(pe, &sets[i]);
+				break;
+			case TYPE_PROCEDURE:
+			case TYPE_CONDITION:
+				sets[i].nullable = TRUE;
+				break;
+		}
+	}
+	bool changed = TRUE;
+	while (changed) {
+		changed = FALSE;
+		for (int i=0 ; i<count ; i++) {
+			Element* e = this->elements[i];
+			if (e == NULL || !ParsingElement_Is(e)) {continue;}
+			ParsingElement* pe       = (ParsingElement*)e;
+			if (pe->type != TYPE_GROUP && pe->type != TYPE_RULE) {continue;}
+			bool            nullable = pe->type == TYPE_RULE;
+			Reference*      child    = pe->children;
+			while (child != NULL) {
+				changed = FirstSet_merge(&sets[i], &sets[child->element->id]) || changed;
+				if (pe->type == TYPE_GROUP) {
+					nullable = nullable || Grammar__isNullable(child, sets);
+				} else if (!Grammar__isNullable(child, sets)) {
+					// A rule can only start with its first non-nullable child
+					nullable = FALSE;
+					break;
+				}
+				child = child->next;
+			}
+			if (nullable && !sets[i].nullable) {
+				sets[i].nullable = TRUE;
+				changed          = TRUE;
+			}
+		}
+	}
+}
+
+// Tells if the given group child can match input starting with `c`
+static inline bool Grammar__canStartWith( Reference* ref, FirstSet* sets, unsigned char c ) {
+	return Grammar__isNullable(ref, sets) || FirstSet_has(&sets[ref->element->id], c);
+}
+
+// Builds the dispatch table of the given group. Bytes that the skip
+// element can start with keep trying every child, as references
+// skip input before retrying.
+void Grammar__prepareGroup( Grammar* this, ParsingElement* group, FirstSet* sets ) {
+	Group__freeConfig(group);
+	FirstSet* skip     = this->skip == NULL ? NULL : &sets[this->skip->id];
+	int       children = 0;
+	bool      words    = TRUE;
+	Reference* child   = group->children;
+	while (child != NULL) {
+		words = words && child->cardinality == CARDINALITY_ONE && child->element->type == TYPE_WORD;
+		children++;
+		child = child->next;
+	}
+	if (children < 2) {return;}
+
+	int    lists[256];   // The index of the candidate list for each byte, -1 for all
+	int    firsts[256];  // The first byte that uses each candidate list
+	int    offsets[256]; // The offset of each candidate list in the storage
+	int    distinct = 0;
+	size_t total    = 0;
+	for (int c=0 ; c<256 ; c++) {
+		lists[c] = -1;
+		if (skip != NULL && (skip->nullable || FirstSet_has(skip, (unsigned char)c))) {continue;}
+		int count = 0;
+		for (child = group->children ; child != NULL ; child = child->next) {
+			if (Grammar__canStartWith(child, sets, (unsigned char)c)) {count++;}
+		}
+		// Groups of words need an entry for every byte that is not skipped,
+		// as it tells them that they can use their trie.
+		if (count == children && !words) {continue;}
+		// We look for a byte that has exactly the same candidates
+		for (int d=0 ; d<distinct && lists[c] < 0 ; d++) {
+			bool same = TRUE;
+			for (child = group->children ; child != NULL && same ; child = child->next) {
+				same = Grammar__canStartWith(child, sets, (unsigned char)c) == Grammar__canStartWith(child, sets, (unsigned char)firsts[d]);
+			}
+			if (same) {lists[c] = d;}
+		}
+		if (lists[c] < 0) {
+			firsts[distinct]  = c;
+			offsets[distinct] = (int)total;
+			lists[c]          = distinct++;
+			total            += count + 1;
+		}
+	}
+	if (distinct == 0) {return;}
+
+	__NEW(GroupConfig, config);
+	__ARRAY_NEW(candidates, Reference*, total);
+	config->candidates = candidates;
+	for (int d=0 ; d<distinct ; d++) {
+		Reference** list = candidates + offsets[d];
+		for (child = group->children ; child != NULL ; child = child->next) {
+			if (Grammar__canStartWith(child, sets, (unsigned char)firsts[d])) {*(list++) = child;}
+		}
+		*list = NULL;
+	}
+	for (int c=0 ; c<256 ; c++) {
+		config->dispatch[c] = lists[c] < 0 ? NULL : candidates + offsets[lists[c]];
+	}
+	config->words = words ? WordTrie_new(group) : NULL;
+	group->config = config;
+}
+
+// Computes the first sets of the grammar's elements and builds the
+// dispatch tables of its groups.
+void Grammar__prepareDispatch( Grammar* this ) {
+	int count = this->axiomCount + this->skipCount + 1;
+	__ARRAY_NEW(sets, FirstSet, count);
+	Grammar__computeFirstSets(this, sets, count);
+	for (int i=0 ; i<count ; i++) {
+		Element* e = this->elements[i];
+		if (e != NULL && ParsingElement_Is(e) && ((ParsingElement*)e)->type == TYPE_GROUP) {
+			Grammar__prepareGroup(this, (ParsingElement*)e, sets);
+		}
+	}
+	__FREE(sets);
+}
+
 void Grammar_prepare ( Grammar* this ) {
 	if (this->skip!=NULL)  {
 		this->skip->id = 0;
@@ -2332,6 +4451,17 @@ void Grammar_prepare ( Grammar* this ) {
 			ParsingElement__walk(this->skip, Grammar__registerElement, count, this);
 		}
 
+		if (this->stats != NULL) {
+			ParsingStats_setSymbolsCount(this->stats, this->axiomCount + this->skipCount + 1);
+		}
+
+		Grammar__markContextual(this);
+		Grammar__markCutting(this);
+		Grammar__prepareDispatch(this);
+
+		ParsingProgram_free(this->program);
+		this->program = ParsingProgram_new(this);
+
 		#ifdef WITH_TRACE
 		int j = this->skipCount + this->axiomCount + 1;
 		TRACE("Grammar_prepare:  skip=%d + axiom=%d = total=%d symbols", this->skipCount, this->axiomCount, j);
@@ -2348,19 +4478,79 @@ void Grammar_prepare ( Grammar* this ) {
 	}
 }
 
-ParsingResult* Grammar_parseIterator( Grammar* this, Iterator* iterator ) {
-	// We make sure the grammar is prepared before we start parsing
-	if (this->elements == NULL) {Grammar_prepare(this);}
+// Recognizes the axiom at the context's current offset
+static inline Match* Grammar__recognize( Grammar* this, ParsingContext* context ) {
+	// The virtual machine does not trace, and runs rules and groups
+	// inline, so verbose and profiled grammars always use the recursive
+	// recognizers.
+	if (this->isVM && !this->isVerbose && this->stats == NULL && this->program != NULL) {
+		return ParsingProgram_run(this->program, context);
+	} else {
+		return ParsingElement_recognize(this->axiom, context);
+	}
+}
+
+// Parses the iterator with a prepared grammar, without changing the
+// grammar, so that threads can share it.
+static ParsingResult* Grammar__parseIterator( Grammar* this, Iterator* iterator ) {
 	assert(this->axiom != NULL);
 	ParsingContext* context = ParsingContext_new(this, iterator);
 	assert(this->axiom->recognize != NULL);
 	clock_t t1  = clock();
-	Match* match = this->axiom->recognize(this->axiom, context);
+	Match* match = Grammar__recognize(this, context);
 	context->stats->parseTime = ((double)clock() - (double)t1) / CLOCKS_PER_SEC;
 	context->stats->bytesRead = iterator->offset;
 	return ParsingResult_new(match, context);
 }
 
+ParsingResult* Grammar_parseIterator( Grammar* this, Iterator* iterator ) {
+	// We make sure the grammar is prepared before we start parsing
+	if (this->elements == NULL) {Grammar_prepare(this);}
+	ParsingResult* result = Grammar__parseIterator(this, iterator);
+	if (this->stats != NULL) {ParsingStats_merge(this->stats, result->context->stats);}
+	return result;
+}
+
+ParsingResult* Grammar_parseStream( Grammar* this, Iterator* iterator, MatchWalkingCallback callback, void* data ) {
+	if (this->elements == NULL) {Grammar_prepare(this);}
+	assert(this->axiom != NULL);
+	ParsingContext* context = ParsingContext_new(this, iterator);
+	clock_t t1   = clock();
+	int     step = 0;
+	while (Iterator_hasMore(iterator)) {
+		size_t offset = iterator->offset;
+		Match* match  = Grammar__recognize(this, context);
+		// Like references, we skip input in between the records, which
+		// might be all that's left.
+		if (!Match_isSuccess(match) && ParsingElement_skip(this->axiom, context) > 0) {
+			if (!Iterator_hasMore(iterator)) {break;}
+			match = Grammar__recognize(this, context);
+		}
+		if (!Match_isSuccess(match) || iterator->offset == offset) {
+			if (iterator->offset != offset) {Iterator_moveTo(iterator, offset);}
+			break;
+		}
+		int next = callback(match, step, data);
+		// The next record can't backtrack before the end of this one, so
+		// we don't need anything that came before. The memoized matches
+		// go along with the arena, and the table drops the forgotten
+		// entries when it grows.
+		ParsingMemo_forget(context->memo);
+		ParsingArena_reset(context->arena);
+		Iterator_release(iterator, iterator->offset);
+		step++;
+		if (next < 0) {break;}
+	}
+	context->stats->parseTime = ((double)clock() - (double)t1) / CLOCKS_PER_SEC;
+	context->stats->bytesRead = iterator->offset;
+	if (this->stats != NULL) {ParsingStats_merge(this->stats, context->stats);}
+	ParsingResult* result = ParsingResult_new(FAILURE, context);
+	if (step > 0) {
+		result->status = Iterator_hasMore(iterator) ? STATUS_PARTIAL : STATUS_SUCCESS;
+	}
+	return result;
+}
+
 ParsingResult* Grammar_parsePath( Grammar* this, const char* path ) {
 	Iterator* iterator = Iterator_Open(path);
 	if (iterator != NULL) {
@@ -2373,8 +4563,22 @@ ParsingResult* Grammar_parsePath( Grammar* this, const char* path ) {
 	}
 }
 
+// Like `Grammar_parsePath`, but with a prepared grammar that it does not
+// change.
+static ParsingResult* Grammar__parsePath( Grammar* this, const char* path ) {
+	Iterator* iterator = Iterator_Open(path);
+	if (iterator == NULL) {return NULL;}
+	ParsingResult* result = Grammar__parseIterator(this, iterator);
+	result->context->freeIterator = TRUE;
+	return result;
+}
+
 ParsingResult* Grammar_parseString( Grammar* this, const char* text ) {
-	Iterator* iterator = Iterator_FromString(text);
+	return Grammar_parseBuffer(this, text, strlen(text));
+}
+
+ParsingResult* Grammar_parseBuffer( Grammar* this, const char* data, size_t length ) {
+	Iterator* iterator = Iterator_FromBuffer(data, length);
 	if (iterator != NULL) {
 		ParsingResult* result = Grammar_parseIterator(this, iterator);
 		result->context->freeIterator = TRUE;
@@ -2385,6 +4589,913 @@ ParsingResult* Grammar_parseString( Grammar* this, const char* text ) {
 	}
 }
 
+// ----------------------------------------------------------------------------
+//
+// BATCH PARSING
+//
+// ----------------------------------------------------------------------------
+
+typedef struct ParsingBatch {
+	Grammar*        grammar;
+	const char**    paths;
+	ParsingResult** results;
+	size_t          count;
+	size_t          next;       // The index of the next path to parse, shared by the workers
+} ParsingBatch;
+
+// Parses the batch's paths until there are none left. Each worker takes
+// the next path, so that the workers stay busy whatever the file sizes.
+static void* ParsingBatch__work( void* data ) {
+	ParsingBatch* batch = (ParsingBatch*)data;
+	while (TRUE) {
+		size_t i = __atomic_fetch_add(&batch->next, 1, __ATOMIC_RELAXED);
+		if (i >= batch->count) {break;}
+		batch->results[i] = Grammar__parsePath(batch->grammar, batch->paths[i]);
+	}
+	return NULL;
+}
+
+ParsingResult** Grammar_parseBatch( Grammar* this, const char** paths, size_t count, int threads ) {
+	// The grammar is prepared once, before it is shared.
+	if (this->elements == NULL) {Grammar_prepare(this);}
+	__ARRAY_NEW(results, ParsingResult*, count > 0 ? count : 1);
+	ParsingBatch batch = {this, paths, results, count, 0};
+	if (threads <= 0) {
+		long processors = sysconf(_SC_NPROCESSORS_ONLN);
+		threads = processors > 0 ? (int)processors : 1;
+	}
+	if ((size_t)threads > count) {threads = count > 0 ? (int)count : 1;}
+	// The calling thread is one of the workers. If a thread can't be
+	// started, the others will parse its share.
+	__ARRAY_NEW(workers, pthread_t, threads);
+	int started = 0;
+	for (int i=1 ; i<threads ; i++) {
+		if (pthread_create(&workers[started], NULL, ParsingBatch__work, &batch) == 0) {started++;}
+	}
+	ParsingBatch__work(&batch);
+	for (int i=0 ; i<started ; i++) {
+		pthread_join(workers[i], NULL);
+	}
+	__FREE(workers);
+	// Profiled grammars get the counters of each parse, in input order.
+	if (this->stats != NULL) {
+		for (size_t i=0 ; i<count ; i++) {
+			if (results[i] != NULL) {ParsingStats_merge(this->stats, results[i]->context->stats);}
+		}
+	}
+	return results;
+}
+
+void ParsingResult_freeBatch( ParsingResult** results, size_t count ) {
+	if (results == NULL) {return;}
+	for (size_t i=0 ; i<count ; i++) {
+		if (results[i] != NULL) {ParsingResult_free(results[i]);}
+	}
+	__FREE(results);
+}
+
+// ----------------------------------------------------------------------------
+//
+// PARALLEL PARSING
+//
+// ----------------------------------------------------------------------------
+
+bool Boundary_Line( const char* text, size_t offset, size_t length ) {
+	return offset > 0 && offset < length && text[offset - 1] == '\n';
+}
+
+bool Boundary_Unindented( const char* text, size_t offset, size_t length ) {
+	if (!Boundary_Line(text, offset, length)) {return FALSE;}
+	char c = text[offset];
+	return c != ' ' && c != '\t' && c != '\r' && c != '\n';
+}
+
+typedef struct ParsingChunk {
+	size_t          start;      // Where the chunk's first record is looked for
+	size_t          end;        // No record is looked for past this offset
+	size_t          first;      // The offset of the first record, `(size_t)-1` when there is none
+	size_t          last;       // The end of the last record
+	size_t          next;       // Where the record after the last one would be looked for
+	bool            failed;     // Set when the records stopped before the end
+	bool            cut;        // Set when a record failed after a cut, which fails the parse
+	Match*          records;
+	Match*          tail;
+	ParsingContext* context;    // The context of the chunk, which owns the records
+} ParsingChunk;
+
+typedef struct ParsingParallel {
+	Grammar*        grammar;
+	ParsingElement* record;
+	Iterator*       input;
+	ParsingChunk*   chunks;
+	size_t          count;
+	size_t          next;       // The index of the next chunk to parse, shared by the workers
+} ParsingParallel;
+
+// Recognizes the records from the chunk's start, skipping in between them
+// like the iterations of a reference do, until a record would start past
+// the chunk's end.
+static void ParsingChunk__parse( ParsingChunk* this, Grammar* grammar, ParsingElement* record, Iterator* input ) {
+	// The chunk's iterator is a view on the whole input, so that the
+	// offsets of the matches are those of the input, and that the last
+	// record can end past the chunk's end.
+	Iterator* view   = Iterator_new();
+	view->buffer     = input->buffer;
+	view->current    = input->buffer + this->start;
+	view->offset     = this->start;
+	view->capacity   = input->capacity;
+	view->available  = input->available;
+	view->move       = String_move;
+	ParsingContext* context = ParsingContext_new(grammar, view);
+	context->freeIterator   = TRUE;
+	this->context = context;
+	this->records = NULL;
+	this->tail    = NULL;
+	this->first   = (size_t)-1;
+	this->last    = this->start;
+	this->failed  = FALSE;
+	this->cut     = FALSE;
+	while (view->offset < this->end && Iterator_hasMore(view)) {
+		size_t offset = view->offset;
+		int    cut    = ParsingContext__enterChoice(context);
+		Match* match  = ParsingElement_recognize(record, context);
+		bool   is_cut = ParsingContext__leaveChoice(context, cut);
+		if (Match_isSuccess(match)) {
+			if (this->records == NULL) {
+				this->records = match;
+				this->first   = offset;
+			} else {
+				this->tail->next = match;
+			}
+			this->tail = match;
+			this->last = view->offset;
+			if (view->offset == offset) {this->failed = TRUE; break;}
+		} else {
+			Match_free(match);
+			if (is_cut || ParsingElement_skip(record, context) == 0) {
+				this->failed = TRUE;
+				this->cut    = is_cut;
+				break;
+			}
+		}
+	}
+	this->next = view->offset;
+	// The records are not recognized again, so we don't need the memo.
+	ParsingMemo_free(context->memo);
+	context->memo = NULL;
+}
+
+static void* ParsingParallel__work( void* data ) {
+	ParsingParallel* parallel = (ParsingParallel*)data;
+	while (TRUE) {
+		size_t i = __atomic_fetch_add(&parallel->next, 1, __ATOMIC_RELAXED);
+		if (i >= parallel->count) {break;}
+		ParsingChunk__parse(&parallel->chunks[i], parallel->grammar, parallel->record, parallel->input);
+	}
+	return NULL;
+}
+
+// Returns the reference of the axiom that repeats the record, if the
+// axiom is a rule that only does that.
+static Reference* Grammar__recordsReference( Grammar* this, ParsingElement* record ) {
+	ParsingElement* axiom = this->axiom;
+	if (axiom == NULL || record == NULL || axiom->type != TYPE_RULE) {return NULL;}
+	Reference* child = axiom->children;
+	if (child == NULL || child->next != NULL || child->element != record || !Reference_isMany(child)) {return NULL;}
+	return child;
+}
+
+// Cuts the input in chunks that start at boundaries, returning their count
+static size_t ParsingParallel__split( ParsingParallel* this, BoundaryCallback isBoundary, size_t count ) {
+	const char* text   = this->input->buffer;
+	size_t      length = this->input->available;
+	size_t      chunks = 0;
+	size_t      start  = 0;
+	for (size_t i=1 ; i<=count ; i++) {
+		size_t end = i == count ? length : MAX(start + 1, length / count * i);
+		while (end < length && !isBoundary(text, end, length)) {end++;}
+		this->chunks[chunks].start = start;
+		this->chunks[chunks].end   = end;
+		chunks++;
+		if (end >= length) {break;}
+		start = end;
+	}
+	return chunks;
+}
+
+ParsingResult* Grammar_parseParallel( Grammar* this, const char* path, ParsingElement* record, BoundaryCallback isBoundary, int threads ) {
+	if (this->elements == NULL) {Grammar_prepare(this);}
+	Iterator* input = Iterator_Open(path);
+	if (input == NULL) {
+		errno = ENOENT;
+		return NULL;
+	}
+	if (threads <= 0) {
+		long processors = sysconf(_SC_NPROCESSORS_ONLN);
+		threads = processors > 0 ? (int)processors : 1;
+	}
+	threads = (int)MIN((size_t)threads, input->available / PARALLEL_CHUNK_MIN);
+	Reference* records = Grammar__recordsReference(this, record);
+	// The chunks' iterators need the whole input in memory, which is the
+	// case for files that can be mapped.
+	if (threads <= 1 || records == NULL || input->move != String_move) {
+		ParsingResult* result = Grammar_parseIterator(this, input);
+		result->context->freeIterator = TRUE;
+		return result;
+	}
+
+	clock_t t1 = clock();
+	__ARRAY_NEW(chunks, ParsingChunk, threads);
+	ParsingParallel parallel = {this, record, input, chunks, 0, 0};
+	parallel.count = ParsingParallel__split(&parallel, isBoundary == NULL ? Boundary_Line : isBoundary, threads);
+	__ARRAY_NEW(workers, pthread_t, parallel.count);
+	int started = 0;
+	for (size_t i=1 ; i<parallel.count ; i++) {
+		if (pthread_create(&workers[started], NULL, ParsingParallel__work, &parallel) == 0) {started++;}
+	}
+	ParsingParallel__work(&parallel);
+	for (int i=0 ; i<started ; i++) {
+		pthread_join(workers[i], NULL);
+	}
+	__FREE(workers);
+
+	// We join the chunks in order. A chunk follows the previous one if it
+	// starts, or has its first record, where the previous one would have
+	// looked for the next record. Otherwise its boundary was wrong, and
+	// it is parsed again from there.
+	ParsingContext* context = ParsingContext_new(this, input);
+	context->freeIterator   = TRUE;
+	Match*          head    = NULL;
+	Match*          tail    = NULL;
+	size_t          cursor  = 0;
+	size_t          end     = 0;
+	bool            failed  = FALSE;
+	for (size_t i=0 ; i<parallel.count ; i++) {
+		ParsingChunk* chunk = &chunks[i];
+		if (failed || chunk->end <= cursor) {
+			ParsingStats_merge(context->stats, chunk->context->stats);
+			ParsingContext_free(chunk->context);
+			continue;
+		}
+		if (chunk->start != cursor && chunk->first != cursor) {
+			ParsingStats_merge(context->stats, chunk->context->stats);
+			ParsingContext_free(chunk->context);
+			chunk->start = cursor;
+			ParsingChunk__parse(chunk, this, record, input);
+		}
+		if (chunk->records != NULL) {
+			if (head == NULL) {head = chunk->records;} else {tail->next = chunk->records;}
+			tail = chunk->tail;
+			end  = chunk->last;
+		}
+		ParsingContext* part = chunk->context;
+		if (part->lastMatchOffset + part->lastMatchLength > context->lastMatchOffset + context->lastMatchLength) {
+			context->lastMatchOffset    = part->lastMatchOffset;
+			context->lastMatchLength    = part->lastMatchLength;
+			context->lastMatchElementID = part->lastMatchElementID;
+		}
+		ParsingStats_merge(context->stats, part->stats);
+		part->parts    = context->parts;
+		context->parts = part;
+		cursor = chunk->next;
+		failed = chunk->failed;
+		// Like in a reference, a record that fails after a cut fails
+		// the whole parse.
+		if (chunk->cut) {head = NULL; end = 0;}
+	}
+	__FREE(chunks);
+
+	// The records are wrapped in the matches of the axiom and of its
+	// reference, as they would be by a sequential parse.
+	Match* match = FAILURE;
+	if (head != NULL) {
+		Match* reference    = Match_SuccessFromReference(end, records, context);
+		reference->offset   = 0;
+		reference->children = head;
+		match               = Match_Success(end, this->axiom, context);
+		match->offset       = 0;
+		match->children     = reference;
+	}
+	Iterator_moveTo(input, end);
+	context->stats->parseTime = ((double)clock() - (double)t1) / CLOCKS_PER_SEC;
+	context->stats->bytesRead = end;
+	if (this->stats != NULL) {ParsingStats_merge(this->stats, context->stats);}
+	return ParsingResult_new(match, context);
+}
+
+// ----------------------------------------------------------------------------
+//
+// INCREMENTAL PARSING
+//
+// ----------------------------------------------------------------------------
+
+// Shifts the offsets of the match, of its descendants and of its next
+// siblings by the given delta. Memoized matches share their children, so
+// the shifted matches are flagged, and are skipped when met again.
+static void Match__shift( Match* this, ssize_t delta ) {
+	for (Match* match = this ; match != NULL ; match = match->next) {
+		if (HAS_FLAG(match->flags, FLAG_SHIFTED)) {continue;}
+		SET_FLAG(match->flags, FLAG_SHIFTED);
+		match->offset = (size_t)((ssize_t)match->offset + delta);
+		if (match->children != NULL) {Match__shift(match->children, delta);}
+	}
+}
+
+// Clears the flags set by `Match__shift`.
+static void Match__unshift( Match* this ) {
+	for (Match* match = this ; match != NULL ; match = match->next) {
+		if (!HAS_FLAG(match->flags, FLAG_SHIFTED)) {continue;}
+		UNSET_FLAG(match->flags, FLAG_SHIFTED);
+		if (match->children != NULL) {Match__unshift(match->children);}
+	}
+}
+
+static inline size_t Match__end( Match* this ) {
+	return this->offset + this->length;
+}
+
+ParsingResult* Grammar_reparse( Grammar* this, ParsingResult* previous, size_t offset, size_t removed, const char* inserted ) {
+	ParsingContext* context  = previous->context;
+	Iterator*       iterator = context->iterator;
+	size_t          length   = iterator->available;
+	// The previous input must be in memory as a whole, which is the case
+	// for strings and mapped files.
+	if (iterator->move != String_move || Iterator_textOffset(iterator) != 0 || offset + removed > length) {
+		errno = EINVAL;
+		return NULL;
+	}
+	if (this->elements == NULL) {Grammar_prepare(this);}
+	size_t  added   = strlen(inserted);
+	ssize_t delta   = (ssize_t)added - (ssize_t)removed;
+	size_t  edited  = offset + removed;   // The end of the edit in the previous text
+	size_t  updated = offset + added;     // The end of the edit in the new text
+	size_t  total   = (size_t)((ssize_t)length + delta);
+	__ARRAY_NEW(text, char, total + 1);
+	memcpy(text, iterator->buffer, offset);
+	memcpy(text + offset, inserted, added);
+	memcpy(text + updated, iterator->buffer + edited, length - edited);
+	text[total] = '\0';
+	size_t consumed = iterator->offset;
+	Iterator__replaceText(iterator, text, total);
+	context->freeIterator = TRUE;
+
+	// The records can only be reused when the axiom repeats them, and
+	// when the previous result still has them.
+	Reference* records   = this->axiom != NULL && this->axiom->children != NULL ? Grammar__recordsReference(this, this->axiom->children->element) : NULL;
+	Match*     axiom     = previous->match;
+	Match*     reference = Match_isSuccess(axiom) ? axiom->children : NULL;
+	previous->match   = NULL;
+	previous->context = NULL;
+	ParsingResult_free(previous);
+	if (records == NULL || reference == NULL || reference->element != (Element*)records) {
+		Match_free(axiom);
+		context->freeIterator = FALSE;
+		ParsingContext_free(context);
+		ParsingResult* result = Grammar_parseIterator(this, iterator);
+		result->context->freeIterator = TRUE;
+		return result;
+	}
+
+	clock_t t1 = clock();
+	// The memoized matches are those of the previous text, at offsets
+	// that may have changed.
+	ParsingMemo_forget(context->memo);
+	ParsingElement* record = records->element;
+	// We keep the records that end before the edit, and parse the next
+	// ones again until one ends where a previous record ended, after the
+	// edit. The records that follow it are then those of the previous
+	// parse, shifted.
+	Match* head = NULL;
+	Match* tail = NULL;
+	Match* old  = reference->children;
+	while (old != NULL && Match__end(old) < offset) {
+		if (head == NULL) {head = old;}
+		tail = old;
+		old  = old->next;
+	}
+	if (tail != NULL) {tail->next = NULL;}
+	size_t cursor = tail == NULL ? 0 : Match__end(tail);
+	// The deepest match is only kept if it is in the records we keep, or
+	// in the records we reuse.
+	size_t lastOffset    = context->lastMatchOffset;
+	size_t lastLength    = context->lastMatchLength;
+	int    lastElementID = context->lastMatchElementID;
+	if (lastOffset + lastLength > cursor) {
+		context->lastMatchOffset    = tail == NULL ? 0  : tail->offset;
+		context->lastMatchLength    = tail == NULL ? 0  : tail->length;
+		context->lastMatchElementID = tail == NULL ? -1 : tail->element->id;
+	}
+	Iterator_moveTo(iterator, cursor);
+	size_t previousCursor = 0;
+	Match* reused = NULL;
+	bool   synced = FALSE;
+	bool   cut    = FALSE;
+	while (Iterator_hasMore(iterator)) {
+		if (cursor >= updated) {
+			previousCursor = (size_t)((ssize_t)cursor - delta);
+			while (old != NULL && Match__end(old) < previousCursor) {old = old->next;}
+			if (old != NULL && Match__end(old) == previousCursor && previousCursor >= edited) {
+				reused = old->next;
+				synced = TRUE;
+				break;
+			}
+		}
+		int    choice = ParsingContext__enterChoice(context);
+		Match* match  = ParsingElement_recognize(record, context);
+		bool   is_cut = ParsingContext__leaveChoice(context, choice);
+		if (Match_isSuccess(match)) {
+			if (head == NULL) {head = match;} else {tail->next = match;}
+			tail   = match;
+			if (iterator->offset == cursor) {break;}
+			cursor = iterator->offset;
+		} else {
+			Match_free(match);
+			if (is_cut || ParsingElement_skip(record, context) == 0) {
+				cut = is_cut;
+				break;
+			}
+		}
+	}
+	if (synced) {
+		// The previous parse went on from there, so we go to where it ended
+		if (reused != NULL) {
+			Match__shift(reused, delta);
+			Match__unshift(reused);
+			if (head == NULL) {head = reused;} else {tail->next = reused;}
+			while (reused->next != NULL) {reused = reused->next;}
+			cursor = Match__end(reused);
+		}
+		Iterator_moveTo(iterator, (size_t)((ssize_t)consumed + delta));
+		if (lastOffset >= previousCursor && lastOffset + lastLength + delta > context->lastMatchOffset + context->lastMatchLength) {
+			context->lastMatchOffset    = (size_t)((ssize_t)lastOffset + delta);
+			context->lastMatchLength    = lastLength;
+			context->lastMatchElementID = lastElementID;
+		}
+	} else if (tail != NULL) {
+		// Like the previous records, the iterator stays at the end of the
+		// last record when the next one fails.
+		cursor = Match__end(tail);
+		Iterator_moveTo(iterator, cursor);
+	}
+	// Like in a reference, a record that fails after a cut fails the
+	// whole parse.
+	Match* match = FAILURE;
+	if (head != NULL && !cut) {
+		reference->children = head;
+		reference->length   = cursor;
+		axiom->length       = cursor;
+		match               = axiom;
+	} else {
+		Iterator_moveTo(iterator, 0);
+	}
+	context->stats->parseTime = ((double)clock() - (double)t1) / CLOCKS_PER_SEC;
+	context->stats->bytesRead = iterator->offset;
+	if (this->stats != NULL) {ParsingStats_merge(this->stats, context->stats);}
+	return ParsingResult_new(match, context);
+}
+
+// ----------------------------------------------------------------------------
+//
+// VIRTUAL MACHINE
+//
+// ----------------------------------------------------------------------------
+
+#define PROGRAM_INITIAL_CAPACITY 256
+#define PROGRAM_INITIAL_DEPTH    256
+
+// The state of a block or of a reference being run by the machine
+typedef struct ParsingProgramFrame {
+	int               ret;        // Where the block returns to
+	Element*          element;    // The element of the block, or the reference
+	size_t            offset;     // The iterator's offset when the frame started
+	ParsingArenaMark  mark;       // The arena's mark when the block was called
+	Match*            result;
+	Match*            tail;       // The last match of the reference or rule
+	int               count;      // The reference's iterations
+	size_t            iteration;  // The offset where the reference's iteration started
+	size_t            endOffset;  // The end of the reference's last match
+	Reference**       candidates; // The remaining candidates of the group
+	Reference*        next;       // The group's next candidate
+	bool              filtered;   // Tells if the group only tries its candidates
+	bool              retried;    // Tells if the rule's current child was retried after a skip
+	int               cut;        // The cut flag of the enclosing choice
+	bool              committed;  // Tells if the reference's iteration failed after a cut
+} ParsingProgramFrame;
+
+static int ParsingProgram__emit( ParsingProgram* this, char op, int a, int b, void* element ) {
+	if (this->length == this->capacity) {
+		this->capacity *= 2;
+		__ARRAY_RESIZE(this->code, ParsingInstruction, (size_t)this->capacity);
+	}
+	ParsingInstruction* instruction = &this->code[this->length];
+	instruction->op      = op;
+	instruction->a       = a;
+	instruction->b       = b;
+	instruction->element = element;
+	return this->length++;
+}
+
+// Tells if the element is recognized by a block of the program rather
+// than by its callback.
+static inline bool ParsingProgram__isBlock( ParsingElement* element ) {
+	return (element->type == TYPE_GROUP && element->recognize == Group_recognize)
+	    || (element->type == TYPE_RULE  && element->recognize == Rule_recognize);
+}
+
+static void ParsingProgram__emitElement( ParsingProgram* this, ParsingElement* element ) {
+	if (ParsingProgram__isBlock(element) && element->id >= 0 && element->id < this->count) {
+		ParsingProgram__emit(this, OP_CALL, element->id, 0, element);
+	} else {
+		ParsingProgram__emit(this, OP_LEAF, 0, 0, element);
+	}
+}
+
+// Emits the loop that iterates on the reference, which leaves the
+// reference's match in the machine's register.
+static void ParsingProgram__emitReference( ParsingProgram* this, Reference* reference ) {
+	ParsingProgram__emit(this, OP_REF_ENTER, 0, 0, reference);
+	int loop = ParsingProgram__emit(this, OP_REF_TEST, 0, 0, reference);
+	ParsingProgram__emitElement(this, reference->element);
+	int step = ParsingProgram__emit(this, OP_REF_STEP, loop, 0, reference);
+	int exit = ParsingProgram__emit(this, OP_REF_LEAVE, 0, 0, reference);
+	this->code[loop].a = exit;
+	this->code[step].b = exit;
+}
+
+static void ParsingProgram__emitGroup( ParsingProgram* this, ParsingElement* group ) {
+	ParsingProgram__emit(this, OP_GROUP_ENTER, 0, 0, group);
+	// The commits are chained through their target until we know
+	// where the block ends.
+	int commits = -1;
+	for (Reference* child = group->children ; child != NULL ; child = child->next) {
+		int choice = ParsingProgram__emit(this, OP_CHOICE, 0, 0, child);
+		ParsingProgram__emitReference(this, child);
+		commits = ParsingProgram__emit(this, OP_COMMIT, commits, 0, group);
+		this->code[choice].a = this->length;
+	}
+	int fail = ParsingProgram__emit(this, OP_GROUP_FAIL, 0, 0, group);
+	int end  = ParsingProgram__emit(this, OP_RETURN, 0, 0, group);
+	while (commits >= 0) {
+		int previous = this->code[commits].a;
+		this->code[commits].a = end;
+		this->code[commits].b = fail;
+		commits = previous;
+	}
+}
+
+static void ParsingProgram__emitRule( ParsingProgram* this, ParsingElement* rule ) {
+	ParsingProgram__emit(this, OP_RULE_ENTER, 0, 0, rule);
+	// The steps are chained through their failure target, like the
+	// group's commits.
+	int steps = -1;
+	for (Reference* child = rule->children ; child != NULL ; child = child->next) {
+		int start = this->length;
+		ParsingProgram__emitReference(this, child);
+		steps = ParsingProgram__emit(this, OP_RULE_STEP, start, steps, rule);
+	}
+	// An empty rule always fails
+	int success = rule->children == NULL ? -1 : ParsingProgram__emit(this, OP_RULE_END, 0, 0, rule);
+	int failure = ParsingProgram__emit(this, OP_RULE_FAIL, 0, 0, rule);
+	int end     = ParsingProgram__emit(this, OP_RETURN, 0, 0, rule);
+	if (success >= 0) {this->code[success].a = end;}
+	while (steps >= 0) {
+		int previous = this->code[steps].b;
+		this->code[steps].b = failure;
+		steps = previous;
+	}
+}
+
+ParsingProgram* ParsingProgram_new( Grammar* grammar ) {
+	__NEW(ParsingProgram, this);
+	__ARRAY_NEW(code, ParsingInstruction, PROGRAM_INITIAL_CAPACITY);
+	this->code     = code;
+	this->length   = 0;
+	this->capacity = PROGRAM_INITIAL_CAPACITY;
+	this->count    = grammar->axiomCount + grammar->skipCount + 1;
+	__ARRAY_NEW(entries, int, (size_t)this->count);
+	this->entries  = entries;
+	for (int i=0 ; i<this->count ; i++) {
+		this->entries[i] = -1;
+	}
+	// The program recognizes the axiom and stops, and is followed by the
+	// blocks of the grammar's groups and rules.
+	ParsingProgram__emitElement(this, grammar->axiom);
+	ParsingProgram__emit(this, OP_HALT, 0, 0, NULL);
+	for (int i=0 ; i<this->count ; i++) {
+		Element* e = grammar->elements[i];
+		if (e == NULL || !ParsingElement_Is(e) || !ParsingProgram__isBlock((ParsingElement*)e)) {continue;}
+		this->entries[i] = this->length;
+		if (e->type == TYPE_GROUP) {
+			ParsingProgram__emitGroup(this, (ParsingElement*)e);
+		} else {
+			ParsingProgram__emitRule(this, (ParsingElement*)e);
+		}
+	}
+	// Elements that did not get a block are recognized as leaves
+	for (int i=0 ; i<this->length ; i++) {
+		if (this->code[i].op == OP_CALL && this->entries[this->code[i].a] < 0) {
+			this->code[i].op = OP_LEAF;
+		}
+	}
+	return this;
+}
+
+void ParsingProgram_free( ParsingProgram* this ) {
+	if (this != NULL) {
+		__FREE(this->code);
+		__FREE(this->entries);
+	}
+	__FREE(this);
+}
+
+// The machine's steps mirror `ParsingElement_recognize`, `Reference_recognize`,
+// `Group_recognize` and `Rule_recognize`, which are the reference for the
+// semantics. The register `match` holds the result of the last element,
+// reference or block.
+Match* ParsingProgram_run( ParsingProgram* this, ParsingContext* context ) {
+	Iterator*            iterator = context->iterator;
+	ParsingMemo*         memo     = context->memo;
+	int                  capacity = PROGRAM_INITIAL_DEPTH;
+	int                  top      = 0;
+	__ARRAY_NEW(stack, ParsingProgramFrame, (size_t)capacity);
+	ParsingProgramFrame* frame    = NULL;
+	Match*               match    = FAILURE;
+	int                  pc       = 0;
+
+	#define FRAME_PUSH \
+		if (top == capacity) {capacity *= 2; __ARRAY_RESIZE(stack, ParsingProgramFrame, (size_t)capacity);} \
+		frame = &stack[top++];
+	#define FRAME_POP \
+		top--; frame = top > 0 ? &stack[top - 1] : NULL;
+
+	while (TRUE) {
+		ParsingInstruction* instruction = &this->code[pc];
+		switch (instruction->op) {
+
+		case OP_HALT:
+			__FREE(stack);
+			return match;
+
+		case OP_LEAF:
+			match = ParsingElement_recognize((ParsingElement*)instruction->element, context);
+			pc++;
+			break;
+
+		case OP_CALL: {
+			ParsingElement* element = (ParsingElement*)instruction->element;
+			if (memo != NULL && ParsingElement_isMemoizable(element)) {
+				ParsingMemoEntry* entry = ParsingMemo_get(memo, element->id, iterator->offset);
+				if (entry != NULL) {
+					if (entry->match == NULL) {
+						match = FAILURE;
+					} else {
+						match = Match__share(entry->match, context->arena);
+						if (entry->end != iterator->offset) {Iterator_moveTo(iterator, entry->end);}
+					}
+					match = ParsingContext_registerMatch(context, (Element*)element, match);
+					pc++;
+					break;
+				}
+			}
+			FRAME_PUSH
+			frame->ret     = pc + 1;
+			frame->element = (Element*)element;
+			frame->offset  = iterator->offset;
+			frame->mark    = ParsingArena_mark(context->arena);
+			pc = this->entries[instruction->a];
+			break;
+		}
+
+		case OP_RETURN: {
+			ParsingElement* element = (ParsingElement*)frame->element;
+			if (!Match_isSuccess(match)) {ParsingArena_rewind(context->arena, frame->mark);}
+			if (memo != NULL && ParsingElement_isMemoizable(element) && (Match_isSuccess(match) || !HAS_FLAG(element->flags, FLAG_NOFAILMEMOIZE))) {
+				ParsingMemo_set(memo, element->id, frame->offset, iterator->offset, match);
+			}
+			pc = frame->ret;
+			FRAME_POP
+			break;
+		}
+
+		case OP_REF_ENTER:
+			FRAME_PUSH
+			frame->element   = (Element*)instruction->element;
+			frame->offset    = iterator->offset;
+			frame->result    = FAILURE;
+			frame->tail      = NULL;
+			frame->count     = 0;
+			frame->endOffset = iterator->offset;
+			frame->committed = FALSE;
+			pc++;
+			break;
+
+		case OP_REF_TEST: {
+			Reference* reference = (Reference*)frame->element;
+			char       type      = reference->element->type;
+			if (Iterator_hasMore(iterator) || type == TYPE_PROCEDURE || type == TYPE_CONDITION) {
+				frame->iteration = iterator->offset;
+				if (reference->cardinality != CARDINALITY_ONE) {frame->cut = ParsingContext__enterChoice(context);}
+				pc++;
+			} else {
+				pc = instruction->a;
+			}
+			break;
+		}
+
+		case OP_REF_STEP: {
+			Reference* reference = (Reference*)frame->element;
+			size_t     parsed    = iterator->offset - frame->iteration;
+			pc = instruction->a;
+			if (reference->cardinality != CARDINALITY_ONE && ParsingContext__leaveChoice(context, frame->cut) && !Match_isSuccess(match)) {
+				match            = Match_free(match);
+				frame->committed = TRUE;
+				pc               = instruction->b;
+				break;
+			}
+			if (Match_isSuccess(match)) {
+				frame->endOffset = match->offset + match->length;
+				if (frame->count == 0) {
+					frame->result = frame->tail = match;
+					if (parsed == 0 || reference->cardinality == CARDINALITY_ONE || reference->cardinality == CARDINALITY_OPTIONAL) {
+						pc = instruction->b;
+					}
+					frame->count++;
+				} else {
+					frame->tail = frame->tail->next = match;
+					if (parsed == 0) {
+						pc = instruction->b;
+					} else {
+						frame->count++;
+					}
+				}
+			} else {
+				match = Match_free(match);
+				if (ParsingElement_skip((ParsingElement*)reference, context) == 0) {
+					pc = instruction->b;
+				}
+			}
+			if (frame->offset == iterator->offset) {pc = instruction->b;}
+			break;
+		}
+
+		case OP_REF_LEAVE: {
+			Reference* reference  = (Reference*)frame->element;
+			Match*     result     = frame->result;
+			if (iterator->offset != frame->endOffset) {
+				Iterator_backtrack(iterator, frame->endOffset);
+			}
+			bool is_success = Match_isSuccess(result) ? TRUE : FALSE;
+			switch (reference->cardinality) {
+				case CARDINALITY_ONE:
+				case CARDINALITY_MANY:
+					break;
+				case CARDINALITY_OPTIONAL:
+				case CARDINALITY_MANY_OPTIONAL:
+					is_success = TRUE;
+					break;
+				case CARDINALITY_NOT_EMPTY:
+					if (is_success && result->length == 0) {is_success = FALSE;}
+					break;
+				default:
+					ERROR("Unsupported cardinality %c", reference->cardinality);
+					is_success = FALSE;
+			}
+			if (frame->committed) {is_success = FALSE;}
+			if (is_success) {
+				Match* m    = Match_SuccessFromReference(iterator->offset - frame->offset, reference, context);
+				m->children = result == FAILURE ? NULL : result;
+				m->offset   = frame->offset;
+				match       = ParsingContext_registerMatch(context, (Element*)reference, m);
+			} else {
+				Match_fail(result);
+				match       = ParsingContext_registerMatch(context, (Element*)reference, FAILURE);
+			}
+			FRAME_POP
+			pc++;
+			break;
+		}
+
+		case OP_GROUP_ENTER: {
+			GroupConfig* config = (GroupConfig*)((ParsingElement*)frame->element)->config;
+			frame->filtered     = FALSE;
+			frame->candidates   = NULL;
+			frame->next         = NULL;
+			if (config != NULL && Iterator_hasMore(iterator)) {
+				Reference** candidates = config->dispatch[(unsigned char)(*iterator->current)];
+				if (candidates != NULL) {
+					frame->filtered = TRUE;
+					if (config->words != NULL) {
+						frame->next       = WordTrie_match(config->words, iterator->current, Iterator_remaining(iterator));
+					} else {
+						frame->next       = *candidates;
+						frame->candidates = candidates;
+					}
+				}
+			}
+			pc++;
+			break;
+		}
+
+		case OP_CHOICE:
+			if (frame->filtered) {
+				if (frame->next != (Reference*)instruction->element) {
+					pc = instruction->a;
+					break;
+				}
+				frame->next = frame->candidates != NULL ? *(++frame->candidates) : NULL;
+			}
+			frame->cut = ParsingContext__enterChoice(context);
+			pc++;
+			break;
+
+		case OP_COMMIT: {
+			bool committed = ParsingContext__leaveChoice(context, frame->cut);
+			if (Match_isSuccess(match)) {
+				ParsingElement* group = (ParsingElement*)frame->element;
+				Match* result    = Match_Success(match->length, group, context);
+				result->offset   = frame->offset;
+				result->children = match;
+				match            = ParsingContext_registerMatch(context, (Element*)group, result);
+				pc               = instruction->a;
+			} else {
+				match = Match_free(match);
+				pc    = committed ? instruction->b : pc + 1;
+			}
+			break;
+		}
+
+		case OP_GROUP_FAIL:
+			if (iterator->offset != frame->offset) {
+				Iterator_backtrack(iterator, frame->offset);
+			}
+			match = ParsingContext_registerMatch(context, frame->element, FAILURE);
+			pc++;
+			break;
+
+		case OP_RULE_ENTER:
+			if (!HAS_FLAG(((ParsingElement*)frame->element)->flags, FLAG_NOSCOPE)) {ParsingContext_push(context);}
+			frame->result  = FAILURE;
+			frame->tail    = NULL;
+			frame->retried = FALSE;
+			pc++;
+			break;
+
+		case OP_RULE_STEP: {
+			ParsingElement* rule = (ParsingElement*)frame->element;
+			if (!Match_isSuccess(match)) {
+				// Like `Rule_recognize`, we try the child again once if
+				// we can skip some input.
+				match = Match_free(match);
+				if (!frame->retried && ParsingElement_skip(rule, context) > 0) {
+					frame->retried = TRUE;
+					pc = instruction->a;
+				} else {
+					pc = instruction->b;
+				}
+				break;
+			}
+			if (frame->tail == NULL) {
+				frame->result           = Match_Success(match->length, rule, context);
+				frame->result->offset   = frame->offset;
+				frame->result->children = frame->tail = match;
+			} else {
+				frame->tail = frame->tail->next = match;
+			}
+			frame->retried = FALSE;
+			pc++;
+			break;
+		}
+
+		case OP_RULE_END: {
+			if (!HAS_FLAG(((ParsingElement*)frame->element)->flags, FLAG_NOSCOPE)) {ParsingContext_pop(context);}
+			Match* result  = frame->result;
+			result->length = frame->tail->offset - result->offset + frame->tail->length;
+			match          = ParsingContext_registerMatch(context, frame->element, result);
+			pc             = instruction->a;
+			break;
+		}
+
+		case OP_RULE_FAIL:
+			if (!HAS_FLAG(((ParsingElement*)frame->element)->flags, FLAG_NOSCOPE)) {ParsingContext_pop(context);}
+			Match_fail(frame->result);
+			if (iterator->offset != frame->offset) {
+				Iterator_backtrack(iterator, frame->offset);
+			}
+			match = ParsingContext_registerMatch(context, frame->element, FAILURE);
+			pc++;
+			break;
+
+		default:
+			ERROR("ParsingProgram_run: unknown opcode %d at %d", instruction->op, pc);
+			__FREE(stack);
+			return FAILURE;
+		}
+	}
+
+	#undef FRAME_PUSH
+	#undef FRAME_POP
+}
+
 // ----------------------------------------------------------------------------
 //
 // PROCESSOR
@@ -2395,30 +5506,47 @@ Processor* Processor_new() {
 	__NEW(Processor,this);
 	this->callbacksCount = 100;
 	__ARRAY_NEW(callbacks, ProcessorCallback, (size_t)this->callbacksCount);
+	__ARRAY_NEW(nodeCallbacks, ProcessorNodeCallback, (size_t)this->callbacksCount);
 	this->callbacks      = callbacks;
+	this->nodeCallbacks  = nodeCallbacks;
 	this->fallback       = NULL;
 	return this;
 }
 
 void Processor_free(Processor* this) {
+	if (this != NULL) {
+		__FREE(this->callbacks);
+		__FREE(this->nodeCallbacks);
+	}
 	__FREE(this);
 }
 
-void Processor_register (Processor* this, int symbolID, ProcessorCallback callback ) {
+static void Processor__reserve (Processor* this, int symbolID) {
 	if (this->callbacksCount < (symbolID + 1)) {
 		int cur_count        = this->callbacksCount;
 		int new_count        = symbolID + 100;
 		__ARRAY_RESIZE(this->callbacks, ProcessorCallback, new_count);
+		__ARRAY_RESIZE(this->nodeCallbacks, ProcessorNodeCallback, new_count);
 		this->callbacksCount = new_count;
 		// We zero the new values, as `realloc` does not guarantee zero data.
 		while (cur_count < new_count) {
-			this->callbacks[cur_count] = NULL;
+			this->callbacks[cur_count]     = NULL;
+			this->nodeCallbacks[cur_count] = NULL;
 			cur_count++;
 		}
 	}
+}
+
+void Processor_register (Processor* this, int symbolID, ProcessorCallback callback ) {
+	Processor__reserve(this, symbolID);
 	this->callbacks[symbolID] = callback;
 }
 
+void Processor_registerNode (Processor* this, int symbolID, ProcessorNodeCallback callback ) {
+	Processor__reserve(this, symbolID);
+	this->nodeCallbacks[symbolID] = callback;
+}
+
 int Processor_process (Processor* this, Match* match, int step) {
 	ProcessorCallback handler = this->fallback;
 	if (ParsingElement_Is(match->element)) {
@@ -2439,6 +5567,24 @@ int Processor_process (Processor* this, Match* match, int step) {
 	return step;
 }
 
+int Processor_processTree (Processor* this, MatchTree* tree, int node, int step) {
+	ProcessorNodeCallback handler = NULL;
+	int element_id = tree->elements[node];
+	if (element_id < this->callbacksCount && ParsingElement_Is(tree->grammar->elements[element_id])) {
+		handler = this->nodeCallbacks[element_id];
+	}
+	if (handler != NULL) {
+		handler (this, tree, node);
+	} else {
+		int child = tree->children[node];
+		while (child >= 0) {
+			step  = Processor_processTree(this, tree, child, step);
+			child = tree->next[child];
+		}
+	}
+	return step;
+}
+
 // ----------------------------------------------------------------------------
 //
 // MAIN
@@ -24,11 +24,17 @@ extern "C" {
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdarg.h>
+#include <stdint.h>
+#include <limits.h>
 #include <errno.h>
 #include <time.h>
 #include <string.h>
 #include <assert.h>
 #include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <pthread.h>
 #ifdef WITH_PCRE
 #include <pcre.h>
 #endif
@@ -152,7 +158,7 @@ extern "C" {
  * C API manages the memory in the following way:
  *
  * - Any string given to the API is *copied* (`Word_new`, `ParsingElement_name`, etc),
- *   except the text string given to `Grammar_parseString`.
+ *   except the text given to `Grammar_parseString` and `Grammar_parseBuffer`.
  *
  * - `ParsingElements` are freed by the `Grammar_free`
  *
@@ -194,6 +200,18 @@ extern "C" {
  *
 */
 
+// @type LineIndex
+// The offsets of the line separators in the input. The index is built
+// lazily, when a line number is queried (see `Iterator_lineAt`), so that
+// moving the iterator does not need to look at the input.
+typedef struct LineIndex {
+	size_t*        offsets;   // The offsets of the indexed separators, in ascending order
+	size_t         count;
+	size_t         capacity;
+	size_t         dropped;   // The number of separators before the first offset, that were dropped with the released input
+	size_t         end;       // The offset up to which the input was indexed
+} LineIndex;
+
 // @type Iterator
 typedef struct Iterator {
 	char           status;    // The status of the iterator, one of STATUS_{INIT|PROCESSING|INPUT_ENDED|ENDED}
@@ -201,11 +219,11 @@ typedef struct Iterator {
 	char*    current;   // The pointer current offset within the buffer
 	char     separator; // The character for line separator, `\n` by default.
 	size_t         offset;    // Offset in input (in bytes), might be different from `current - buffer` if some input was freed.
-	size_t         lines;     // Counter for lines that have been encountered
+	LineIndex      lines;     // The index of the line separators, see `Iterator_lineAt`
 	size_t         capacity;  // Content capacity (in bytes), might be bigger than the data acquired from the input
 	size_t         available; // Available data in buffer (in bytes), always `<= capacity`
+	size_t         released;  // The offset before which the input is not needed anymore, see `Iterator_release`
 	bool           freeBuffer;
-	// FIXME: The head should be freed when the offsets have been parsed, no need to keep in memory stuff we won't need.
 	void*          input;     // Pointer to the input source (opaque structure)
 	void           (*freeInput) (void*);
 	bool          (*move) (struct Iterator*, int n); // Plug-in function to move to the previous/next positions
@@ -213,10 +231,16 @@ typedef struct Iterator {
 
 // @type FileInput
 // The file input wraps information about the input file, such
-// as the `FILE` object and the `path`.
+// as the `FILE` object and the `path`. Regular files are mapped
+// in memory as a whole, while other files (like pipes) are read
+// into the iterator's buffer as the iterator moves.
 typedef struct FileInput {
 	FILE*        file;
 	const char*  path;
+	char*        data;    // The mapped file, NULL when the file is read
+	size_t       size;    // The size of the file, when mapped
+	size_t       mapped;  // The length of the mapping, which ends with a zero byte
+	size_t       dropped; // The length of the mapping's start that was given back to the system
 } FileInput;
 
 // @shared
@@ -231,6 +255,12 @@ Iterator* Iterator_Open(const char* path);
 // Returns a new iterator instance with the text
 Iterator* Iterator_FromString(const char* text);
 
+// @operation
+// Returns a new iterator on the `length` bytes of data, which don't need
+// to be followed by a zero byte. The data is not copied, and must outlive
+// the iterator.
+Iterator* Iterator_FromBuffer(const char* data, size_t length);
+
 // @constructor
 Iterator* Iterator_new(void);
 
@@ -240,7 +270,9 @@ void      Iterator_free(Iterator* this);
 // @method
 // Makes the given iterator open the file at the given path.
 // This will automatically assign a `FileInput` to the iterator
-// as an input source.
+// as an input source. Regular files are mapped in memory and are
+// then iterated like strings, other files are read as the iterator
+// moves.
 bool Iterator_open( Iterator* this, const char* path );
 
 // @method
@@ -259,13 +291,41 @@ size_t Iterator_remaining( Iterator* this );
 bool Iterator_moveTo ( Iterator* this, size_t offset );
 
 // @method
-// Backtracks the iterator to the given offset, setting the line counter
-bool Iterator_backtrack ( Iterator* this, size_t offset, size_t lines );
+// Backtracks the iterator to the given offset
+bool Iterator_backtrack ( Iterator* this, size_t offset );
+
+// @method
+// Returns the line (starting at 0) of the given offset, which is the number
+// of separators before it. The input is indexed up to the offset on the
+// first query, and the index is then searched. The offsets that were
+// released are all on the first line that is still in the buffer.
+size_t Iterator_lineAt ( Iterator* this, size_t offset );
+
+// @method
+// Returns the line of the iterator's current offset
+size_t Iterator_line ( Iterator* this );
 
 // @method
 // Gets the character at the given offset
 char Iterator_charAt ( Iterator* this, size_t offset );
 
+// @method
+// Returns the input offset of the first byte in the buffer. This is 0
+// unless input was released, and offsets in the input should be turned
+// into buffer positions by substracting it.
+size_t Iterator_textOffset ( Iterator* this );
+
+// @method
+// Declares that the input before `offset` won't be needed anymore, which
+// is the iterator's low-water mark. Nothing before that offset can be
+// backtracked to or read afterwards, including the text of matches.
+//
+// Read files drop the released input from their buffer when they need
+// room for more input, so that the buffer's size depends on the amount
+// of input that is still needed rather than on the input's size.
+// Mapped files give the released pages back to the system.
+void Iterator_release ( Iterator* this, size_t offset );
+
 // @method
 bool String_move ( Iterator* this, int offset );
 
@@ -281,17 +341,150 @@ FileInput* FileInput_new(const char* path );
 // @destructor
 void       FileInput_free(void* this);
 
+// @method
+// Maps the whole file in memory if it is a regular file, and tells
+// if it succeeded. The mapping is followed by at least one zero byte.
+bool FileInput_map( FileInput* this );
+
 // @method
 // Preloads data from the input source so that the buffer
-// has up to ITERATOR_BUFFER_AHEAD characters ahead.
+// has up to ITERATOR_BUFFER_AHEAD characters ahead. The released
+// input is dropped from the buffer before it is grown.
 size_t FileInput_preload( Iterator* this );
 
+// @method
+// Gives the pages of a mapped file that were released by the iterator
+// back to the system. Read files drop their released input on preload.
+void FileInput_release( Iterator* this );
+
 // @method
 // Advances/rewinds the given iterator, loading new data from the file input
 // whenever there is not `ITERATOR_BUFFER_AHEAD` data elements
 // ahead of the iterator's current position.
 bool FileInput_move   ( Iterator* this, int n );
 
+// @callback
+// Reads up to `length` bytes of input into `data`, returning the number
+// of bytes read, which can be less than asked, `0` once the input ended,
+// or `-1` if it failed (with `errno` set).
+typedef ssize_t (*ReaderCallback)(char* data, size_t length, void* context);
+
+// @define
+// The number of bytes a reader input asks for at once
+#define READER_INPUT_CHUNK (1024 * 1024)
+
+// @type ReaderInput
+// The reader input gets its data from a callback, or from a file
+// descriptor, in large reads made straight into the iterator's buffer.
+// This suits pipes, sockets or decompressed streams, which can't be
+// mapped, without going through a `FILE*`. Like read files, the input
+// that was released is dropped from the buffer.
+typedef struct ReaderInput {
+	ReaderCallback read;
+	void*          context;  // Given to the callback
+	int            fd;       // The file descriptor read by default, -1 if none
+	bool           closeFD;  // Tells if the file descriptor is closed along with the input
+	int            error;    // The `errno` of the read that failed, which ends the input, 0 if none
+} ReaderInput;
+
+// @operation
+// Returns a new iterator on the input read by the given callback
+Iterator* Iterator_FromReader(ReaderCallback read, void* context);
+
+// @operation
+// Returns a new iterator on the input read from the given file
+// descriptor, which is closed along with the iterator when `close` is set.
+Iterator* Iterator_FromFD(int fd, bool close);
+
+// @constructor
+// Creates an input that calls the given callback, or reads its `fd` when
+// the callback is NULL.
+ReaderInput* ReaderInput_new(ReaderCallback read, void* context);
+
+// @destructor
+void       ReaderInput_free(void* this);
+
+// @method
+// Reads from the input until there are `ITERATOR_BUFFER_AHEAD` bytes
+// ahead of the iterator's current position, or until the input ends,
+// returning the number of bytes ahead.
+size_t ReaderInput_preload( Iterator* this );
+
+// @method
+// Like `FileInput_move`, for a reader input.
+bool ReaderInput_move ( Iterator* this, int n );
+
+/**
+ * Output data
+ * -----------
+ *
+ * Matches are serialized (see `Match_dumpJSON`) to a `Writer`, which
+ * buffers the output in memory. An in-memory writer keeps all of it, while
+ * the other ones hand the buffer to a callback, a file descriptor or a
+ * `FILE*` whenever it is full.
+ *
+ * ```c
+ * Writer* writer = Writer_new();
+ * Match_dumpJSON(result->match, writer);
+ * fwrite(writer->data, 1, writer->length, stdout);
+ * Writer_free(writer);
+ * ```
+*/
+
+// The size of a writer's buffer, which is where in-memory writers start
+#define WRITER_CAPACITY (64 * 1024)
+
+// @callback
+// Receives the `length` bytes of data flushed by a writer, returning
+// `FALSE` if they could not be written.
+typedef bool (*WriterCallback)(const char* data, size_t length, void* context);
+
+// @type Writer
+typedef struct Writer {
+	char*          data;       // The buffered data, followed by a zero byte
+	size_t         length;     // The number of bytes in `data`
+	size_t         flushed;    // The number of bytes given to the callback so far
+	size_t         capacity;   // The number of bytes `data` can hold
+	WriterCallback callback;   // Where the data is flushed, NULL to keep it in memory
+	void*          context;    // Given to the callback
+	bool           failed;     // Set once the callback failed, the data is then dropped
+} Writer;
+
+// @constructor
+// Creates a writer that keeps all the data in memory
+Writer* Writer_new( void );
+
+// @constructor
+Writer* Writer_FromCallback( WriterCallback callback, void* context );
+
+// @constructor
+Writer* Writer_FromFD( int fd );
+
+// @constructor
+Writer* Writer_FromFile( FILE* file );
+
+// @destructor
+// Flushes the writer and frees it, along with its data
+void Writer_free( Writer* this );
+
+// @method
+// Gives the buffered data to the callback, telling if everything was
+// written so far. In-memory writers are left untouched.
+bool Writer_flush( Writer* this );
+
+// @method
+void Writer_write( Writer* this, const char* data, size_t length );
+
+// @method
+void Writer_print( Writer* this, const char* text );
+
+// @method
+void Writer_printf( Writer* this, const char* format, ... );
+
+// @method
+// Writes the text as the content of a JSON string
+void Writer_printEscaped( Writer* this, const char* text, size_t length );
+
 /**
  * Grammar
  * -------
@@ -303,7 +496,10 @@ bool FileInput_move   ( Iterator* this, int n );
  * The `axiom` and `skip` properties are both references to _parsing elements_.
 */
 
-typedef struct ParsingVariable ParsingVariable;
+typedef struct ParsingVariables ParsingVariables;
+typedef struct ParsingMemo     ParsingMemo;
+typedef struct ParsingArena    ParsingArena;
+typedef struct ParsingProgram  ParsingProgram;
 typedef struct ParsingContext  ParsingContext;
 typedef struct ParsingElement  ParsingElement;
 typedef struct ParsingResult   ParsingResult;
@@ -311,6 +507,9 @@ typedef struct Reference       Reference;
 typedef struct Match           Match;
 typedef struct Element         Element;
 
+// @callback
+typedef int (*MatchWalkingCallback)(Match* this, int step, void* context);
+
 // @type Element
 typedef struct Element {
 	char           type;       // Type is used du differentiate ParsingElement from Reference
@@ -326,6 +525,12 @@ typedef struct Grammar {
 	int              skipCount;   // The count of parsing elements in skip
 	Element**        elements;    // The set of all elements in the grammar
 	bool             isVerbose;
+	bool             isMemoized;  // Tells if matches are memoized (packrat parsing), FALSE by default
+	bool             isVM;        // Tells if parsing runs the compiled program, FALSE by default
+	ParsingProgram*  program;     // The program compiled by `Grammar_prepare`
+	char**           keys;        // The names of the variable keys, see `Grammar_key`
+	int              keysCount;
+	struct ParsingStats* stats;   // The counters of the profiled parses, NULL by default
 } Grammar;
 
 // @constructor
@@ -335,26 +540,167 @@ Grammar* Grammar_new(void);
 void Grammar_free(Grammar* this);
 
 // @method
+// Assigns ids to the grammar's elements, flags the contextual ones,
+// builds the groups' first-byte dispatch tables and compiles the
+// grammar's program. This is called on the first parse, and must be
+// called again if the grammar is modified.
+//
+// A prepared grammar is read-only while parsing: each parse has its own
+// context, variables and matches, so the grammar can be shared by threads
+// parsing at the same time. The grammar must not be changed while they
+// do (`Grammar_setVerbose`, `Grammar_enableProfiling`...), profiled
+// grammars must use `Grammar_parseBatch`, and the grammar's procedures and
+// conditions must only change their context.
 void Grammar_prepare ( Grammar* this );
 
 // @method
+// Logs each step of the parses that start from now on. Verbose grammars
+// use the tracing variants of the recognizers, which are slower.
 void Grammar_setVerbose ( Grammar* this );
 
 // @method
 void Grammar_setSilent ( Grammar* this );
 
+// @method
+// Enables the memoization of matches and failures by (element, offset).
+// This pays off for grammars that backtrack over the same input a lot,
+// but otherwise costs more time and memory than it saves, which is
+// why it is not the default. See `ParsingElement_recognize`.
+void Grammar_enableMemoize ( Grammar* this );
+
+// @method
+// Disables memoization altogether, which is the default: each element
+// will be recognized again every time the parser backtracks over it.
+void Grammar_disableMemoize ( Grammar* this );
+
+// @method
+// Runs the parser on the program compiled by `Grammar_prepare` instead of
+// the recursive `recognize` callbacks. Both yield the same matches, see
+// `ParsingProgram_run`.
+void Grammar_enableVM ( Grammar* this );
+
+// @method
+// Goes back to the recursive recognizers, which is the default.
+void Grammar_disableVM ( Grammar* this );
+
+// @method
+// Counts the attempts, successes, failures, consumed bytes and time of
+// each symbol in the grammar's `stats`, accumulating across parses.
+// Profiled parses always use the recursive recognizers.
+void Grammar_enableProfiling ( Grammar* this );
+
+// @method
+// Stops profiling, discarding the grammar's stats.
+void Grammar_disableProfiling ( Grammar* this );
+
+// @method
+// Interns the name of a parsing variable, returning its key, which can
+// then be given to `ParsingContext_getKey` and `ParsingContext_setKey`
+// in any context of the grammar. This is meant to be done when the
+// grammar is built, for instance when creating procedures.
+int Grammar_key ( Grammar* this, const char* name );
+
 // @method
 int Grammar_symbolsCount ( Grammar* this );
 
 // @method
 ParsingResult* Grammar_parseIterator( Grammar* this, Iterator* iterator );
 
+// @method
+// Parses the iterator's input as a sequence of the grammar's axiom, which
+// should thus recognize a single record of the input, like a line of a log.
+// The `callback` is given each match as soon as it is recognized, along
+// with its index as `step`, and can stop the parsing by returning a negative
+// value.
+//
+// Once the callback returns, the match is released along with its input
+// (see `Iterator_release`), so that memory depends on the size of a record
+// rather than on the size of the input. The callback must thus copy
+// whatever it needs from the match, including its text.
+//
+// The returned result has no match. It is a success if the whole input was
+// parsed, partial if some records were parsed.
+ParsingResult* Grammar_parseStream( Grammar* this, Iterator* iterator, MatchWalkingCallback callback, void* data );
+
 // @method
 ParsingResult* Grammar_parsePath( Grammar* this, const char* path );
 
 // @method
 ParsingResult* Grammar_parseString( Grammar* this, const char* text );
 
+// @method
+// Like `Grammar_parseString`, for the `length` bytes of data, which are
+// neither copied nor expected to be followed by a zero byte.
+ParsingResult* Grammar_parseBuffer( Grammar* this, const char* data, size_t length );
+
+// @method
+// Returns the result of a parse saved with `Match_writeBinary`, for the
+// input of the given iterator, or `NULL` if the data can't be read for
+// this grammar (see `Match_readBinary`).
+ParsingResult* Grammar_readBinary( Grammar* this, Iterator* iterator, const char* data, size_t length );
+
+// @method
+// Parses the `count` files at `paths` with `threads` threads sharing the
+// grammar (one per processor when `threads` is 0), returning an array of
+// `count` results in the order of the paths. A path that can't be opened
+// yields a `NULL` result. The results are freed with `ParsingResult_freeBatch`.
+ParsingResult** Grammar_parseBatch( Grammar* this, const char** paths, size_t count, int threads );
+
+// The minimum size of the chunks of `Grammar_parseParallel`, smaller
+// inputs use fewer threads.
+#define PARALLEL_CHUNK_MIN (64 * 1024)
+
+// @callback
+// Tells if a record may start at the given offset of the `length` bytes
+// of text. See `Grammar_parseParallel`.
+typedef bool (*BoundaryCallback)(const char* text, size_t offset, size_t length);
+
+// @function
+// A boundary at the start of each line
+bool Boundary_Line( const char* text, size_t offset, size_t length );
+
+// @function
+// A boundary at the start of each line that is not indented nor blank
+bool Boundary_Unindented( const char* text, size_t offset, size_t length );
+
+// @method
+// Parses the file at `path` with `threads` threads (one per processor
+// when 0), for grammars whose axiom is a rule that repeats the `record`
+// symbol, like `Records = RULE(_MO(Record))`. The file is cut in as many
+// chunks, each starting at the first offset where `isBoundary` (by
+// default `Boundary_Line`) tells that a record may start, and the records
+// of each chunk are recognized on their own.
+//
+// The chunks are then joined in one result, where the matches have the
+// offsets of the file, and that is the same as the one of a sequential
+// parse. A chunk whose boundary turns out to be wrong, as the last record
+// of the previous chunk went past it, is parsed again from the end of
+// that record. The records must thus not depend on the ones before them
+// (through variables or procedures), and the boundaries should be rare
+// within records, or the chunks will be parsed twice.
+//
+// Grammars with another axiom, and inputs that can't be mapped in memory
+// or are too small, are parsed sequentially.
+ParsingResult* Grammar_parseParallel( Grammar* this, const char* path, ParsingElement* record, BoundaryCallback isBoundary, int threads );
+
+// @method
+// Parses the input of the `previous` result again after an edit that
+// replaced the `removed` bytes at `offset` with the `inserted` text,
+// returning the new result. The previous result is consumed, and can't
+// be used anymore, as the new one takes over its context and matches.
+//
+// When the axiom repeats a record, like for `Grammar_parseParallel`, the
+// records that end before the edit are kept, and the next ones are parsed
+// again until one ends where a previous record ended, after the edit. The
+// records that follow are those of the previous result, shifted. Like
+// for parallel parsing, the records must thus not depend on the ones
+// before them. Other grammars are parsed again as a whole.
+//
+// The matches of the records that were replaced are only released with
+// the result. Returns `NULL` (leaving `previous` as it is) if the edit
+// goes past the input, or if the input is not in memory as a whole.
+ParsingResult* Grammar_reparse( Grammar* this, ParsingResult* previous, size_t offset, size_t removed, const char* inserted );
+
 // @method
 void Grammar_freeElements(Grammar* this);
 
@@ -394,9 +740,9 @@ int Element__walk( Element* this, ElementWalkingCallback callback, int step, voi
 typedef struct Match {
 	// TODO: We might need to put offset there
 	char            status;     // The status of the match (see STATUS_XXX)
+	char            flags;      // The match's flags (see FLAG_ARENA)
 	size_t          offset;     // The offset of `char` matched
 	size_t          length;     // The number of `char` matched
-	size_t          line;       // The line number for the match
 	Element*        element;
 	void*           data;      // The matched data (usually a subset of the input stream)
 	struct Match*   next;      // A pointer to the next  match (see `References`)
@@ -441,8 +787,48 @@ typedef struct Match {
 #define TYPE_REFERENCE  '#'
 
 #define FLAG_SKIPPING    0x1
+// @define
+// Set on the parsing context when a `Cut` was passed since the innermost
+// choice started.
+#define FLAG_CUT         0x2
+// @define
+// Set on the parsing context when its grammar is profiled
+#define FLAG_PROFILING   0x4
+// @define
+// Set on the parsing context when its grammar is verbose or profiled, so
+// that the elements use the tracing variants of their recognizers.
+#define FLAG_TRACING     0x8
 
 #define FLAG_NOEMPTY     0x1
+// @define
+// The match was allocated in the parsing context's arena, and is freed along
+// with it
+#define FLAG_ARENA       0x1
+// @define
+// The match was shifted by `Grammar_reparse`, which only shifts once the
+// matches that are shared by memoized matches
+#define FLAG_SHIFTED     0x2
+// @define
+// The parsing element's matches won't be memoized (see `ParsingElement_disableMemoize`)
+#define FLAG_NOMEMOIZE      0x2
+// @define
+// The parsing element's failures won't be memoized
+#define FLAG_NOFAILMEMOIZE  0x4
+// @define
+// Set by `Grammar_prepare` on elements that can reach a `Procedure`
+// or a `Condition`, and whose result might thus depend on the context
+// variables.
+#define FLAG_CONTEXTUAL     0x8
+// @define
+// Set by `Grammar_prepare` on cuts, and on the rules that pass a cut
+// without going through a choice. Their matches are not memoized, as
+// a memoized match would not commit the enclosing choice.
+#define FLAG_CUTTING        0x10
+// @define
+// Set by `Grammar_prepare` on the rules that are not `FLAG_CONTEXTUAL`. As
+// nothing they reach can use the context variables, they don't push a
+// variable scope (nor notify the context's callback).
+#define FLAG_NOSCOPE        0x20
 
 #define PUSH_FLAGS(v)    int _flags = v;
 #define SET_FLAG(v,f)    v=v|f;
@@ -458,9 +844,6 @@ typedef struct Match {
 // will have an id of `ID_BINDING` temporarily.
 #define ID_BINDING       -1
 
-// @callback
-typedef int (*MatchWalkingCallback)(Match* this, int step, void* context);
-
 // @singleton FAILURE_S
 // A specific match that indicates a failure
 extern Match FAILURE_S;
@@ -545,7 +928,11 @@ int Match_countChildren(Match* this);
 
 // @method
 // Protected method
-void Match__writeJSON(Match* match, int fd, int flags);
+void Match__writeJSON(Match* match, Writer* writer, int flags);
+
+// @method
+// Writes the match and its children as JSON to the writer
+void Match_dumpJSON(Match* this, Writer* writer);
 
 // @method
 void Match_writeJSON(Match* this, int fd);
@@ -555,7 +942,11 @@ void Match_printJSON(Match* this);
 //
 // @method
 // Protected method
-void Match__writeXML(Match* match, int fd, int flags);
+void Match__writeXML(Match* match, Writer* writer, int flags);
+
+// @method
+// Writes the match and its children as an XML document to the writer
+void Match_dumpXML(Match* this, Writer* writer);
 
 // @method
 void Match_writeXML(Match* this, int fd);
@@ -563,6 +954,207 @@ void Match_writeXML(Match* this, int fd);
 // @method
 void Match_printXML(Match* this);
 
+/**
+ * Binary format
+ * -------------
+ *
+ * Match trees can be written in a compact binary format, to be cached or
+ * passed to another process, and read back without parsing the input again.
+ * The format is:
+ *
+ * - the `BINARY_MAGIC` bytes
+ * - the nodes of the tree in pre-order, each one being the element id,
+ *   the offset (relative to the previous node's), the length and the number
+ *   of children (shifted left, the lowest bit telling that the node has
+ *   token groups), followed by the groups' count and spans for tokens
+ * - the table, with the number of nodes and of names, and then each
+ *   element's id, type and zero-terminated name
+ * - the offset of the table, as 8 bytes in little-endian order
+ *
+ * Numbers are unsigned LEB128 varints, zig-zag encoded when signed. A
+ * `MatchReader` goes through the nodes straight from the data, which can
+ * be mapped from a file, while `Match_readBinary` rebuilds the matches.
+ * The input is not part of the format, it must be given to the reader's
+ * iterator.
+*/
+
+#define BINARY_MAGIC "LPT\x01"
+
+// @type MatchNode
+typedef struct MatchNode {
+	int          id;         // The id of the node's element
+	char         type;       // The type of the node's element
+	const char*  name;       // The name of the node's element, empty if it has none
+	size_t       offset;
+	size_t       length;
+	size_t       children;   // The number of children, which are the next nodes
+	int          groups;     // The number of token groups
+	const int*   spans;      // The start and end of each token group, relative to the node's offset, valid until the next node
+} MatchNode;
+
+// @type MatchReader
+typedef struct MatchReader {
+	const char*  data;
+	size_t       length;
+	size_t       position;   // The position of the next node in the data
+	size_t       end;        // The position of the table, where the nodes end
+	size_t       count;      // The number of nodes
+	size_t       read;       // The number of nodes read so far
+	size_t       offset;     // The offset of the last node read
+	const char** names;      // The names of the elements, by id
+	char*        types;      // The types of the elements, by id
+	int          namesCount;
+	int*         spans;
+	int          spansCount;
+} MatchReader;
+
+// @method
+// Writes the match and its descendants (but not its siblings) to the
+// writer, in the binary format.
+void Match_writeBinary(Match* this, Writer* writer);
+
+// @constructor
+// Returns a reader on the binary data, or `NULL` if the data is not in the
+// binary format. The data must outlive the reader.
+MatchReader* MatchReader_new(const char* data, size_t length);
+
+// @destructor
+void MatchReader_free(MatchReader* this);
+
+// @method
+// Reads the next node, returning `FALSE` once they are all read, or if
+// the data is corrupted.
+bool MatchReader_next(MatchReader* this, MatchNode* node);
+
+// @method
+// Rebuilds the matches from the binary data, in the context's arena and
+// bound to the context's grammar and iterator. Returns `NULL` if the data
+// is invalid, was written with elements that are not the grammar's, or
+// has matches past the input that is available to the iterator.
+Match* Match_readBinary(ParsingContext* context, const char* data, size_t length);
+
+/**
+ * Match tree
+ * ----------
+ *
+ * A `MatchTree` is a compact copy of a match tree, where the nodes are
+ * stored as 32-bit values in parallel arrays rather than as `Match`
+ * structures linked by pointers. A node takes 20 bytes instead of the 80
+ * of a match (plus its token data), and the nodes are contiguous, in
+ * pre-order, so that going through the tree stays in cache.
+ *
+ * Nodes are designated by their index, the root being `0` and `-1`
+ * standing for no node. Token groups are not kept: tokens that need them
+ * can be recognized again on the node's text.
+*/
+
+// @type MatchTree
+typedef struct MatchTree {
+	uint32_t*        offsets;
+	uint32_t*        lengths;
+	int32_t*         elements;   // The id of each node's element (a reference or a parsing element) in the grammar
+	int32_t*         children;   // The index of each node's first child, -1 if it has none
+	int32_t*         next;       // The index of each node's next sibling, -1 if it has none
+	int32_t          count;
+	int32_t          capacity;
+	struct Grammar*  grammar;    // The grammar whose elements the ids refer to
+} MatchTree;
+
+// @constructor
+// Returns a compact copy of the given match and its descendants (but not
+// its siblings), or `NULL` if the match failed or if an offset or a
+// length does not fit in 32 bits.
+MatchTree* MatchTree_new(Match* match, struct Grammar* grammar);
+
+// @destructor
+void MatchTree_free(MatchTree* this);
+
+// @method
+int MatchTree_getOffset(MatchTree* this, int node);
+
+// @method
+int MatchTree_getLength(MatchTree* this, int node);
+
+// @method
+int MatchTree_getEndOffset(MatchTree* this, int node);
+
+// @method
+int MatchTree_getElementID(MatchTree* this, int node);
+
+// @method
+// Returns the node's element, which might be a reference.
+Element* MatchTree_getElement(MatchTree* this, int node);
+
+// @method
+// Returns the node's parsing element, traversing references.
+ParsingElement* MatchTree_getParsingElement(MatchTree* this, int node);
+
+// @method
+const char* MatchTree_getElementName(MatchTree* this, int node);
+
+// @method
+bool MatchTree_hasNext(MatchTree* this, int node);
+
+// @method
+int MatchTree_getNext(MatchTree* this, int node);
+
+// @method
+bool MatchTree_hasChildren(MatchTree* this, int node);
+
+// @method
+int MatchTree_getChildren(MatchTree* this, int node);
+
+// @method
+int MatchTree_countChildren(MatchTree* this, int node);
+
+/**
+ * Match buffer
+ * ------------
+ *
+ * A `MatchBuffer` holds a match tree as fixed-width records in a single
+ * block of memory, followed by the spans of the token groups. Bindings
+ * can read the whole tree through one view of the block, instead of
+ * calling into the library for each node and each of its fields.
+ *
+ * Every field is a 32-bit integer, so the block can be seen as an array
+ * of `MATCH_RECORD_FIELDS` integers per node, the spans starting right
+ * after the last node. Nodes are in pre-order, so the first child of a
+ * node is the node that follows it, when that node has it as parent.
+*/
+
+#define MATCH_RECORD_FIELDS 8
+
+// @type MatchRecord
+typedef struct MatchRecord {
+	int32_t      type;       // The type of the node's element, `TYPE_REFERENCE` for references
+	int32_t      id;         // The id of the node's element
+	int32_t      offset;
+	int32_t      length;
+	int32_t      parent;     // The index of the parent node, -1 for the root
+	int32_t      next;       // The index of the next sibling, -1 if it has none
+	int32_t      groups;     // The number of token groups
+	int32_t      spans;      // The index of the node's first group in the spans
+} MatchRecord;
+
+// @type MatchBuffer
+typedef struct MatchBuffer {
+	char*        data;       // The records followed by the spans
+	size_t       size;       // The size of the data, in bytes
+	MatchRecord* records;
+	int32_t*     spans;      // The start and end offsets of each token group, -1 if the group did not match
+	int32_t      count;      // The number of records
+	int32_t      spansCount; // The number of spans, twice the number of groups
+} MatchBuffer;
+
+// @constructor
+// Returns the records of the given match and its descendants (but not
+// its siblings), or `NULL` if the match failed or if an offset or a
+// length does not fit in 31 bits.
+MatchBuffer* MatchBuffer_new(Match* match);
+
+// @destructor
+void MatchBuffer_free(MatchBuffer* this);
+
 // @type ParsingElement
 typedef struct ParsingElement {
 	char           type;       // Type is used du differentiate ParsingElement from Reference
@@ -573,6 +1165,7 @@ typedef struct ParsingElement {
 	struct Match*         (*recognize) (struct ParsingElement*, ParsingContext*);
 	struct Match*         (*process)   (struct ParsingElement*, ParsingContext*, Match*);
 	void                  (*freeMatch) (Match*);
+	int                   flags;      // The parsing element's flags (see FLAG_NOMEMOIZE)
 } ParsingElement;
 
 // @operation
@@ -607,6 +1200,26 @@ ParsingElement* ParsingElement_add(ParsingElement* this, Reference* child);
 // @method
 ParsingElement* ParsingElement_clear(ParsingElement* this);
 
+// @method
+// Recognizes this element at the context's current offset, going through
+// the context's memoization table when the element can be memoized. This
+// is what composite elements use to recognize their children.
+Match* ParsingElement_recognize(ParsingElement* this, ParsingContext* context);
+
+// @method
+// Tells if the results of this parsing element can be memoized
+bool ParsingElement_isMemoizable(ParsingElement* this);
+
+// @method
+// Disables the memoization of both the matches and failures of this
+// parsing element. Use this for elements whose result depends on
+// state that the grammar cannot see.
+ParsingElement* ParsingElement_disableMemoize(ParsingElement* this);
+
+// @method
+// Disables the memoization of failures only for this parsing element.
+ParsingElement* ParsingElement_disableFailMemoize(ParsingElement* this);
+
 // @method
 // Applies the grammar's skip property *once* , returning
 // the resulting change in the parsing offset.
@@ -685,9 +1298,14 @@ typedef struct TokenConfig {
 } TokenConfig;
 
 // @type
+// A token match only keeps the offsets of its groups within the input,
+// the groups' strings are created when first requested by `TokenMatch_group`.
 typedef struct TokenMatch {
 	int             count;
-	const char**    groups;
+	const char**    groups;    // The groups' strings, NULL until requested
+	int*            spans;     // The start and end offsets of each group, relative to the match's offset (-1 if the group did not match)
+	Iterator*       iterator;  // The iterator holding the matched input
+	ParsingArena*   arena;     // The arena where the strings are allocated, NULL when they are on the heap
 } TokenMatch;
 
 
@@ -705,13 +1323,26 @@ Match* Token_recognize(ParsingElement* this, ParsingContext* context);
 // @method
 const char* Token_expr(ParsingElement* this);
 
+// @method
+// Protected method, that allocates a token match with `count` groups in
+// the given arena, unless it is NULL.
+TokenMatch* TokenMatch__new(ParsingArena* arena, Iterator* iterator, int count);
+
 // @method
 // Frees the `TokenMatch` created in `Token_recognize`
 void TokenMatch_free(Match* match);
 
 // @method
+// Returns the given group as a NUL-terminated string, which is created on
+// the first call and owned by the match.
 const char* TokenMatch_group(Match* match, int index);
 
+// @method
+// Returns a pointer to the given group within the input, setting `length`
+// to the group's length. This does not copy anything, but the result is
+// not NUL-terminated and is only valid as long as the input is.
+const char* TokenMatch_slice(Match* match, int index, size_t* length);
+
 // @method
 int TokenMatch_count(Match* match);
 
@@ -806,11 +1437,60 @@ Match* Reference_recognize(Reference* this, ParsingContext* context);
  *
  * Groups are composite parsing elements that will return the first matching reference's
  * match. Think of it as a logical `or`.
+ *
+ * When the grammar is prepared, each group with more than one child gets
+ * a dispatch table that lists, for every possible first byte of input, the
+ * children that can match starting with that byte (see `Grammar_prepare`).
+ * The group then only tries these children, in their original order.
+ *
+ * Groups made only of words, like keywords or operators, also get a trie
+ * of their words. The trie finds the first child, in the group's order, that
+ * matches the input in a single pass. It does not compare each word in
+ * turn.
 */
 
+// @type
+typedef struct WordTrieEdge {
+	unsigned char byte;        // The byte that leads to the target node
+	int           target;      // The index of the target node
+	int           next;        // The index of the node's next edge, -1 for the last one
+} WordTrieEdge;
+
+// @type
+typedef struct WordTrie {
+	int           count;       // The number of nodes, the root being 0
+	int*          words;       // For each node, the index of the first child whose word ends there, -1 if none
+	int*          edges;       // For each node, the index of its first edge, -1 if none
+	WordTrieEdge* links;       // The edges
+	Reference**   children;    // The group's children, by index
+} WordTrie;
+
+// @type
+typedef struct GroupConfig {
+	Reference** dispatch[256]; // The candidate children for each first byte, NULL-terminated. NULL means all the children.
+	Reference** candidates;    // The storage for the candidate lists
+	WordTrie*   words;         // The trie of the words, when the group only has words
+} GroupConfig;
+
+// @constructor
+// Creates a trie of the words of the given group, which must only have
+// words as children.
+WordTrie* WordTrie_new(ParsingElement* group);
+
+// @destructor
+void WordTrie_free(WordTrie* this);
+
+// @method
+// Returns the first of the group's children whose word is a prefix of the
+// `length` bytes of `text`, or NULL.
+Reference* WordTrie_match(WordTrie* this, const char* text, size_t length);
+
 // @constructor
 ParsingElement* Group_new(Reference* children[]);
 
+// @destructor
+void            Group_free(ParsingElement* this);
+
 // @method
 Match*          Group_recognize(ParsingElement* this, ParsingContext* context);
 
@@ -863,6 +1543,25 @@ ParsingElement* Condition_new(ConditionCallback c);
 // @method
 Match*          Condition_recognize(ParsingElement* this, ParsingContext* context);
 
+/**
+ * ### Cuts
+ *
+ * A cut always succeeds without consuming any input, and commits the
+ * innermost choice, that is the alternative of a group or the iteration
+ * of an optional or repeated reference. If a committed alternative fails,
+ * the choice fails instead of trying the next alternative.
+ *
+ * Once every enclosing choice is committed, the parser can't backtrack
+ * before the cut anymore, and the memoization table drops the entries
+ * that precede it.
+*/
+
+// @constructor
+ParsingElement* Cut_new(void);
+
+// @method
+Match*          Cut_recognize(ParsingElement* this, ParsingContext* context);
+
 /**
  * The parsing process
  * -------------------
@@ -876,12 +1575,18 @@ Match*          Condition_recognize(ParsingElement* this, ParsingContext* contex
 */
 
 // @type
+// The per-symbol counters are indexed by the ids assigned by
+// `Grammar_prepare`, and are only kept when the grammar is profiled
+// (see `Grammar_enableProfiling`). Otherwise, `symbolsCount` is 0.
 typedef struct ParsingStats {
 	size_t   bytesRead;
 	double   parseTime;
 	size_t   symbolsCount;
+	size_t*  attemptsBySymbol;
 	size_t*  successBySymbol;
 	size_t*  failureBySymbol;
+	size_t*  bytesBySymbol;   // The bytes consumed by the successes
+	double*  timeBySymbol;    // The time spent, including the children's
 	size_t   failureOffset;   // A reference to the deepest failure
 	size_t   matchOffset;
 	size_t   matchLength;
@@ -898,59 +1603,225 @@ void ParsingStats_free(ParsingStats* this);
 void ParsingStats_setSymbolsCount(ParsingStats* this, size_t t);
 
 // @method
+// Counts the success or failure of the element's match
 Match* ParsingStats_registerMatch(ParsingStats* this, Element* e, Match* m);
 
+// @method
+// Adds the other stats' counters to this one's
+void ParsingStats_merge(ParsingStats* this, ParsingStats* other);
+
+// @function
+// Returns a monotonic time in seconds
+double ParsingStats_now(void);
+
 /**
  * 1. Parsing variables
  * --------------------
  *
- * Parsing variables for a type of hierarchical list that can store
- * named values within a parsing element subtrees. It basically allows
- * for the storing of contextual values during parse time. The parsing
- * variables are not handled directly, but are instead accessed through
- * the `ParsingContext` object.
+ * Parsing variables store named values within a parsing element subtrees.
+ * They basically allow for the storing of contextual values during parse
+ * time. Each rule pushes a frame, and a variable set within a frame
+ * shadows its value in the parent frames until the frame is popped.
+ *
+ * Variable names are interned to integer keys, ideally when the grammar
+ * is built (see `Grammar_key`), so that getting and setting a variable
+ * is an array access. Pushing a frame only records the size of the
+ * shadow stack, so that rules don't allocate anything.
+ *
+ * The parsing variables are not handled directly, but are instead accessed
+ * through the `ParsingContext` object.
 */
 
+// @define
+// The key of the `depth` variable, which is always the depth of the
+// current frame.
+#define KEY_DEPTH 0
+
+// @type
+typedef struct ParsingSlot {
+	void*  value;
+	int    depth;     // The depth of the frame that set the value, -1 when unset
+} ParsingSlot;
+
+// @type
+// The value that a variable had before it was set in the current frame,
+// which is restored when the frame is popped.
+typedef struct ParsingShadow {
+	int          key;
+	ParsingSlot  previous;
+} ParsingShadow;
+
 // @type
-typedef struct ParsingVariable {
-	int depth;
-	char* key;
-	void* value;
-	struct ParsingVariable* previous;
-} ParsingVariable;
+typedef struct ParsingVariables {
+	char**         keys;            // The names of the keys, starting with the grammar's
+	int            keysCount;
+	int            keysCapacity;
+	int            keysShared;      // The number of keys that belong to the grammar
+	ParsingSlot*   slots;           // The current value of each key
+	ParsingShadow* shadows;         // The values shadowed by the frames
+	int            shadowsCount;
+	int            shadowsCapacity;
+	int*           frames;          // The number of shadows when each frame was pushed
+	int            framesCapacity;
+} ParsingVariables;
 
 // @constructor
-ParsingVariable* ParsingVariable_new(int depth, const char* key, void* value);
+// Creates the variables with the keys of the given grammar, which can
+// be NULL.
+ParsingVariables* ParsingVariables_new(Grammar* grammar);
 
 // @destructor
-void ParsingVariable_free(ParsingVariable* this);
+void ParsingVariables_free(ParsingVariables* this);
+
+// @method
+// Returns the key for the given name, adding it if `create` is TRUE,
+// or -1.
+int ParsingVariables_key(ParsingVariables* this, const char* name, bool create);
+
+/**
+ * 2. Memoization
+ * --------------
+ *
+ * The parsing context keeps a memoization table of the results of
+ * parsing elements, keyed by `(element id, offset)`. As elements
+ * that do not depend on context variables always yield the same
+ * result at the same offset, the parser does not need to re-recognize
+ * them when it backtracks, which keeps parsing time linear (packrat
+ * parsing).
+ *
+ * Successful matches are stored as they are, in the context's arena,
+ * which keeps them from being released when the parser backtracks
+ * (see `ParsingArena_keep`). A hit returns a copy of the match's node
+ * that shares its children, which must thus not change once matched.
+ * Failures are stored without a match.
+*/
+
+// @type
+typedef struct ParsingMemoEntry {
+	int     id;         // The id of the memoized element, -1 when the slot is empty
+	int     generation; // The table's generation when the entry was set
+	size_t  offset;     // The offset at which the element was recognized
+	size_t  end;        // The iterator's offset after recognition
+	Match*  match;      // The successful match, NULL for a failure
+} ParsingMemoEntry;
+
+// @type
+typedef struct ParsingMemo {
+	size_t            capacity;  // The number of slots, always a power of 2
+	size_t            count;     // The number of used slots
+	size_t            hits;      // The number of lookups that found an entry
+	size_t            committed; // The offset before which the parser won't backtrack
+	int               generation; // Entries from a previous generation are ignored
+	struct ParsingArena* arena;  // The arena of the memoized matches
+	ParsingMemoEntry* entries;
+} ParsingMemo;
+
+// @constructor
+// Creates a table for the matches allocated in the given arena
+ParsingMemo* ParsingMemo_new(struct ParsingArena* arena);
 
 // @destructor
-void ParsingVariable_freeAll(ParsingVariable* this);
+void ParsingMemo_free(ParsingMemo* this);
 
 // @method
-bool ParsingVariable_is(ParsingVariable* this, const char* key);
+// Returns the entry for the given element and offset, or NULL
+ParsingMemoEntry* ParsingMemo_get(ParsingMemo* this, int id, size_t offset);
+
+// @method
+// Registers the result of recognizing the element with the given
+// id at the given offset. A successful match is kept in the arena,
+// `FAILURE` is stored as a failure.
+ParsingMemoEntry* ParsingMemo_set(ParsingMemo* this, int id, size_t offset, size_t end, Match* match);
+
+// @method
+// Clears all the entries of the table
+void ParsingMemo_clear(ParsingMemo* this);
+
+// @method
+// Forgets all the entries without going through the table, for when the
+// arena was reset or the input changed. The forgotten entries are
+// dropped when the table grows.
+void ParsingMemo_forget(ParsingMemo* this);
+
+/**
+ * 3. Arena
+ * --------
+ *
+ * The matches created while parsing, along with their token data, are
+ * allocated from a bump arena owned by the parsing context. When an
+ * element fails, the arena is rewound to where it was before the element
+ * was recognized, and the whole arena is dropped at once when the
+ * parsing result is freed.
+ *
+ * Matches allocated in an arena have the `FLAG_ARENA` flag and are
+ * ignored by `Match_free`.
+*/
+
+#define ARENA_CHUNK_SIZE  (64 * 1024)
+#define ARENA_ALIGNMENT   16
+
+// @type
+typedef struct ParsingArenaChunk {
+	struct ParsingArenaChunk* previous;  // The previously filled chunk
+	size_t                    capacity;  // The number of bytes available in data
+	size_t                    used;      // The number of bytes allocated in data
+	char*                     data;
+} ParsingArenaChunk;
+
+// @type
+typedef struct ParsingArenaMark {
+	ParsingArenaChunk* chunk;
+	size_t             used;
+} ParsingArenaMark;
+
+// @type
+typedef struct ParsingArena {
+	ParsingArenaChunk* chunk;      // The chunk we're currently allocating from
+	ParsingArenaChunk* spare;      // A chunk released by a rewind, kept for reuse
+	void*              pinned;     // The list of pinned allocations
+	size_t             allocated;  // The total capacity of the arena's chunks
+	ParsingArenaMark   kept;       // Rewinds don't release what's before it (see `ParsingArena_keep`)
+} ParsingArena;
+
+// @constructor
+ParsingArena* ParsingArena_new(void);
+
+// @destructor
+// Frees all the chunks, and thus everything that was allocated in the arena
+void ParsingArena_free(ParsingArena* this);
 
 // @method
-ParsingVariable* ParsingVariable_set(ParsingVariable* this, const char* name, void* value);
+// Allocates `size` bytes, aligned on `ARENA_ALIGNMENT`
+void* ParsingArena_alloc(ParsingArena* this, size_t size);
 
 // @method
-void* ParsingVariable_get(ParsingVariable* this, const char* name);
+// Allocates `size` bytes that won't be released by `ParsingArena_rewind`,
+// only when the arena is freed. This is for data attached to matches
+// after they were recognized.
+void* ParsingArena_allocPinned(ParsingArena* this, size_t size);
 
 // @method
-ParsingVariable* ParsingVariable_find(ParsingVariable* this, const char* key, bool local);
+// Returns a mark that can later be passed to `ParsingArena_rewind`
+ParsingArenaMark ParsingArena_mark(ParsingArena* this);
 
 // @method
-int ParsingVariable_getDepth(ParsingVariable* this);
+// Releases everything that was allocated since the given mark, unless
+// it was kept.
+void ParsingArena_rewind(ParsingArena* this, ParsingArenaMark mark);
 
 // @method
-const char* ParsingVariable_getName(ParsingVariable* this);
+// Keeps everything allocated so far from being released by a rewind,
+// until the arena is reset. This is how memoized matches outlive the
+// elements that failed around them.
+void ParsingArena_keep(ParsingArena* this);
 
 // @method
-int  ParsingVariable_count(ParsingVariable* this);
+// Releases everything that was allocated in the arena, including the
+// pinned allocations, and keeps a chunk for reuse.
+void ParsingArena_reset(ParsingArena* this);
 
 /**
- * 2. Parsing context
+ * 4. Parsing context
  * --------------------
  *
  *
@@ -964,7 +1835,9 @@ typedef struct ParsingContext {
 	struct Grammar*         grammar;      // The grammar used to parse
 	struct Iterator*        iterator;     // Iterator on the input data
 	struct ParsingStats*    stats;
-	struct ParsingVariable* variables;
+	struct ParsingVariables* variables;
+	struct ParsingMemo*     memo;         // The memoization table, NULL when disabled
+	struct ParsingArena*    arena;        // The arena where matches are allocated
 	size_t                  lastMatchOffset;    // The last deepest successful match, useful for displaying error
 	size_t                  lastMatchLength;    // The last deepest successful match, useful for displaying error
 	int                     lastMatchElementID; // The last deepest successful match, useful for displaying error
@@ -972,7 +1845,9 @@ typedef struct ParsingContext {
 	int                     depth;
 	const char*             indent;
 	int                     flags;
+	int                     choices;      // The number of enclosing choices that were not cut
 	bool                    freeIterator;
+	struct ParsingContext*  parts;        // The contexts of the chunks of a parallel parse, which own their matches
 } ParsingContext;
 
 
@@ -1008,6 +1883,14 @@ void ParsingContext_pop ( ParsingContext* this );
 // Retrieves the value bound to the given `name` in the variables.
 void*  ParsingContext_get(ParsingContext*  this, const char* name);
 
+// @method
+// Retrieves the value bound to the given key (see `Grammar_key`)
+void*  ParsingContext_getKey(ParsingContext*  this, int key);
+
+// @method
+// Binds the value to the given key (see `Grammar_key`) in the current frame
+void  ParsingContext_setKey(ParsingContext*  this, int key, void* value);
+
 // @method
 int  ParsingContext_getInt(ParsingContext*  this, const char* name);
 
@@ -1031,6 +1914,7 @@ typedef struct ParsingResult {
 	char            status;
 	Match*          match;
 	ParsingContext* context;
+	MatchTree*      tree;      // The compact tree, set by `ParsingResult_compact`
 } ParsingResult;
 
 // @constructor
@@ -1040,6 +1924,17 @@ ParsingResult* ParsingResult_new(Match* match, ParsingContext* context);
 // Frees this parsing result instance as well as all the matches it referes to.
 void ParsingResult_free(ParsingResult* this);
 
+// @destructor
+// Frees the results returned by `Grammar_parseBatch`, and the array.
+void ParsingResult_freeBatch(ParsingResult** results, size_t count);
+
+// @method
+// Replaces the matches of a successful parse with a `MatchTree`, releasing
+// the memory of the matches. The result's `match` is then `NULL`. Returns
+// the tree, or `NULL` (keeping the matches) if the parse failed or if the
+// input is too large for the tree.
+MatchTree* ParsingResult_compact(ParsingResult* this);
+
 // @method
 bool ParsingResult_isSuccess(ParsingResult* this);
 
@@ -1058,6 +1953,90 @@ int ParsingResult_textOffset(ParsingResult* this);
 // @method
 size_t ParsingResult_remaining(ParsingResult* this);
 
+// @method
+// Returns the line (starting at 0) of the given offset in the input. The
+// iterator's line index is built on the first query and then reused, so
+// lookups are a binary search.
+size_t ParsingResult_lineForOffset(ParsingResult* this, size_t offset);
+
+// @method
+// Returns the column (starting at 0, in bytes) of the given offset in
+// the input.
+size_t ParsingResult_columnForOffset(ParsingResult* this, size_t offset);
+
+// @method
+// Sets `start` and `end` to the offsets of the given line, the end being
+// the offset of the line's separator, or the end of the input for the
+// last line. Either pointer can be NULL. Returns FALSE when the line is
+// past the input, or starts in input that was released.
+bool ParsingResult_lineRange(ParsingResult* this, size_t line, size_t* start, size_t* end);
+
+/**
+ * 5. Virtual machine
+ * ------------------
+ *
+ * `Grammar_prepare` compiles the groups and rules of the grammar into a
+ * flat program, where each composite element becomes a block of
+ * instructions and each reference a loop within its parent's block. The
+ * virtual machine runs the program with an explicit stack of frames, so
+ * that deeply nested input does not exhaust the C stack, and without
+ * going through the `recognize` callbacks of composite elements.
+ *
+ * Words, tokens, procedures and conditions are leaves of the program and
+ * are recognized by their `recognize` callback, as is the `skip` element.
+ * The virtual machine memoizes the elements like `ParsingElement_recognize`
+ * does, and yields exactly the same matches as the recursive engine. It
+ * does not trace its steps, so verbose grammars always use the recursive
+ * engine.
+*/
+
+// @define
+// The virtual machine's opcodes, `a` and `b` are jump targets unless noted
+#define OP_HALT         0  // Stops the program
+#define OP_CALL         1  // Calls the block of the group or rule with id `a`
+#define OP_LEAF         2  // Recognizes a leaf element with its callback
+#define OP_RETURN       3  // Returns from the current block
+#define OP_REF_ENTER    4  // Starts iterating on a reference
+#define OP_REF_TEST     5  // Goes to `a` when the reference cannot iterate
+#define OP_REF_STEP     6  // Registers an iteration, loops to `a` or exits to `b`
+#define OP_REF_LEAVE    7  // Ends the reference, applying its cardinality
+#define OP_GROUP_ENTER  8  // Starts a group, looking up its dispatch table
+#define OP_CHOICE       9  // Goes to `a` when the dispatch excludes the child
+#define OP_COMMIT      10  // Goes to `a` with the group's match if the child matched
+#define OP_GROUP_FAIL  11  // Fails the group
+#define OP_RULE_ENTER  12  // Starts a rule
+#define OP_RULE_STEP   13  // Adds the child's match, retries `a` after a skip or fails to `b`
+#define OP_RULE_END    14  // Ends a successful rule and goes to `a`
+#define OP_RULE_FAIL   15  // Fails the rule
+
+// @type
+typedef struct ParsingInstruction {
+	char   op;
+	int    a;
+	int    b;
+	void*  element;  // The element or reference the instruction applies to
+} ParsingInstruction;
+
+// @type
+typedef struct ParsingProgram {
+	ParsingInstruction* code;
+	int                 length;
+	int                 capacity;
+	int*                entries;  // The offset of each element's block by id, -1 for leaves
+	int                 count;    // The number of entries
+} ParsingProgram;
+
+// @constructor
+// Compiles the given prepared grammar, starting with its axiom
+ParsingProgram* ParsingProgram_new(Grammar* grammar);
+
+// @destructor
+void ParsingProgram_free(ParsingProgram* this);
+
+// @method
+// Runs the program on the given context and returns the axiom's match
+Match* ParsingProgram_run(ParsingProgram* this, ParsingContext* context);
+
 /**
  * Processor
  * ---------
@@ -1068,10 +2047,15 @@ typedef struct Processor Processor;
 // @callback
 typedef void (*ProcessorCallback)(Processor* processor, Match* match);
 
+// @callback
+// Like `ProcessorCallback`, for the nodes of a `MatchTree`
+typedef void (*ProcessorNodeCallback)(Processor* processor, MatchTree* tree, int node);
+
 typedef struct Processor {
-	ProcessorCallback   fallback;
-	ProcessorCallback*  callbacks;
-	int                 callbacksCount;
+	ProcessorCallback      fallback;
+	ProcessorCallback*     callbacks;
+	ProcessorNodeCallback* nodeCallbacks;
+	int                    callbacksCount;
 } Processor;
 
 
@@ -1087,6 +2071,14 @@ void Processor_register (Processor* this, int symbolID, ProcessorCallback callba
 // @method
 int Processor_process (Processor* this, Match* match, int step);
 
+// @method
+void Processor_registerNode (Processor* this, int symbolID, ProcessorNodeCallback callback);
+
+// @method
+// Like `Processor_process`, for the given node of a compact tree and the
+// callbacks registered with `Processor_registerNode`.
+int Processor_processTree (Processor* this, MatchTree* tree, int node, int step);
+
 /**
  * Utilities
  * ---------
@@ -1185,6 +2177,11 @@ bool Utilites_checkIndent( ParsingElement* this, ParsingContext* context );
 // Creates a `Condition` parsing element
 #define CONDITION(f)      Condition_new(f)
 
+// @macro
+// Creates a `Cut` parsing element, referenced once so that it can be
+// used directly as a child of a rule or a group.
+#define CUT()             ONE(Cut_new())
+
 // @macro
 // Sets the grammar's axiom to the given symbol
 #define AXIOM(n) g->axiom = s_ ## n;
@@ -17,3 +17,48 @@
 #define TEST_SUCCEED printf("[OK]\n");
 #define TEST_TRUE(e)  if (e != TRUE) {printf("[ERROR] Value exected to be TRUE at %s:%d\n", __FILE__, __LINE__);}
 #define TEST_FALSE(e) if (e != FALSE)  {printf("[ERROR] Value expected to be FALSE at %s:%d\n", __FILE__, __LINE__);}
+
+// The helpers below compare the results of different ways of parsing the
+// same text, and are shared by the tests.
+#ifdef __PARSING_H__
+
+// Tells if both matches, their descendants and their next siblings have the
+// same offsets, lengths, elements and token groups.
+bool Match_isSame(Match* a, Match* b) {
+	while (a != NULL && b != NULL) {
+		if (a->offset != b->offset || a->length != b->length || a->element != b->element) {
+			return FALSE;
+		}
+		if ((a->data == NULL) != (b->data == NULL)) {
+			return FALSE;
+		}
+		if (a->element != NULL && a->element->type == TYPE_TOKEN && a->data != NULL) {
+			if (TokenMatch_count(a) != TokenMatch_count(b)) {return FALSE;}
+			for (int i=0 ; i<TokenMatch_count(a) ; i++) {
+				if (strcmp(TokenMatch_group(a, i), TokenMatch_group(b, i)) != 0) {return FALSE;}
+			}
+		}
+		if (!Match_isSame(a->children, b->children)) {return FALSE;}
+		a = a->next;
+		b = b->next;
+	}
+	return a == b;
+}
+
+// Tells if the text is parsed the same by the recursive engine and by the
+// virtual machine, which is left disabled.
+bool Grammar_isSame(Grammar* g, const char* text) {
+	Grammar_disableVM(g);
+	ParsingResult* recursive = Grammar_parseString(g, text);
+	Grammar_enableVM(g);
+	ParsingResult* compiled  = Grammar_parseString(g, text);
+	Grammar_disableVM(g);
+	bool same = recursive->status == compiled->status
+		&& ParsingResult_textOffset(recursive) == ParsingResult_textOffset(compiled)
+		&& Match_isSame(recursive->match, compiled->match);
+	ParsingResult_free(recursive);
+	ParsingResult_free(compiled);
+	return same;
+}
+
+#endif
@@ -11,7 +11,7 @@
 
 from __future__ import print_function
 
-import sys, os, re, glob, inspect, tempfile, collections
+import sys, os, re, glob, inspect, collections, array, mmap
 from   cffi    import FFI
 from   os.path import dirname, join, abspath
 
@@ -145,6 +145,14 @@ else:
 	def is_string( v ):
 		return isinstance(v,str) or isinstance(v,unicode)
 
+def ensure_buffer( v ):
+	"""Returns the given text or buffer-protocol object (bytes, bytearray,
+	memoryview, mmap...), along with a `char[]` on its data that can be
+	passed to C. Only unicode text is encoded, the data of other objects
+	is not copied, and is valid as long as both are referenced."""
+	v = v.encode("utf8") if is_string(v) and not isinstance(v, bytes) else v
+	return v, ffi.from_buffer(v)
+
 # -----------------------------------------------------------------------------
 #
 # C OJBECT ABSTRACTION
@@ -328,9 +336,11 @@ class ParsingElement(CObject):
 		return Reference(self).oneOrMore()
 
 	def disableMemoize( self ):
+		lib.ParsingElement_disableMemoize(self._cobject)
 		return self
 
 	def disableFailMemoize( self ):
+		lib.ParsingElement_disableFailMemoize(self._cobject)
 		return self
 
 	def skip( self, value=True ):
@@ -465,6 +475,20 @@ class Procedure(ParsingElement):
 		self._callback = (self.WrapCallback(callback), callback)
 		return lib.Procedure_new(self._callback[0])
 
+# -----------------------------------------------------------------------------
+#
+# CUT
+#
+# -----------------------------------------------------------------------------
+
+class Cut(ParsingElement):
+	"""Commits the innermost choice: once passed, the enclosing group
+	won't try its next alternatives and the repetition won't backtrack
+	before it."""
+
+	def _new( self ):
+		return lib.Cut_new()
+
 # -----------------------------------------------------------------------------
 #
 # REFERENCE
@@ -585,9 +609,16 @@ class Match(CObject):
 	_RECYCLABLE = False
 
 	@classmethod
-	def Wrap( cls, cobject ):
+	def Wrap( cls, cobject, iterator=None ):
 		assert cobject.element != ffi.NULL, "Match C object does not have an element: %s %d+%d" % (cobject.status, cobject.offset, cobject.length)
-		return cls.Reuse(cobject) or Match(cobject, wrap=cls._TYPE)
+		match = cls.Reuse(cobject) or Match(cobject, wrap=cls._TYPE)
+		# The iterator gives the line of the match, and is passed on
+		# to the children.
+		match._iterator = iterator
+		return match
+
+	def _init( self ):
+		self._iterator = None
 
 	def _new( self, o ):
 		return ffi.cast(self._TYPE, o)
@@ -606,7 +637,7 @@ class Match(CObject):
 
 	@property
 	def line( self ):
-		return self._cobject.line
+		return lib.Iterator_lineAt(self._iterator, self.offset) if self._iterator else None
 
 	@property
 	def type( self ):
@@ -642,6 +673,20 @@ class Match(CObject):
 	def hasChildren( self ):
 		return lib.Match_hasChildren(self._cobject)
 
+	def isMany( self ):
+		return lib.Reference_IsMany(self.element)
+
+	def word( self ):
+		return ensure_unicode(ffi.string(lib.WordMatch_group(self._cobject)))
+
+	def groups( self ):
+		"""Returns the strings of the token's groups, groups that did not
+		match being empty."""
+		# We read the groups straight from the input, without
+		# having the C side create the strings.
+		length = ffi.new("size_t*")
+		return list(ensure_unicode(ffi.unpack(lib.TokenMatch_slice(self._cobject, i, length), length[0])) for i in range(lib.TokenMatch_count(self._cobject)))
+
 	def countChildren( self ):
 		"""Returns the number of children."""
 		count = 0
@@ -651,20 +696,28 @@ class Match(CObject):
 			count += 1
 		return count
 
-	def _toHelper( self, callback ):
-		(fd, fn) = tempfile.mkstemp()
-		callback(self._cobject, fd)
-		os.close(fd)
-		with open(fn) as f:
-			text = f.read()
-		os.unlink(fn)
-		return text
-
-	def toJSON( self ):
-		return self._toHelper(lib.Match_writeJSON)
-
-	def toXML( self ):
-		return self._toHelper(lib.Match_writeXML)
+	def _toHelper( self, callback, raw ):
+		# The output is buffered in memory and copied once into bytes
+		writer = lib.Writer_new()
+		try:
+			callback(self._cobject, writer)
+			data = ffi.unpack(writer.data, writer.length)
+		finally:
+			lib.Writer_free(writer)
+		return data if raw else ensure_str(data)
+
+	def toJSON( self, raw=False ):
+		"""Returns the match as JSON, as bytes when `raw` is set."""
+		return self._toHelper(lib.Match_dumpJSON, raw)
+
+	def toXML( self, raw=False ):
+		"""Returns the match as XML, as bytes when `raw` is set."""
+		return self._toHelper(lib.Match_dumpXML, raw)
+
+	def toBinary( self ):
+		"""Returns the match in the binary format, as bytes, which can be
+		read back with `Grammar.readBinary`."""
+		return self._toHelper(lib.Match_writeBinary, True)
 
 	# =========================================================================
 	# SUGAR
@@ -673,7 +726,7 @@ class Match(CObject):
 	def __iter__( self ):
 		child = self._cobject.children
 		while child:
-			yield Match.Wrap(child)
+			yield Match.Wrap(child, self._iterator)
 			child = child.next
 
 	def __getitem__( self, index ):
@@ -686,7 +739,7 @@ class Match(CObject):
 			child = self._cobject.children
 			while child:
 				if i == index:
-					return Match.Wrap(child)
+					return Match.Wrap(child, self._iterator)
 				else:
 					child = child.next
 					i += 1
@@ -721,6 +774,217 @@ class Match(CObject):
 		# free  them.
 		pass
 
+# -----------------------------------------------------------------------------
+#
+# MATCH BUFFER
+#
+# -----------------------------------------------------------------------------
+
+MATCH_RECORD_FIELDS = 8
+TYPE_BY_CODE        = dict((ord(_), _) for _ in (TYPE_WORD, TYPE_TOKEN, TYPE_GROUP, TYPE_RULE, TYPE_CONDITION, TYPE_PROCEDURE, TYPE_REFERENCE))
+
+class MatchBuffer(object):
+	"""The nodes of a result's match tree, exported at once by the library
+	(see `MatchBuffer_new`) and read from a memory view, so that going
+	through the tree does not call into the library for each node. The
+	nodes are `FlatMatch` instances, which can be processed like matches."""
+
+	def __init__( self, cobject, result ):
+		self._cobject = cobject
+		# The result holds the input that the offsets refer to
+		self.result   = result
+		self.count    = cobject.count
+		data          = ffi.buffer(cobject.data, cobject.size)
+		try:
+			self.data = memoryview(data).cast("i")
+		except AttributeError:
+			self.data = array.array("i", data[:])
+		iterator      = result._cobject.context.iterator
+		self.iterator = iterator
+		self.base     = lib.Iterator_textOffset(iterator)
+		self.text     = ffi.buffer(iterator.buffer, iterator.available)
+		# The elements are looked up when needed, as preparing the grammar
+		# again allocates them anew.
+		self.grammar  = result._cobject.context.grammar
+		self._names   = {}
+		self._many    = {}
+
+	@property
+	def root( self ):
+		return FlatMatch(self, 0) if self.count > 0 else None
+
+	def name( self, id ):
+		"""Returns the name of the element with the given id."""
+		name = self._names.get(id, self)
+		if name is self:
+			name = self.grammar.elements[id].name
+			name = self._names[id] = ensure_str(ffi.string(name)) if name else None
+		return name
+
+	def isMany( self, id ):
+		"""Tells if the reference with the given id matches many times."""
+		many = self._many.get(id)
+		if many is None:
+			many = self._many[id] = bool(lib.Reference_IsMany(self.grammar.elements[id]))
+		return many
+
+	def slice( self, start, end ):
+		return ensure_unicode(self.text[start - self.base:end - self.base])
+
+	def match( self, index ):
+		"""Returns the `Match` of the node with the given index, found by
+		going down the result's matches along the node's ancestors."""
+		path = []
+		while index > 0:
+			path.append(index)
+			index = self.data[index * MATCH_RECORD_FIELDS + 4]
+		match = self.result._cobject.match
+		node  = 0
+		for index in reversed(path):
+			match, node = match.children, node + 1
+			while node != index:
+				match, node = match.next, self.data[node * MATCH_RECORD_FIELDS + 5]
+		return Match.Wrap(match, self.iterator)
+
+	def __len__( self ):
+		return self.count
+
+	def __getitem__( self, index ):
+		if index < 0: index += self.count
+		if index < 0 or index >= self.count:
+			raise IndexError("Cannot find node #{0} in {1}".format(index, self))
+		return FlatMatch(self, index)
+
+	def __del__( self ):
+		# The view must be released before the data is
+		if isinstance(self.data, memoryview): self.data.release()
+		lib.MatchBuffer_free(self._cobject)
+
+class FlatMatch(object):
+	"""A node of a `MatchBuffer`, which has the same accessors as a `Match`.
+	The serializers (`toJSON`, `toXML` and `toBinary`) go through the
+	node's `Match`, which is looked up in the result."""
+
+	__slots__ = ("buffer", "index", "base")
+
+	def __init__( self, buffer, index ):
+		self.buffer = buffer
+		self.index  = index
+		self.base   = index * MATCH_RECORD_FIELDS
+
+	@property
+	def type( self ):
+		return TYPE_BY_CODE[self.buffer.data[self.base]]
+
+	@property
+	def id( self ):
+		return self.buffer.data[self.base + 1]
+
+	@property
+	def element( self ):
+		return self.buffer.grammar.elements[self.id]
+
+	@property
+	def name( self ):
+		return self.buffer.name(self.id)
+
+	@property
+	def offset( self ):
+		return self.buffer.data[self.base + 2]
+
+	@property
+	def line( self ):
+		return lib.Iterator_lineAt(self.buffer.iterator, self.offset)
+
+	@property
+	def length( self ):
+		return self.buffer.data[self.base + 3]
+
+	@property
+	def range( self ):
+		o = self.offset
+		return o, o + self.length
+
+	@property
+	def parent( self ):
+		parent = self.buffer.data[self.base + 4]
+		return FlatMatch(self.buffer, parent) if parent >= 0 else None
+
+	def isMany( self ):
+		return self.buffer.isMany(self.id)
+
+	def word( self ):
+		return self.buffer.slice(self.offset, self.offset + self.length)
+
+	def groups( self ):
+		"""Returns the strings of the token's groups, groups that did not
+		match being empty."""
+		data  = self.buffer.data
+		count = data[self.base + 6]
+		spans = self.buffer.count * MATCH_RECORD_FIELDS + data[self.base + 7]
+		return [self.buffer.slice(data[spans + i * 2], data[spans + i * 2 + 1]) if data[spans + i * 2] >= 0 else u"" for i in range(count)]
+
+	def slots( self ):
+		return list(_ for _ in self if _.name)
+
+	def indexForKey( self, name ):
+		for i,_ in enumerate(self):
+			if _.name == name:
+				return i
+		return -1
+
+	def hasChildren( self ):
+		child = self.index + 1
+		return child < self.buffer.count and self.buffer.data[child * MATCH_RECORD_FIELDS + 4] == self.index
+
+	def countChildren( self ):
+		return sum(1 for _ in self)
+
+	def toJSON( self, raw=False ):
+		return self.buffer.match(self.index).toJSON(raw)
+
+	def toXML( self, raw=False ):
+		return self.buffer.match(self.index).toXML(raw)
+
+	def toBinary( self ):
+		return self.buffer.match(self.index).toBinary()
+
+	def __iter__( self ):
+		data  = self.buffer.data
+		child = self.index + 1 if self.hasChildren() else -1
+		while child >= 0:
+			yield FlatMatch(self.buffer, child)
+			child = data[child * MATCH_RECORD_FIELDS + 5]
+
+	def __getitem__( self, index ):
+		if type(index) == int:
+			if index < 0:
+				index = self.countChildren() + index
+			data  = self.buffer.data
+			child = self.index + 1 if self.hasChildren() else -1
+			while child >= 0 and index > 0:
+				child  = data[child * MATCH_RECORD_FIELDS + 5]
+				index -= 1
+			if child >= 0 and index == 0:
+				return FlatMatch(self.buffer, child)
+			raise KeyError("Cannot find item #{0} in {1}".format(index, self))
+		else:
+			i = self.indexForKey(index)
+			if i >= 0:
+				return self[i]
+			else:
+				raise KeyError("Cannot find item #{0} in {1}".format(index, self))
+
+	def __repr__(self):
+		return "<{0} {1}:{2}@{3} {4}-{5}>".format(
+			self.__class__.__name__.rsplit(".", 1)[-1],
+			ensure_str(self.type),
+			self.id,
+			ensure_str(self.name) or "_",
+			self.offset,
+			self.offset + self.length,
+		)
+
 # -----------------------------------------------------------------------------
 #
 # MATCH RESULT
@@ -801,7 +1065,7 @@ class ParsingContext(CObject):
 
 	@property
 	def line( self ):
-		return self._cobject.iterator.lines
+		return lib.Iterator_line(self._cobject.iterator)
 
 	def push( self ):
 		lib.ParsingContext_push(self._cobject)
@@ -812,12 +1076,19 @@ class ParsingContext(CObject):
 		return self
 
 	def set( self, key, value ):
+		"""Sets the variable with the given name, or key (see `Grammar.key`)"""
 		assert isinstance(value, int)
-		lib.ParsingContext_setInt(self._cobject, ensure_cstring(key), value)
+		if isinstance(key, int):
+			lib.ParsingContext_setKey(self._cobject, key, ffi.cast("void*", value))
+		else:
+			lib.ParsingContext_setInt(self._cobject, ensure_cstring(key), value)
 		return value
 
 	def get( self, key ):
-		return lib.ParsingContext_getInt(self._cobject, ensure_cstring(key))
+		if isinstance(key, int):
+			return int(ffi.cast("long", lib.ParsingContext_getKey(self._cobject, key)))
+		else:
+			return lib.ParsingContext_getInt(self._cobject, ensure_cstring(key))
 
 	def __getitem__( self, offset ):
 		return lib.ParsingContext_charAt(self._cobject, offset)
@@ -856,7 +1127,7 @@ class ParsingResult(CObject):
 
 	@property
 	def match( self ):
-		return Match.Wrap(self._cobject.match)
+		return Match.Wrap(self._cobject.match, self._cobject.context.iterator)
 
 	@property
 	def lastMatch( self ):
@@ -885,7 +1156,7 @@ class ParsingResult(CObject):
 
 	@property
 	def line( self ):
-		return self._cobject.context.iterator.lines
+		return lib.Iterator_line(self._cobject.context.iterator)
 
 	@property
 	def offset( self ):
@@ -901,7 +1172,8 @@ class ParsingResult(CObject):
 
 	@property
 	def text( self ):
-		return ensure_str(ffi.string(self._cobject.context.iterator.buffer))
+		iterator = self._cobject.context.iterator
+		return ensure_str(ffi.unpack(iterator.buffer, iterator.available))
 
 	# =========================================================================
 	# METHODS
@@ -916,6 +1188,33 @@ class ParsingResult(CObject):
 	def isPartial( self ):
 		return True if lib.ParsingResult_isPartial(self._cobject)!= 0 else False
 
+	def lineForOffset( self, offset ):
+		return lib.ParsingResult_lineForOffset(self._cobject, offset)
+
+	def columnForOffset( self, offset ):
+		return lib.ParsingResult_columnForOffset(self._cobject, offset)
+
+	def lineRange( self, line ):
+		"""Returns the `(start, end)` offsets of the given line, without
+		its separator, or `None` if there is no such line."""
+		r = ffi.new("size_t[2]")
+		if lib.ParsingResult_lineRange(self._cobject, line, r, r + 1):
+			return (r[0], r[1])
+		else:
+			return None
+
+	def flatten( self ):
+		"""Returns the matches as a `MatchBuffer`, which is exported in
+		a single call and can be processed without calling into the
+		library for each match. Returns `None` if the parse failed."""
+		buffer = lib.MatchBuffer_new(self._cobject.match) if not self.isFailure() else ffi.NULL
+		return MatchBuffer(buffer, self) if buffer else None
+
+	def slice( self, start, end ):
+		"""Returns the text between the given offsets"""
+		base = self.textOffset
+		return ensure_str(ffi.unpack(self._cobject.context.iterator.buffer + (start - base), max(0, end - start)))
+
 	# =========================================================================
 	# HELPERS
 	# =========================================================================
@@ -934,23 +1233,25 @@ class ParsingResult(CObject):
 		around the start/end offsets"""
 		if start is None or end is None:
 			start, end = self.lastMatchRange()
-		s    = start
-		e    = end
-		t    = ensure_str(self.text)
-		bt   = t[0:s].rsplit("\n", before + 1)[-before-1:]
-		at   = t[e:].split("\n", after + 1)[:after+1]
-		c    = bt[-1] + t[s:e] + at[0]
+		first  = self.lineForOffset(start)
+		last   = self.lineForOffset(end)
+		ls, _  = self.lineRange(first) or (start, start)
+		_, le  = self.lineRange(last)  or (end, end)
+		lines  = lambda a, b: [self.slice(*r) for r in (self.lineRange(_) for _ in range(a, b)) if r]
+		lb     = self.slice(ls, start)
+		lm     = self.slice(start, end)
+		la     = self.slice(end, le)
 		return dict(
-			before=bt[:-1],
-			line=c,
-			after=at[1:],
+			before=lines(max(0, first - before), first),
+			line=lb + lm + la,
+			after=lines(last + 1, last + 1 + after),
 			start=start,
 			end=end,
-			lineBefore=bt[-1],
-			lineMatch=t[s:e],
-			lineAfter=at[0],
-			lineOffset=len(bt[-1]),
-			lineLength=max(0,e-s),
+			lineBefore=lb,
+			lineMatch=lm,
+			lineAfter=la,
+			lineOffset=len(lb),
+			lineLength=max(0,end-start),
 		)
 
 	def _asSpaces( self, line, char=" " ):
@@ -989,9 +1290,8 @@ class ParsingResult(CObject):
 			m     = self.lastMatch
 			s,e   = self.lastMatchRange ()
 			t     = self.formatContext(self.getContext(before=context, after=context))
-			lines = self.text[:s].split("\n")
-			line  = len(lines) - 1
-			char  = len(lines[-1])
+			line  = self.lineForOffset(s)
+			char  = self.columnForOffset(s)
 			sym   = ", symbol " + str(self._grammar.symbol(m.id)) if m and m.id and m.id >= 0 else ""
 			return "Parsing failed at line {0} character {1}, offset {2}→{3}{4}:{5}".format(
 				line, char, s, e,
@@ -999,11 +1299,14 @@ class ParsingResult(CObject):
 				"\n".join([_ for _ in t.split("\n")])
 			)
 
-	def toJSON( self ):
-		return self.match.toJSON()
+	def toJSON( self, raw=False ):
+		return self.match.toJSON(raw)
 
-	def toXML( self ):
-		return self.match.toXML()
+	def toXML( self, raw=False ):
+		return self.match.toXML(raw)
+
+	def toBinary( self ):
+		return self.match.toBinary()
 
 	def __repr__( self ):
 		return "<{0}(status={2}, line={3}, char={4}, offset={5}, remaining={6}) at {1:02x}>".format(
@@ -1025,6 +1328,9 @@ class ParsingResult(CObject):
 # -----------------------------------------------------------------------------
 
 class ParsingStats(CObject):
+	"""The stats of a parse, or of a profiled grammar's parses. The
+	per-symbol counters are only kept by profiled grammars
+	(see `Grammar.setProfiling`)."""
 
 	def bytesRead( self ):
 		return self._cobject.bytesRead
@@ -1032,6 +1338,9 @@ class ParsingStats(CObject):
 	def parseTime( self ):
 		return self._cobject.parseTime
 
+	def totalAttempts( self ):
+		return sum(self._cobject.attemptsBySymbol[i] for i in range(self._cobject.symbolsCount))
+
 	def totalSuccess( self ):
 		return sum(self._cobject.successBySymbol[i] for i in range(self._cobject.symbolsCount))
 
@@ -1046,11 +1355,20 @@ class ParsingStats(CObject):
 			(i, self._cobject.successBySymbol[i], self._cobject.failureBySymbol[i]) for i in range(self.symbolsCount())
 		]
 
+	def profile( self ):
+		"""Returns `(id, attempts, successes, failures, bytes, time)` for
+		each symbol, the time including the symbol's children."""
+		c = self._cobject
+		return [
+			(i, c.attemptsBySymbol[i], c.successBySymbol[i], c.failureBySymbol[i], c.bytesBySymbol[i], c.timeBySymbol[i]) for i in range(self.symbolsCount())
+		]
+
 	def report( self, grammar=None, output=sys.stdout ):
 		br    = self.bytesRead()
-		pt    = self.parseTime()
+		pt    = self.parseTime() or 1e-9
 		ts    = self.totalSuccess()
 		tf    = self.totalFailures()
+		to    = max(ts + tf, 1)
 		def write(s):
 			output.write(s)
 			output.write("\n")
@@ -1061,29 +1379,29 @@ class ParsingStats(CObject):
 		write("Sucesses   :  {0}".format(ts))
 		write("Failures   :  {0}".format(tf))
 		write("Throughput :  {0}op/s".format((ts + tf) / pt))
-		write("Op time    : ~{0}/op".format(pt / (ts + tf)))
-		write("Op/byte    :  {0}".format((ts + tf) / br))
+		write("Op time    : ~{0}/op".format(pt / to))
+		write("Op/byte    :  {0}".format((ts + tf) / float(max(br, 1))))
 		write("-" * 80)
-		write("   SYMBOL   NAME                               SUCCESSES       FAILURES")
-		s  = sorted(self.symbols(), lambda a,b:cmp(b[1] + b[2], a[1] + a[2]))
+		write("   SYMBOL   NAME                   ATTEMPTS  SUCCESSES   FAILURES      BYTES   TIME(s)")
+		s  = sorted(self.profile(), key=lambda _:_[5], reverse=True)
 		c  = 0
 		ct = 0
-		for sid, s, f in s:
+		for sid, a, s, f, b, t in s:
 			ct += 1
-			if s == 0 and f == 0: continue
+			if a == 0: continue
 			e = grammar.symbol(sid) if grammar else None
 			n = ""
 			if e:
 				if e.isReference():
-					n = "*" + e.element().name() + "(" + e.cardinality() + ")"
-					if e.name():
-						n += ":" + e.name()
+					n = "*" + (e.element.name or "") + "(" + ensure_str(e.cardinality()) + ")"
+					if e.name:
+						n += ":" + e.name
 				else:
-					n = e.name()
-			write("{0:9d} {1:31s} {2:14d} {3:14d}".format(sid, n, s, f))
+					n = e.name or ""
+			write("{0:9d} {1:20s} {2:10d} {3:10d} {4:10d} {5:10d} {6:9.6f}".format(sid, n, a, s, f, b, t))
 			c += 1
 		write("-" * 80)
-		write("Activated  :  {0}/{1} ~{2}%".format(c, ct, int(100.0 * c / ct)))
+		write("Activated  :  {0}/{1} ~{2}%".format(c, ct, int(100.0 * c / max(ct, 1))))
 		return self
 
 
@@ -1115,13 +1433,91 @@ class Grammar(CObject):
 		_path = ensure_cstring(ensure_unicode(path))
 		return ParsingResult.Wrap(lib.Grammar_parsePath(self._cobject, _path), path=(path, _path), grammar=self)
 
+	def parseBatch( self, paths, threads=0 ):
+		"""Parses the files at the given paths with `threads` threads sharing
+		this grammar (one per processor by default), returning a list of
+		results in the same order, with `None` for the files that can't be
+		opened."""
+		self._prepare()
+		_paths   = [ensure_cstring(ensure_unicode(_)) for _ in paths]
+		_cpaths  = [ffi.new("char[]", _) for _ in _paths]
+		results  = lib.Grammar_parseBatch(self._cobject, ffi.new("const char*[]", _cpaths), len(_cpaths), threads)
+		res      = []
+		for i, path in enumerate(paths):
+			res.append(ParsingResult.Wrap(results[i], path=(path, _paths[i]), grammar=self))
+			# The wrapped results are freed on their own
+			results[i] = ffi.NULL
+		lib.ParsingResult_freeBatch(results, len(_cpaths))
+		return res
+
+	def parseParallel( self, path, record, boundary=None, threads=0 ):
+		"""Parses the file at the given path in chunks, with `threads` threads,
+		for grammars whose axiom repeats the `record` symbol. The chunks
+		start at lines, or at lines that are not indented when `boundary` is
+		`"unindented"`. See `Grammar_parseParallel`."""
+		self._prepare()
+		_path     = ensure_cstring(ensure_unicode(path))
+		if isinstance(record, Reference): record = record._cobject.element
+		elif isinstance(record, ParsingElement): record = record._cobject
+		_boundary = ffi.addressof(lib, "Boundary_Unindented" if boundary == "unindented" else "Boundary_Line")
+		return ParsingResult.Wrap(lib.Grammar_parseParallel(self._cobject, _path, record, _boundary, threads), path=(path, _path), grammar=self)
+
 	def parseStream( self, stream ):
-		return self.parseString(stream.read())
+		"""Parses the rest of the stream, which is mapped in memory rather
+		than read when it is a regular file at its start."""
+		try:
+			data = mmap.mmap(stream.fileno(), 0, access=mmap.ACCESS_READ) if stream.tell() == 0 else None
+		except (AttributeError, EnvironmentError, ValueError):
+			# Streams without a file descriptor, or that can't be mapped,
+			# like pipes and empty files.
+			data = None
+		return self.parseString(stream.read() if data is None else data)
+
+	def parseDescriptor( self, fd ):
+		"""Parses what is read from the given file descriptor (a pipe or a
+		socket, for instance) until it ends, in large reads that bypass any
+		Python buffering. The descriptor is not closed."""
+		self._prepare()
+		iterator = lib.Iterator_FromFD(fd, False)
+		result   = lib.Grammar_parseIterator(self._cobject, iterator)
+		result.context.freeIterator = True
+		return ParsingResult.Wrap(result, grammar=self)
 
 	def parseString( self, text ):
+		"""Parses the given text, or the data of the given buffer-protocol
+		object (bytes, bytearray, memoryview, mmap...) without copying it.
+		The data must not change while the result is used."""
 		self._prepare()
-		_text = ensure_cstring(ensure_unicode(text))
-		return ParsingResult.Wrap(lib.Grammar_parseString(self._cobject,_text), text=(text, _text), grammar=self)
+		text, _text = ensure_buffer(text)
+		return ParsingResult.Wrap(lib.Grammar_parseBuffer(self._cobject, _text, len(_text)), text=(text, _text), grammar=self)
+
+	def reparse( self, result, offset, removed, inserted ):
+		"""Returns the result of parsing the text of `result` once the
+		`removed` bytes at `offset` are replaced with `inserted`, reusing
+		its records. The given result can't be used afterwards. Returns
+		`None` if the edit is out of range. See `Grammar_reparse`."""
+		self._prepare()
+		_inserted = ensure_cstring(ensure_unicode(inserted))
+		res       = lib.Grammar_reparse(self._cobject, result._cobject, offset, removed, _inserted)
+		if not res:
+			return None
+		# The previous result was freed along with the reparse
+		result._cobject = ffi.NULL
+		return ParsingResult.Wrap(res, grammar=self)
+
+	def readBinary( self, data, text ):
+		"""Returns the result saved with `ParsingResult.toBinary` for the
+		given text, without parsing it again, or `None` if the data is
+		invalid or was not written with this grammar."""
+		self._prepare()
+		text, _text = ensure_buffer(text)
+		iterator = lib.Iterator_FromBuffer(_text, len(_text))
+		result   = lib.Grammar_readBinary(self._cobject, iterator, data, len(data))
+		if not result:
+			lib.Iterator_free(iterator)
+			return None
+		result.context.freeIterator = True
+		return ParsingResult.Wrap(result, text=(text, _text), grammar=self)
 
 	# =========================================================================
 	# AXIOM AND SKIPPING
@@ -1200,6 +1596,10 @@ class Grammar(CObject):
 		self._prepared = False
 		return self._registerAnonymous(Condition(callback))
 
+	def cut( self ):
+		self._prepared = False
+		return self._registerAnonymous(Cut())
+
 	def group( self, name, *children):
 		self._prepared = False
 		r = Group(*children)
@@ -1244,6 +1644,46 @@ class Grammar(CObject):
 		e = ffi.cast("Grammar*", self._cobject)
 		return e.isVerbose == 1
 
+	def setMemoize( self, enabled=True ):
+		"""Memoizes the matches and failures of the elements by offset
+		(packrat parsing), which pays off for grammars that backtrack
+		over the same input a lot. Elements can still opt out with
+		`ParsingElement.disableMemoize`."""
+		if enabled:
+			lib.Grammar_enableMemoize(self._cobject)
+		else:
+			lib.Grammar_disableMemoize(self._cobject)
+		return self
+
+	def setVM( self, enabled=True ):
+		"""Runs the parser on the grammar's compiled program rather than
+		the recursive recognizers. Both yield the same matches."""
+		if enabled:
+			lib.Grammar_enableVM(self._cobject)
+		else:
+			lib.Grammar_disableVM(self._cobject)
+		return self
+
+	def setProfiling( self, enabled=True ):
+		"""Counts the attempts, successes, failures, bytes and time of each
+		symbol, accumulating across parses in `Grammar.stats`. Disabling
+		profiling discards the counters."""
+		if enabled:
+			lib.Grammar_enableProfiling(self._cobject)
+		else:
+			lib.Grammar_disableProfiling(self._cobject)
+		return self
+
+	@property
+	def stats( self ):
+		"""The stats of the profiled parses, or None."""
+		return ParsingStats.Wrap(self._cobject.stats)
+
+	def key( self, name ):
+		"""Interns the name of a context variable, returning the key
+		that `ParsingContext.get` and `ParsingContext.set` take."""
+		return lib.Grammar_key(self._cobject, ensure_cstring(name))
+
 	def symbol( self, id ):
 		if type(id) is int:
 			e = ffi.cast("Reference*", self._cobject.elements[id])
@@ -1374,8 +1814,13 @@ class Processor:
 
 	def process( self, match ):
 		self.depth += 1
+		# The parsing result frees its matches, so we hold on to it until
+		# they are processed.
+		source = match
 		match  = match.match if isinstance(match, ParsingResult) else match
-		result = self._processMatch(match) if isinstance(match, Match) else match
+		match  = match.root  if isinstance(match, MatchBuffer)   else match
+		result = self._processMatch(match) if isinstance(match, (Match, FlatMatch)) else match
+		del source
 		self.depth -= 1
 		return result.value if isinstance(result, MatchResult) else result
 
@@ -1435,14 +1880,10 @@ class Processor:
 			return res
 
 	def _processWord( self, match ):
-		return ensure_unicode(ffi.string(lib.WordMatch_group(match._cobject)))
+		return match.word()
 
 	def _processToken( self, match ):
-		n = lib.TokenMatch_count(match._cobject)
-		if n == 0:
-			return None
-		else:
-			return list(ensure_unicode(ffi.string(lib.TokenMatch_group(match._cobject, i))) for i in range(n))
+		return match.groups() or None
 
 	def _processCondition( self, match ):
 		return True
@@ -1459,7 +1900,7 @@ class Processor:
 		return list(self._processMatch(_) for _ in match)
 
 	def _processReference( self, match ):
-		if not lib.Reference_IsMany(match.element):
+		if not match.isMany():
 			res = self._processMatch(match[0]) if match.hasChildren() else None
 			return res
 		else:
@@ -30,7 +30,7 @@ def builder():
 	ffibuilder = cffi.FFI()
 	ffibuilder.set_source(
 		"{0}".format(name()), H_SOURCE + C_SOURCE,
-		extra_link_args=["-Wl,-lpcre,-Ofast,--export-dynamic"]
+		extra_link_args=["-Wl,-lpcre,-lpthread,-Ofast,--export-dynamic"]
 	)
 	ffibuilder.cdef(FFI_SOURCE)
 	ffibuilder.embedding_init_code("""
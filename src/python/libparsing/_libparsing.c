@@ -1,16 +1,25 @@
+typedef struct LineIndex {
+ size_t* offsets;
+ size_t count;
+ size_t capacity;
+ size_t dropped;
+ size_t end;
+} LineIndex;
+
+
 typedef struct Iterator {
  char status;
  char* buffer;
  char* current;
  char separator;
  size_t offset;
- size_t lines;
+ LineIndex lines;
  size_t capacity;
  size_t available;
+ size_t released;
  
 _Bool 
                freeBuffer;
-
  void* input;
  void (*freeInput) (void*);
  
@@ -21,9 +30,15 @@ _Bool
 
 
 
+
+
 typedef struct FileInput {
  FILE* file;
  const char* path;
+ char* data;
+ size_t size;
+ size_t mapped;
+ size_t dropped;
 } FileInput;
 
 
@@ -39,6 +54,12 @@ Iterator* Iterator_Open(const char* path);
 Iterator* Iterator_FromString(const char* text);
 
 
+
+
+
+Iterator* Iterator_FromBuffer(const char* data, size_t length);
+
+
 Iterator* Iterator_new(void);
 
 
@@ -49,6 +70,8 @@ void Iterator_free(Iterator* this);
 
 
 
+
+
 _Bool 
     Iterator_open( Iterator* this, const char* path );
 
@@ -75,7 +98,18 @@ _Bool
 
 
 _Bool 
-    Iterator_backtrack ( Iterator* this, size_t offset, size_t lines );
+    Iterator_backtrack ( Iterator* this, size_t offset );
+
+
+
+
+
+
+size_t Iterator_lineAt ( Iterator* this, size_t offset );
+
+
+
+size_t Iterator_line ( Iterator* this );
 
 
 
@@ -83,6 +117,13 @@ char Iterator_charAt ( Iterator* this, size_t offset );
 
 
 
+
+
+size_t Iterator_textOffset ( Iterator* this );
+void Iterator_release ( Iterator* this, size_t offset );
+
+
+
 _Bool 
     String_move ( Iterator* this, int offset );
 FileInput* FileInput_new(const char* path );
@@ -93,16 +134,131 @@ void FileInput_free(void* this);
 
 
 
+
+_Bool 
+    FileInput_map( FileInput* this );
+
+
+
+
+
 size_t FileInput_preload( Iterator* this );
 
 
 
 
+void FileInput_release( Iterator* this );
+
+
+
+
 
 
 _Bool 
     FileInput_move ( Iterator* this, int n );
-typedef struct ParsingVariable ParsingVariable;
+
+
+
+
+
+typedef ssize_t (*ReaderCallback)(char* data, size_t length, void* context);
+typedef struct ReaderInput {
+ ReaderCallback read;
+ void* context;
+ int fd;
+ 
+_Bool 
+               closeFD;
+ int error;
+} ReaderInput;
+
+
+
+Iterator* Iterator_FromReader(ReaderCallback read, void* context);
+
+
+
+
+Iterator* Iterator_FromFD(int fd, 
+                                 _Bool 
+                                      close);
+
+
+
+
+ReaderInput* ReaderInput_new(ReaderCallback read, void* context);
+
+
+void ReaderInput_free(void* this);
+
+
+
+
+
+size_t ReaderInput_preload( Iterator* this );
+
+
+
+
+_Bool 
+    ReaderInput_move ( Iterator* this, int n );
+typedef 
+       _Bool 
+            (*WriterCallback)(const char* data, size_t length, void* context);
+
+
+typedef struct Writer {
+ char* data;
+ size_t length;
+ size_t flushed;
+ size_t capacity;
+ WriterCallback callback;
+ void* context;
+ 
+_Bool 
+               failed;
+} Writer;
+
+
+
+Writer* Writer_new( void );
+
+
+Writer* Writer_FromCallback( WriterCallback callback, void* context );
+
+
+Writer* Writer_FromFD( int fd );
+
+
+Writer* Writer_FromFile( FILE* file );
+
+
+
+void Writer_free( Writer* this );
+
+
+
+
+
+_Bool 
+    Writer_flush( Writer* this );
+
+
+void Writer_write( Writer* this, const char* data, size_t length );
+
+
+void Writer_print( Writer* this, const char* text );
+
+
+void Writer_printf( Writer* this, const char* format, ... );
+
+
+
+void Writer_printEscaped( Writer* this, const char* text, size_t length );
+typedef struct ParsingVariables ParsingVariables;
+typedef struct ParsingMemo ParsingMemo;
+typedef struct ParsingArena ParsingArena;
+typedef struct ParsingProgram ParsingProgram;
 typedef struct ParsingContext ParsingContext;
 typedef struct ParsingElement ParsingElement;
 typedef struct ParsingResult ParsingResult;
@@ -111,6 +267,9 @@ typedef struct Match Match;
 typedef struct Element Element;
 
 
+typedef int (*MatchWalkingCallback)(Match* this, int step, void* context);
+
+
 typedef struct Element {
  char type;
  int id;
@@ -127,6 +286,16 @@ typedef struct Grammar {
  
 _Bool 
                  isVerbose;
+ 
+_Bool 
+                 isMemoized;
+ 
+_Bool 
+                 isVM;
+ ParsingProgram* program;
+ char** keys;
+ int keysCount;
+ struct ParsingStats* stats;
 } Grammar;
 
 
@@ -134,9 +303,9 @@ Grammar* Grammar_new(void);
 
 
 void Grammar_free(Grammar* this);
+void Grammar_prepare ( Grammar* this );
 
 
-void Grammar_prepare ( Grammar* this );
 
 
 void Grammar_setVerbose ( Grammar* this );
@@ -145,10 +314,50 @@ void Grammar_setVerbose ( Grammar* this );
 void Grammar_setSilent ( Grammar* this );
 
 
+
+
+
+
+void Grammar_enableMemoize ( Grammar* this );
+
+
+
+
+void Grammar_disableMemoize ( Grammar* this );
+
+
+
+
+
+void Grammar_enableVM ( Grammar* this );
+
+
+
+void Grammar_disableVM ( Grammar* this );
+
+
+
+
+
+void Grammar_enableProfiling ( Grammar* this );
+
+
+
+void Grammar_disableProfiling ( Grammar* this );
+
+
+
+
+
+
+int Grammar_key ( Grammar* this, const char* name );
+
+
 int Grammar_symbolsCount ( Grammar* this );
 
 
 ParsingResult* Grammar_parseIterator( Grammar* this, Iterator* iterator );
+ParsingResult* Grammar_parseStream( Grammar* this, Iterator* iterator, MatchWalkingCallback callback, void* data );
 
 
 ParsingResult* Grammar_parsePath( Grammar* this, const char* path );
@@ -157,6 +366,41 @@ ParsingResult* Grammar_parsePath( Grammar* this, const char* path );
 ParsingResult* Grammar_parseString( Grammar* this, const char* text );
 
 
+
+
+ParsingResult* Grammar_parseBuffer( Grammar* this, const char* data, size_t length );
+
+
+
+
+
+ParsingResult* Grammar_readBinary( Grammar* this, Iterator* iterator, const char* data, size_t length );
+
+
+
+
+
+
+ParsingResult** Grammar_parseBatch( Grammar* this, const char** paths, size_t count, int threads );
+typedef 
+       _Bool 
+            (*BoundaryCallback)(const char* text, size_t offset, size_t length);
+
+
+
+
+_Bool 
+    Boundary_Line( const char* text, size_t offset, size_t length );
+
+
+
+
+_Bool 
+    Boundary_Unindented( const char* text, size_t offset, size_t length );
+ParsingResult* Grammar_parseParallel( Grammar* this, const char* path, ParsingElement* record, BoundaryCallback isBoundary, int threads );
+ParsingResult* Grammar_reparse( Grammar* this, ParsingResult* previous, size_t offset, size_t removed, const char* inserted );
+
+
 void Grammar_freeElements(Grammar* this);
 
 
@@ -175,9 +419,9 @@ int Element__walk( Element* this, ElementWalkingCallback callback, int step, voi
 typedef struct Match {
 
  char status;
+ char flags;
  size_t offset;
  size_t length;
- size_t line;
  Element* element;
  void* data;
  struct Match* next;
@@ -185,10 +429,6 @@ typedef struct Match {
  struct Match* parent;
  void* result;
 } Match;
-typedef int (*MatchWalkingCallback)(Match* this, int step, void* context);
-
-
-
 extern Match FAILURE_S;
 
 
@@ -277,7 +517,11 @@ int Match_countChildren(Match* this);
 
 
 
-void Match__writeJSON(Match* match, int fd, int flags);
+void Match__writeJSON(Match* match, Writer* writer, int flags);
+
+
+
+void Match_dumpJSON(Match* this, Writer* writer);
 
 
 void Match_writeJSON(Match* this, int fd);
@@ -287,141 +531,329 @@ void Match_printJSON(Match* this);
 
 
 
-void Match__writeXML(Match* match, int fd, int flags);
+void Match__writeXML(Match* match, Writer* writer, int flags);
+
+
+
+void Match_dumpXML(Match* this, Writer* writer);
 
 
 void Match_writeXML(Match* this, int fd);
 
 
 void Match_printXML(Match* this);
+typedef struct MatchNode {
+ int id;
+ char type;
+ const char* name;
+ size_t offset;
+ size_t length;
+ size_t children;
+ int groups;
+ const int* spans;
+} MatchNode;
 
 
-typedef struct ParsingElement {
- char type;
- int id;
- char* name;
- void* config;
- struct Reference* children;
- struct Match* (*recognize) (struct ParsingElement*, ParsingContext*);
- struct Match* (*process) (struct ParsingElement*, ParsingContext*, Match*);
- void (*freeMatch) (Match*);
-} ParsingElement;
+typedef struct MatchReader {
+ const char* data;
+ size_t length;
+ size_t position;
+ size_t end;
+ size_t count;
+ size_t read;
+ size_t offset;
+ const char** names;
+ char* types;
+ int namesCount;
+ int* spans;
+ int spansCount;
+} MatchReader;
 
 
 
 
-_Bool 
-            ParsingElement_Is(void* this);
+void Match_writeBinary(Match* this, Writer* writer);
 
 
 
 
+MatchReader* MatchReader_new(const char* data, size_t length);
 
-ParsingElement* ParsingElement_new(Reference* children[]);
 
+void MatchReader_free(MatchReader* this);
 
-void ParsingElement_freeChildren(ParsingElement* this);
 
 
-void ParsingElement_free(ParsingElement* this);
 
-ParsingElement* ParsingElement_Ensure(void* referenceOfElement);
 
+_Bool 
+    MatchReader_next(MatchReader* this, MatchNode* node);
 
-ParsingElement* ParsingElement_insert(ParsingElement* this, int index, Reference* child);
 
 
-ParsingElement* ParsingElement_replace(ParsingElement* this, int index, Reference* child);
 
 
 
+Match* Match_readBinary(ParsingContext* context, const char* data, size_t length);
+typedef struct MatchTree {
+ uint32_t* offsets;
+ uint32_t* lengths;
+ int32_t* elements;
+ int32_t* children;
+ int32_t* next;
+ int32_t count;
+ int32_t capacity;
+ struct Grammar* grammar;
+} MatchTree;
 
-ParsingElement* ParsingElement_add(ParsingElement* this, Reference* child);
 
 
-ParsingElement* ParsingElement_clear(ParsingElement* this);
 
 
+MatchTree* MatchTree_new(Match* match, struct Grammar* grammar);
 
 
-size_t ParsingElement_skip(ParsingElement* this, ParsingContext* context);
+void MatchTree_free(MatchTree* this);
 
 
+int MatchTree_getOffset(MatchTree* this, int node);
 
 
+int MatchTree_getLength(MatchTree* this, int node);
 
-Match* ParsingElement_process( ParsingElement* this, Match* match );
 
+int MatchTree_getEndOffset(MatchTree* this, int node);
 
 
+int MatchTree_getElementID(MatchTree* this, int node);
 
-ParsingElement* ParsingElement_name( ParsingElement* this, const char* name );
 
 
-const char* ParsingElement_getName( ParsingElement* this );
+Element* MatchTree_getElement(MatchTree* this, int node);
 
 
-int ParsingElement_walk( ParsingElement* this, ElementWalkingCallback callback, void* context);
 
+ParsingElement* MatchTree_getParsingElement(MatchTree* this, int node);
 
-int ParsingElement__walk( ParsingElement* this, ElementWalkingCallback callback, int step, void* context);
-typedef struct WordConfig {
- char* word;
- size_t length;
-} WordConfig;
 
+const char* MatchTree_getElementName(MatchTree* this, int node);
 
-ParsingElement* Word_new(const char* word);
 
 
-void Word_free(ParsingElement* this);
+_Bool 
+    MatchTree_hasNext(MatchTree* this, int node);
 
 
+int MatchTree_getNext(MatchTree* this, int node);
 
-Match* Word_recognize(ParsingElement* this, ParsingContext* context);
 
 
-const char* Word_word(ParsingElement* this);
+_Bool 
+    MatchTree_hasChildren(MatchTree* this, int node);
 
 
-const char* WordMatch_group(Match* match);
-typedef struct TokenConfig {
- char* expr;
+int MatchTree_getChildren(MatchTree* this, int node);
 
- pcre* regexp;
- pcre_extra* extra;
 
-} TokenConfig;
+int MatchTree_countChildren(MatchTree* this, int node);
+typedef struct MatchRecord {
+ int32_t type;
+ int32_t id;
+ int32_t offset;
+ int32_t length;
+ int32_t parent;
+ int32_t next;
+ int32_t groups;
+ int32_t spans;
+} MatchRecord;
 
 
-typedef struct TokenMatch {
- int count;
- const char** groups;
-} TokenMatch;
+typedef struct MatchBuffer {
+ char* data;
+ size_t size;
+ MatchRecord* records;
+ int32_t* spans;
+ int32_t count;
+ int32_t spansCount;
+} MatchBuffer;
 
 
 
 
-ParsingElement* Token_new(const char* expr);
 
+MatchBuffer* MatchBuffer_new(Match* match);
 
-void Token_free(ParsingElement*);
 
+void MatchBuffer_free(MatchBuffer* this);
 
 
-Match* Token_recognize(ParsingElement* this, ParsingContext* context);
+typedef struct ParsingElement {
+ char type;
+ int id;
+ char* name;
+ void* config;
+ struct Reference* children;
+ struct Match* (*recognize) (struct ParsingElement*, ParsingContext*);
+ struct Match* (*process) (struct ParsingElement*, ParsingContext*, Match*);
+ void (*freeMatch) (Match*);
+ int flags;
+} ParsingElement;
 
 
-const char* Token_expr(ParsingElement* this);
 
 
+_Bool 
+            ParsingElement_Is(void* this);
+
+
+
+
+
+ParsingElement* ParsingElement_new(Reference* children[]);
+
+
+void ParsingElement_freeChildren(ParsingElement* this);
+
+
+void ParsingElement_free(ParsingElement* this);
+
+ParsingElement* ParsingElement_Ensure(void* referenceOfElement);
+
+
+ParsingElement* ParsingElement_insert(ParsingElement* this, int index, Reference* child);
+
+
+ParsingElement* ParsingElement_replace(ParsingElement* this, int index, Reference* child);
+
+
+
+
+ParsingElement* ParsingElement_add(ParsingElement* this, Reference* child);
+
+
+ParsingElement* ParsingElement_clear(ParsingElement* this);
+
+
+
+
+
+Match* ParsingElement_recognize(ParsingElement* this, ParsingContext* context);
+
+
+
+
+_Bool 
+    ParsingElement_isMemoizable(ParsingElement* this);
+
+
+
+
+
+ParsingElement* ParsingElement_disableMemoize(ParsingElement* this);
+
+
+
+ParsingElement* ParsingElement_disableFailMemoize(ParsingElement* this);
+
+
+
+
+size_t ParsingElement_skip(ParsingElement* this, ParsingContext* context);
+
+
+
+
+
+Match* ParsingElement_process( ParsingElement* this, Match* match );
+
+
+
+
+ParsingElement* ParsingElement_name( ParsingElement* this, const char* name );
+
+
+const char* ParsingElement_getName( ParsingElement* this );
+
+
+int ParsingElement_walk( ParsingElement* this, ElementWalkingCallback callback, void* context);
+
+
+int ParsingElement__walk( ParsingElement* this, ElementWalkingCallback callback, int step, void* context);
+typedef struct WordConfig {
+ char* word;
+ size_t length;
+} WordConfig;
+
+
+ParsingElement* Word_new(const char* word);
+
+
+void Word_free(ParsingElement* this);
+
+
+
+Match* Word_recognize(ParsingElement* this, ParsingContext* context);
+
+
+const char* Word_word(ParsingElement* this);
+
+
+const char* WordMatch_group(Match* match);
+typedef struct TokenConfig {
+ char* expr;
+
+ pcre* regexp;
+ pcre_extra* extra;
+
+} TokenConfig;
+
+
+
+
+typedef struct TokenMatch {
+ int count;
+ const char** groups;
+ int* spans;
+ Iterator* iterator;
+ ParsingArena* arena;
+} TokenMatch;
+
+
+
+
+ParsingElement* Token_new(const char* expr);
+
+
+void Token_free(ParsingElement*);
+
+
+
+Match* Token_recognize(ParsingElement* this, ParsingContext* context);
+
+
+const char* Token_expr(ParsingElement* this);
+
+
+
+
+TokenMatch* TokenMatch__new(ParsingArena* arena, Iterator* iterator, int count);
+
+
+
+void TokenMatch_free(Match* match);
+
 
-void TokenMatch_free(Match* match);
 
 
 const char* TokenMatch_group(Match* match, int index);
 
 
+
+
+
+const char* TokenMatch_slice(Match* match, int index, size_t* length);
+
+
 int TokenMatch_count(Match* match);
 typedef struct Reference {
  char type;
@@ -488,9 +920,48 @@ int Reference__walk( Reference* this, ElementWalkingCallback callback, int step,
 
 
 Match* Reference_recognize(Reference* this, ParsingContext* context);
+typedef struct WordTrieEdge {
+ unsigned char byte;
+ int target;
+ int next;
+} WordTrieEdge;
+
+
+typedef struct WordTrie {
+ int count;
+ int* words;
+ int* edges;
+ WordTrieEdge* links;
+ Reference** children;
+} WordTrie;
+
+
+typedef struct GroupConfig {
+ Reference** dispatch[256];
+ Reference** candidates;
+ WordTrie* words;
+} GroupConfig;
+
+
+
+
+WordTrie* WordTrie_new(ParsingElement* group);
+
+
+void WordTrie_free(WordTrie* this);
+
+
+
+
+Reference* WordTrie_match(WordTrie* this, const char* text, size_t length);
+
+
 ParsingElement* Group_new(Reference* children[]);
 
 
+void Group_free(ParsingElement* this);
+
+
 Match* Group_recognize(ParsingElement* this, ParsingContext* context);
 ParsingElement* Rule_new(Reference* children[]);
 
@@ -515,12 +986,19 @@ ParsingElement* Condition_new(ConditionCallback c);
 
 
 Match* Condition_recognize(ParsingElement* this, ParsingContext* context);
+ParsingElement* Cut_new(void);
+
+
+Match* Cut_recognize(ParsingElement* this, ParsingContext* context);
 typedef struct ParsingStats {
  size_t bytesRead;
  double parseTime;
  size_t symbolsCount;
+ size_t* attemptsBySymbol;
  size_t* successBySymbol;
  size_t* failureBySymbol;
+ size_t* bytesBySymbol;
+ double* timeBySymbol;
  size_t failureOffset;
  size_t matchOffset;
  size_t matchLength;
@@ -537,47 +1015,160 @@ void ParsingStats_free(ParsingStats* this);
 void ParsingStats_setSymbolsCount(ParsingStats* this, size_t t);
 
 
+
 Match* ParsingStats_registerMatch(ParsingStats* this, Element* e, Match* m);
-typedef struct ParsingVariable {
- int depth;
- char* key;
+
+
+
+void ParsingStats_merge(ParsingStats* this, ParsingStats* other);
+
+
+
+double ParsingStats_now(void);
+typedef struct ParsingSlot {
  void* value;
- struct ParsingVariable* previous;
-} ParsingVariable;
+ int depth;
+} ParsingSlot;
 
 
-ParsingVariable* ParsingVariable_new(int depth, const char* key, void* value);
 
 
-void ParsingVariable_free(ParsingVariable* this);
+typedef struct ParsingShadow {
+ int key;
+ ParsingSlot previous;
+} ParsingShadow;
 
 
-void ParsingVariable_freeAll(ParsingVariable* this);
+typedef struct ParsingVariables {
+ char** keys;
+ int keysCount;
+ int keysCapacity;
+ int keysShared;
+ ParsingSlot* slots;
+ ParsingShadow* shadows;
+ int shadowsCount;
+ int shadowsCapacity;
+ int* frames;
+ int framesCapacity;
+} ParsingVariables;
 
 
 
-_Bool 
-    ParsingVariable_is(ParsingVariable* this, const char* key);
+
+ParsingVariables* ParsingVariables_new(Grammar* grammar);
+
+
+void ParsingVariables_free(ParsingVariables* this);
+
+
+
+
+int ParsingVariables_key(ParsingVariables* this, const char* name, 
+                                                                  _Bool 
+                                                                       create);
+typedef struct ParsingMemoEntry {
+ int id;
+ int generation;
+ size_t offset;
+ size_t end;
+ Match* match;
+} ParsingMemoEntry;
+
+
+typedef struct ParsingMemo {
+ size_t capacity;
+ size_t count;
+ size_t hits;
+ size_t committed;
+ int generation;
+ struct ParsingArena* arena;
+ ParsingMemoEntry* entries;
+} ParsingMemo;
+
+
+
+ParsingMemo* ParsingMemo_new(struct ParsingArena* arena);
+
+
+void ParsingMemo_free(ParsingMemo* this);
+
+
+
+ParsingMemoEntry* ParsingMemo_get(ParsingMemo* this, int id, size_t offset);
+
+
+
+
+
+ParsingMemoEntry* ParsingMemo_set(ParsingMemo* this, int id, size_t offset, size_t end, Match* match);
 
 
-ParsingVariable* ParsingVariable_set(ParsingVariable* this, const char* name, void* value);
 
+void ParsingMemo_clear(ParsingMemo* this);
 
-void* ParsingVariable_get(ParsingVariable* this, const char* name);
 
 
-ParsingVariable* ParsingVariable_find(ParsingVariable* this, const char* key, 
-                                                                             _Bool 
-                                                                                  local);
 
 
-int ParsingVariable_getDepth(ParsingVariable* this);
+void ParsingMemo_forget(ParsingMemo* this);
+typedef struct ParsingArenaChunk {
+ struct ParsingArenaChunk* previous;
+ size_t capacity;
+ size_t used;
+ char* data;
+} ParsingArenaChunk;
+
+
+typedef struct ParsingArenaMark {
+ ParsingArenaChunk* chunk;
+ size_t used;
+} ParsingArenaMark;
+
+
+typedef struct ParsingArena {
+ ParsingArenaChunk* chunk;
+ ParsingArenaChunk* spare;
+ void* pinned;
+ size_t allocated;
+ ParsingArenaMark kept;
+} ParsingArena;
+
+
+ParsingArena* ParsingArena_new(void);
+
+
+
+void ParsingArena_free(ParsingArena* this);
+
+
+
+void* ParsingArena_alloc(ParsingArena* this, size_t size);
+
+
+
 
 
-const char* ParsingVariable_getName(ParsingVariable* this);
+void* ParsingArena_allocPinned(ParsingArena* this, size_t size);
 
 
-int ParsingVariable_count(ParsingVariable* this);
+
+ParsingArenaMark ParsingArena_mark(ParsingArena* this);
+
+
+
+
+void ParsingArena_rewind(ParsingArena* this, ParsingArenaMark mark);
+
+
+
+
+
+void ParsingArena_keep(ParsingArena* this);
+
+
+
+
+void ParsingArena_reset(ParsingArena* this);
 typedef void (*ContextCallback)(ParsingContext* context, char op );
 
 
@@ -585,7 +1176,9 @@ typedef struct ParsingContext {
  struct Grammar* grammar;
  struct Iterator* iterator;
  struct ParsingStats* stats;
- struct ParsingVariable* variables;
+ struct ParsingVariables* variables;
+ struct ParsingMemo* memo;
+ struct ParsingArena* arena;
  size_t lastMatchOffset;
  size_t lastMatchLength;
  int lastMatchElementID;
@@ -593,9 +1186,11 @@ typedef struct ParsingContext {
  int depth;
  const char* indent;
  int flags;
+ int choices;
  
 _Bool 
                         freeIterator;
+ struct ParsingContext* parts;
 } ParsingContext;
 
 
@@ -632,6 +1227,14 @@ void ParsingContext_pop ( ParsingContext* this );
 void* ParsingContext_get(ParsingContext* this, const char* name);
 
 
+
+void* ParsingContext_getKey(ParsingContext* this, int key);
+
+
+
+void ParsingContext_setKey(ParsingContext* this, int key, void* value);
+
+
 int ParsingContext_getInt(ParsingContext* this, const char* name);
 
 
@@ -654,6 +1257,7 @@ typedef struct ParsingResult {
  char status;
  Match* match;
  ParsingContext* context;
+ MatchTree* tree;
 } ParsingResult;
 
 
@@ -665,6 +1269,17 @@ void ParsingResult_free(ParsingResult* this);
 
 
 
+void ParsingResult_freeBatch(ParsingResult** results, size_t count);
+
+
+
+
+
+
+MatchTree* ParsingResult_compact(ParsingResult* this);
+
+
+
 _Bool 
     ParsingResult_isSuccess(ParsingResult* this);
 
@@ -691,48 +1306,107 @@ size_t ParsingResult_remaining(ParsingResult* this);
 
 
 
+size_t ParsingResult_lineForOffset(ParsingResult* this, size_t offset);
 
-typedef struct Processor Processor;
 
 
-typedef void (*ProcessorCallback)(Processor* processor, Match* match);
 
-typedef struct Processor {
- ProcessorCallback fallback;
- ProcessorCallback* callbacks;
- int callbacksCount;
-} Processor;
+size_t ParsingResult_columnForOffset(ParsingResult* this, size_t offset);
 
 
 
-Processor* Processor_new(void);
 
 
-void Processor_free(Processor* this);
 
 
-void Processor_register (Processor* this, int symbolID, ProcessorCallback callback) ;
+_Bool 
+    ParsingResult_lineRange(ParsingResult* this, size_t line, size_t* start, size_t* end);
+typedef struct ParsingInstruction {
+ char op;
+ int a;
+ int b;
+ void* element;
+} ParsingInstruction;
+
+
+typedef struct ParsingProgram {
+ ParsingInstruction* code;
+ int length;
+ int capacity;
+ int* entries;
+ int count;
+} ParsingProgram;
 
 
-int Processor_process (Processor* this, Match* match, int step);
 
+ParsingProgram* ParsingProgram_new(Grammar* grammar);
 
 
+void ParsingProgram_free(ParsingProgram* this);
 
 
 
+Match* ParsingProgram_run(ParsingProgram* this, ParsingContext* context);
 
-void Utilities_indent( ParsingElement* this, ParsingContext* context );
 
 
-void Utilities_dedent( ParsingElement* this, ParsingContext* context );
 
 
 
-_Bool 
-    Utilites_checkIndent( ParsingElement* this, ParsingContext* context );
-typedef struct gc_Reference {
- char guard;
+typedef struct Processor Processor;
+
+
+typedef void (*ProcessorCallback)(Processor* processor, Match* match);
+
+
+
+typedef void (*ProcessorNodeCallback)(Processor* processor, MatchTree* tree, int node);
+
+typedef struct Processor {
+ ProcessorCallback fallback;
+ ProcessorCallback* callbacks;
+ ProcessorNodeCallback* nodeCallbacks;
+ int callbacksCount;
+} Processor;
+
+
+
+Processor* Processor_new(void);
+
+
+void Processor_free(Processor* this);
+
+
+void Processor_register (Processor* this, int symbolID, ProcessorCallback callback) ;
+
+
+int Processor_process (Processor* this, Match* match, int step);
+
+
+void Processor_registerNode (Processor* this, int symbolID, ProcessorNodeCallback callback);
+
+
+
+
+int Processor_processTree (Processor* this, MatchTree* tree, int node, int step);
+
+
+
+
+
+
+
+void Utilities_indent( ParsingElement* this, ParsingContext* context );
+
+
+void Utilities_dedent( ParsingElement* this, ParsingContext* context );
+
+
+
+_Bool 
+    Utilites_checkIndent( ParsingElement* this, ParsingContext* context );
+typedef struct gc_Reference {
+ char guard;
  size_t size;
  int count;
  void* previous;
@@ -790,6 +1464,28 @@ Match* FAILURE = &FAILURE_S;
 
 const char* EMPTY = "";
 const char* INDENT = "                                                                                ";
+static inline Match* ParsingContext__registerMatch(ParsingContext* this, Match* m) {
+
+ if ((this->flags & 0x1)) {return m;}
+
+
+
+ if (m != NULL && Match_isSuccess(m)) {
+  if ( (this->lastMatchOffset + this->lastMatchLength) < (m->offset + m->length) && m->length > 0) {
+   this->lastMatchOffset = m->offset;
+   this->lastMatchLength = m->length;
+   this->lastMatchElementID = m->element->id;
+  }
+ }
+ return m;
+}
+
+
+
+
+
+
+
 char* String_escape(const char* string) {
  const char* p = string;
  int n = 0;
@@ -838,6 +1534,144 @@ char* String_escape(const char* string) {
  res[l + n] = '\0';
  return res;
 }
+static 
+      _Bool 
+           Writer__writeFD( const char* data, size_t length, void* context ) {
+ int fd = (int)(intptr_t)context;
+ while (length > 0) {
+  ssize_t written = write(fd, data, length);
+  if (written < 0) {
+   if (errno == EINTR) {continue;}
+   return 0;
+  }
+  data += written;
+  length -= (size_t)written;
+ }
+ return 1;
+}
+
+static 
+      _Bool 
+           Writer__writeFile( const char* data, size_t length, void* context ) {
+ return fwrite(data, 1, length, (FILE*)context) == length;
+}
+
+Writer* Writer_new( void ) {
+ return Writer_FromCallback(NULL, NULL);
+}
+
+Writer* Writer_FromCallback( WriterCallback callback, void* context ) {
+ Writer* this = (Writer*) gc_new(sizeof(Writer)); assert (this!=NULL); ;
+ char* data = (char*) gc_calloc((64 * 1024) + 1, sizeof(char)) ; assert (data!=NULL); ;
+ this->data = data;
+ this->data[0] = '\0';
+ this->length = 0;
+ this->flushed = 0;
+ this->capacity = (64 * 1024);
+ this->callback = callback;
+ this->context = context;
+ this->failed = 0;
+ return this;
+}
+
+Writer* Writer_FromFD( int fd ) {
+ return Writer_FromCallback(Writer__writeFD, (void*)(intptr_t)fd);
+}
+
+Writer* Writer_FromFile( FILE* file ) {
+ return Writer_FromCallback(Writer__writeFile, (void*)file);
+}
+
+void Writer_free( Writer* this ) {
+ if (this == NULL) {return;}
+ Writer_flush(this);
+ if (this->data!=NULL) {; gc_free(this->data); } ;
+ if (this!=NULL) {; gc_free(this); } ;
+}
+
+
+_Bool 
+    Writer_flush( Writer* this ) {
+ if (this->callback != NULL && this->length > 0) {
+  if (!this->failed && !this->callback(this->data, this->length, this->context)) {
+   this->failed = 1;
+  }
+  this->flushed += this->length;
+  this->length = 0;
+  this->data[0] = '\0';
+ }
+ return !this->failed;
+}
+
+
+
+static inline void Writer__reserve( Writer* this, size_t length ) {
+ if (this->length + length <= this->capacity) {return;}
+ if (this->callback != NULL) {Writer_flush(this);}
+ if (this->length + length > this->capacity) {
+  this->capacity = (this->capacity * 2 > this->length + length ? this->capacity * 2 : this->length + length);
+  this->data=gc_realloc(this->data,this->capacity + 1 * sizeof(char)); ;
+ }
+}
+
+void Writer_write( Writer* this, const char* data, size_t length ) {
+ Writer__reserve(this, length);
+ memcpy(this->data + this->length, data, length);
+ this->length += length;
+ this->data[this->length] = '\0';
+}
+
+void Writer_print( Writer* this, const char* text ) {
+ Writer_write(this, text, strlen(text));
+}
+
+void Writer_printf( Writer* this, const char* format, ... ) {
+ va_list args;
+ va_start(args, format);
+ int length = vsnprintf(this->data + this->length, this->capacity - this->length + 1, format, args);
+ va_end(args);
+ if (length < 0) {return;}
+ if (this->length + (size_t)length > this->capacity) {
+
+  this->data[this->length] = '\0';
+  Writer__reserve(this, (size_t)length);
+  va_start(args, format);
+  vsnprintf(this->data + this->length, this->capacity - this->length + 1, format, args);
+  va_end(args);
+ }
+ this->length += (size_t)length;
+}
+
+void Writer_printEscaped( Writer* this, const char* text, size_t length ) {
+
+ Writer__reserve(this, length * 6);
+ char* out = this->data + this->length;
+ for (size_t i=0 ; i<length ; i++) {
+  unsigned char c = (unsigned char)text[i];
+  switch (c) {
+   case '\n': *out++ = '\\'; *out++ = 'n'; break;
+   case '\t': *out++ = '\\'; *out++ = 't'; break;
+   case '\r': *out++ = '\\'; *out++ = 'r'; break;
+   case '"': *out++ = '\\'; *out++ = '"'; break;
+   case '\\': *out++ = '\\'; *out++ = '\\'; break;
+   default:
+    if (c < 0x20) {
+     out += sprintf(out, "\\u%04x", c);
+    } else {
+     *out++ = (char)c;
+    }
+  }
+ }
+ this->length = (size_t)(out - this->data);
+ this->data[this->length] = '\0';
+}
+
+
+
+
+
+
+
 Iterator* Iterator_Open(const char* path) {
  Iterator* result = Iterator_new();
  result->freeBuffer = 1;
@@ -850,17 +1684,45 @@ Iterator* Iterator_Open(const char* path) {
 }
 
 Iterator* Iterator_FromString(const char* text) {
+ return Iterator_FromBuffer(text, strlen(text));
+}
+
+Iterator* Iterator_FromBuffer(const char* data, size_t length) {
  Iterator* this = Iterator_new();
  if (this!=NULL) {
-  this->buffer = (char*)text;
-  this->current = (char*)text;
-  this->capacity = strlen(text);
+  this->buffer = (char*)data;
+  this->current = (char*)data;
+  this->capacity = length;
   this->available = this->capacity;
   this->move = String_move;
  }
  return this;
 }
 
+static Iterator* Iterator__fromReaderInput(ReaderInput* input) {
+ Iterator* this = Iterator_new();
+ this->input = (void*)input;
+ this->freeInput = ReaderInput_free;
+ this->status = '~';
+ this->freeBuffer = 1;
+ this->move = ReaderInput_move;
+ ReaderInput_preload(this);
+ return this;
+}
+
+Iterator* Iterator_FromReader(ReaderCallback read, void* context) {
+ return Iterator__fromReaderInput(ReaderInput_new(read, context));
+}
+
+Iterator* Iterator_FromFD(int fd, 
+                                 _Bool 
+                                      close) {
+ ReaderInput* input = ReaderInput_new(NULL, NULL);
+ input->fd = fd;
+ input->closeFD = close;
+ return Iterator__fromReaderInput(input);
+}
+
 Iterator* Iterator_new( void ) {
  Iterator* this = (Iterator*) gc_new(sizeof(Iterator)); assert (this!=NULL); ;
  this->status = '-';
@@ -868,13 +1730,18 @@ Iterator* Iterator_new( void ) {
  this->buffer = NULL;
  this->current = NULL;
  this->offset = 0;
- this->lines = 0;
  this->available = 0;
+ this->released = 0;
  this->capacity = 0;
  this->input = NULL;
  this->freeInput = NULL;
  this->move = NULL;
  this->freeBuffer = 0;
+ this->lines.offsets = NULL;
+ this->lines.count = 0;
+ this->lines.capacity = 0;
+ this->lines.dropped = 0;
+ this->lines.end = 0;
  return this;
 }
 
@@ -886,6 +1753,29 @@ void Iterator__freeInput( Iterator* this ) {
  this->input = NULL;
 }
 
+
+
+
+static void Iterator__replaceText( Iterator* this, char* text, size_t length ) {
+ Iterator__freeInput(this);
+ if (this->freeBuffer) {if (this->buffer!=NULL) {; gc_free(this->buffer); } ;}
+ if (this->lines.offsets!=NULL) {; gc_free(this->lines.offsets); } ;
+ this->status = '-';
+ this->buffer = text;
+ this->current = text;
+ this->offset = 0;
+ this->capacity = length;
+ this->available = length;
+ this->released = 0;
+ this->freeBuffer = 1;
+ this->move = String_move;
+ this->lines.offsets = NULL;
+ this->lines.count = 0;
+ this->lines.capacity = 0;
+ this->lines.dropped = 0;
+ this->lines.end = 0;
+}
+
 void Iterator_free( Iterator* this ) {
  ;
  if (this != NULL) {
@@ -894,6 +1784,7 @@ void Iterator_free( Iterator* this ) {
  if (this->freeBuffer) {
   if (this->buffer!=NULL) {; gc_free(this->buffer); } ;
  }
+ if (this->lines.offsets!=NULL) {; gc_free(this->lines.offsets); } ;
  if (this!=NULL) {; gc_free(this); } ;
 }
 
@@ -908,6 +1799,17 @@ _Bool
   this->freeInput = FileInput_free;
   this->status = '~';
   this->offset = 0;
+  if (FileInput_map(input)) {
+
+
+   this->buffer = input->data;
+   this->current = input->data;
+   this->capacity = input->size;
+   this->available = input->size;
+   this->freeBuffer = 0;
+   this->move = String_move;
+   return 1;
+  }
 
 
 
@@ -942,33 +1844,108 @@ _Bool
 }
 
 size_t Iterator_remaining( Iterator* this ) {
- int buffer_offset = ((char*)this->current - this->buffer);
 
- int remaining = this->available - buffer_offset;
- assert(remaining >= 0);
 
- return (size_t)remaining;
+ size_t buffer_offset = ((char*)this->current - this->buffer);
+
+ assert(buffer_offset <= this->available);
+ size_t remaining = this->available - buffer_offset;
+
+ return remaining;
 }
 
 
 _Bool 
     Iterator_moveTo ( Iterator* this, size_t offset ) {
- return this->move(this, offset - this->offset );
+
+
+ while (offset > this->offset && offset - this->offset > INT_MAX) {
+  if (!this->move(this, INT_MAX)) {return 0;}
+ }
+ while (offset < this->offset && this->offset - offset > INT_MAX) {
+  if (!this->move(this, -INT_MAX)) {return 0;}
+ }
+ return this->move(this, (int)((ssize_t)offset - (ssize_t)this->offset));
+}
+
+
+static size_t LineIndex__count( LineIndex* this, size_t offset ) {
+ size_t lo = 0;
+ size_t hi = this->count;
+ while (lo < hi) {
+  size_t mid = lo + (hi - lo) / 2;
+  if (this->offsets[mid] < offset) {lo = mid + 1;} else {hi = mid;}
+ }
+ return lo;
+}
+
+
+
+
+static void Iterator__indexLines( Iterator* this, size_t offset ) {
+ LineIndex* index = &(this->lines);
+ size_t base = Iterator_textOffset(this);
+ size_t end = (offset < (base + this->available) ? offset : (base + this->available));
+ if (index->end >= end) {return;}
+ const char* start = this->buffer + (((index->end > base ? index->end : base)) - base);
+ const char* limit = this->buffer + (end - base);
+ while (start < limit && (start = memchr(start, this->separator, (size_t)(limit - start))) != NULL) {
+  if (index->count == index->capacity) {
+   index->capacity = index->capacity == 0 ? 256 : index->capacity * 2;
+   index->offsets=gc_realloc(index->offsets,index->capacity * sizeof(size_t)); ;
+  }
+  index->offsets[index->count++] = base + (size_t)(start - this->buffer);
+  start++;
+ }
+ index->end = end;
 }
 
 
 _Bool 
-    Iterator_backtrack ( Iterator* this, size_t offset, size_t lines ) {
+    Iterator_backtrack ( Iterator* this, size_t offset ) {
  assert(offset <= this->offset);
- assert(lines <= this->lines);
- this->lines = lines;
- return this->move(this, offset - this->offset );
+ return Iterator_moveTo(this, offset);
 }
 
 char Iterator_charAt ( Iterator* this, size_t offset ) {
- assert(this->offset == (this->current - this->buffer));
- assert(offset <= this->available);
- return (char)(this->buffer[offset]);
+ size_t base = Iterator_textOffset(this);
+ assert(offset >= base);
+ assert(offset - base <= this->available);
+ return (char)(this->buffer[offset - base]);
+}
+
+size_t Iterator_textOffset ( Iterator* this ) {
+ return this->offset - (size_t)(this->current - this->buffer);
+}
+
+void Iterator_release ( Iterator* this, size_t offset ) {
+
+ offset = (offset < this->offset ? offset : this->offset);
+ if (offset <= this->released) {return;}
+ this->released = offset;
+
+
+
+ LineIndex* index = &(this->lines);
+ Iterator__indexLines(this, offset);
+ size_t dropped = LineIndex__count(index, offset);
+ if (dropped > 0 && dropped * 2 >= index->count) {
+  memmove(index->offsets, index->offsets + dropped, (index->count - dropped) * sizeof(size_t));
+  index->count -= dropped;
+  index->dropped += dropped;
+ }
+ if (this->freeInput == FileInput_free) {
+  FileInput_release(this);
+ }
+}
+
+size_t Iterator_lineAt ( Iterator* this, size_t offset ) {
+ Iterator__indexLines(this, offset);
+ return this->lines.dropped + LineIndex__count(&(this->lines), offset);
+}
+
+size_t Iterator_line ( Iterator* this ) {
+ return Iterator_lineAt(this, this->offset);
 }
 
 _Bool 
@@ -988,12 +1965,9 @@ _Bool
 
   size_t c = n <= left ? n : left;
 
-  while (c > 0) {
-   this->current++;
-   this->offset++;
-   if (*(this->current) == this->separator) {this->lines++;}
-   c--;
-  }
+
+  this->current += c;
+  this->offset += c;
 
   left = this->available - this->offset;
 
@@ -1034,6 +2008,10 @@ FileInput* FileInput_new(const char* path ) {
  assert(this != NULL);
 
  this->path = path;
+ this->data = NULL;
+ this->size = 0;
+ this->mapped = 0;
+ this->dropped = 0;
  this->file = fopen(path, "r");
  if (this->file==NULL) {
   fprintf(stderr, "ERR ");fprintf(stderr, "Cannot open file: %s", path);fprintf(stderr, "\n");;
@@ -1047,10 +2025,49 @@ FileInput* FileInput_new(const char* path ) {
 void FileInput_free(void* this) {
  ;
  FileInput* self = (FileInput*) this;
+ if (self != NULL && self->data != NULL) { munmap(self->data, self->mapped); }
  if (self != NULL && self->file != NULL) { fclose(self->file); }
  if (this!=NULL) {; gc_free(this); } ;
 }
 
+void FileInput_release( Iterator* this ) {
+ FileInput* input = (FileInput*)this->input;
+ if (input == NULL || input->data == NULL) {return;}
+
+ size_t page = (size_t)sysconf(_SC_PAGESIZE);
+ size_t end = (this->released / page) * page;
+ if (end > input->dropped) {
+  madvise(input->data + input->dropped, end - input->dropped, MADV_DONTNEED);
+  input->dropped = end;
+ }
+}
+
+
+_Bool 
+    FileInput_map( FileInput* this ) {
+ struct stat info;
+ int fd = fileno(this->file);
+
+ if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode) || info.st_size == 0) {return 0;}
+ size_t size = (size_t)info.st_size;
+ size_t page = (size_t)sysconf(_SC_PAGESIZE);
+ size_t mapped = (size / page + 1) * page;
+
+
+
+ char* data = (char*)mmap(NULL, mapped, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+ if (data == MAP_FAILED) {return 0;}
+ if (mmap(data, size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+  munmap(data, mapped);
+  return 0;
+ }
+ madvise(data, size, MADV_SEQUENTIAL);
+ this->data = data;
+ this->size = size;
+ this->mapped = mapped;
+ return 1;
+}
+
 size_t FileInput_preload( Iterator* this ) {
 
 
@@ -1059,7 +2076,9 @@ size_t FileInput_preload( Iterator* this ) {
  size_t left = this->available - read;
  size_t until_eob = this->capacity - read;
  ;;
- assert (left < this->capacity);
+
+
+ assert (left <= this->capacity);
 
 
 
@@ -1068,22 +2087,34 @@ size_t FileInput_preload( Iterator* this ) {
 
 
 
+
+  size_t base = Iterator_textOffset(this);
+  size_t dropped = this->released > base ? this->released - base : 0;
+  if (dropped >= 64000) {
+   ;
+   memmove(this->buffer, this->buffer + dropped, this->available - dropped);
+   this->current -= dropped;
+   this->available -= dropped;
+   until_eob += dropped;
+  }
   size_t delta = this->current - this->buffer;
+  if (until_eob < 64000) {
 
-  this->capacity += 64000;
+   this->capacity += 64000;
 
-  assert(this->capacity + 1 > 0);
-  ;
+   assert(this->capacity + 1 > 0);
+   ;
 
 
-  this->buffer=gc_realloc(this->buffer,this->capacity + 1); ;
-  assert(this->buffer != NULL);
+   this->buffer=gc_realloc(this->buffer,this->capacity + 1); ;
+   assert(this->buffer != NULL);
 
-  this->current = this->buffer + delta;
+   this->current = this->buffer + delta;
+  }
 
   this->buffer[this->capacity] = '\0';
 
-  size_t to_read = this->capacity - left;
+  size_t to_read = this->capacity - this->available;
   size_t read = fread((char*)this->buffer + this->available, sizeof(char), to_read, input->file);
   this->available += read;
   left += read;
@@ -1099,25 +2130,22 @@ size_t FileInput_preload( Iterator* this ) {
 }
 
 
-_Bool 
-    FileInput_move ( Iterator* this, int n ) {
+
+static inline 
+             _Bool 
+                  Iterator__moveBuffered( Iterator* this, int n, size_t (*preload)(Iterator*) ) {
  if ( n == 0) {
 
   return 1;
  } else if ( n >= 0 ) {
 
 
-  size_t left = FileInput_preload(this);
+  size_t left = preload(this);
   if (left > 0) {
    int c = n > left ? left : n;
 
-
-   while (c > 0) {
-    this->current++;
-    this->offset++;
-    if (*(this->current) == this->separator) {this->lines++;}
-    c--;
-   }
+   this->current += c;
+   this->offset += c;
    ;;
    if (n>left) {
     this->status = '.';
@@ -1135,8 +2163,7 @@ _Bool
 
 
  
-
-  n = ((int)this->capacity )+ n < 0 ? 0 - (int)this->capacity : n;
+  n = (n > (int)(this->buffer - this->current) ? n : (int)(this->buffer - this->current));
   this->current = (((char*)this->current) + n);
   this->offset += n;
   if (n!=0) {this->status = '~';}
@@ -1147,56 +2174,192 @@ _Bool
 }
 
 
+_Bool 
+    FileInput_move ( Iterator* this, int n ) {
+ return Iterator__moveBuffered(this, n, FileInput_preload);
+}
 
 
 
 
 
-Grammar* Grammar_new(void) {
- Grammar* this = (Grammar*) gc_new(sizeof(Grammar)); assert (this!=NULL); ;
- this->axiom = NULL;
- this->skip = NULL;
- this->axiomCount = 0;
- this->skipCount = 0;
- this->elements = NULL;
- this->isVerbose = 0;
- return this;
-}
 
-void Grammar_setVerbose ( Grammar* this ) {
- this->isVerbose = 1;
+
+static ssize_t ReaderInput__readFD(char* data, size_t length, void* context) {
+ ReaderInput* input = (ReaderInput*)context;
+ ssize_t count = -1;
+ do {
+  count = read(input->fd, data, length);
+ } while (count < 0 && errno == EINTR);
+ return count;
 }
 
-void Grammar_setSilent ( Grammar* this ) {
- this->isVerbose = 0;
+ReaderInput* ReaderInput_new(ReaderCallback read, void* context) {
+ ReaderInput* this = (ReaderInput*) gc_new(sizeof(ReaderInput)); assert (this!=NULL); ;
+ assert(this != NULL);
+ this->read = read != NULL ? read : ReaderInput__readFD;
+ this->context = read != NULL ? context : (void*)this;
+ this->fd = -1;
+ this->closeFD = 0;
+ this->error = 0;
+ return this;
 }
 
-int Grammar_symbolsCount(Grammar* this) {
- return this->axiomCount + this->skipCount;
+void ReaderInput_free(void* this) {
+ ;
+ ReaderInput* self = (ReaderInput*) this;
+ if (self != NULL && self->closeFD && self->fd >= 0) { close(self->fd); }
+ if (this!=NULL) {; gc_free(this); } ;
 }
 
-void Grammar_freeElements(Grammar* this) {
- if (this->elements == NULL) {
-  Grammar_prepare(this);
- }
- int count = (this->axiomCount + this->skipCount);
- if (this->elements != NULL) {
+size_t ReaderInput_preload( Iterator* this ) {
+ ReaderInput* input = (ReaderInput*)this->input;
 
-  for (int i = 0; i < count + 1 ; i++ ) {
-   Element* element = this->elements[i];
-   if (element == NULL) {
-    ;;
-   } else if (ParsingElement_Is(element)) {
-    ParsingElement* e = (ParsingElement*)element;
-    ;
-    ParsingElement_free(e);
-   } else {
-    Reference* r = (Reference*)element;
+
+ while (Iterator_remaining(this) < 64000 && this->status != '.') {
+
+
+  size_t base = Iterator_textOffset(this);
+  size_t dropped = this->released > base ? this->released - base : 0;
+  if (dropped >= 64000) {
+   ;
+   memmove(this->buffer, this->buffer + dropped, this->available - dropped);
+   this->current -= dropped;
+   this->available -= dropped;
+  }
+
+
+  if (this->capacity - this->available < (1024 * 1024)) {
+   size_t delta = this->current - this->buffer;
+   this->capacity = (this->capacity * 2 > this->available + (1024 * 1024) ? this->capacity * 2 : this->available + (1024 * 1024));
+   ;
+   this->buffer=gc_realloc(this->buffer,this->capacity + 1); ;
+   assert(this->buffer != NULL);
+   this->current = this->buffer + delta;
+  }
+  ssize_t read = input->read(this->buffer + this->available, this->capacity - this->available, input->context);
+  if (read > 0) {
+   this->available += (size_t)read;
+  } else {
+
+   if (read < 0) {input->error = errno;}
+   ;;
+   this->status = '.';
+  }
+  this->buffer[this->available] = '\0';
+ }
+ return Iterator_remaining(this);
+}
+
+
+_Bool 
+    ReaderInput_move ( Iterator* this, int n ) {
+ return Iterator__moveBuffered(this, n, ReaderInput_preload);
+}
+
+
+
+
+
+
+
+Grammar* Grammar_new(void) {
+ Grammar* this = (Grammar*) gc_new(sizeof(Grammar)); assert (this!=NULL); ;
+ this->axiom = NULL;
+ this->skip = NULL;
+ this->axiomCount = 0;
+ this->skipCount = 0;
+ this->elements = NULL;
+ this->isVerbose = 0;
+ this->isMemoized = 0;
+ this->isVM = 0;
+ this->program = NULL;
+ this->keys = NULL;
+ this->keysCount = 0;
+ this->stats = NULL;
+ return this;
+}
+
+void Grammar_setVerbose ( Grammar* this ) {
+ this->isVerbose = 1;
+}
+
+void Grammar_setSilent ( Grammar* this ) {
+ this->isVerbose = 0;
+}
+
+void Grammar_enableMemoize ( Grammar* this ) {
+ this->isMemoized = 1;
+}
+
+void Grammar_disableMemoize ( Grammar* this ) {
+ this->isMemoized = 0;
+}
+
+void Grammar_enableVM ( Grammar* this ) {
+ this->isVM = 1;
+}
+
+void Grammar_disableVM ( Grammar* this ) {
+ this->isVM = 0;
+}
+
+void Grammar_enableProfiling ( Grammar* this ) {
+ if (this->stats != NULL) {return;}
+ this->stats = ParsingStats_new();
+ if (this->elements != NULL) {
+  ParsingStats_setSymbolsCount(this->stats, this->axiomCount + this->skipCount + 1);
+ }
+}
+
+void Grammar_disableProfiling ( Grammar* this ) {
+ ParsingStats_free(this->stats);
+ this->stats = NULL;
+}
+
+int Grammar_key ( Grammar* this, const char* name ) {
+ if (this->keys == NULL) {
+  char** keys = (char**) gc_calloc(1, sizeof(char*)) ; assert (keys!=NULL); ;
+  this->keys = keys;
+  this->keys[0] = gc_strdup("depth") ; assert (this->keys[0]!=NULL); ;
+  this->keysCount = 1;
+ }
+ for (int i=0 ; i<this->keysCount ; i++) {
+  if (strcmp(this->keys[i], name) == 0) {return i;}
+ }
+ this->keys=gc_realloc(this->keys,(size_t)(this->keysCount + 1) * sizeof(char*)); ;
+ this->keys[this->keysCount] = gc_strdup(name) ; assert (this->keys[this->keysCount]!=NULL); ;
+ return this->keysCount++;
+}
+
+int Grammar_symbolsCount(Grammar* this) {
+ return this->axiomCount + this->skipCount;
+}
+
+void Grammar_freeElements(Grammar* this) {
+ if (this->elements == NULL) {
+  Grammar_prepare(this);
+ }
+ int count = (this->axiomCount + this->skipCount);
+ if (this->elements != NULL) {
+
+  for (int i = 0; i < count + 1 ; i++ ) {
+   Element* element = this->elements[i];
+   if (element == NULL) {
+    ;;
+   } else if (ParsingElement_Is(element)) {
+    ParsingElement* e = (ParsingElement*)element;
+    ;
+    ParsingElement_free(e);
+   } else {
+    Reference* r = (Reference*)element;
     ;
     Reference_free(r);
    }
   }
  }
+ ParsingProgram_free(this->program);
+ this->program = NULL;
  this->axiomCount = 0;
  this->skipCount = 0;
  this->skip = NULL;
@@ -1207,23 +2370,35 @@ void Grammar_freeElements(Grammar* this) {
 
 void Grammar_free(Grammar* this) {
  Grammar_freeElements(this);
+ for (int i=0 ; i<this->keysCount ; i++) {
+  if (this->keys[i]!=NULL) {; gc_free(this->keys[i]); } ;
+ }
+ if (this->keys!=NULL) {; gc_free(this->keys); } ;
+ ParsingStats_free(this->stats);
  if (this!=NULL) {; gc_free(this); } ;
 }
-
-
-
-
-
-
+Match* Match__new(ParsingArena* arena) {
+ if (arena == NULL) {return Match_new();}
+ Match* this = (Match*)ParsingArena_alloc(arena, sizeof(Match));
+ this->status = '-';
+ this->flags = 0x1;
+ this->offset = 0;
+ this->length = 0;
+ this->element = NULL;
+ this->data = NULL;
+ this->next = NULL;
+ this->children = NULL;
+ this->parent = NULL;
+ this->result = NULL;
+ return this;
+}
 
 Match* Match__Success(size_t length, Element* element, ParsingContext* context) {
- Match* this = Match_new();
+ Match* this = Match__new(context->arena);
  assert( element != NULL );
  this->status = 'M';
  this->offset = context->iterator->offset;
  this->length = length;
-
- this->line = context->iterator->lines;
  this->element = (Element*)element;
  this->data = NULL;
  this->next = NULL;
@@ -1244,9 +2419,9 @@ Match* Match_new(void) {
  Match* this = (Match*) gc_new(sizeof(Match)); assert (this!=NULL); ;
 
  this->status = '-';
+ this->flags = 0;
  this->offset = 0;
  this->length = 0;
- this->line = 0;
  this->element = NULL;
  this->data = NULL;
  this->next = NULL;
@@ -1257,7 +2432,7 @@ Match* Match_new(void) {
 }
 
 inline void Match_free__specialized(Match* this, ParsingElement* element) {
- assert(ParsingElement_Is(this->element));
+ assert(element == NULL || ParsingElement_Is(element));
  if (element!=NULL && this!=NULL){
   switch (element->type) {
    case 'T':
@@ -1268,9 +2443,8 @@ inline void Match_free__specialized(Match* this, ParsingElement* element) {
 }
 
 
-
 void* Match_free(Match* this) {
- if (this!=NULL && this!=FAILURE) {
+ if (this!=NULL && this!=FAILURE && !(this->flags & 0x1)) {
   ;
 
 
@@ -1413,7 +2587,21 @@ int Match_countChildren(Match* this) {
  }
  return count;
 }
-void Match__childrenWriteJSON(Match* match, int fd, int flags) {
+
+
+
+
+static inline Match* Match__share(Match* this, ParsingArena* arena) {
+ Match* copy = Match__new(arena);
+ copy->status = this->status;
+ copy->offset = this->offset;
+ copy->length = this->length;
+ copy->element = this->element;
+ copy->data = this->data;
+ copy->children = this->children;
+ return copy;
+}
+void Match__childrenWriteJSON(Match* match, Writer* writer, int flags) {
  int count = 0 ;
  Match* child = match->children;
  while (child != NULL) {
@@ -1428,9 +2616,9 @@ void Match__childrenWriteJSON(Match* match, int fd, int flags) {
  while (child != NULL) {
   ParsingElement* element = ParsingElement_Ensure(child->element);
   if (element->type != 'p' && element->type != 'c') {
-   Match__writeJSON(child, fd, flags);
+   Match__writeJSON(child, writer, flags);
    if ( (i+1) < count ) {
-    dprintf(fd,"%s",",");
+    Writer_print(writer, ",");
    }
    i += 1;
   }
@@ -1438,9 +2626,9 @@ void Match__childrenWriteJSON(Match* match, int fd, int flags) {
  }
 }
 
-void Match__writeJSON(Match* match, int fd, int flags) {
+void Match__writeJSON(Match* match, Writer* writer, int flags) {
  if (match == NULL || match->element == NULL) {
-  dprintf(fd,"%s","null");
+  Writer_print(writer, "null");
   return;
  }
 
@@ -1449,61 +2637,60 @@ void Match__writeJSON(Match* match, int fd, int flags) {
  if (element->type == '#') {
   Reference* ref = (Reference*)match->element;
   if (ref->cardinality == '1' || ref->cardinality == '=' || ref->cardinality == '?') {
-   Match__writeJSON(match->children, fd, flags);
+   Match__writeJSON(match->children, writer, flags);
   } else {
-   dprintf(fd,"%s","[");
-   Match__childrenWriteJSON(match, fd, flags);
-   dprintf(fd,"%s","]");
+   Writer_print(writer, "[");
+   Match__childrenWriteJSON(match, writer, flags);
+   Writer_print(writer, "]");
   }
  }
  else if (element->type != '#') {
 
   int i = 0;
   int count = 0;
-  char* word = NULL;
+  size_t length = 0;
+  const char* slice = NULL;
   switch(element->type) {
    case 'W':
-    word = String_escape(Word_word(element));
-    if (element->name) {dprintf(fd,"%s","{\"name\":\"");dprintf(fd,"%s",element->name);dprintf(fd,"%s","\"");} else {dprintf(fd,"%s","{\"id\":");dprintf(fd,"%d",element->id);};
-    dprintf(fd,"%s",",\"value\":\"");dprintf(fd,"%s",word);dprintf(fd,"%s","\"");
-    dprintf(fd,"%s","}");
-    free(word);
+    slice = Word_word(element);
+    if (element->name) {Writer_print(writer, "{\"name\":\"");Writer_print(writer, element->name);Writer_print(writer, "\"");} else {Writer_print(writer, "{\"id\":");Writer_printf(writer, "%d", element->id);};
+    Writer_print(writer, ",\"value\":\"");Writer_printEscaped(writer, slice, strlen(slice));Writer_print(writer, "\"");
+    Writer_print(writer, "}");
     break;
    case 'T':
     count = TokenMatch_count(match);
     if (count == 0) {
-     if (element->name) {dprintf(fd,"%s","{\"name\":\"");dprintf(fd,"%s",element->name);dprintf(fd,"%s","\"");} else {dprintf(fd,"%s","{\"id\":");dprintf(fd,"%d",element->id);};
-     dprintf(fd,"%s","}");
+     if (element->name) {Writer_print(writer, "{\"name\":\"");Writer_print(writer, element->name);Writer_print(writer, "\"");} else {Writer_print(writer, "{\"id\":");Writer_printf(writer, "%d", element->id);};
+     Writer_print(writer, "}");
     } else if (count == 1) {
-     if (element->name) {dprintf(fd,"%s","{\"name\":\"");dprintf(fd,"%s",element->name);dprintf(fd,"%s","\"");} else {dprintf(fd,"%s","{\"id\":");dprintf(fd,"%d",element->id);};
-     word = String_escape(TokenMatch_group(match, 0));
-     dprintf(fd,"%s",",\"value\":\"");dprintf(fd,"%s",word);dprintf(fd,"%s","\"");
-     free(word);
-     dprintf(fd,"%s","}");
+     if (element->name) {Writer_print(writer, "{\"name\":\"");Writer_print(writer, element->name);Writer_print(writer, "\"");} else {Writer_print(writer, "{\"id\":");Writer_printf(writer, "%d", element->id);};
+
+     slice = TokenMatch_slice(match, 0, &length);
+     Writer_print(writer, ",\"value\":\"");Writer_printEscaped(writer, slice, length);Writer_print(writer, "\"");
+     Writer_print(writer, "}");
     } else {
-     if (element->name) {dprintf(fd,"%s","{\"name\":\"");dprintf(fd,"%s",element->name);dprintf(fd,"%s","\"");} else {dprintf(fd,"%s","{\"id\":");dprintf(fd,"%d",element->id);};
-     dprintf(fd,"%s",",\"content\":[");
+     if (element->name) {Writer_print(writer, "{\"name\":\"");Writer_print(writer, element->name);Writer_print(writer, "\"");} else {Writer_print(writer, "{\"id\":");Writer_printf(writer, "%d", element->id);};
+     Writer_print(writer, ",\"content\":[");
      for (i=0 ; i < count ; i++) {
-      word = String_escape(TokenMatch_group(match, i));
-      dprintf(fd,"%s","\"");dprintf(fd,"%s",word);dprintf(fd,"%s","\"");
-      if (i+1 < count) {dprintf(fd,"%s",",");}
-      free(word);
+      slice = TokenMatch_slice(match, i, &length);
+      Writer_print(writer, "\"");Writer_printEscaped(writer, slice, length);Writer_print(writer, "\"");
+      if (i+1 < count) {Writer_print(writer, ",");}
      }
-     dprintf(fd,"%s","]");
-     dprintf(fd,"%s","}");
+     Writer_print(writer, "]");
+     Writer_print(writer, "}");
     }
     break;
    case 'G':
    case 'R':
     if (match->children == NULL) {
-     if (element->name) {dprintf(fd,"%s","{\"name\":\"");dprintf(fd,"%s",element->name);dprintf(fd,"%s","\"");} else {dprintf(fd,"%s","{\"id\":");dprintf(fd,"%d",element->id);};
-     dprintf(fd,"%s","}");
+     if (element->name) {Writer_print(writer, "{\"name\":\"");Writer_print(writer, element->name);Writer_print(writer, "\"");} else {Writer_print(writer, "{\"id\":");Writer_printf(writer, "%d", element->id);};
+     Writer_print(writer, "}");
     } else {
-     if (element->name) {dprintf(fd,"%s","{\"name\":\"");dprintf(fd,"%s",element->name);dprintf(fd,"%s","\"");} else {dprintf(fd,"%s","{\"id\":");dprintf(fd,"%d",element->id);};
-     dprintf(fd,"%s",",\"content\":[");
-     Match__childrenWriteJSON(match, fd, flags);
-     dprintf(fd,"%s","]");
-     dprintf(fd,"%s","}");
+     if (element->name) {Writer_print(writer, "{\"name\":\"");Writer_print(writer, element->name);Writer_print(writer, "\"");} else {Writer_print(writer, "{\"id\":");Writer_printf(writer, "%d", element->id);};
+     Writer_print(writer, ",\"content\":[");
+     Match__childrenWriteJSON(match, writer, flags);
+     Writer_print(writer, "]");
+     Writer_print(writer, "}");
     }
     break;
    case 'p':
@@ -1511,22 +2698,28 @@ void Match__writeJSON(Match* match, int fd, int flags) {
    case 'c':
     break;
    default:
-    dprintf(fd,"\"ERROR:undefined element type=%c\"",element->type);
+    Writer_printf(writer, "\"ERROR:undefined element type=%c\"", element->type);
   }
  } else {
-  dprintf(fd,"\"ERROR:unsupported element type=%c\"",element->type);
+  Writer_printf(writer, "\"ERROR:unsupported element type=%c\"", element->type);
  }
 }
 
+void Match_dumpJSON(Match* this, Writer* writer) {
+ Match__writeJSON(this, writer, 0);
+}
+
 void Match_writeJSON(Match* this, int fd) {
- Match__writeJSON(this, fd, 0);
+ Writer* writer = Writer_FromFD(fd);
+ Match__writeJSON(this, writer, 0);
+ Writer_free(writer);
 }
 
 
 void Match_printJSON(Match* this) {
  return Match_writeJSON(this, 1);
 }
-void Match__childrenWriteXML(Match* match, int fd, int flags) {
+void Match__childrenWriteXML(Match* match, Writer* writer, int flags) {
  int count = 0 ;
  Match* child = match->children;
  while (child != NULL) {
@@ -1541,14 +2734,14 @@ void Match__childrenWriteXML(Match* match, int fd, int flags) {
  while (child != NULL) {
   ParsingElement* element = ParsingElement_Ensure(child->element);
   if (element->type != 'p' && element->type != 'c') {
-   Match__writeXML(child, fd, flags);
+   Match__writeXML(child, writer, flags);
    i += 1;
   }
   child = child->next;
  }
 }
 
-void Match__writeXML(Match* match, int fd, int flags) {
+void Match__writeXML(Match* match, Writer* writer, int flags) {
  if (match == NULL || match->element == NULL) {
   return;
  }
@@ -1557,21 +2750,23 @@ void Match__writeXML(Match* match, int fd, int flags) {
  if (element->type == '#') {
   Reference* ref = (Reference*)match->element;
   if (ref->cardinality == '1' || ref->cardinality == '=' || ref->cardinality == '?') {
-   Match__writeXML(match->children, fd, flags);
+   Match__writeXML(match->children, writer, flags);
   } else {
-   Match__childrenWriteXML(match, fd, flags);
+   Match__childrenWriteXML(match, writer, flags);
   }
  }
 
  else if (element->type != '#') {
   int i = 0;
   int count = 0;
+  size_t length = 0;
+  const char* slice = NULL;
   switch(element->type) {
    case 'W':
     if (element->name != NULL) {
-     dprintf(fd,"%s","<");
-     if (element->name != NULL) { dprintf(fd,"%s",element->name); } else {dprintf(fd,"E%d",element->id);};
-     dprintf(fd,"%s","/>");
+     Writer_print(writer, "<");
+     if (element->name != NULL) { Writer_print(writer, element->name); } else {Writer_printf(writer, "E%d", element->id);};
+     Writer_print(writer, "/>");
     } else {
 
 
@@ -1581,29 +2776,32 @@ void Match__writeXML(Match* match, int fd, int flags) {
     count = TokenMatch_count(match);
     if (count == 0) {
      if (element->name != NULL) {
-      dprintf(fd,"%s","<");
-      if (element->name != NULL) { dprintf(fd,"%s",element->name); } else {dprintf(fd,"E%d",element->id);};
-      dprintf(fd,"%s","/>");
+      Writer_print(writer, "<");
+      if (element->name != NULL) { Writer_print(writer, element->name); } else {Writer_printf(writer, "E%d", element->id);};
+      Writer_print(writer, "/>");
      }
     } else if (count == 1) {
+
+     slice = TokenMatch_slice(match, i, &length);
      if (element->name != NULL) {
-      dprintf(fd,"%s","<");
-      if (element->name != NULL) { dprintf(fd,"%s",element->name); } else {dprintf(fd,"E%d",element->id);};
-      dprintf(fd,"%s"," t=\"");
-      dprintf(fd,"%s",TokenMatch_group(match, i));
-      dprintf(fd,"%s","\"/>");
+      Writer_print(writer, "<");
+      if (element->name != NULL) { Writer_print(writer, element->name); } else {Writer_printf(writer, "E%d", element->id);};
+      Writer_print(writer, " t=\"");
+      Writer_write(writer, slice, length);
+      Writer_print(writer, "\"/>");
      } else {
-      dprintf(fd,"%s",TokenMatch_group(match, i));
+      Writer_write(writer, slice, length);
      }
     } else {
      if (element->name != NULL) {
-      if (element->name != NULL) {dprintf(fd,"%s","<") ; if (element->name != NULL) { dprintf(fd,"%s",element->name); } else {dprintf(fd,"E%d",element->id);} ; dprintf(fd,"%s",">");};
+      if (element->name != NULL) {Writer_print(writer, "<") ; if (element->name != NULL) { Writer_print(writer, element->name); } else {Writer_printf(writer, "E%d", element->id);} ; Writer_print(writer, ">");};
       for (i=0 ; i < count ; i++) {
-       dprintf(fd,"%s","<g t=\"");
-       dprintf(fd,"%s",TokenMatch_group(match, i));
-       dprintf(fd,"%s","\"/>");
+       slice = TokenMatch_slice(match, i, &length);
+       Writer_print(writer, "<g t=\"");
+       Writer_write(writer, slice, length);
+       Writer_print(writer, "\"/>");
       }
-      if (element->name != NULL) {dprintf(fd,"%s","</") ; if (element->name != NULL) { dprintf(fd,"%s",element->name); } else {dprintf(fd,"E%d",element->id);} ; dprintf(fd,"%s",">");};
+      if (element->name != NULL) {Writer_print(writer, "</") ; if (element->name != NULL) { Writer_print(writer, element->name); } else {Writer_printf(writer, "E%d", element->id);} ; Writer_print(writer, ">");};
      } else {
 
      }
@@ -1614,11 +2812,11 @@ void Match__writeXML(Match* match, int fd, int flags) {
 
     } else {
      if (element->name != NULL) {
-      if (element->name != NULL) {dprintf(fd,"%s","<") ; if (element->name != NULL) { dprintf(fd,"%s",element->name); } else {dprintf(fd,"E%d",element->id);} ; dprintf(fd,"%s",">");};
-      Match__writeXML(match->children, fd, flags);
-      if (element->name != NULL) {dprintf(fd,"%s","</") ; if (element->name != NULL) { dprintf(fd,"%s",element->name); } else {dprintf(fd,"E%d",element->id);} ; dprintf(fd,"%s",">");};
+      if (element->name != NULL) {Writer_print(writer, "<") ; if (element->name != NULL) { Writer_print(writer, element->name); } else {Writer_printf(writer, "E%d", element->id);} ; Writer_print(writer, ">");};
+      Match__writeXML(match->children, writer, flags);
+      if (element->name != NULL) {Writer_print(writer, "</") ; if (element->name != NULL) { Writer_print(writer, element->name); } else {Writer_printf(writer, "E%d", element->id);} ; Writer_print(writer, ">");};
      } else {
-      Match__writeXML(match->children, fd, flags);
+      Match__writeXML(match->children, writer, flags);
      }
     }
     break;
@@ -1626,11 +2824,11 @@ void Match__writeXML(Match* match, int fd, int flags) {
     if (match->children == NULL) {
     } else {
      if (element->name != NULL) {
-      if (element->name != NULL) {dprintf(fd,"%s","<") ; if (element->name != NULL) { dprintf(fd,"%s",element->name); } else {dprintf(fd,"E%d",element->id);} ; dprintf(fd,"%s",">");};
-      Match__childrenWriteXML(match, fd, flags);
-      if (element->name != NULL) {dprintf(fd,"%s","</") ; if (element->name != NULL) { dprintf(fd,"%s",element->name); } else {dprintf(fd,"E%d",element->id);} ; dprintf(fd,"%s",">");};
+      if (element->name != NULL) {Writer_print(writer, "<") ; if (element->name != NULL) { Writer_print(writer, element->name); } else {Writer_printf(writer, "E%d", element->id);} ; Writer_print(writer, ">");};
+      Match__childrenWriteXML(match, writer, flags);
+      if (element->name != NULL) {Writer_print(writer, "</") ; if (element->name != NULL) { Writer_print(writer, element->name); } else {Writer_printf(writer, "E%d", element->id);} ; Writer_print(writer, ">");};
      } else {
-      Match__childrenWriteXML(match, fd, flags);
+      Match__childrenWriteXML(match, writer, flags);
      }
     }
     break;
@@ -1639,10 +2837,10 @@ void Match__writeXML(Match* match, int fd, int flags) {
    case 'c':
     break;
    default:
-    dprintf(fd,"<error value=\"Undefined element type\" type=\"%c\" />",element->type);
+    Writer_printf(writer, "<error value=\"Undefined element type\" type=\"%c\" />", element->type);
   }
  } else {
-  dprintf(fd,"<error t=\"Unsupported element type\" type=\"%c\" />",element->type);
+  Writer_printf(writer, "<error t=\"Unsupported element type\" type=\"%c\" />", element->type);
  }
 }
 
@@ -1650,9 +2848,15 @@ void Match_printXML(Match* this) {
  Match_writeXML(this, 1);
 }
 
+void Match_dumpXML(Match* this, Writer* writer) {
+ Writer_print(writer, "<?xml version=\"1.0\" encoding=\"UTF-8\" standalone=\"no\" ?>\n");
+ Match__writeXML(this, writer, 0);
+}
+
 void Match_writeXML(Match* this, int fd ) {
- dprintf(fd,"%s","<?xml version=\"1.0\" encoding=\"UTF-8\" standalone=\"no\" ?>\n");
- Match__writeXML(this, fd, 0);
+ Writer* writer = Writer_FromFD(fd);
+ Match_dumpXML(this, writer);
+ Writer_free(writer);
 }
 
 
@@ -1661,108 +2865,674 @@ void Match_writeXML(Match* this, int fd ) {
 
 
 
+static inline void Writer__varint( Writer* this, uint64_t value ) {
+ char bytes[10];
+ int n = 0;
+ while (value >= 0x80) {
+  bytes[n++] = (char)((value & 0x7F) | 0x80);
+  value >>= 7;
+ }
+ bytes[n++] = (char)value;
+ Writer_write(this, bytes, n);
+}
 
-_Bool 
-    ParsingElement_Is(void *this) {
- if (this == NULL) { return 0; }
- switch (((ParsingElement*)this)->type) {
 
-  case 'E':
-  case 'W':
-  case 'T':
-  case 'G':
-  case 'R':
-  case 'c':
-  case 'p':
+static inline void Writer__svarint( Writer* this, int64_t value ) {
+ Writer__varint(this, ((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+}
+
+static inline 
+             _Bool 
+                  Binary__varint( const char** data, const char* end, uint64_t* value ) {
+ const unsigned char* p = (const unsigned char*)*data;
+ uint64_t result = 0;
+ int shift = 0;
+ while ((const char*)p < end && shift < 64) {
+  unsigned char c = *p++;
+  result |= ((uint64_t)(c & 0x7F)) << shift;
+  if ((c & 0x80) == 0) {
+   *data = (const char*)p;
+   *value = result;
    return 1;
-  default:
-   return 0;
+  }
+  shift += 7;
  }
+ return 0;
 }
 
-ParsingElement* ParsingElement_Ensure(void* elementOrReference) {
- void * element = elementOrReference;
- assert(element!=NULL);
- assert(Reference_Is(element) || ParsingElement_Is(element));
- return Reference_Is(element) ? ((Reference*)element)->element : (ParsingElement*)element;
+static inline 
+             _Bool 
+                  Binary__svarint( const char** data, const char* end, int64_t* value ) {
+ uint64_t v = 0;
+ if (!Binary__varint(data, end, &v)) {return 0;}
+ *value = (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+ return 1;
 }
 
-ParsingElement* ParsingElement_new(Reference* children[]) {
- ParsingElement* this = (ParsingElement*) gc_new(sizeof(ParsingElement)); assert (this!=NULL); ;
- this->type = 'E';
- this->id = -10;
- this->name = NULL;
- this->config = NULL;
- this->children = NULL;
- this->recognize = NULL;
- this->process = NULL;
- if (children != NULL && *children != NULL) {
-  Reference* r = Reference_Ensure(*children);
-  while ( r != NULL ) {
-   ;
+static void Match__writeBinaryNode( Match* this, Writer* writer, size_t previous ) {
+ Element* element = this->element;
+ size_t children = 0;
+ for (Match* child = this->children ; child != NULL ; child = child->next) {children++;}
+ 
+_Bool 
+         groups = element->type == 'T' && this->data != NULL;
+ Writer__varint(writer, (uint64_t)element->id);
+ Writer__svarint(writer, (int64_t)this->offset - (int64_t)previous);
+ Writer__varint(writer, this->length);
+ Writer__varint(writer, (children << 1) | (groups ? 1 : 0));
+ if (groups) {
+  TokenMatch* token = (TokenMatch*)this->data;
+  Writer__varint(writer, (uint64_t)token->count);
+  for (int i=0 ; i<token->count ; i++) {
+   int start = token->spans[i * 2];
+   int end = token->spans[i * 2 + 1];
+   Writer__varint(writer, start < 0 ? 0 : (uint64_t)start + 1);
+   Writer__varint(writer, start < 0 ? 0 : (uint64_t)(end - start));
+  }
+ }
+}
 
-   ParsingElement_add(this, r);
-   r = *(++children);
+void Match_writeBinary(Match* this, Writer* writer) {
+ size_t start = writer->flushed + writer->length;
+ Writer_write(writer, "LPT\x01", 4);
+ size_t nodes = 0;
+
+
+ Element** elements = NULL;
+ int elementsCount = 0;
+ Match** stack = NULL;
+ size_t depth = 0;
+ size_t capacity = 0;
+ size_t previous = 0;
+ Match* match = Match_isSuccess(this) ? this : NULL;
+ while (match != NULL) {
+  Element* element = match->element;
+  assert(element != NULL && element->id >= 0);
+  if (element->id >= elementsCount) {
+   int count = (element->id + 1 > elementsCount * 2 ? element->id + 1 : elementsCount * 2);
+   elements=gc_realloc(elements,count * sizeof(Element*)); ;
+   memset(elements + elementsCount, 0, sizeof(Element*) * (count - elementsCount));
+   elementsCount = count;
+  }
+  elements[element->id] = element;
+  Match__writeBinaryNode(match, writer, previous);
+  previous = match->offset;
+  nodes++;
+
+
+  if (match->children != NULL) {
+   if (depth == capacity) {
+    capacity = capacity == 0 ? 64 : capacity * 2;
+    stack=gc_realloc(stack,capacity * sizeof(Match*)); ;
+   }
+   stack[depth++] = match == this ? NULL : match->next;
+   match = match->children;
+  } else {
+   match = match == this ? NULL : match->next;
+   while (match == NULL && depth > 0) {match = stack[--depth];}
   }
  }
+ if (stack!=NULL) {; gc_free(stack); } ;
+
+
+ size_t table = writer->flushed + writer->length - start;
+ Writer__varint(writer, nodes);
+ int names = 0;
+ for (int i=0 ; i<elementsCount ; i++) {if (elements[i] != NULL) {names++;}}
+ Writer__varint(writer, (uint64_t)names);
+ for (int i=0 ; i<elementsCount ; i++) {
+  Element* element = elements[i];
+  if (element == NULL) {continue;}
+  const char* name = element->name == NULL ? "" : element->name;
+  size_t length = strlen(name);
+  Writer__varint(writer, (uint64_t)i);
+  Writer_write(writer, &element->type, 1);
+  Writer__varint(writer, length);
+
+  Writer_write(writer, name, length + 1);
+ }
+ if (elements!=NULL) {; gc_free(elements); } ;
+ unsigned char footer[8];
+ for (int i=0 ; i<8 ; i++) {footer[i] = (unsigned char)(((uint64_t)table >> (i * 8)) & 0xFF);}
+ Writer_write(writer, (const char*)footer, 8);
+}
+
+MatchReader* MatchReader_new(const char* data, size_t length) {
+ if (data == NULL || length < 4 + 8 || memcmp(data, "LPT\x01", 4) != 0) {return NULL;}
+ uint64_t table = 0;
+ for (int i=0 ; i<8 ; i++) {table |= ((uint64_t)(unsigned char)data[length - 8 + i]) << (i * 8);}
+ if (table < 4 || table > length - 8) {return NULL;}
+ const char* p = data + table;
+ const char* end = data + length - 8;
+ uint64_t nodes = 0;
+ uint64_t names = 0;
+ if (!Binary__varint(&p, end, &nodes) || !Binary__varint(&p, end, &names)) {return NULL;}
+ MatchReader* this = (MatchReader*) gc_new(sizeof(MatchReader)); assert (this!=NULL); ;
+ this->data = data;
+ this->length = length;
+ this->position = 4;
+ this->end = (size_t)table;
+ this->count = (size_t)nodes;
+ this->read = 0;
+ this->offset = 0;
+ this->names = NULL;
+ this->types = NULL;
+ this->namesCount = 0;
+ this->spans = NULL;
+ this->spansCount = 0;
+ for (uint64_t i=0 ; i<names ; i++) {
+  uint64_t id = 0;
+  uint64_t size = 0;
+  if (!Binary__varint(&p, end, &id) || id > INT_MAX || p >= end) {MatchReader_free(this); return NULL;}
+  char type = *p++;
+  if (!Binary__varint(&p, end, &size) || size >= (uint64_t)(end - p) || p[size] != '\0') {MatchReader_free(this); return NULL;}
+  if ((int)id >= this->namesCount) {
+   int count = ((int)id + 1 > this->namesCount * 2 ? (int)id + 1 : this->namesCount * 2);
+   this->names=gc_realloc(this->names,count * sizeof(const char*)); ;
+   this->types=gc_realloc(this->types,count * sizeof(char)); ;
+   memset(this->names + this->namesCount, 0, sizeof(const char*) * (count - this->namesCount));
+   memset(this->types + this->namesCount, 0, sizeof(char) * (count - this->namesCount));
+   this->namesCount = count;
+  }
+  this->names[id] = p;
+  this->types[id] = type;
+  p += size + 1;
+ }
  return this;
 }
 
-void ParsingElement_freeChildren( ParsingElement* this ) {
+void MatchReader_free(MatchReader* this) {
  if (this == NULL) {return;}
- Reference* child = this->children;
- while (child != NULL) {
-  Reference* next = child->next;
-  assert(Reference_Is(child));
-  Reference_free(child);
-  child = next;
+ if (this->names!=NULL) {; gc_free(this->names); } ;
+ if (this->types!=NULL) {; gc_free(this->types); } ;
+ if (this->spans!=NULL) {; gc_free(this->spans); } ;
+ if (this!=NULL) {; gc_free(this); } ;
+}
+
+
+_Bool 
+    MatchReader_next(MatchReader* this, MatchNode* node) {
+ if (this->read >= this->count) {return 0;}
+ const char* p = this->data + this->position;
+ const char* end = this->data + this->end;
+ uint64_t id = 0;
+ int64_t delta = 0;
+ uint64_t length = 0;
+ uint64_t children = 0;
+ if (!Binary__varint(&p, end, &id) || !Binary__svarint(&p, end, &delta) || !Binary__varint(&p, end, &length) || !Binary__varint(&p, end, &children)) {return 0;}
+ if (id >= (uint64_t)this->namesCount || this->names[id] == NULL) {return 0;}
+ if (delta < 0 && (uint64_t)(-delta) > this->offset) {return 0;}
+ if (delta > 0 && (uint64_t)delta > SIZE_MAX - this->offset) {return 0;}
+
+ if (((children & 1) != 0) != (this->types[id] == 'T')) {return 0;}
+ node->id = (int)id;
+ node->type = this->types[id];
+ node->name = this->names[id];
+ node->offset = (size_t)((int64_t)this->offset + delta);
+ node->length = (size_t)length;
+ node->children = (size_t)(children >> 1);
+ if (node->length > SIZE_MAX - node->offset) {return 0;}
+ node->groups = 0;
+ node->spans = NULL;
+ if (children & 1) {
+  uint64_t count = 0;
+  if (!Binary__varint(&p, end, &count) || count == 0 || count > (uint64_t)(end - p)) {return 0;}
+  if ((int)count * 2 > this->spansCount) {
+   this->spansCount = (int)count * 2;
+   this->spans=gc_realloc(this->spans,this->spansCount * sizeof(int)); ;
+  }
+  for (uint64_t i=0 ; i<count ; i++) {
+   uint64_t start = 0;
+   uint64_t size = 0;
+   if (!Binary__varint(&p, end, &start) || !Binary__varint(&p, end, &size)) {return 0;}
+
+   if (start > 0 && (start - 1 > length || size > length - (start - 1) || length > INT_MAX)) {return 0;}
+   this->spans[i * 2] = start == 0 ? -1 : (int)(start - 1);
+   this->spans[i * 2 + 1] = start == 0 ? -1 : (int)(start - 1 + size);
+  }
+  node->groups = (int)count;
+  node->spans = this->spans;
  }
+ this->offset = node->offset;
+ this->position = (size_t)(p - this->data);
+ this->read++;
+ return 1;
 }
 
+Match* Match_readBinary(ParsingContext* context, const char* data, size_t length) {
+ MatchReader* reader = MatchReader_new(data, length);
+ if (reader == NULL) {return NULL;}
+ Grammar* grammar = context->grammar;
+ int elements = grammar->axiomCount + grammar->skipCount + 1;
 
-void ParsingElement_free(ParsingElement* this) {
+ for (int i=0 ; i<reader->namesCount ; i++) {
+  if (reader->names[i] == NULL) {continue;}
+  Element* element = i < elements ? grammar->elements[i] : NULL;
+  if (element == NULL || element->type != reader->types[i] || strcmp(element->name == NULL ? "" : element->name, reader->names[i]) != 0) {
+   MatchReader_free(reader);
+   return NULL;
+  }
+ }
 
 
- if (this == NULL) {return;}
- switch (this->type) {
-  case 'T':
-   Token_free(this);
-   break;
-  case 'W':
-   Word_free(this);
-   break;
-  default:
-   if (this!=NULL) {if (this->name!=NULL) {; gc_free(this->name); } };
-   if (this!=NULL) {; gc_free(this); } ;
+ typedef struct {Match* match; size_t remaining; Match* last;} Parent;
+ Parent* stack = NULL;
+ size_t depth = 0;
+ size_t capacity = 0;
+ Match* root = FAILURE;
+ MatchNode node;
+ size_t read = 0;
+
+ Iterator* iterator = context->iterator;
+ size_t input = iterator == NULL ? SIZE_MAX : Iterator_textOffset(iterator) + iterator->available;
+ while (MatchReader_next(reader, &node)) {
+  if (node.offset + node.length > input) {break;}
+  Match* match = Match__new(context->arena);
+  match->status = 'M';
+  match->offset = node.offset;
+  match->length = node.length;
+  match->element = grammar->elements[node.id];
+  if (node.spans != NULL) {
+   TokenMatch* token = TokenMatch__new(context->arena, context->iterator, node.groups);
+   memcpy(token->spans, node.spans, sizeof(int) * node.groups * 2);
+   match->data = token;
+  }
+  if (depth == 0) {
+   if (read > 0) {break;}
+   root = match;
+  } else {
+   Parent* parent = &stack[depth - 1];
+   if (parent->last == NULL) {parent->match->children = match;} else {parent->last->next = match;}
+   parent->last = match;
+   parent->remaining--;
+  }
+  read++;
+  if (node.children > 0) {
+   if (depth == capacity) {
+    capacity = capacity == 0 ? 64 : capacity * 2;
+    stack=gc_realloc(stack,capacity * sizeof(Parent)); ;
+   }
+   stack[depth].match = match;
+   stack[depth].remaining = node.children;
+   stack[depth].last = NULL;
+   depth++;
+  }
+  while (depth > 0 && stack[depth - 1].remaining == 0) {depth--;}
  }
+ 
+_Bool 
+     complete = read == reader->count && depth == 0;
+ if (stack!=NULL) {; gc_free(stack); } ;
+ MatchReader_free(reader);
+ return complete ? root : NULL;
 }
 
-ParsingElement* ParsingElement_insert(ParsingElement* this, int index, Reference* child) {
- assert(!Reference_hasNext(child));
- assert(child->next == NULL);
- assert(child->element->recognize!=NULL);
- assert(index >= 0);
- if (index == 0) {
-  child->next = this->children;
-  this->children = child;
- } else {
-  Reference* current = this->children;
-  Reference* previous = NULL;
-  while (current && index > 0) {
-   previous = current;
-   current = current->next;
-   index -= 1;
+ParsingResult* Grammar_readBinary( Grammar* this, Iterator* iterator, const char* data, size_t length ) {
+ if (this->elements == NULL) {Grammar_prepare(this);}
+ ParsingContext* context = ParsingContext_new(this, iterator);
+ Match* match = Match_readBinary(context, data, length);
+ if (match == NULL) {
+  ParsingContext_free(context);
+  return NULL;
+ }
+ if (Match_isSuccess(match)) {Iterator_moveTo(iterator, match->offset + match->length);}
+ return ParsingResult_new(match, context);
+}
+static void MatchTree__reserve( MatchTree* this ) {
+ if (this->count < this->capacity) {return;}
+ this->capacity = this->capacity == 0 ? 1024 : this->capacity * 2;
+ this->offsets=gc_realloc(this->offsets,(size_t)this->capacity * sizeof(uint32_t)); ;
+ this->lengths=gc_realloc(this->lengths,(size_t)this->capacity * sizeof(uint32_t)); ;
+ this->elements=gc_realloc(this->elements,(size_t)this->capacity * sizeof(int32_t)); ;
+ this->children=gc_realloc(this->children,(size_t)this->capacity * sizeof(int32_t)); ;
+ this->next=gc_realloc(this->next,(size_t)this->capacity * sizeof(int32_t)); ;
+}
+
+
+
+static inline int MatchTree__add( MatchTree* this, Match* match ) {
+ if (match->offset + match->length > UINT32_MAX || this->count == INT32_MAX) {return -1;}
+ MatchTree__reserve(this);
+ int node = this->count++;
+ this->offsets[node] = (uint32_t)match->offset;
+ this->lengths[node] = (uint32_t)match->length;
+ this->elements[node] = match->element->id;
+ this->children[node] = -1;
+ this->next[node] = -1;
+ return node;
+}
+
+typedef struct MatchTreeFrame {
+ Match* match;
+ int parent;
+ int previous;
+} MatchTreeFrame;
+
+MatchTree* MatchTree_new(Match* match, Grammar* grammar) {
+ if (!Match_isSuccess(match)) {return NULL;}
+ MatchTree* this = (MatchTree*) gc_new(sizeof(MatchTree)); assert (this!=NULL); ;
+ this->offsets = NULL;
+ this->lengths = NULL;
+ this->elements = NULL;
+ this->children = NULL;
+ this->next = NULL;
+ this->count = 0;
+ this->capacity = 0;
+ this->grammar = grammar;
+
+
+ MatchTreeFrame* stack = NULL;
+ size_t depth = 0;
+ size_t capacity = 0;
+ 
+_Bool 
+                valid = MatchTree__add(this, match) == 0;
+ if (valid && match->children != NULL) {
+  capacity = 64;
+  stack=gc_realloc(stack,capacity * sizeof(MatchTreeFrame)); ;
+  stack[depth++] = (MatchTreeFrame){match->children, 0, -1};
+ }
+ while (valid && depth > 0) {
+  MatchTreeFrame* frame = &stack[depth - 1];
+  Match* child = frame->match;
+  if (child == NULL) {depth--; continue;}
+  int node = MatchTree__add(this, child);
+  if (node < 0) {valid = 0; break;}
+  if (frame->previous < 0) {this->children[frame->parent] = node;}
+  else {this->next[frame->previous] = node;}
+  frame->previous = node;
+  frame->match = child->next;
+  if (child->children != NULL) {
+   if (depth == capacity) {
+    capacity *= 2;
+    stack=gc_realloc(stack,capacity * sizeof(MatchTreeFrame)); ;
+   }
+   stack[depth++] = (MatchTreeFrame){child->children, node, -1};
   }
-  assert (index == 0);
-  assert (current != NULL);
-  assert (previous != NULL);
-  previous->next = child;
-  child->next = current;
  }
+ if (stack!=NULL) {; gc_free(stack); } ;
+ if (!valid) {
+  MatchTree_free(this);
+  return NULL;
+ }
+
+ this->capacity = this->count;
+ this->offsets=gc_realloc(this->offsets,(size_t)this->capacity * sizeof(uint32_t)); ;
+ this->lengths=gc_realloc(this->lengths,(size_t)this->capacity * sizeof(uint32_t)); ;
+ this->elements=gc_realloc(this->elements,(size_t)this->capacity * sizeof(int32_t)); ;
+ this->children=gc_realloc(this->children,(size_t)this->capacity * sizeof(int32_t)); ;
+ this->next=gc_realloc(this->next,(size_t)this->capacity * sizeof(int32_t)); ;
  return this;
 }
 
-ParsingElement* ParsingElement_replace(ParsingElement* this, int index, Reference* child) {
+void MatchTree_free(MatchTree* this) {
+ if (this == NULL) {return;}
+ if (this->offsets!=NULL) {; gc_free(this->offsets); } ;
+ if (this->lengths!=NULL) {; gc_free(this->lengths); } ;
+ if (this->elements!=NULL) {; gc_free(this->elements); } ;
+ if (this->children!=NULL) {; gc_free(this->children); } ;
+ if (this->next!=NULL) {; gc_free(this->next); } ;
+ if (this!=NULL) {; gc_free(this); } ;
+}
+
+int MatchTree_getOffset(MatchTree* this, int node) {
+ return node >= 0 ? (int)this->offsets[node] : -1;
+}
+
+int MatchTree_getLength(MatchTree* this, int node) {
+ return node >= 0 ? (int)this->lengths[node] : 0;
+}
+
+int MatchTree_getEndOffset(MatchTree* this, int node) {
+ return node >= 0 ? (int)(this->offsets[node] + this->lengths[node]) : -1;
+}
+
+int MatchTree_getElementID(MatchTree* this, int node) {
+ return node >= 0 ? this->elements[node] : -1;
+}
+
+Element* MatchTree_getElement(MatchTree* this, int node) {
+ return node >= 0 ? this->grammar->elements[this->elements[node]] : NULL;
+}
+
+ParsingElement* MatchTree_getParsingElement(MatchTree* this, int node) {
+ Element* element = MatchTree_getElement(this, node);
+ return element != NULL ? ParsingElement_Ensure(element) : NULL;
+}
+
+const char* MatchTree_getElementName(MatchTree* this, int node) {
+ Element* element = MatchTree_getElement(this, node);
+ return element != NULL ? element->name : NULL;
+}
+
+
+_Bool 
+    MatchTree_hasNext(MatchTree* this, int node) {
+ return node >= 0 && this->next[node] >= 0;
+}
+
+int MatchTree_getNext(MatchTree* this, int node) {
+ return node >= 0 ? this->next[node] : -1;
+}
+
+
+_Bool 
+    MatchTree_hasChildren(MatchTree* this, int node) {
+ return node >= 0 && this->children[node] >= 0;
+}
+
+int MatchTree_getChildren(MatchTree* this, int node) {
+ return node >= 0 ? this->children[node] : -1;
+}
+
+int MatchTree_countChildren(MatchTree* this, int node) {
+ int count = 0;
+ for (int child = MatchTree_getChildren(this, node) ; child >= 0 ; child = this->next[child]) {
+  count++;
+ }
+ return count;
+}
+static 
+      _Bool 
+           MatchBuffer__walk( MatchBuffer* this, Match* match ) {
+ size_t capacity = 64;
+ size_t depth = 0;
+ MatchTreeFrame* stack = (MatchTreeFrame*) gc_calloc(capacity, sizeof(MatchTreeFrame)) ; assert (stack!=NULL); ;
+ stack[depth++] = (MatchTreeFrame){match, -1, -1};
+ int32_t count = 0;
+ int32_t spans = 0;
+ 
+_Bool 
+        valid = 1;
+ while (depth > 0) {
+  MatchTreeFrame* frame = &stack[depth - 1];
+  Match* node = frame->match;
+  if (node == NULL) {depth--; continue;}
+
+  frame->match = frame->parent < 0 ? NULL : node->next;
+  int groups = node->element->type == 'T' && node->data != NULL ? ((TokenMatch*)node->data)->count : 0;
+  if (node->offset + node->length > INT32_MAX || count == INT32_MAX || spans > INT32_MAX - groups * 2) {
+   valid = 0;
+   break;
+  }
+  if (this->records != NULL) {
+   MatchRecord* record = &this->records[count];
+   record->type = node->element->type;
+   record->id = node->element->id;
+   record->offset = (int32_t)node->offset;
+   record->length = (int32_t)node->length;
+   record->parent = frame->parent;
+   record->next = -1;
+   record->groups = groups;
+   record->spans = spans;
+   if (frame->previous >= 0) {this->records[frame->previous].next = count;}
+   for (int i=0 ; i<groups ; i++) {
+    int start = ((TokenMatch*)node->data)->spans[i * 2];
+    int end = ((TokenMatch*)node->data)->spans[i * 2 + 1];
+    this->spans[spans + i * 2] = start < 0 ? -1 : record->offset + start;
+    this->spans[spans + i * 2 + 1] = start < 0 ? -1 : record->offset + end;
+   }
+  }
+  frame->previous = count;
+  count++;
+  spans += groups * 2;
+  if (node->children != NULL) {
+   if (depth == capacity) {
+    capacity *= 2;
+    stack=gc_realloc(stack,capacity * sizeof(MatchTreeFrame)); ;
+   }
+   stack[depth++] = (MatchTreeFrame){node->children, count - 1, -1};
+  }
+ }
+ if (stack!=NULL) {; gc_free(stack); } ;
+ this->count = count;
+ this->spansCount = spans;
+ return valid;
+}
+
+MatchBuffer* MatchBuffer_new(Match* match) {
+ if (!Match_isSuccess(match)) {return NULL;}
+ MatchBuffer* this = (MatchBuffer*) gc_new(sizeof(MatchBuffer)); assert (this!=NULL); ;
+ this->data = NULL;
+ this->size = 0;
+ this->records = NULL;
+ this->spans = NULL;
+ this->count = 0;
+ this->spansCount = 0;
+
+
+ if (!MatchBuffer__walk(this, match)) {
+  MatchBuffer_free(this);
+  return NULL;
+ }
+ this->size = sizeof(MatchRecord) * (size_t)this->count + sizeof(int32_t) * (size_t)this->spansCount;
+ char* data = (char*) gc_calloc(this->size, sizeof(char)) ; assert (data!=NULL); ;
+ this->data = data;
+ this->records = (MatchRecord*)data;
+ this->spans = (int32_t*)(data + sizeof(MatchRecord) * (size_t)this->count);
+ MatchBuffer__walk(this, match);
+ return this;
+}
+
+void MatchBuffer_free(MatchBuffer* this) {
+ if (this == NULL) {return;}
+ if (this->data!=NULL) {; gc_free(this->data); } ;
+ if (this!=NULL) {; gc_free(this); } ;
+}
+
+
+
+
+
+
+
+
+_Bool 
+    ParsingElement_Is(void *this) {
+ if (this == NULL) { return 0; }
+ switch (((ParsingElement*)this)->type) {
+
+  case 'E':
+  case 'W':
+  case 'T':
+  case 'G':
+  case 'R':
+  case 'c':
+  case 'p':
+   return 1;
+  default:
+   return 0;
+ }
+}
+
+ParsingElement* ParsingElement_Ensure(void* elementOrReference) {
+ void * element = elementOrReference;
+ assert(element!=NULL);
+ assert(Reference_Is(element) || ParsingElement_Is(element));
+ return Reference_Is(element) ? ((Reference*)element)->element : (ParsingElement*)element;
+}
+
+ParsingElement* ParsingElement_new(Reference* children[]) {
+ ParsingElement* this = (ParsingElement*) gc_new(sizeof(ParsingElement)); assert (this!=NULL); ;
+ this->type = 'E';
+ this->id = -10;
+ this->name = NULL;
+ this->config = NULL;
+ this->children = NULL;
+ this->recognize = NULL;
+ this->process = NULL;
+ this->freeMatch = NULL;
+ this->flags = 0;
+ if (children != NULL && *children != NULL) {
+  Reference* r = Reference_Ensure(*children);
+  while ( r != NULL ) {
+   ;
+
+   ParsingElement_add(this, r);
+   r = *(++children);
+  }
+ }
+ return this;
+}
+
+void ParsingElement_freeChildren( ParsingElement* this ) {
+ if (this == NULL) {return;}
+ Reference* child = this->children;
+ while (child != NULL) {
+  Reference* next = child->next;
+  assert(Reference_Is(child));
+  Reference_free(child);
+  child = next;
+ }
+}
+
+
+void ParsingElement_free(ParsingElement* this) {
+
+
+ if (this == NULL) {return;}
+ switch (this->type) {
+  case 'T':
+   Token_free(this);
+   break;
+  case 'W':
+   Word_free(this);
+   break;
+  case 'G':
+   Group_free(this);
+   break;
+  default:
+   if (this!=NULL) {if (this->name!=NULL) {; gc_free(this->name); } };
+   if (this!=NULL) {; gc_free(this); } ;
+ }
+}
+
+ParsingElement* ParsingElement_insert(ParsingElement* this, int index, Reference* child) {
+ assert(!Reference_hasNext(child));
+ assert(child->next == NULL);
+ assert(child->element->recognize!=NULL);
+ assert(index >= 0);
+ if (index == 0) {
+  child->next = this->children;
+  this->children = child;
+ } else {
+  Reference* current = this->children;
+  Reference* previous = NULL;
+  while (current && index > 0) {
+   previous = current;
+   current = current->next;
+   index -= 1;
+  }
+  assert (index == 0);
+  assert (current != NULL);
+  assert (previous != NULL);
+  previous->next = child;
+  child->next = current;
+ }
+ return this;
+}
+
+ParsingElement* ParsingElement_replace(ParsingElement* this, int index, Reference* child) {
  assert(!Reference_hasNext(child));
  assert(child->next == NULL);
  assert(child->element->recognize!=NULL);
@@ -1821,14 +3591,123 @@ Match* ParsingElement_process( ParsingElement* this, Match* match ) {
  return match;
 }
 
+
+_Bool 
+    ParsingElement_isMemoizable( ParsingElement* this ) {
+
+
+ if (this->id < 0) {return 0;}
+ if ((this->flags & 0x2) || (this->flags & 0x8) || (this->flags & 0x10)) {return 0;}
+ switch (this->type) {
+  case 'T':
+  case 'G':
+  case 'R':
+   return 1;
+  default:
+   return 0;
+ }
+}
+
+ParsingElement* ParsingElement_disableMemoize( ParsingElement* this ) {
+ this->flags=this->flags|0x2;;
+ return this;
+}
+
+ParsingElement* ParsingElement_disableFailMemoize( ParsingElement* this ) {
+ this->flags=this->flags|0x4;;
+ return this;
+}
+
+static Match* ParsingElement__recognizeLean( ParsingElement* this, ParsingContext* context );
+
+
+
+static inline Match* ParsingElement__recognize( ParsingElement* this, ParsingContext* context, const 
+                                                                                                    _Bool 
+                                                                                                         trace ) {
+ ParsingArenaMark mark = ParsingArena_mark(context->arena);
+ Match* match = trace ? this->recognize(this, context) : ParsingElement__recognizeLean(this, context);
+ if (!Match_isSuccess(match)) {ParsingArena_rewind(context->arena, mark);}
+ return match;
+}
+
+
+static inline Match* ParsingElement__memoize( ParsingElement* this, ParsingContext* context, const 
+                                                                                                  _Bool 
+                                                                                                       trace ) {
+ ParsingMemo* memo = context->memo;
+ if (memo == NULL || !ParsingElement_isMemoizable(this)) {
+  return ParsingElement__recognize(this, context, trace);
+ }
+ Iterator* iterator = context->iterator;
+ size_t offset = iterator->offset;
+ ParsingMemoEntry* entry = ParsingMemo_get(memo, this->id, offset);
+ if (entry != NULL) {
+
+
+
+
+  if (entry->match == NULL) {
+   if(trace && context->grammar->isVerbose && !(context->flags & 0x1)){fprintf(stdout, " !  %s└ Memo %s#%d failed at %zu:%zu", context->indent, this->name, this->id, Iterator_line(iterator), offset);fprintf(stdout, "\n");;};
+   return FAILURE;
+  } else {
+   Match* match = Match__share(entry->match, context->arena);
+   if (entry->end != offset) {Iterator_moveTo(iterator, entry->end);}
+   if(trace && context->grammar->isVerbose && !(context->flags & 0x1)){fprintf(stdout, "[✓] %s└ Memo %s#%d matched %zu:%zu-%zu", context->indent, this->name, this->id, Iterator_line(iterator), offset, entry->end);fprintf(stdout, "\n");;};
+   return ParsingContext__registerMatch(context, match);
+  }
+ }
+ Match* match = ParsingElement__recognize(this, context, trace);
+ if (Match_isSuccess(match) || !(this->flags & 0x4)) {
+  ParsingMemo_set(memo, this->id, offset, iterator->offset, match);
+ }
+ return match;
+}
+
+
+
+
+static Match* ParsingElement__profile( ParsingElement* this, ParsingContext* context ) {
+ ParsingStats* stats = context->stats;
+ size_t offset = context->iterator->offset;
+ double start = ParsingStats_now();
+ Match* match = ParsingElement__memoize(this, context, 1);
+ if (this->id >= 0 && (size_t)this->id < stats->symbolsCount) {
+  stats->attemptsBySymbol[this->id] += 1;
+  stats->timeBySymbol[this->id] += ParsingStats_now() - start;
+  if (Match_isSuccess(match)) {
+   stats->bytesBySymbol[this->id] += context->iterator->offset - offset;
+  } else if (offset >= stats->failureOffset) {
+
+
+   stats->failureOffset = offset;
+   stats->failureElement = (Element*)this;
+  }
+ }
+ return ParsingStats_registerMatch(stats, (Element*)this, match);
+}
+
+Match* ParsingElement_recognize( ParsingElement* this, ParsingContext* context ) {
+ if ((context->flags & 0x4)) {
+  return ParsingElement__profile(this, context);
+ } else if ((context->flags & 0x8)) {
+  return ParsingElement__memoize(this, context, 1);
+ } else {
+  return ParsingElement__memoize(this, context, 0);
+ }
+}
+
 size_t ParsingElement_skip( ParsingElement* this, ParsingContext* context) {
  if (this == NULL || context == NULL || context->grammar->skip == NULL || context->flags & 0x1) {return 0;}
  context->flags=context->flags|0x1;;
  ParsingElement* skip = context->grammar->skip;
  size_t offset = context->iterator->offset;
 
- Match* match = skip->recognize(skip, context);
+
+ ParsingArenaMark mark = ParsingArena_mark(context->arena);
+ Match* match = ParsingElement_recognize(skip, context);
  match = Match_free(match);
+ ParsingArena_rewind(context->arena, mark);
  size_t skipped = context->iterator->offset - offset;
  if (skipped > 0) {
   if(context->grammar->isVerbose){fprintf(stdout, " %s   ►►►skipped %zu", context->indent, skipped);fprintf(stdout, "\n");;}
@@ -1993,7 +3872,33 @@ int Reference__walk( Reference* this, ElementWalkingCallback callback, int step,
  return step;
 }
 
-Match* Reference_recognize(Reference* this, ParsingContext* context) {
+
+
+
+static inline int ParsingContext__enterChoice( ParsingContext* context ) {
+ int cut = context->flags & 0x2;
+ context->flags = context->flags & ~0x2;;
+ context->choices += 1;
+ return cut;
+}
+
+
+
+static inline 
+             _Bool 
+                  ParsingContext__leaveChoice( ParsingContext* context, int cut ) {
+ 
+_Bool 
+     committed = (context->flags & 0x2) ? 1 : 0;
+ if (!committed) {context->choices -= 1;}
+ context->flags = context->flags & ~0x2;;
+ context->flags=context->flags|cut;;
+ return committed;
+}
+
+static inline __attribute__((always_inline)) Match* Reference__recognize(Reference* this, ParsingContext* context, const 
+                                                                                      _Bool 
+                                                                                           trace) {
 
 
 
@@ -2003,9 +3908,14 @@ Match* Reference_recognize(Reference* this, ParsingContext* context) {
  Match* result = FAILURE;
  Match* tail = NULL;
  int count = 0;
- int offset = context->iterator->offset;
- int match_end_offset = offset;
- size_t match_end_lines = context->iterator->lines;
+ size_t offset = context->iterator->offset;
+ size_t match_end_offset = offset;
+ 
+_Bool 
+       is_choice = this->cardinality != '1';
+ 
+_Bool 
+       committed = 0;
 
 
 
@@ -2018,21 +3928,23 @@ Match* Reference_recognize(Reference* this, ParsingContext* context) {
 
   ;
   if (this->cardinality != '1' && this->cardinality != '?') {
-   if(context->grammar->isVerbose && !(context->flags & 0x1)){fprintf(stdout, "   %s ├┈" "\033[1m\033[33m" "[%d](%c)" "\033[0m", context->indent, count, this->cardinality);fprintf(stdout, "\n");;}
+   if(trace && context->grammar->isVerbose && !(context->flags & 0x1)){fprintf(stdout, "   %s ├┈" "\033[1m\033[33m" "[%d](%c)" "\033[0m", context->indent, count, this->cardinality);fprintf(stdout, "\n");;}
 
     ;
   }
 
 
-  int iteration_offset = context->iterator->offset;
-  Match* match = this->element->recognize(this->element, context);
-  int parsed = context->iterator->offset - iteration_offset;
+  size_t iteration_offset = context->iterator->offset;
+  int cut = is_choice ? ParsingContext__enterChoice(context) : 0;
+  Match* match = ParsingElement_recognize(this->element, context);
+  size_t parsed = context->iterator->offset - iteration_offset;
+  
+ _Bool 
+        is_cut = is_choice ? ParsingContext__leaveChoice(context, cut) : 0;
 
 
   if (Match_isSuccess(match)) {
-   match_end_offset = Match_getEndOffset(match);
-
-   match_end_lines = context->iterator->lines;
+   match_end_offset = match->offset + match->length;
    if (count == 0) {
 
 
@@ -2062,6 +3974,11 @@ Match* Reference_recognize(Reference* this, ParsingContext* context) {
 
    match = Match_free(match);
 
+   if (is_cut) {
+    committed = 1;
+    break;
+   }
+
 
    size_t skipped = ParsingElement_skip((ParsingElement*)this, context);
 
@@ -2080,7 +3997,12 @@ Match* Reference_recognize(Reference* this, ParsingContext* context) {
 
  if (context->iterator->offset != match_end_offset) {
 
-  Iterator_backtrack(context->iterator, match_end_offset, match_end_lines);
+  Iterator_backtrack(context->iterator, match_end_offset);
+ }
+
+ if (committed) {
+  result = Match_fail(result);
+  return (trace ? ParsingContext_registerMatch(context, (Element*)this, FAILURE) : (FAILURE));
  }
 
  ;;
@@ -2107,14 +4029,14 @@ _Bool
   case '=':
    if (is_success && result->length == 0) {
     result = Match_fail(result);
-    return ParsingContext_registerMatch(context, (Element*)this, result);
+    return (trace ? ParsingContext_registerMatch(context, (Element*)this, result) : (result));
    }
    break;
   default:
 
    fprintf(stderr, "ERR ");fprintf(stderr, "Unsupported cardinality %c", this->cardinality);fprintf(stderr, "\n");;
    result = Match_fail(result);
-   return ParsingContext_registerMatch(context, (Element*)this, result);
+   return (trace ? ParsingContext_registerMatch(context, (Element*)this, result) : (result));
  }
 
 
@@ -2124,21 +4046,23 @@ _Bool
 
 
 
-  int length = context->iterator->offset - offset;
+  size_t length = context->iterator->offset - offset;
   Match* m = Match_SuccessFromReference(length, this, context);
 
   m->children = result == FAILURE ? NULL : result;
   m->offset = offset;
   assert(m->children == NULL || m->children->element != NULL);
 
-  return ParsingContext_registerMatch(context, (Element*)this, m);
+  return (trace ? ParsingContext_registerMatch(context, (Element*)this, m) : (m));
  } else {
 
   result = Match_fail(result);
-  return ParsingContext_registerMatch(context, (Element*)this, FAILURE);
+  return (trace ? ParsingContext_registerMatch(context, (Element*)this, FAILURE) : (FAILURE));
  }
 }
 
+Match* Reference_recognize(Reference* this, ParsingContext* context) {return Reference__recognize(this, context, 1);} static Match* Reference__recognizeLean(Reference* this, ParsingContext* context) {return Reference__recognize(this, context, 0);}
+
 
 
 
@@ -2156,7 +4080,6 @@ ParsingElement* Word_new(const char* word) {
 
 
  config->word = gc_strdup(word) ; assert (config->word!=NULL); ;
- assert(config->length>0);
  this->config = config;
  assert(this->config != NULL);
  assert(this->recognize != NULL);
@@ -2181,22 +4104,28 @@ const char* Word_word(ParsingElement* this) {
  return ((WordConfig*)this->config)->word;
 }
 
-Match* Word_recognize(ParsingElement* this, ParsingContext* context) {
+static inline __attribute__((always_inline)) Match* Word__recognize(ParsingElement* this, ParsingContext* context, const 
+                                                                                      _Bool 
+                                                                                           trace) {
  WordConfig* config = ((WordConfig*)this->config);
- if (strncmp(config->word, context->iterator->current, config->length) == 0) {
 
 
-  Match* success = ParsingContext_registerMatch(context, (Element*)this, Match_Success(config->length, this, context));
+ if (config->length <= Iterator_remaining(context->iterator) && memcmp(config->word, context->iterator->current, config->length) == 0) {
+
+
+  Match* success = ParsingContext__registerMatch(context, Match_Success(config->length, this, context));
  
   context->iterator->move(context->iterator, config->length);
-  if(context->grammar->isVerbose && !(context->flags & 0x1)){fprintf(stdout, "[✓] %s└ Word %s#%d:`" "\033[36m" "%s" "\033[0m" "` matched %zu:%zu-%zu[→%d]", context->indent, this->name, this->id, ((WordConfig*)this->config)->word, context->iterator->lines, context->iterator->offset - config->length, context->iterator->offset, context->depth);fprintf(stdout, "\n");;};
+  if(trace && context->grammar->isVerbose && !(context->flags & 0x1)){fprintf(stdout, "[✓] %s└ Word %s#%d:`" "\033[36m" "%s" "\033[0m" "` matched %zu:%zu-%zu[→%d]", context->indent, this->name, this->id, ((WordConfig*)this->config)->word, Iterator_line(context->iterator), context->iterator->offset - config->length, context->iterator->offset, context->depth);fprintf(stdout, "\n");;};
   return success;
  } else {
-  if(context->grammar->isVerbose && !(context->flags & 0x1)){fprintf(stdout, " !  %s└ Word %s#%d:" "\033[36m" "`%s`" "\033[0m" " failed at %zu:%zu[→%d]", context->indent, this->name, this->id, ((WordConfig*)this->config)->word, context->iterator->lines, context->iterator->offset, context->depth);fprintf(stdout, "\n");;};
-  return ParsingContext_registerMatch(context, (Element*)this, FAILURE);
+  if(trace && context->grammar->isVerbose && !(context->flags & 0x1)){fprintf(stdout, " !  %s└ Word %s#%d:" "\033[36m" "`%s`" "\033[0m" " failed at %zu:%zu[→%d]", context->indent, this->name, this->id, ((WordConfig*)this->config)->word, Iterator_line(context->iterator), context->iterator->offset, context->depth);fprintf(stdout, "\n");;};
+  return ParsingContext__registerMatch(context, FAILURE);
  }
 }
 
+Match* Word_recognize(ParsingElement* this, ParsingContext* context) {return Word__recognize(this, context, 1);} static Match* Word__recognizeLean(ParsingElement* this, ParsingContext* context) {return Word__recognize(this, context, 0);}
+
 const char* WordMatch_group(Match* match) {
  return ((WordConfig*)((ParsingElement*)match->element)->config)->word;
 }
@@ -2266,8 +4195,30 @@ const char* Token_expr(ParsingElement* this) {
  return ((TokenConfig*)this->config)->expr;
 }
 
-Match* Token_recognize(ParsingElement* this, ParsingContext* context) {
- assert(this->config);
+
+
+TokenMatch* TokenMatch__new(ParsingArena* arena, Iterator* iterator, int count) {
+ TokenMatch* data = NULL;
+ if (arena == NULL) {
+  TokenMatch* m = (TokenMatch*) gc_new(sizeof(TokenMatch)); assert (m!=NULL); ;
+  int* spans = (int*) gc_calloc(count * 2, sizeof(int)) ; assert (spans!=NULL); ;
+  data = m;
+  data->spans = spans;
+ } else {
+  data = (TokenMatch*)ParsingArena_alloc(arena, sizeof(TokenMatch));
+  data->spans = (int*)ParsingArena_alloc(arena, sizeof(int) * count * 2);
+ }
+ data->count = count;
+ data->groups = NULL;
+ data->iterator = iterator;
+ data->arena = arena;
+ return data;
+}
+
+static inline __attribute__((always_inline)) Match* Token__recognize(ParsingElement* this, ParsingContext* context, const 
+                                                                                       _Bool 
+                                                                                            trace) {
+ assert(this->config);
  if(this->config == NULL) {return FAILURE;}
  Match* result = NULL;
 
@@ -2277,10 +4228,14 @@ Match* Token_recognize(ParsingElement* this, ParsingContext* context) {
  int vector[vector_length];
  const char* line = (const char*)context->iterator->current;
 
+
+ size_t remaining = Iterator_remaining(context->iterator);
+ int length = remaining > INT_MAX ? INT_MAX : (int)remaining;
+
  int r = pcre_exec(
   config->regexp, config->extra,
   line,
-  context->iterator->available,
+  length,
   0,
     PCRE_ANCHORED
   | PCRE_NO_UTF8_CHECK
@@ -2299,7 +4254,7 @@ Match* Token_recognize(ParsingElement* this, ParsingContext* context) {
    case PCRE_ERROR_NOMEMORY : fprintf(stderr, "ERR ");fprintf(stderr, "Token:%s Ran out of memory", config->expr);fprintf(stderr, "\n");; break;
    default : fprintf(stderr, "ERR ");fprintf(stderr, "Token:%s Unknown error", config->expr);fprintf(stderr, "\n");; break;
   };
-  if(context->grammar->isVerbose && !(context->flags & 0x1)){fprintf(stdout, "    %s└✘Token " "\033[1m\033[31m" "%s" "\033[0m" "#%d:`" "\033[36m" "%s" "\033[0m" "` failed at %zu:%zu", context->indent, this->name, this->id, config->expr, context->iterator->lines, context->iterator->offset);fprintf(stdout, "\n");;};
+  if(trace && context->grammar->isVerbose && !(context->flags & 0x1)){fprintf(stdout, "    %s└✘Token " "\033[1m\033[31m" "%s" "\033[0m" "#%d:`" "\033[36m" "%s" "\033[0m" "` failed at %zu:%zu", context->indent, this->name, this->id, config->expr, Iterator_line(context->iterator), context->iterator->offset);fprintf(stdout, "\n");;};
  } else {
   if(r == 0) {
    fprintf(stderr, "ERR ");fprintf(stderr, "Token: %s many substrings matched\n", config->expr);fprintf(stderr, "\n");;
@@ -2312,32 +4267,23 @@ Match* Token_recognize(ParsingElement* this, ParsingContext* context) {
   }
 
   result = Match_Success(vector[1], this, context);
-  if(context->grammar->isVerbose && !(context->flags & 0x1)){fprintf(stdout, "[✓] %s└ Token " "\033[1m\033[32m" "%s" "\033[0m" "#%d:" "\033[36m" "`%s`" "\033[0m" " matched " "\033[1m\033[32m" "%zu:%zu-%zu" "\033[0m", context->indent, this->name, this->id, config->expr, context->iterator->lines, context->iterator->offset, context->iterator->offset + result->length);fprintf(stdout, "\n");;};
-
-
-  TokenMatch* data = (TokenMatch*) gc_new(sizeof(TokenMatch)); assert (data!=NULL); ;
-  data->count = r;
-  const char** groups = (const char**) gc_calloc(r, sizeof(const char*)) ; assert (groups!=NULL); ;
-  data->groups = groups;
-
+  if(trace && context->grammar->isVerbose && !(context->flags & 0x1)){fprintf(stdout, "[✓] %s└ Token " "\033[1m\033[32m" "%s" "\033[0m" "#%d:" "\033[36m" "`%s`" "\033[0m" " matched " "\033[1m\033[32m" "%zu:%zu-%zu" "\033[0m", context->indent, this->name, this->id, config->expr, Iterator_line(context->iterator), context->iterator->offset, context->iterator->offset + result->length);fprintf(stdout, "\n");;};
 
 
-  for (int j=0 ; j<r ; j++) {
-   const char* substring;
 
-
-   pcre_get_substring(line, vector, r, j, &(substring));
-   data->groups[j] = substring;
-  }
+  TokenMatch* data = TokenMatch__new(context->arena, context->iterator, r);
+  memcpy(data->spans, vector, sizeof(int) * r * 2);
   result->data = data;
   context->iterator->move(context->iterator,result->length);
   assert (result->data != NULL);
   assert(Match_isSuccess(result));
  }
 
- return ParsingContext_registerMatch(context, (Element*)this, result);
+ return ParsingContext__registerMatch(context, result);
 }
 
+Match* Token_recognize(ParsingElement* this, ParsingContext* context) {return Token__recognize(this, context, 1);} static Match* Token__recognizeLean(ParsingElement* this, ParsingContext* context) {return Token__recognize(this, context, 0);}
+
 const char* TokenMatch_group(Match* match, int index) {
  assert (match != NULL);
  assert (match->data != NULL);
@@ -2346,12 +4292,58 @@ const char* TokenMatch_group(Match* match, int index) {
  if (m) {
   assert (index >= 0);
   assert (index < m->count);
+
+
+  if (m->groups == NULL) {
+   if (m->arena == NULL) {
+    const char** groups = (const char**) gc_calloc(m->count, sizeof(const char*)) ; assert (groups!=NULL); ;
+    m->groups = groups;
+   } else {
+    m->groups = (const char**)ParsingArena_allocPinned(m->arena, sizeof(const char*) * m->count);
+   }
+  }
+  if (m->groups[index] == NULL) {
+   size_t length = 0;
+   const char* slice = TokenMatch_slice(match, index, &length);
+   char* group = NULL;
+   if (m->arena == NULL) {
+    char* g = (char*) gc_calloc(length + 1, sizeof(char)) ; assert (g!=NULL); ;
+    group = g;
+   } else {
+    group = (char*)ParsingArena_allocPinned(m->arena, length + 1);
+   }
+   memcpy(group, slice, length);
+   group[length] = '\0';
+   m->groups[index] = group;
+  }
   return m->groups[index];
  } else {
   return NULL;
  }
 }
 
+const char* TokenMatch_slice(Match* match, int index, size_t* length) {
+ assert (match != NULL);
+ assert (match->data != NULL);
+ assert (Match_getElementType(match) == 'T');
+ TokenMatch* m = (TokenMatch*)match->data;
+ assert (index >= 0);
+ assert (index < m->count);
+ int start = m->spans[index * 2];
+ int end = m->spans[index * 2 + 1];
+
+
+
+ const char* text = m->iterator->buffer + (match->offset - Iterator_textOffset(m->iterator));
+ if (start < 0) {
+  *length = 0;
+  return text;
+ } else {
+  *length = (size_t)(end - start);
+  return text + start;
+ }
+}
+
 
 int TokenMatch_count(Match* match) {
  assert (match != NULL);
@@ -2374,20 +4366,18 @@ void Token_print(ParsingElement* this) {
 void TokenMatch_free(Match* match) {
  assert (match != NULL);
  assert (Match_getElementType(match) == 'T');
-
  ;;
- if (match->data != NULL) {
-  TokenMatch* m = (TokenMatch*)match->data;
-  if (m != NULL ) {
+ TokenMatch* m = (TokenMatch*)match->data;
+ if (m != NULL) {
+  if (m->groups != NULL) {
    for (int j=0 ; j<m->count ; j++) {
-    pcre_free_substring(m->groups[j]);
+    if ((char*)m->groups[j]!=NULL) {; gc_free((char*)m->groups[j]); } ;
    }
   }
   if (m->groups!=NULL) {; gc_free(m->groups); } ;
+  if (m->spans!=NULL) {; gc_free(m->spans); } ;
  }
-
  if (match->data!=NULL) {; gc_free(match->data); } ;
-
 }
 
 
@@ -2403,13 +4393,110 @@ ParsingElement* Group_new(Reference* children[]) {
  return this;
 }
 
-Match* Group_recognize(ParsingElement* this, ParsingContext* context){
+WordTrie* WordTrie_new(ParsingElement* group) {
+
+
+ int children = 0;
+ int bytes = 0;
+ Reference* child = group->children;
+ while (child != NULL) {
+  assert(child->element->type == 'W');
+  bytes += (int)((WordConfig*)child->element->config)->length;
+  children += 1;
+  child = child->next;
+ }
+ WordTrie* this = (WordTrie*) gc_new(sizeof(WordTrie)); assert (this!=NULL); ;
+ int* words = (int*) gc_calloc(bytes + 1, sizeof(int)) ; assert (words!=NULL); ;
+ int* edges = (int*) gc_calloc(bytes + 1, sizeof(int)) ; assert (edges!=NULL); ;
+ WordTrieEdge* links = (WordTrieEdge*) gc_calloc(bytes + 1, sizeof(WordTrieEdge)) ; assert (links!=NULL); ;
+ Reference** references = (Reference**) gc_calloc(children, sizeof(Reference*)) ; assert (references!=NULL); ;
+ this->words = words;
+ this->edges = edges;
+ this->links = links;
+ this->children = references;
+ this->count = 1;
+ words[0] = -1;
+ edges[0] = -1;
+ int link_count = 0;
+ int index = 0;
+ for (child = group->children ; child != NULL ; child = child->next, index++) {
+  WordConfig* config = (WordConfig*)child->element->config;
+  int node = 0;
+  references[index] = child;
+  for (size_t i=0 ; i<config->length ; i++) {
+   unsigned char c = (unsigned char)config->word[i];
+   int edge = edges[node];
+   while (edge >= 0 && links[edge].byte != c) {edge = links[edge].next;}
+   if (edge < 0) {
+
+    int target = this->count++;
+    words[target] = -1;
+    edges[target] = -1;
+    links[link_count] = (WordTrieEdge){c, target, edges[node]};
+    edges[node] = link_count++;
+    node = target;
+   } else {
+    node = links[edge].target;
+   }
+  }
+
+  if (words[node] < 0) {words[node] = index;}
+ }
+ return this;
+}
+
+void WordTrie_free(WordTrie* this) {
+ if (this != NULL) {
+  if (this->words!=NULL) {; gc_free(this->words); } ;
+  if (this->edges!=NULL) {; gc_free(this->edges); } ;
+  if (this->links!=NULL) {; gc_free(this->links); } ;
+  if (this->children!=NULL) {; gc_free(this->children); } ;
+ }
+ if (this!=NULL) {; gc_free(this); } ;
+}
+
+Reference* WordTrie_match(WordTrie* this, const char* text, size_t length) {
+
+
+
+ int best = this->words[0];
+ int node = 0;
+ for (size_t i=0 ; i<length ; i++) {
+  unsigned char c = (unsigned char)text[i];
+  int edge = this->edges[node];
+  while (edge >= 0 && this->links[edge].byte != c) {edge = this->links[edge].next;}
+  if (edge < 0) {break;}
+  node = this->links[edge].target;
+  int word = this->words[node];
+  if (word >= 0 && (best < 0 || word < best)) {best = word;}
+ }
+ return best < 0 ? NULL : this->children[best];
+}
+
+void Group__freeConfig(ParsingElement* this) {
+ GroupConfig* config = (GroupConfig*)this->config;
+ if (config != NULL) {
+  WordTrie_free(config->words);
+  if (config->candidates!=NULL) {; gc_free(config->candidates); } ;
+  if (config!=NULL) {; gc_free(config); } ;
+ }
+ this->config = NULL;
+}
+
+void Group_free(ParsingElement* this) {
+ Group__freeConfig(this);
+ if (this->name!=NULL) {; gc_free(this->name); } ;
+ if (this!=NULL) {; gc_free(this); } ;
+}
+
+static inline __attribute__((always_inline)) Match* Group__recognize(ParsingElement* this, ParsingContext* context, const 
+                                                                                       _Bool 
+                                                                                            trace) {
 
 
- if(context->grammar->isVerbose && !(context->flags & 0x1)){fprintf(stdout, "??? %s┌── Group " "\033[1m\033[33m" "%s" "\033[0m" ":#%d at %zu:%zu[→%d]", context->indent, this->name, this->id, context->iterator->lines, context->iterator->offset, context->depth);fprintf(stdout, "\n");;};
+ if(trace && context->grammar->isVerbose && !(context->flags & 0x1)){fprintf(stdout, "??? %s┌── Group " "\033[1m\033[33m" "%s" "\033[0m" ":#%d at %zu:%zu[→%d]", context->indent, this->name, this->id, Iterator_line(context->iterator), context->iterator->offset, context->depth);fprintf(stdout, "\n");;};
  Match* result = NULL;
  size_t offset = context->iterator->offset;
- size_t lines = context->iterator->lines;
  int step = 0;
 
 
@@ -2418,9 +4505,28 @@ Match* Group_recognize(ParsingElement* this, ParsingContext* context){
  Match* match = NULL;
  step = 0;
 
+
+
+ GroupConfig* config = (GroupConfig*)this->config;
+ Reference** candidates = NULL;
+ Reference* word[2] = {NULL, NULL};
+ if (config != NULL && Iterator_hasMore(context->iterator)) {
+  candidates = config->dispatch[(unsigned char)(*context->iterator->current)];
+
+  if (candidates != NULL && config->words != NULL) {
+   word[0] = WordTrie_match(config->words, context->iterator->current, Iterator_remaining(context->iterator));
+   candidates = word;
+  }
+  if (candidates != NULL) {child = *candidates;}
+ }
+
  while (child != NULL ) {
   assert (match == NULL);
-  match = Reference_recognize(child, context);
+  int cut = ParsingContext__enterChoice(context);
+  match = trace ? Reference_recognize(child, context) : Reference__recognizeLean(child, context);
+  
+ _Bool 
+      committed = ParsingContext__leaveChoice(context, cut);
 
   if (Match_isSuccess(match)) {
 
@@ -2432,27 +4538,29 @@ Match* Group_recognize(ParsingElement* this, ParsingContext* context){
   } else {
 
    match = Match_free(match);
-   child = child->next;
+   child = committed ? NULL : candidates != NULL ? *(++candidates) : child->next;
    step += 1;
   }
  }
 
 
  if (Match_isSuccess(result)) {
-  if(context->grammar->isVerbose && !(context->flags & 0x1)){fprintf(stdout, "[✓] %s╘═⇒ Group " "\033[1m\033[32m" "%s" "\033[0m" "#%d[%d] matched" "\033[1m\033[32m" "%zu:%zu-%zu" "\033[0m" "[%zu][→%d]", context->indent, this->name, this->id, step, context->iterator->lines, result->offset, context->iterator->offset, result->length, context->depth);fprintf(stdout, "\n");;}
-  return ParsingContext_registerMatch(context, (Element*)this, result);
+  if(trace && context->grammar->isVerbose && !(context->flags & 0x1)){fprintf(stdout, "[✓] %s╘═⇒ Group " "\033[1m\033[32m" "%s" "\033[0m" "#%d[%d] matched" "\033[1m\033[32m" "%zu:%zu-%zu" "\033[0m" "[%zu][→%d]", context->indent, this->name, this->id, step, Iterator_line(context->iterator), result->offset, context->iterator->offset, result->length, context->depth);fprintf(stdout, "\n");;}
+  return (trace ? ParsingContext_registerMatch(context, (Element*)this, result) : (result));
  } else {
 
-  if(context->grammar->isVerbose && !(context->flags & 0x1)){fprintf(stdout, " !  %s╘═⇒ Group " "\033[1m\033[31m" "%s" "\033[0m" "#%d[%d] failed at %zu:%zu-%zu[→%d]", context->indent, this->name, this->id, step, context->iterator->lines, context->iterator->offset, offset, context->depth);fprintf(stdout, "\n");;}
+  if(trace && context->grammar->isVerbose && !(context->flags & 0x1)){fprintf(stdout, " !  %s╘═⇒ Group " "\033[1m\033[31m" "%s" "\033[0m" "#%d[%d] failed at %zu:%zu-%zu[→%d]", context->indent, this->name, this->id, step, Iterator_line(context->iterator), context->iterator->offset, offset, context->depth);fprintf(stdout, "\n");;}
   result = Match_fail(result);
   if (context->iterator->offset != offset ) {
-   Iterator_backtrack(context->iterator, offset, lines);
+   Iterator_backtrack(context->iterator, offset);
    assert( context->iterator->offset == offset );
   }
-  return ParsingContext_registerMatch(context, (Element*)this, FAILURE);
+  return (trace ? ParsingContext_registerMatch(context, (Element*)this, FAILURE) : (FAILURE));
  }
 
 }
+
+Match* Group_recognize(ParsingElement* this, ParsingContext* context) {return Group__recognize(this, context, 1);} static Match* Group__recognizeLean(ParsingElement* this, ParsingContext* context) {return Group__recognize(this, context, 0);}
 ParsingElement* Rule_new(Reference* children[]) {
  ParsingElement* this = ParsingElement_new(children);
  this->type = 'R';
@@ -2461,7 +4569,17 @@ ParsingElement* Rule_new(Reference* children[]) {
  return this;
 }
 
-Match* Rule_recognize (ParsingElement* this, ParsingContext* context){
+
+
+static inline void ParsingContext__deepen( ParsingContext* this, int delta ) {
+ this->depth += delta;
+ int d = (this->depth > 0 ? this->depth : 0) % 40;
+ this->indent = INDENT + (40 - d) * 2;
+}
+
+static inline __attribute__((always_inline)) Match* Rule__recognize(ParsingElement* this, ParsingContext* context, const 
+                                                                                      _Bool 
+                                                                                           trace) {
 
 
 
@@ -2470,27 +4588,30 @@ Match* Rule_recognize (ParsingElement* this, ParsingContext* context){
  int step = 0;
  const char* step_name = NULL;
  size_t offset = context->iterator->offset;
- size_t lines = context->iterator->lines;
  Reference* child = this->children;
 
- if(context->grammar->isVerbose && !(context->flags & 0x1)){fprintf(stdout, "??? %s┌── Rule:" "\033[1m\033[33m" "%s" "\033[0m" " at %zu:%zu[→%d]", context->indent, this->name, context->iterator->lines, context->iterator->offset, context->depth);fprintf(stdout, "\n");;};
+ if(trace && context->grammar->isVerbose && !(context->flags & 0x1)){fprintf(stdout, "??? %s┌── Rule:" "\033[1m\033[33m" "%s" "\033[0m" " at %zu:%zu[→%d]", context->indent, this->name, Iterator_line(context->iterator), context->iterator->offset, context->depth);fprintf(stdout, "\n");;};
+
 
 
- ParsingContext_push(context);
+ 
+_Bool 
+     scoped = !(this->flags & 0x20);
+ if (scoped) {ParsingContext_push(context);} else if (trace) {ParsingContext__deepen(context, 1);}
 
 
 
  while (child != NULL) {
 
   if (child->next != NULL) {
-   if(context->grammar->isVerbose && !(context->flags & 0x1)){fprintf(stdout, " ‥%s├─" "\033[1m\033[33m" "%d" "\033[0m", context->indent, step);fprintf(stdout, "\n");;};
+   if(trace && context->grammar->isVerbose && !(context->flags & 0x1)){fprintf(stdout, " ‥%s├─" "\033[1m\033[33m" "%d" "\033[0m", context->indent, step);fprintf(stdout, "\n");;};
   } else {
-   if(context->grammar->isVerbose && !(context->flags & 0x1)){fprintf(stdout, " ‥%s└─" "\033[1m\033[33m" "%d" "\033[0m", context->indent, step);fprintf(stdout, "\n");;};
+   if(trace && context->grammar->isVerbose && !(context->flags & 0x1)){fprintf(stdout, " ‥%s└─" "\033[1m\033[33m" "%d" "\033[0m", context->indent, step);fprintf(stdout, "\n");;};
   }
 
 
 
-  Match* match = Reference_recognize(child, context);
+  Match* match = trace ? Reference_recognize(child, context) : Reference__recognizeLean(child, context);
 
 
 
@@ -2506,7 +4627,7 @@ Match* Rule_recognize (ParsingElement* this, ParsingContext* context){
 
 
 
-    match = Reference_recognize(child, context);
+    match = trace ? Reference_recognize(child, context) : Reference__recognizeLean(child, context);
 
 
     if (!Match_isSuccess(match)) {
@@ -2554,29 +4675,31 @@ Match* Rule_recognize (ParsingElement* this, ParsingContext* context){
  }
 
 
- ParsingContext_pop(context);
+ if (scoped) {ParsingContext_pop(context);} else if (trace) {ParsingContext__deepen(context, -1);}
 
 
  if (Match_isSuccess(result)) {
-  if(context->grammar->isVerbose && !(context->flags & 0x1)){fprintf(stdout, "[✓] %s╘═⇒ Rule " "\033[1m\033[32m" "%s" "\033[0m" "#%d[%d] matched " "\033[1m\033[32m" "%zu:%zu-%zu" "\033[0m" "[%zub][→%d]", context->indent, this->name, this->id, step, context->iterator->lines, offset, context->iterator->offset, result->length, context->depth);fprintf(stdout, "\n");;}
+  if(trace && context->grammar->isVerbose && !(context->flags & 0x1)){fprintf(stdout, "[✓] %s╘═⇒ Rule " "\033[1m\033[32m" "%s" "\033[0m" "#%d[%d] matched " "\033[1m\033[32m" "%zu:%zu-%zu" "\033[0m" "[%zub][→%d]", context->indent, this->name, this->id, step, Iterator_line(context->iterator), offset, context->iterator->offset, result->length, context->depth);fprintf(stdout, "\n");;}
 
 
 
   result->length = last->offset - result->offset + last->length;
  } else {
-  if(context->grammar->isVerbose && !(context->flags & 0x1)){fprintf(stdout, " !  %s╘ Rule " "\033[1m\033[31m" "%s" "\033[0m" "#%d failed on step %d=%s at %zu:%zu-%zu[→%d]", context->indent, this->name, this->id, step, step_name == NULL ? "-" : step_name, context->iterator->lines, offset, context->iterator->offset, context->depth);fprintf(stdout, "\n");;}
+  if(trace && context->grammar->isVerbose && !(context->flags & 0x1)){fprintf(stdout, " !  %s╘ Rule " "\033[1m\033[31m" "%s" "\033[0m" "#%d failed on step %d=%s at %zu:%zu-%zu[→%d]", context->indent, this->name, this->id, step, step_name == NULL ? "-" : step_name, Iterator_line(context->iterator), offset, context->iterator->offset, context->depth);fprintf(stdout, "\n");;}
 
   result = Match_fail(result);
 
   if (offset != context->iterator->offset) {
-   Iterator_backtrack(context->iterator, offset, lines);
+   Iterator_backtrack(context->iterator, offset);
    assert( context->iterator->offset == offset );
   }
  }
 
- return ParsingContext_registerMatch(context, (Element*)this, result);
+ return (trace ? ParsingContext_registerMatch(context, (Element*)this, result) : (result));
 }
 
+Match* Rule_recognize(ParsingElement* this, ParsingContext* context) {return Rule__recognize(this, context, 1);} static Match* Rule__recognizeLean(ParsingElement* this, ParsingContext* context) {return Rule__recognize(this, context, 0);}
+
 
 
 
@@ -2591,15 +4714,19 @@ ParsingElement* Procedure_new(ProcedureCallback c) {
  return this;
 }
 
-Match* Procedure_recognize(ParsingElement* this, ParsingContext* context) {
+static inline __attribute__((always_inline)) Match* Procedure__recognize(ParsingElement* this, ParsingContext* context, const 
+                                                                                           _Bool 
+                                                                                                trace) {
  if (this->config != NULL) {
 
   ((ProcedureCallback)(this->config))(this, context);
  }
- if(context->grammar->isVerbose && !(context->flags & 0x1) && this->name){fprintf(stdout, "[✓] %sProcedure " "\033[1m\033[32m" "%s" "\033[0m" "#%d executed at %zu", context->indent, this->name, this->id, context->iterator->offset);fprintf(stdout, "\n");;}
- return ParsingContext_registerMatch(context, (Element*)this, Match_Success(0, this, context));
+ if(trace && context->grammar->isVerbose && !(context->flags & 0x1) && this->name){fprintf(stdout, "[✓] %sProcedure " "\033[1m\033[32m" "%s" "\033[0m" "#%d executed at %zu", context->indent, this->name, this->id, context->iterator->offset);fprintf(stdout, "\n");;}
+ return (trace ? ParsingContext_registerMatch(context, (Element*)this, Match_Success(0, this, context)) : (Match_Success(0, this, context)));
 }
 
+Match* Procedure_recognize(ParsingElement* this, ParsingContext* context) {return Procedure__recognize(this, context, 1);} static Match* Procedure__recognizeLean(ParsingElement* this, ParsingContext* context) {return Procedure__recognize(this, context, 0);}
+
 
 
 
@@ -2614,131 +4741,393 @@ ParsingElement* Condition_new(ConditionCallback c) {
  return this;
 }
 
-Match* Condition_recognize(ParsingElement* this, ParsingContext* context) {
+static inline __attribute__((always_inline)) Match* Condition__recognize(ParsingElement* this, ParsingContext* context, const 
+                                                                                           _Bool 
+                                                                                                trace) {
  if (this->config != NULL) {
   
  _Bool 
       value = ((ConditionCallback)this->config)(this, context);
   Match* result = value == 1 ? Match_Success(0, this, context) : FAILURE;
-  if(context->grammar->isVerbose && !(context->flags & 0x1) && Match_isSuccess(result)){fprintf(stdout, "[✓] %s└ Condition " "\033[1m\033[32m" "%s" "\033[0m" "#%d matched %zu:%zu-%zu[→%d]", context->indent, this->name, this->id, context->iterator->lines, context->iterator->offset - result->length, context->iterator->offset, context->depth);fprintf(stdout, "\n");;}
-  if(context->grammar->isVerbose && !(context->flags & 0x1) && !Match_isSuccess(result)){fprintf(stdout, " !  %s└ Condition " "\033[1m\033[31m" "%s" "\033[0m" "#%d failed at %zu:%zu[→%d]", context->indent, this->name, this->id, context->iterator->lines, context->iterator->offset, context->depth);fprintf(stdout, "\n");;}
-  return ParsingContext_registerMatch(context, (Element*)this, result);
+  if(trace && context->grammar->isVerbose && !(context->flags & 0x1) && Match_isSuccess(result)){fprintf(stdout, "[✓] %s└ Condition " "\033[1m\033[32m" "%s" "\033[0m" "#%d matched %zu:%zu-%zu[→%d]", context->indent, this->name, this->id, Iterator_line(context->iterator), context->iterator->offset - result->length, context->iterator->offset, context->depth);fprintf(stdout, "\n");;}
+  if(trace && context->grammar->isVerbose && !(context->flags & 0x1) && !Match_isSuccess(result)){fprintf(stdout, " !  %s└ Condition " "\033[1m\033[31m" "%s" "\033[0m" "#%d failed at %zu:%zu[→%d]", context->indent, this->name, this->id, Iterator_line(context->iterator), context->iterator->offset, context->depth);fprintf(stdout, "\n");;}
+  return (trace ? ParsingContext_registerMatch(context, (Element*)this, result) : (result));
  } else {
-  if(context->grammar->isVerbose && !(context->flags & 0x1)){fprintf(stdout, "[✓] %s└ Condition %s#%d matched by default at %zu", context->indent, this->name, this->id, context->iterator->offset);fprintf(stdout, "\n");;};
+  if(trace && context->grammar->isVerbose && !(context->flags & 0x1)){fprintf(stdout, "[✓] %s└ Condition %s#%d matched by default at %zu", context->indent, this->name, this->id, context->iterator->offset);fprintf(stdout, "\n");;};
   Match* result = Match_Success(0, this, context);
   assert(Match_isSuccess(result));
-  return ParsingContext_registerMatch(context, (Element*)this, result);
+  return (trace ? ParsingContext_registerMatch(context, (Element*)this, result) : (result));
  }
 }
 
+Match* Condition_recognize(ParsingElement* this, ParsingContext* context) {return Condition__recognize(this, context, 1);} static Match* Condition__recognizeLean(ParsingElement* this, ParsingContext* context) {return Condition__recognize(this, context, 0);}
 
 
 
 
 
 
-ParsingVariable* ParsingVariable_new(int depth, const char* key, void* value) {
- ParsingVariable* this = (ParsingVariable*) gc_new(sizeof(ParsingVariable)); assert (this!=NULL); ;
- this->depth = depth;
- this->key = gc_strdup(key) ; assert (this->key!=NULL); ;
- this->value = value;
- this->previous = NULL;
+
+ParsingElement* Cut_new(void) {
+ ParsingElement* this = ParsingElement_new(NULL);
+ this->type = 'p';
+ this->recognize = Cut_recognize;
  return this;
 }
 
-void ParsingVariable_free(ParsingVariable* this) {
- if (this!=NULL) {
-  if (this->key!=NULL) {; gc_free(this->key); } ;
-  if (this!=NULL) {; gc_free(this); } ;
+static inline __attribute__((always_inline)) Match* Cut__recognize(ParsingElement* this, ParsingContext* context, const 
+                                                                                     _Bool 
+                                                                                          trace) {
+
+
+ if (!(context->flags & 0x2)) {
+  context->flags=context->flags|0x2;;
+  if (context->choices > 0) {context->choices -= 1;}
+ }
+ if (context->choices == 0 && context->memo != NULL) {
+  context->memo->committed = context->iterator->offset;
+ }
+ if(trace && context->grammar->isVerbose && !(context->flags & 0x1)){fprintf(stdout, "[✓] %sCut " "\033[1m\033[32m" "%s" "\033[0m" "#%d at %zu[%d]", context->indent, this->name, this->id, context->iterator->offset, context->choices);fprintf(stdout, "\n");;}
+ return (trace ? ParsingContext_registerMatch(context, (Element*)this, Match_Success(0, this, context)) : (Match_Success(0, this, context)));
+}
+
+Match* Cut_recognize(ParsingElement* this, ParsingContext* context) {return Cut__recognize(this, context, 1);} static Match* Cut__recognizeLean(ParsingElement* this, ParsingContext* context) {return Cut__recognize(this, context, 0);}
+
+
+
+static Match* ParsingElement__recognizeLean( ParsingElement* this, ParsingContext* context ) {
+ switch (this->type) {
+  case 'W':
+   if (this->recognize == Word_recognize) {return Word__recognizeLean(this, context);}
+   break;
+  case 'T':
+   if (this->recognize == Token_recognize) {return Token__recognizeLean(this, context);}
+   break;
+  case 'G':
+   if (this->recognize == Group_recognize) {return Group__recognizeLean(this, context);}
+   break;
+  case 'R':
+   if (this->recognize == Rule_recognize) {return Rule__recognizeLean(this, context);}
+   break;
+  case 'c':
+   if (this->recognize == Condition_recognize) {return Condition__recognizeLean(this, context);}
+   break;
+  case 'p':
+   if (this->recognize == Procedure_recognize) {return Procedure__recognizeLean(this, context);}
+   if (this->recognize == Cut_recognize) {return Cut__recognizeLean(this, context);}
+   break;
+ }
+ return this->recognize(this, context);
+}
+ParsingVariables* ParsingVariables_new(Grammar* grammar) {
+ ParsingVariables* this = (ParsingVariables*) gc_new(sizeof(ParsingVariables)); assert (this!=NULL); ;
+ int count = grammar != NULL && grammar->keysCount > 0 ? grammar->keysCount : 1;
+ int capacity = (count > 16 ? count : 16);
+ char** keys = (char**) gc_calloc((size_t)capacity, sizeof(char*)) ; assert (keys!=NULL); ;
+ ParsingSlot* slots = (ParsingSlot*) gc_calloc((size_t)capacity, sizeof(ParsingSlot)) ; assert (slots!=NULL); ;
+ ParsingShadow* shadows = (ParsingShadow*) gc_calloc(16, sizeof(ParsingShadow)) ; assert (shadows!=NULL); ;
+ int* frames = (int*) gc_calloc(16, sizeof(int)) ; assert (frames!=NULL); ;
+ this->keys = keys;
+ this->slots = slots;
+ this->shadows = shadows;
+ this->frames = frames;
+ this->keysCapacity = capacity;
+ this->shadowsCount = 0;
+ this->shadowsCapacity = 16;
+ this->framesCapacity = 16;
+
+
+ if (grammar != NULL && grammar->keysCount > 0) {
+  for (int i=0 ; i<count ; i++) {this->keys[i] = grammar->keys[i];}
+  this->keysCount = count;
+  this->keysShared = count;
+ } else {
+  this->keys[0] = gc_strdup("depth") ; assert (this->keys[0]!=NULL); ;
+  this->keysCount = 1;
+  this->keysShared = 0;
+ }
+ for (int i=0 ; i<capacity ; i++) {
+  this->slots[i].value = NULL;
+  this->slots[i].depth = -1;
  }
+ return this;
 }
 
-void ParsingVariable_freeAll(ParsingVariable* this) {
- ParsingVariable* current = this;
- while (current!=NULL) {
-  ParsingVariable* to_free = current;
-  current = current->previous;
-  ParsingVariable_free(to_free);
+void ParsingVariables_free(ParsingVariables* this) {
+ if (this != NULL) {
+  for (int i=this->keysShared ; i<this->keysCount ; i++) {
+   if (this->keys[i]!=NULL) {; gc_free(this->keys[i]); } ;
+  }
+  if (this->keys!=NULL) {; gc_free(this->keys); } ;
+  if (this->slots!=NULL) {; gc_free(this->slots); } ;
+  if (this->shadows!=NULL) {; gc_free(this->shadows); } ;
+  if (this->frames!=NULL) {; gc_free(this->frames); } ;
  }
+ if (this!=NULL) {; gc_free(this); } ;
 }
 
-int ParsingVariable_getDepth(ParsingVariable* this) {
- return this == NULL ? -1 : this->depth;
+int ParsingVariables_key(ParsingVariables* this, const char* name, 
+                                                                  _Bool 
+                                                                       create) {
+
+ for (int i=0 ; i<this->keysCount ; i++) {
+  if (strcmp(this->keys[i], name) == 0) {return i;}
+ }
+ if (!create) {return -1;}
+ if (this->keysCount == this->keysCapacity) {
+  this->keysCapacity *= 2;
+  this->keys=gc_realloc(this->keys,(size_t)this->keysCapacity * sizeof(char*)); ;
+  this->slots=gc_realloc(this->slots,(size_t)this->keysCapacity * sizeof(ParsingSlot)); ;
+  for (int i=this->keysCount ; i<this->keysCapacity ; i++) {
+   this->slots[i].value = NULL;
+   this->slots[i].depth = -1;
+  }
+ }
+ this->keys[this->keysCount] = gc_strdup(name) ; assert (this->keys[this->keysCount]!=NULL); ;
+ return this->keysCount++;
 }
 
-const char* ParsingVariable_getName(ParsingVariable* this) {
- return (const char*)this->key;
+
+
+
+
+
+
+ParsingArenaChunk* ParsingArenaChunk__new(size_t capacity, ParsingArenaChunk* previous) {
+ ParsingArenaChunk* this = (ParsingArenaChunk*) gc_new(sizeof(ParsingArenaChunk)); assert (this!=NULL); ;
+ char* data = (char*) gc_calloc(capacity, sizeof(char)) ; assert (data!=NULL); ;
+ this->previous = previous;
+ this->capacity = capacity;
+ this->used = 0;
+ this->data = data;
+ return this;
 }
 
-void* ParsingVariable_get(ParsingVariable* this, const char* name) {
- ParsingVariable* found = ParsingVariable_find(this, name, 0);
- return found != NULL ? found->value : NULL;
+void ParsingArenaChunk__free(ParsingArenaChunk* this) {
+ if (this != NULL) {if (this->data!=NULL) {; gc_free(this->data); } ;}
+ if (this!=NULL) {; gc_free(this); } ;
 }
 
+ParsingArena* ParsingArena_new(void) {
+ ParsingArena* this = (ParsingArena*) gc_new(sizeof(ParsingArena)); assert (this!=NULL); ;
+ this->chunk = NULL;
+ this->spare = NULL;
+ this->pinned = NULL;
+ this->allocated = 0;
+ this->kept = ParsingArena_mark(NULL);
+ return this;
+}
 
-_Bool 
-    ParsingVariable_is(ParsingVariable* this, const char* key) {
- if (this == NULL || key == NULL) {return 0;}
- return (key == this->key || strcmp(this->key, key)) == 0 ? 1 : 0;
+void ParsingArena_free(ParsingArena* this) {
+ if (this == NULL) {return;}
+ ParsingArenaChunk* chunk = this->chunk;
+ while (chunk != NULL) {
+  ParsingArenaChunk* previous = chunk->previous;
+  ParsingArenaChunk__free(chunk);
+  chunk = previous;
+ }
+ ParsingArenaChunk__free(this->spare);
+ void* pinned = this->pinned;
+ while (pinned != NULL) {
+  void* next = *((void**)pinned);
+  if (pinned!=NULL) {; gc_free(pinned); } ;
+  pinned = next;
+ }
+ if (this!=NULL) {; gc_free(this); } ;
 }
 
-ParsingVariable* ParsingVariable_find(ParsingVariable* this, const char* key, 
-                                                                             _Bool 
-                                                                                  local) {
- ParsingVariable* current=this;
- while (current!=NULL) {
-  if (ParsingVariable_is(current, key)) {
-   return current;
+void* ParsingArena_alloc(ParsingArena* this, size_t size) {
+ size = (size + 16 - 1) & ~((size_t)16 - 1);
+ ParsingArenaChunk* chunk = this->chunk;
+ if (chunk == NULL || chunk->used + size > chunk->capacity) {
+
+  if (this->spare != NULL && this->spare->capacity >= size) {
+   chunk = this->spare;
+   chunk->previous = this->chunk;
+   chunk->used = 0;
+   this->spare = NULL;
+  } else {
+   size_t capacity = size > (64 * 1024) ? size : (64 * 1024);
+   chunk = ParsingArenaChunk__new(capacity, this->chunk);
+   this->allocated += capacity;
   }
-  if (current->previous!=NULL) {
+  this->chunk = chunk;
+ }
+ void* data = chunk->data + chunk->used;
+ chunk->used += size;
+ return data;
+}
+
+void* ParsingArena_allocPinned(ParsingArena* this, size_t size) {
+
+ char* block = (char*) gc_calloc(16 + size, sizeof(char)) ; assert (block!=NULL); ;
+ *((void**)block) = this->pinned;
+ this->pinned = block;
+ return block + 16;
+}
+
+ParsingArenaMark ParsingArena_mark(ParsingArena* this) {
+ ParsingArenaMark mark = {NULL, 0};
+ if (this != NULL && this->chunk != NULL) {
+  mark.chunk = this->chunk;
+  mark.used = this->chunk->used;
+ }
+ return mark;
+}
+
+void ParsingArena_rewind(ParsingArena* this, ParsingArenaMark mark) {
+ if (this == NULL) {return;}
+
+
+ if (this->kept.chunk == mark.chunk) {
+  mark.used = (mark.used > this->kept.used ? mark.used : this->kept.used);
+ } else if (this->kept.chunk != NULL) {
+  ParsingArenaChunk* chunk = this->chunk;
+  while (chunk != mark.chunk && chunk != this->kept.chunk) {chunk = chunk->previous;}
+  if (chunk == this->kept.chunk) {mark = this->kept;}
+ }
 
-   current = (local && current->previous->depth != current->depth) ? NULL : current->previous;
+
+
+ while (this->chunk != mark.chunk) {
+  ParsingArenaChunk* chunk = this->chunk;
+  this->chunk = chunk->previous;
+  if (this->spare == NULL || this->spare->capacity < chunk->capacity) {
+   if (this->spare != NULL) {this->allocated -= this->spare->capacity;}
+   ParsingArenaChunk__free(this->spare);
+   this->spare = chunk;
   } else {
-   current = NULL;
+   this->allocated -= chunk->capacity;
+   ParsingArenaChunk__free(chunk);
   }
  }
- return current;
+ if (this->chunk != NULL) {this->chunk->used = mark.used;}
 }
 
-ParsingVariable* ParsingVariable_set(ParsingVariable* this, const char* key, void* value) {
- ParsingVariable* found = ParsingVariable_find(this, key, 1);
- if (found == NULL) {
-  found = ParsingVariable_new( this->depth, key, value );
-  found->previous = this;
-  return found;
- } else {
-  found->value = value;
-  return found;
+void ParsingArena_keep(ParsingArena* this) {
+ if (this != NULL) {this->kept = ParsingArena_mark(this);}
+}
+
+void ParsingArena_reset(ParsingArena* this) {
+ if (this == NULL) {return;}
+ ParsingArenaMark empty = {NULL, 0};
+ this->kept = empty;
+ ParsingArena_rewind(this, empty);
+ void* pinned = this->pinned;
+ while (pinned != NULL) {
+  void* next = *((void**)pinned);
+  if (pinned!=NULL) {; gc_free(pinned); } ;
+  pinned = next;
  }
+ this->pinned = NULL;
+}
+static inline size_t ParsingMemo__slot( ParsingMemo* this, int id, size_t offset ) {
+ size_t h = (offset * 2654435761u) ^ ((size_t)id * 40503u);
+ return h & (this->capacity - 1);
 }
 
-ParsingVariable* ParsingVariable_push(ParsingVariable* this) {
- int depth = this == NULL ? 0 : ParsingVariable_getDepth(this) + 1;
- ParsingVariable* res = ParsingVariable_new(depth, "depth", (void*)(long)depth);
- res->previous = this;
- return res;
+static void ParsingMemo__allocate( ParsingMemo* this, size_t capacity ) {
+ ParsingMemoEntry* entries = (ParsingMemoEntry*) gc_calloc(capacity, sizeof(ParsingMemoEntry)) ; assert (entries!=NULL); ;
+ for (size_t i=0 ; i<capacity ; i++) {entries[i].id = -1;}
+ this->entries = entries;
+ this->capacity = capacity;
+ this->count = 0;
 }
 
-ParsingVariable* ParsingVariable_pop(ParsingVariable* this) {
- if (this == NULL) {return NULL;}
- ParsingVariable* current = this;
- int depth = this->depth;
- while (current != NULL && current->depth >= depth) {
-  ParsingVariable* to_free = current;
-  current = current->previous;
-  ParsingVariable_free(to_free);
+ParsingMemo* ParsingMemo_new(ParsingArena* arena) {
+ ParsingMemo* this = (ParsingMemo*) gc_new(sizeof(ParsingMemo)); assert (this!=NULL); ;
+ this->hits = 0;
+ this->committed = 0;
+ this->generation = 0;
+ this->arena = arena;
+ ParsingMemo__allocate(this, 1024);
+ return this;
+}
+
+
+void ParsingMemo_clear(ParsingMemo* this) {
+ for (size_t i=0 ; i<this->capacity ; i++) {
+  this->entries[i].match = NULL;
+  this->entries[i].id = -1;
  }
- return current;
+ this->count = 0;
 }
 
-int ParsingVariable_count(ParsingVariable* this) {
- ParsingVariable* current = this;
- int count = 0;
- while (current!=NULL) {
-  current = current->previous;
-  count++;
+void ParsingMemo_forget(ParsingMemo* this) {
+ if (this != NULL) {this->generation += 1;}
+}
+
+void ParsingMemo_free(ParsingMemo* this) {
+ if (this != NULL) {
+  if (this->entries!=NULL) {; gc_free(this->entries); } ;
  }
- return count;
+ if (this!=NULL) {; gc_free(this); } ;
+}
+
+ParsingMemoEntry* ParsingMemo_get(ParsingMemo* this, int id, size_t offset) {
+ size_t mask = this->capacity - 1;
+ size_t i = ParsingMemo__slot(this, id, offset);
+
+ while (this->entries[i].id >= 0) {
+  ParsingMemoEntry* e = &(this->entries[i]);
+  if (e->id == id && e->offset == offset) {
+   if (e->generation != this->generation) {return NULL;}
+   this->hits += 1;
+   return e;
+  }
+  i = (i + 1) & mask;
+ }
+ return NULL;
+}
+
+static ParsingMemoEntry* ParsingMemo__insert( ParsingMemo* this, int id, size_t offset ) {
+ size_t mask = this->capacity - 1;
+ size_t i = ParsingMemo__slot(this, id, offset);
+ while (this->entries[i].id >= 0) {
+  if (this->entries[i].id == id && this->entries[i].offset == offset) {
+   return &(this->entries[i]);
+  }
+  i = (i + 1) & mask;
+ }
+ this->entries[i].id = id;
+ this->entries[i].generation = this->generation;
+ this->entries[i].offset = offset;
+ this->entries[i].match = NULL;
+ this->count += 1;
+ return &(this->entries[i]);
+}
+
+ParsingMemoEntry* ParsingMemo_set(ParsingMemo* this, int id, size_t offset, size_t end, Match* match) {
+
+
+
+
+ if ((this->count + 1) * 4 > this->capacity * 3) {
+  ParsingMemoEntry* previous = this->entries;
+  size_t capacity = this->capacity;
+  size_t kept = 0;
+
+  for (size_t i=0 ; i<capacity ; i++) {
+   if (((previous[i]).id >= 0 && (previous[i]).generation == this->generation && (previous[i]).offset >= this->committed)) {kept++;}
+  }
+  ParsingMemo__allocate(this, (kept + 1) * 2 > capacity ? capacity * 2 : capacity);
+  for (size_t i=0 ; i<capacity ; i++) {
+   if (((previous[i]).id >= 0 && (previous[i]).generation == this->generation && (previous[i]).offset >= this->committed)) {
+    *ParsingMemo__insert(this, previous[i].id, previous[i].offset) = previous[i];
+   }
+  }
+
+  if (previous!=NULL) {; gc_free(previous); } ;
+ }
+ ParsingMemoEntry* entry = ParsingMemo__insert(this, id, offset);
+ if (entry->match == NULL || entry->generation != this->generation) {
+  entry->generation = this->generation;
+  entry->end = end;
+  entry->match = Match_isSuccess(match) ? match : NULL;
+
+  if (entry->match != NULL) {ParsingArena_keep(this->arena);}
+ }
+ return entry;
 }
 
 
@@ -2753,25 +5142,38 @@ ParsingContext* ParsingContext_new( Grammar* g, Iterator* iterator ) {
  this->iterator = iterator;
  this->stats = ParsingStats_new();
  this->freeIterator = 0;
- if (g != NULL) {
-  ParsingStats_setSymbolsCount(this->stats, g->axiomCount + g->skipCount);
+ this->flags = 0;
+
+ if (g != NULL && g->stats != NULL) {
+  ParsingStats_setSymbolsCount(this->stats, g->axiomCount + g->skipCount + 1);
+  this->flags=this->flags|0x4;;
+ }
+
+ if (g != NULL && (g->isVerbose || g->stats != NULL)) {
+  this->flags=this->flags|0x8;;
  }
  this->depth = 0;
- this->variables = ParsingVariable_new(0, "depth", 0);
+ this->variables = ParsingVariables_new(g);
+ this->arena = ParsingArena_new();
+ this->memo = (g != NULL && g->isMemoized) ? ParsingMemo_new(this->arena) : NULL;
  this->callback = NULL;
  this->indent = INDENT + (40 * 2);
- this->flags = 0;
+ this->choices = 0;
  this->lastMatchOffset = 0;
  this->lastMatchLength = 0;
  this->lastMatchElementID = -1;
+ this->parts = NULL;
  return this;
 }
 
 void ParsingContext_free( ParsingContext* this ) {
 
  if (this!=NULL) {
+  ParsingContext_free(this->parts);
   if (this->freeIterator) {Iterator_free(this->iterator);}
-  ParsingVariable_freeAll(this->variables);
+  ParsingVariables_free(this->variables);
+  ParsingMemo_free(this->memo);
+  ParsingArena_free(this->arena);
   ParsingStats_free(this->stats);
   if (this!=NULL) {; gc_free(this); } ;
  }
@@ -2787,41 +5189,71 @@ char ParsingContext_charAt ( ParsingContext* this, size_t offset ) {
 
 
 void ParsingContext_push ( ParsingContext* this ) {
- this->variables = ParsingVariable_push(this->variables);
  if (this->callback != NULL) {this->callback(this, '+');}
- this->depth += 1;
- if (this->depth >= 0) {
-  int d = this->depth % 40;
-  this->indent = INDENT + (40 - d) * 2;
+ ParsingContext__deepen(this, 1);
+
+ ParsingVariables* variables = this->variables;
+ if (this->depth > 0) {
+  if (this->depth >= variables->framesCapacity) {
+   variables->framesCapacity *= 2;
+   variables->frames=gc_realloc(variables->frames,(size_t)variables->framesCapacity * sizeof(int)); ;
+  }
+  variables->frames[this->depth] = variables->shadowsCount;
  }
 }
 
 void ParsingContext_pop ( ParsingContext* this ) {
  if (this->callback != NULL) {this->callback(this, '-');}
- this->variables = ParsingVariable_pop(this->variables);
- this->depth -= 1;
- if (this->depth <= 0) {
-  this->indent = INDENT + 40 * 2;
- } else {
-  int d = this->depth % 40;
-  this->indent = INDENT + (40 - d) * 2;
+
+ ParsingVariables* variables = this->variables;
+ int start = this->depth > 0 ? variables->frames[this->depth] : 0;
+ while (variables->shadowsCount > start) {
+  ParsingShadow* shadow = &(variables->shadows[--variables->shadowsCount]);
+  variables->slots[shadow->key] = shadow->previous;
+ }
+ ParsingContext__deepen(this, -1);
+}
+
+void* ParsingContext_getKey(ParsingContext* this, int key) {
+ if (key == 0) {return (void*)(long)this->depth;}
+ if (key < 0 || key >= this->variables->keysCount) {return NULL;}
+ return this->variables->slots[key].value;
+}
+
+void ParsingContext_setKey(ParsingContext* this, int key, void* value) {
+ ParsingVariables* variables = this->variables;
+ if (key <= 0 || key >= variables->keysCount) {return;}
+ int depth = (this->depth > 0 ? this->depth : 0);
+ ParsingSlot* slot = &(variables->slots[key]);
+
+
+ if (slot->depth != depth) {
+  if (variables->shadowsCount == variables->shadowsCapacity) {
+   variables->shadowsCapacity *= 2;
+   variables->shadows=gc_realloc(variables->shadows,(size_t)variables->shadowsCapacity * sizeof(ParsingShadow)); ;
+  }
+  ParsingShadow* shadow = &(variables->shadows[variables->shadowsCount++]);
+  shadow->key = key;
+  shadow->previous = *slot;
+  slot->depth = depth;
  }
+ slot->value = value;
 }
 
 void* ParsingContext_get(ParsingContext* this, const char* name) {
- return ParsingVariable_get(this->variables, name);
+ return ParsingContext_getKey(this, ParsingVariables_key(this->variables, name, 0));
 }
 
 int ParsingContext_getInt(ParsingContext* this, const char* name) {
- return (int)(long)(ParsingVariable_get(this->variables, name));
+ return (int)(long)(ParsingContext_get(this, name));
 }
 
 void ParsingContext_set(ParsingContext* this, const char* name, void* value) {
- this->variables = ParsingVariable_set(this->variables, name, value);
+ ParsingContext_setKey(this, ParsingVariables_key(this->variables, name, 1), value);
 }
 
 void ParsingContext_setInt(ParsingContext* this, const char* name, int value) {
- this->variables = ParsingVariable_set(this->variables, name, (void*)(long)value);
+ ParsingContext_set(this, name, (void*)(long)value);
 }
 
 void ParsingContext_on(ParsingContext* this, ContextCallback callback) {
@@ -2829,7 +5261,8 @@ void ParsingContext_on(ParsingContext* this, ContextCallback callback) {
 }
 
 int ParsingContext_getVariableCount(ParsingContext* this) {
- return ParsingVariable_count(this->variables);
+
+ return (this->depth >= 0 ? this->depth + 1 : 0) + this->variables->shadowsCount;
 }
 
 size_t ParsingContext_getOffset(ParsingContext* this) {
@@ -2837,20 +5270,7 @@ size_t ParsingContext_getOffset(ParsingContext* this) {
 }
 
 Match* ParsingContext_registerMatch(ParsingContext* this, Element* e, Match* m) {
-
- if ((this->flags & 0x1)) {return m;}
- ParsingStats_registerMatch(this->stats, e, m);
-
-
-
- if (m != NULL && Match_isSuccess(m)) {
-  if ( (this->lastMatchOffset + this->lastMatchLength) < (m->offset + m->length) && m->length > 0) {
-   this->lastMatchOffset = m->offset;
-   this->lastMatchLength = m->length;
-   this->lastMatchElementID = m->element->id;
-  }
- }
- return m;
+ return ParsingContext__registerMatch(this, m);
 }
 
 
@@ -2863,8 +5283,12 @@ ParsingStats* ParsingStats_new(void) {
  ParsingStats* this = (ParsingStats*) gc_new(sizeof(ParsingStats)); assert (this!=NULL); ;
  this->bytesRead = 0;
  this->parseTime = 0;
+ this->symbolsCount = 0;
+ this->attemptsBySymbol = NULL;
  this->successBySymbol = NULL;
  this->failureBySymbol = NULL;
+ this->bytesBySymbol = NULL;
+ this->timeBySymbol = NULL;
  this->failureOffset = 0;
  this->matchOffset = 0;
  this->matchLength = 0;
@@ -2874,22 +5298,65 @@ ParsingStats* ParsingStats_new(void) {
 
 void ParsingStats_free(ParsingStats* this) {
  if (this != NULL) {
+  if (this->attemptsBySymbol!=NULL) {; gc_free(this->attemptsBySymbol); } ;
   if (this->successBySymbol!=NULL) {; gc_free(this->successBySymbol); } ;
   if (this->failureBySymbol!=NULL) {; gc_free(this->failureBySymbol); } ;
+  if (this->bytesBySymbol!=NULL) {; gc_free(this->bytesBySymbol); } ;
+  if (this->timeBySymbol!=NULL) {; gc_free(this->timeBySymbol); } ;
  }
  if (this!=NULL) {; gc_free(this); } ;
 }
 
 void ParsingStats_setSymbolsCount(ParsingStats* this, size_t t) {
+ this->attemptsBySymbol=gc_realloc(this->attemptsBySymbol,t * sizeof(size_t)); ;
  this->successBySymbol=gc_realloc(this->successBySymbol,t * sizeof(size_t)); ;
  this->failureBySymbol=gc_realloc(this->failureBySymbol,t * sizeof(size_t)); ;
+ this->bytesBySymbol=gc_realloc(this->bytesBySymbol,t * sizeof(size_t)); ;
+ this->timeBySymbol=gc_realloc(this->timeBySymbol,t * sizeof(double)); ;
+
+ for (size_t i=this->symbolsCount ; i<t ; i++) {
+  this->attemptsBySymbol[i] = 0;
+  this->successBySymbol[i] = 0;
+  this->failureBySymbol[i] = 0;
+  this->bytesBySymbol[i] = 0;
+  this->timeBySymbol[i] = 0;
+ }
  this->symbolsCount = t;
 }
 
 Match* ParsingStats_registerMatch(ParsingStats* this, Element* e, Match* m) {
+ if (e->id < 0 || (size_t)e->id >= this->symbolsCount) {return m;}
+ if (m!=NULL && Match_isSuccess(m)) {
+  this->successBySymbol[e->id] += 1;
+  if (m->offset >= this->matchOffset) {
+   this->matchOffset = m->offset;
+   this->matchLength = m->length;
+  }
+ } else {
+  this->failureBySymbol[e->id] += 1;
+ }
  return m;
 }
 
+void ParsingStats_merge(ParsingStats* this, ParsingStats* other) {
+ size_t count = (this->symbolsCount < other->symbolsCount ? this->symbolsCount : other->symbolsCount);
+ for (size_t i=0 ; i<count ; i++) {
+  this->attemptsBySymbol[i] += other->attemptsBySymbol[i];
+  this->successBySymbol[i] += other->successBySymbol[i];
+  this->failureBySymbol[i] += other->failureBySymbol[i];
+  this->bytesBySymbol[i] += other->bytesBySymbol[i];
+  this->timeBySymbol[i] += other->timeBySymbol[i];
+ }
+ this->bytesRead += other->bytesRead;
+ this->parseTime += other->parseTime;
+}
+
+double ParsingStats_now(void) {
+ struct timespec t;
+ clock_gettime(CLOCK_MONOTONIC, &t);
+ return (double)t.tv_sec + (double)t.tv_nsec / 1e9;
+}
+
 
 
 
@@ -2903,6 +5370,7 @@ ParsingResult* ParsingResult_new(Match* match, ParsingContext* context) {
  assert(context->iterator != NULL);
  this->match = match;
  this->context = context;
+ this->tree = NULL;
  if (match != FAILURE && context->iterator->offset > 0) {
   if (Iterator_hasMore(context->iterator) && Iterator_remaining(context->iterator) > 0) {
    if(context->grammar->isVerbose){fprintf(stderr, "--- ");fprintf(stderr, "Partial success, parsed %zu bytes, %zu remaining", context->iterator->offset, Iterator_remaining(context->iterator));fprintf(stderr, "\n");;};
@@ -2946,18 +5414,65 @@ size_t ParsingResult_remaining(ParsingResult* this) {
 }
 
 int ParsingResult_textOffset(ParsingResult* this) {
- int buffer_offset = this->context->iterator->current - this->context->iterator->buffer;
- return this->context->iterator->offset - buffer_offset;
+ return (int)Iterator_textOffset(this->context->iterator);
+}
+
+size_t ParsingResult_lineForOffset(ParsingResult* this, size_t offset) {
+ return Iterator_lineAt(this->context->iterator, offset);
+}
+
+size_t ParsingResult_columnForOffset(ParsingResult* this, size_t offset) {
+ size_t start = Iterator_textOffset(this->context->iterator);
+ ParsingResult_lineRange(this, ParsingResult_lineForOffset(this, offset), &start, NULL);
+ return offset - start;
+}
+
+
+_Bool 
+    ParsingResult_lineRange(ParsingResult* this, size_t line, size_t* start, size_t* end) {
+ Iterator* iterator = this->context->iterator;
+ LineIndex* index = &(iterator->lines);
+ size_t base = Iterator_textOffset(iterator);
+
+
+
+ Iterator__indexLines(iterator, base + iterator->available);
+ if (line > index->dropped + index->count || (line <= index->dropped && index->dropped > 0)) {return 0;}
+ size_t i = line - index->dropped;
+ if (start != NULL) {*start = i == 0 ? 0 : index->offsets[i - 1] + 1;}
+ if (end != NULL) {*end = i < index->count ? index->offsets[i] : base + iterator->available;}
+ return 1;
 }
 
 void ParsingResult_free(ParsingResult* this) {
  if (this != NULL) {
   this->match = Match_free(this->match);
+  MatchTree_free(this->tree);
   ParsingContext_free(this->context);
  }
  if (this!=NULL) {; gc_free(this); } ;
 }
 
+MatchTree* ParsingResult_compact(ParsingResult* this) {
+ if (this->tree != NULL) {return this->tree;}
+ if (this->status == 'F') {return NULL;}
+ MatchTree* tree = MatchTree_new(this->match, this->context->grammar);
+ if (tree == NULL) {return NULL;}
+
+
+ ParsingContext* context = this->context;
+ Match_free(this->match);
+ ParsingMemo_free(context->memo);
+ context->memo = NULL;
+ ParsingArena_free(context->arena);
+ context->arena = ParsingArena_new();
+ ParsingContext_free(context->parts);
+ context->parts = NULL;
+ this->match = NULL;
+ this->tree = tree;
+ return tree;
+}
+
 
 
 
@@ -3022,6 +5537,325 @@ int Grammar__registerElement(Element* e, int step, void* grammar) {
  }
 }
 
+
+
+
+void Grammar__markContextual( Grammar* this ) {
+ int count = this->axiomCount + this->skipCount + 1;
+ 
+_Bool 
+     changed = 1;
+ for (int i=0 ; i<count ; i++) {
+  Element* e = this->elements[i];
+  if (e != NULL && ParsingElement_Is(e)) {
+   ParsingElement* pe = (ParsingElement*)e;
+   pe->flags = pe->flags & ~0x8;;
+
+   if ((pe->type == 'p' && pe->recognize != Cut_recognize) || pe->type == 'c') {
+    pe->flags=pe->flags|0x8;;
+   }
+  }
+ }
+ while (changed) {
+  changed = 0;
+  for (int i=0 ; i<count ; i++) {
+   Element* e = this->elements[i];
+   if (e == NULL || !ParsingElement_Is(e)) {continue;}
+   ParsingElement* pe = (ParsingElement*)e;
+   if ((pe->flags & 0x8)) {continue;}
+   Reference* child = pe->children;
+   while (child != NULL) {
+    if ((child->element->flags & 0x8)) {
+     pe->flags=pe->flags|0x8;;
+     changed = 1;
+     break;
+    }
+    child = child->next;
+   }
+  }
+ }
+
+ for (int i=0 ; i<count ; i++) {
+  Element* e = this->elements[i];
+  if (e == NULL || !ParsingElement_Is(e)) {continue;}
+  ParsingElement* pe = (ParsingElement*)e;
+  pe->flags = pe->flags & ~0x20;;
+  if (pe->type == 'R' && !(pe->flags & 0x8)) {
+   pe->flags=pe->flags|0x20;;
+  }
+ }
+}
+
+
+
+
+void Grammar__markCutting( Grammar* this ) {
+ int count = this->axiomCount + this->skipCount + 1;
+ 
+_Bool 
+     changed = 1;
+ for (int i=0 ; i<count ; i++) {
+  Element* e = this->elements[i];
+  if (e != NULL && ParsingElement_Is(e)) {
+   ParsingElement* pe = (ParsingElement*)e;
+   pe->flags = pe->flags & ~0x10;;
+   if (pe->recognize == Cut_recognize) {
+    pe->flags=pe->flags|0x10;;
+   }
+  }
+ }
+ while (changed) {
+  changed = 0;
+  for (int i=0 ; i<count ; i++) {
+   Element* e = this->elements[i];
+   if (e == NULL || !ParsingElement_Is(e)) {continue;}
+   ParsingElement* pe = (ParsingElement*)e;
+   if (pe->type != 'R' || (pe->flags & 0x10)) {continue;}
+   Reference* child = pe->children;
+   while (child != NULL) {
+    if (child->cardinality == '1' && (child->element->flags & 0x10)) {
+     pe->flags=pe->flags|0x10;;
+     changed = 1;
+     break;
+    }
+    child = child->next;
+   }
+  }
+ }
+}
+
+
+
+typedef struct FirstSet {
+ unsigned char bytes[32];
+ 
+_Bool 
+              nullable;
+} FirstSet;
+
+static inline 
+             _Bool 
+                  FirstSet_has( FirstSet* this, unsigned char c ) {
+ return (this->bytes[c >> 3] & (1 << (c & 7))) != 0;
+}
+
+static inline void FirstSet_add( FirstSet* this, unsigned char c ) {
+ this->bytes[c >> 3] |= (1 << (c & 7));
+}
+
+static void FirstSet_fill( FirstSet* this, int from, int to ) {
+ for (int c=from ; c<=to ; c++) {FirstSet_add(this, (unsigned char)c);}
+}
+
+
+
+static 
+      _Bool 
+           FirstSet_merge( FirstSet* this, FirstSet* other ) {
+ 
+_Bool 
+     changed = 0;
+ for (int i=0 ; i<32 ; i++) {
+  unsigned char b = this->bytes[i] | other->bytes[i];
+  if (b != this->bytes[i]) {this->bytes[i] = b; changed = 1;}
+ }
+ return changed;
+}
+
+
+
+void Grammar__tokenFirstSet( ParsingElement* token, FirstSet* set ) {
+
+ TokenConfig* config = (TokenConfig*)token->config;
+ int min_length = -1;
+ int first_byte = -2;
+ const unsigned char* table = NULL;
+ if (config->extra != NULL) {
+  pcre_fullinfo(config->regexp, config->extra, PCRE_INFO_MINLENGTH, &min_length);
+ }
+ if (min_length <= 0) {
+
+  set->nullable = 1;
+  FirstSet_fill(set, 0, 255);
+  return;
+ }
+ pcre_fullinfo(config->regexp, config->extra, PCRE_INFO_FIRSTBYTE, &first_byte);
+ pcre_fullinfo(config->regexp, config->extra, PCRE_INFO_FIRSTTABLE, &table);
+ if (first_byte >= 0x80) {
+
+
+  FirstSet_fill(set, 0x80, 255);
+ } else if (first_byte >= 0) {
+  FirstSet_add(set, (unsigned char)first_byte);
+  if (first_byte >= 'a' && first_byte <= 'z') {FirstSet_add(set, (unsigned char)(first_byte - 'a' + 'A'));}
+  if (first_byte >= 'A' && first_byte <= 'Z') {FirstSet_add(set, (unsigned char)(first_byte - 'A' + 'a'));}
+ } else if (table != NULL) {
+  for (int i=0 ; i<32 ; i++) {set->bytes[i] |= table[i];}
+ } else {
+  FirstSet_fill(set, 0, 255);
+ }
+
+
+
+}
+
+
+static inline 
+             _Bool 
+                  Grammar__isNullable( Reference* ref, FirstSet* sets ) {
+ return ref->cardinality == '?'
+     || ref->cardinality == '*'
+     || sets[ref->element->id].nullable;
+}
+
+
+
+void Grammar__computeFirstSets( Grammar* this, FirstSet* sets, int count ) {
+ for (int i=0 ; i<count ; i++) {
+  Element* e = this->elements[i];
+  if (e == NULL || !ParsingElement_Is(e)) {continue;}
+  ParsingElement* pe = (ParsingElement*)e;
+  switch (pe->type) {
+   case 'W':
+    if (((WordConfig*)pe->config)->length > 0) {
+     FirstSet_add(&sets[i], (unsigned char)((WordConfig*)pe->config)->word[0]);
+    } else {
+     sets[i].nullable = 1;
+    }
+    break;
+   case 'T':
+    Grammar__tokenFirstSet(pe, &sets[i]);
+    break;
+   case 'p':
+   case 'c':
+    sets[i].nullable = 1;
+    break;
+  }
+ }
+ 
+_Bool 
+     changed = 1;
+ while (changed) {
+  changed = 0;
+  for (int i=0 ; i<count ; i++) {
+   Element* e = this->elements[i];
+   if (e == NULL || !ParsingElement_Is(e)) {continue;}
+   ParsingElement* pe = (ParsingElement*)e;
+   if (pe->type != 'G' && pe->type != 'R') {continue;}
+   
+  _Bool 
+                  nullable = pe->type == 'R';
+   Reference* child = pe->children;
+   while (child != NULL) {
+    changed = FirstSet_merge(&sets[i], &sets[child->element->id]) || changed;
+    if (pe->type == 'G') {
+     nullable = nullable || Grammar__isNullable(child, sets);
+    } else if (!Grammar__isNullable(child, sets)) {
+
+     nullable = 0;
+     break;
+    }
+    child = child->next;
+   }
+   if (nullable && !sets[i].nullable) {
+    sets[i].nullable = 1;
+    changed = 1;
+   }
+  }
+ }
+}
+
+
+static inline 
+             _Bool 
+                  Grammar__canStartWith( Reference* ref, FirstSet* sets, unsigned char c ) {
+ return Grammar__isNullable(ref, sets) || FirstSet_has(&sets[ref->element->id], c);
+}
+
+
+
+
+void Grammar__prepareGroup( Grammar* this, ParsingElement* group, FirstSet* sets ) {
+ Group__freeConfig(group);
+ FirstSet* skip = this->skip == NULL ? NULL : &sets[this->skip->id];
+ int children = 0;
+ 
+_Bool 
+          words = 1;
+ Reference* child = group->children;
+ while (child != NULL) {
+  words = words && child->cardinality == '1' && child->element->type == 'W';
+  children++;
+  child = child->next;
+ }
+ if (children < 2) {return;}
+
+ int lists[256];
+ int firsts[256];
+ int offsets[256];
+ int distinct = 0;
+ size_t total = 0;
+ for (int c=0 ; c<256 ; c++) {
+  lists[c] = -1;
+  if (skip != NULL && (skip->nullable || FirstSet_has(skip, (unsigned char)c))) {continue;}
+  int count = 0;
+  for (child = group->children ; child != NULL ; child = child->next) {
+   if (Grammar__canStartWith(child, sets, (unsigned char)c)) {count++;}
+  }
+
+
+  if (count == children && !words) {continue;}
+
+  for (int d=0 ; d<distinct && lists[c] < 0 ; d++) {
+   
+  _Bool 
+       same = 1;
+   for (child = group->children ; child != NULL && same ; child = child->next) {
+    same = Grammar__canStartWith(child, sets, (unsigned char)c) == Grammar__canStartWith(child, sets, (unsigned char)firsts[d]);
+   }
+   if (same) {lists[c] = d;}
+  }
+  if (lists[c] < 0) {
+   firsts[distinct] = c;
+   offsets[distinct] = (int)total;
+   lists[c] = distinct++;
+   total += count + 1;
+  }
+ }
+ if (distinct == 0) {return;}
+
+ GroupConfig* config = (GroupConfig*) gc_new(sizeof(GroupConfig)); assert (config!=NULL); ;
+ Reference** candidates = (Reference**) gc_calloc(total, sizeof(Reference*)) ; assert (candidates!=NULL); ;
+ config->candidates = candidates;
+ for (int d=0 ; d<distinct ; d++) {
+  Reference** list = candidates + offsets[d];
+  for (child = group->children ; child != NULL ; child = child->next) {
+   if (Grammar__canStartWith(child, sets, (unsigned char)firsts[d])) {*(list++) = child;}
+  }
+  *list = NULL;
+ }
+ for (int c=0 ; c<256 ; c++) {
+  config->dispatch[c] = lists[c] < 0 ? NULL : candidates + offsets[lists[c]];
+ }
+ config->words = words ? WordTrie_new(group) : NULL;
+ group->config = config;
+}
+
+
+
+void Grammar__prepareDispatch( Grammar* this ) {
+ int count = this->axiomCount + this->skipCount + 1;
+ FirstSet* sets = (FirstSet*) gc_calloc(count, sizeof(FirstSet)) ; assert (sets!=NULL); ;
+ Grammar__computeFirstSets(this, sets, count);
+ for (int i=0 ; i<count ; i++) {
+  Element* e = this->elements[i];
+  if (e != NULL && ParsingElement_Is(e) && ((ParsingElement*)e)->type == 'G') {
+   Grammar__prepareGroup(this, (ParsingElement*)e, sets);
+  }
+ }
+ if (sets!=NULL) {; gc_free(sets); } ;
+}
+
 void Grammar_prepare ( Grammar* this ) {
  if (this->skip!=NULL) {
   this->skip->id = 0;
@@ -3052,22 +5886,93 @@ void Grammar_prepare ( Grammar* this ) {
   if (this->skip != NULL) {
    ParsingElement__walk(this->skip, Grammar__registerElement, count, this);
   }
+
+  if (this->stats != NULL) {
+   ParsingStats_setSymbolsCount(this->stats, this->axiomCount + this->skipCount + 1);
+  }
+
+  Grammar__markContextual(this);
+  Grammar__markCutting(this);
+  Grammar__prepareDispatch(this);
+
+  ParsingProgram_free(this->program);
+  this->program = ParsingProgram_new(this);
  }
 }
 
-ParsingResult* Grammar_parseIterator( Grammar* this, Iterator* iterator ) {
 
- if (this->elements == NULL) {Grammar_prepare(this);}
+static inline Match* Grammar__recognize( Grammar* this, ParsingContext* context ) {
+
+
+
+ if (this->isVM && !this->isVerbose && this->stats == NULL && this->program != NULL) {
+  return ParsingProgram_run(this->program, context);
+ } else {
+  return ParsingElement_recognize(this->axiom, context);
+ }
+}
+
+
+
+static ParsingResult* Grammar__parseIterator( Grammar* this, Iterator* iterator ) {
  assert(this->axiom != NULL);
  ParsingContext* context = ParsingContext_new(this, iterator);
  assert(this->axiom->recognize != NULL);
  clock_t t1 = clock();
- Match* match = this->axiom->recognize(this->axiom, context);
+ Match* match = Grammar__recognize(this, context);
  context->stats->parseTime = ((double)clock() - (double)t1) / CLOCKS_PER_SEC;
  context->stats->bytesRead = iterator->offset;
  return ParsingResult_new(match, context);
 }
 
+ParsingResult* Grammar_parseIterator( Grammar* this, Iterator* iterator ) {
+
+ if (this->elements == NULL) {Grammar_prepare(this);}
+ ParsingResult* result = Grammar__parseIterator(this, iterator);
+ if (this->stats != NULL) {ParsingStats_merge(this->stats, result->context->stats);}
+ return result;
+}
+
+ParsingResult* Grammar_parseStream( Grammar* this, Iterator* iterator, MatchWalkingCallback callback, void* data ) {
+ if (this->elements == NULL) {Grammar_prepare(this);}
+ assert(this->axiom != NULL);
+ ParsingContext* context = ParsingContext_new(this, iterator);
+ clock_t t1 = clock();
+ int step = 0;
+ while (Iterator_hasMore(iterator)) {
+  size_t offset = iterator->offset;
+  Match* match = Grammar__recognize(this, context);
+
+
+  if (!Match_isSuccess(match) && ParsingElement_skip(this->axiom, context) > 0) {
+   if (!Iterator_hasMore(iterator)) {break;}
+   match = Grammar__recognize(this, context);
+  }
+  if (!Match_isSuccess(match) || iterator->offset == offset) {
+   if (iterator->offset != offset) {Iterator_moveTo(iterator, offset);}
+   break;
+  }
+  int next = callback(match, step, data);
+
+
+
+
+  ParsingMemo_forget(context->memo);
+  ParsingArena_reset(context->arena);
+  Iterator_release(iterator, iterator->offset);
+  step++;
+  if (next < 0) {break;}
+ }
+ context->stats->parseTime = ((double)clock() - (double)t1) / CLOCKS_PER_SEC;
+ context->stats->bytesRead = iterator->offset;
+ if (this->stats != NULL) {ParsingStats_merge(this->stats, context->stats);}
+ ParsingResult* result = ParsingResult_new(FAILURE, context);
+ if (step > 0) {
+  result->status = Iterator_hasMore(iterator) ? 'p' : 'S';
+ }
+ return result;
+}
+
 ParsingResult* Grammar_parsePath( Grammar* this, const char* path ) {
  Iterator* iterator = Iterator_Open(path);
  if (iterator != NULL) {
@@ -3080,8 +5985,22 @@ ParsingResult* Grammar_parsePath( Grammar* this, const char* path ) {
  }
 }
 
+
+
+static ParsingResult* Grammar__parsePath( Grammar* this, const char* path ) {
+ Iterator* iterator = Iterator_Open(path);
+ if (iterator == NULL) {return NULL;}
+ ParsingResult* result = Grammar__parseIterator(this, iterator);
+ result->context->freeIterator = 1;
+ return result;
+}
+
 ParsingResult* Grammar_parseString( Grammar* this, const char* text ) {
- Iterator* iterator = Iterator_FromString(text);
+ return Grammar_parseBuffer(this, text, strlen(text));
+}
+
+ParsingResult* Grammar_parseBuffer( Grammar* this, const char* data, size_t length ) {
+ Iterator* iterator = Iterator_FromBuffer(data, length);
  if (iterator != NULL) {
   ParsingResult* result = Grammar_parseIterator(this, iterator);
   result->context->freeIterator = 1;
@@ -3098,49 +6017,1000 @@ ParsingResult* Grammar_parseString( Grammar* this, const char* text ) {
 
 
 
-Processor* Processor_new() {
- Processor* this = (Processor*) gc_new(sizeof(Processor)); assert (this!=NULL); ;
- this->callbacksCount = 100;
- ProcessorCallback* callbacks = (ProcessorCallback*) gc_calloc((size_t)this->callbacksCount, sizeof(ProcessorCallback)) ; assert (callbacks!=NULL); ;
- this->callbacks = callbacks;
- this->fallback = NULL;
- return this;
-}
+typedef struct ParsingBatch {
+ Grammar* grammar;
+ const char** paths;
+ ParsingResult** results;
+ size_t count;
+ size_t next;
+} ParsingBatch;
 
-void Processor_free(Processor* this) {
- if (this!=NULL) {; gc_free(this); } ;
+
+
+static void* ParsingBatch__work( void* data ) {
+ ParsingBatch* batch = (ParsingBatch*)data;
+ while (1) {
+  size_t i = __atomic_fetch_add(&batch->next, 1, 0);
+  if (i >= batch->count) {break;}
+  batch->results[i] = Grammar__parsePath(batch->grammar, batch->paths[i]);
+ }
+ return NULL;
 }
 
-void Processor_register (Processor* this, int symbolID, ProcessorCallback callback ) {
- if (this->callbacksCount < (symbolID + 1)) {
-  int cur_count = this->callbacksCount;
-  int new_count = symbolID + 100;
-  this->callbacks=gc_realloc(this->callbacks,new_count * sizeof(ProcessorCallback)); ;
-  this->callbacksCount = new_count;
+ParsingResult** Grammar_parseBatch( Grammar* this, const char** paths, size_t count, int threads ) {
 
-  while (cur_count < new_count) {
-   this->callbacks[cur_count] = NULL;
-   cur_count++;
+ if (this->elements == NULL) {Grammar_prepare(this);}
+ ParsingResult** results = (ParsingResult**) gc_calloc(count > 0 ? count : 1, sizeof(ParsingResult*)) ; assert (results!=NULL); ;
+ ParsingBatch batch = {this, paths, results, count, 0};
+ if (threads <= 0) {
+  long processors = sysconf(_SC_NPROCESSORS_ONLN);
+  threads = processors > 0 ? (int)processors : 1;
+ }
+ if ((size_t)threads > count) {threads = count > 0 ? (int)count : 1;}
+
+
+ pthread_t* workers = (pthread_t*) gc_calloc(threads, sizeof(pthread_t)) ; assert (workers!=NULL); ;
+ int started = 0;
+ for (int i=1 ; i<threads ; i++) {
+  if (pthread_create(&workers[started], NULL, ParsingBatch__work, &batch) == 0) {started++;}
+ }
+ ParsingBatch__work(&batch);
+ for (int i=0 ; i<started ; i++) {
+  pthread_join(workers[i], NULL);
+ }
+ if (workers!=NULL) {; gc_free(workers); } ;
+
+ if (this->stats != NULL) {
+  for (size_t i=0 ; i<count ; i++) {
+   if (results[i] != NULL) {ParsingStats_merge(this->stats, results[i]->context->stats);}
   }
  }
- this->callbacks[symbolID] = callback;
+ return results;
 }
 
-int Processor_process (Processor* this, Match* match, int step) {
- ProcessorCallback handler = this->fallback;
- if (ParsingElement_Is(match->element)) {
-  int element_id = ((ParsingElement*)match->element)->id;
-  if (element_id >= 0 && element_id < this->callbacksCount) {
-   handler = this->callbacks[element_id];
+void ParsingResult_freeBatch( ParsingResult** results, size_t count ) {
+ if (results == NULL) {return;}
+ for (size_t i=0 ; i<count ; i++) {
+  if (results[i] != NULL) {ParsingResult_free(results[i]);}
+ }
+ if (results!=NULL) {; gc_free(results); } ;
+}
+
+
+
+
+
+
+
+
+_Bool 
+    Boundary_Line( const char* text, size_t offset, size_t length ) {
+ return offset > 0 && offset < length && text[offset - 1] == '\n';
+}
+
+
+_Bool 
+    Boundary_Unindented( const char* text, size_t offset, size_t length ) {
+ if (!Boundary_Line(text, offset, length)) {return 0;}
+ char c = text[offset];
+ return c != ' ' && c != '\t' && c != '\r' && c != '\n';
+}
+
+typedef struct ParsingChunk {
+ size_t start;
+ size_t end;
+ size_t first;
+ size_t last;
+ size_t next;
+ 
+_Bool 
+                failed;
+ 
+_Bool 
+                cut;
+ Match* records;
+ Match* tail;
+ ParsingContext* context;
+} ParsingChunk;
+
+typedef struct ParsingParallel {
+ Grammar* grammar;
+ ParsingElement* record;
+ Iterator* input;
+ ParsingChunk* chunks;
+ size_t count;
+ size_t next;
+} ParsingParallel;
+
+
+
+
+static void ParsingChunk__parse( ParsingChunk* this, Grammar* grammar, ParsingElement* record, Iterator* input ) {
+
+
+
+ Iterator* view = Iterator_new();
+ view->buffer = input->buffer;
+ view->current = input->buffer + this->start;
+ view->offset = this->start;
+ view->capacity = input->capacity;
+ view->available = input->available;
+ view->move = String_move;
+ ParsingContext* context = ParsingContext_new(grammar, view);
+ context->freeIterator = 1;
+ this->context = context;
+ this->records = NULL;
+ this->tail = NULL;
+ this->first = (size_t)-1;
+ this->last = this->start;
+ this->failed = 0;
+ this->cut = 0;
+ while (view->offset < this->end && Iterator_hasMore(view)) {
+  size_t offset = view->offset;
+  int cut = ParsingContext__enterChoice(context);
+  Match* match = ParsingElement_recognize(record, context);
+  
+ _Bool 
+        is_cut = ParsingContext__leaveChoice(context, cut);
+  if (Match_isSuccess(match)) {
+   if (this->records == NULL) {
+    this->records = match;
+    this->first = offset;
+   } else {
+    this->tail->next = match;
+   }
+   this->tail = match;
+   this->last = view->offset;
+   if (view->offset == offset) {this->failed = 1; break;}
+  } else {
+   Match_free(match);
+   if (is_cut || ParsingElement_skip(record, context) == 0) {
+    this->failed = 1;
+    this->cut = is_cut;
+    break;
+   }
   }
  }
- if (handler != NULL) {
-  handler (this, match);
- } else {
-  Match* child = match->children;
-  while (child) {
-   step = Processor_process(this, child, step);
-   child = child->next;
+ this->next = view->offset;
+
+ ParsingMemo_free(context->memo);
+ context->memo = NULL;
+}
+
+static void* ParsingParallel__work( void* data ) {
+ ParsingParallel* parallel = (ParsingParallel*)data;
+ while (1) {
+  size_t i = __atomic_fetch_add(&parallel->next, 1, 0);
+  if (i >= parallel->count) {break;}
+  ParsingChunk__parse(&parallel->chunks[i], parallel->grammar, parallel->record, parallel->input);
+ }
+ return NULL;
+}
+
+
+
+static Reference* Grammar__recordsReference( Grammar* this, ParsingElement* record ) {
+ ParsingElement* axiom = this->axiom;
+ if (axiom == NULL || record == NULL || axiom->type != 'R') {return NULL;}
+ Reference* child = axiom->children;
+ if (child == NULL || child->next != NULL || child->element != record || !Reference_isMany(child)) {return NULL;}
+ return child;
+}
+
+
+static size_t ParsingParallel__split( ParsingParallel* this, BoundaryCallback isBoundary, size_t count ) {
+ const char* text = this->input->buffer;
+ size_t length = this->input->available;
+ size_t chunks = 0;
+ size_t start = 0;
+ for (size_t i=1 ; i<=count ; i++) {
+  size_t end = i == count ? length : (start + 1 > length / count * i ? start + 1 : length / count * i);
+  while (end < length && !isBoundary(text, end, length)) {end++;}
+  this->chunks[chunks].start = start;
+  this->chunks[chunks].end = end;
+  chunks++;
+  if (end >= length) {break;}
+  start = end;
+ }
+ return chunks;
+}
+
+ParsingResult* Grammar_parseParallel( Grammar* this, const char* path, ParsingElement* record, BoundaryCallback isBoundary, int threads ) {
+ if (this->elements == NULL) {Grammar_prepare(this);}
+ Iterator* input = Iterator_Open(path);
+ if (input == NULL) {
+  errno = ENOENT;
+  return NULL;
+ }
+ if (threads <= 0) {
+  long processors = sysconf(_SC_NPROCESSORS_ONLN);
+  threads = processors > 0 ? (int)processors : 1;
+ }
+ threads = (int)((size_t)threads < input->available / (64 * 1024) ? (size_t)threads : input->available / (64 * 1024));
+ Reference* records = Grammar__recordsReference(this, record);
+
+
+ if (threads <= 1 || records == NULL || input->move != String_move) {
+  ParsingResult* result = Grammar_parseIterator(this, input);
+  result->context->freeIterator = 1;
+  return result;
+ }
+
+ clock_t t1 = clock();
+ ParsingChunk* chunks = (ParsingChunk*) gc_calloc(threads, sizeof(ParsingChunk)) ; assert (chunks!=NULL); ;
+ ParsingParallel parallel = {this, record, input, chunks, 0, 0};
+ parallel.count = ParsingParallel__split(&parallel, isBoundary == NULL ? Boundary_Line : isBoundary, threads);
+ pthread_t* workers = (pthread_t*) gc_calloc(parallel.count, sizeof(pthread_t)) ; assert (workers!=NULL); ;
+ int started = 0;
+ for (size_t i=1 ; i<parallel.count ; i++) {
+  if (pthread_create(&workers[started], NULL, ParsingParallel__work, &parallel) == 0) {started++;}
+ }
+ ParsingParallel__work(&parallel);
+ for (int i=0 ; i<started ; i++) {
+  pthread_join(workers[i], NULL);
+ }
+ if (workers!=NULL) {; gc_free(workers); } ;
+
+
+
+
+
+ ParsingContext* context = ParsingContext_new(this, input);
+ context->freeIterator = 1;
+ Match* head = NULL;
+ Match* tail = NULL;
+ size_t cursor = 0;
+ size_t end = 0;
+ 
+_Bool 
+                failed = 0;
+ for (size_t i=0 ; i<parallel.count ; i++) {
+  ParsingChunk* chunk = &chunks[i];
+  if (failed || chunk->end <= cursor) {
+   ParsingStats_merge(context->stats, chunk->context->stats);
+   ParsingContext_free(chunk->context);
+   continue;
+  }
+  if (chunk->start != cursor && chunk->first != cursor) {
+   ParsingStats_merge(context->stats, chunk->context->stats);
+   ParsingContext_free(chunk->context);
+   chunk->start = cursor;
+   ParsingChunk__parse(chunk, this, record, input);
+  }
+  if (chunk->records != NULL) {
+   if (head == NULL) {head = chunk->records;} else {tail->next = chunk->records;}
+   tail = chunk->tail;
+   end = chunk->last;
+  }
+  ParsingContext* part = chunk->context;
+  if (part->lastMatchOffset + part->lastMatchLength > context->lastMatchOffset + context->lastMatchLength) {
+   context->lastMatchOffset = part->lastMatchOffset;
+   context->lastMatchLength = part->lastMatchLength;
+   context->lastMatchElementID = part->lastMatchElementID;
+  }
+  ParsingStats_merge(context->stats, part->stats);
+  part->parts = context->parts;
+  context->parts = part;
+  cursor = chunk->next;
+  failed = chunk->failed;
+
+
+  if (chunk->cut) {head = NULL; end = 0;}
+ }
+ if (chunks!=NULL) {; gc_free(chunks); } ;
+
+
+
+ Match* match = FAILURE;
+ if (head != NULL) {
+  Match* reference = Match_SuccessFromReference(end, records, context);
+  reference->offset = 0;
+  reference->children = head;
+  match = Match_Success(end, this->axiom, context);
+  match->offset = 0;
+  match->children = reference;
+ }
+ Iterator_moveTo(input, end);
+ context->stats->parseTime = ((double)clock() - (double)t1) / CLOCKS_PER_SEC;
+ context->stats->bytesRead = end;
+ if (this->stats != NULL) {ParsingStats_merge(this->stats, context->stats);}
+ return ParsingResult_new(match, context);
+}
+static void Match__shift( Match* this, ssize_t delta ) {
+ for (Match* match = this ; match != NULL ; match = match->next) {
+  if ((match->flags & 0x2)) {continue;}
+  match->flags=match->flags|0x2;;
+  match->offset = (size_t)((ssize_t)match->offset + delta);
+  if (match->children != NULL) {Match__shift(match->children, delta);}
+ }
+}
+
+
+static void Match__unshift( Match* this ) {
+ for (Match* match = this ; match != NULL ; match = match->next) {
+  if (!(match->flags & 0x2)) {continue;}
+  match->flags = match->flags & ~0x2;;
+  if (match->children != NULL) {Match__unshift(match->children);}
+ }
+}
+
+static inline size_t Match__end( Match* this ) {
+ return this->offset + this->length;
+}
+
+ParsingResult* Grammar_reparse( Grammar* this, ParsingResult* previous, size_t offset, size_t removed, const char* inserted ) {
+ ParsingContext* context = previous->context;
+ Iterator* iterator = context->iterator;
+ size_t length = iterator->available;
+
+
+ if (iterator->move != String_move || Iterator_textOffset(iterator) != 0 || offset + removed > length) {
+  errno = EINVAL;
+  return NULL;
+ }
+ if (this->elements == NULL) {Grammar_prepare(this);}
+ size_t added = strlen(inserted);
+ ssize_t delta = (ssize_t)added - (ssize_t)removed;
+ size_t edited = offset + removed;
+ size_t updated = offset + added;
+ size_t total = (size_t)((ssize_t)length + delta);
+ char* text = (char*) gc_calloc(total + 1, sizeof(char)) ; assert (text!=NULL); ;
+ memcpy(text, iterator->buffer, offset);
+ memcpy(text + offset, inserted, added);
+ memcpy(text + updated, iterator->buffer + edited, length - edited);
+ text[total] = '\0';
+ size_t consumed = iterator->offset;
+ Iterator__replaceText(iterator, text, total);
+ context->freeIterator = 1;
+
+
+
+ Reference* records = this->axiom != NULL && this->axiom->children != NULL ? Grammar__recordsReference(this, this->axiom->children->element) : NULL;
+ Match* axiom = previous->match;
+ Match* reference = Match_isSuccess(axiom) ? axiom->children : NULL;
+ previous->match = NULL;
+ previous->context = NULL;
+ ParsingResult_free(previous);
+ if (records == NULL || reference == NULL || reference->element != (Element*)records) {
+  Match_free(axiom);
+  context->freeIterator = 0;
+  ParsingContext_free(context);
+  ParsingResult* result = Grammar_parseIterator(this, iterator);
+  result->context->freeIterator = 1;
+  return result;
+ }
+
+ clock_t t1 = clock();
+
+
+ ParsingMemo_forget(context->memo);
+ ParsingElement* record = records->element;
+
+
+
+
+ Match* head = NULL;
+ Match* tail = NULL;
+ Match* old = reference->children;
+ while (old != NULL && Match__end(old) < offset) {
+  if (head == NULL) {head = old;}
+  tail = old;
+  old = old->next;
+ }
+ if (tail != NULL) {tail->next = NULL;}
+ size_t cursor = tail == NULL ? 0 : Match__end(tail);
+
+
+ size_t lastOffset = context->lastMatchOffset;
+ size_t lastLength = context->lastMatchLength;
+ int lastElementID = context->lastMatchElementID;
+ if (lastOffset + lastLength > cursor) {
+  context->lastMatchOffset = tail == NULL ? 0 : tail->offset;
+  context->lastMatchLength = tail == NULL ? 0 : tail->length;
+  context->lastMatchElementID = tail == NULL ? -1 : tail->element->id;
+ }
+ Iterator_moveTo(iterator, cursor);
+ size_t previousCursor = 0;
+ Match* reused = NULL;
+ 
+_Bool 
+       synced = 0;
+ 
+_Bool 
+       cut = 0;
+ while (Iterator_hasMore(iterator)) {
+  if (cursor >= updated) {
+   previousCursor = (size_t)((ssize_t)cursor - delta);
+   while (old != NULL && Match__end(old) < previousCursor) {old = old->next;}
+   if (old != NULL && Match__end(old) == previousCursor && previousCursor >= edited) {
+    reused = old->next;
+    synced = 1;
+    break;
+   }
+  }
+  int choice = ParsingContext__enterChoice(context);
+  Match* match = ParsingElement_recognize(record, context);
+  
+ _Bool 
+        is_cut = ParsingContext__leaveChoice(context, choice);
+  if (Match_isSuccess(match)) {
+   if (head == NULL) {head = match;} else {tail->next = match;}
+   tail = match;
+   if (iterator->offset == cursor) {break;}
+   cursor = iterator->offset;
+  } else {
+   Match_free(match);
+   if (is_cut || ParsingElement_skip(record, context) == 0) {
+    cut = is_cut;
+    break;
+   }
+  }
+ }
+ if (synced) {
+
+  if (reused != NULL) {
+   Match__shift(reused, delta);
+   Match__unshift(reused);
+   if (head == NULL) {head = reused;} else {tail->next = reused;}
+   while (reused->next != NULL) {reused = reused->next;}
+   cursor = Match__end(reused);
+  }
+  Iterator_moveTo(iterator, (size_t)((ssize_t)consumed + delta));
+  if (lastOffset >= previousCursor && lastOffset + lastLength + delta > context->lastMatchOffset + context->lastMatchLength) {
+   context->lastMatchOffset = (size_t)((ssize_t)lastOffset + delta);
+   context->lastMatchLength = lastLength;
+   context->lastMatchElementID = lastElementID;
+  }
+ } else if (tail != NULL) {
+
+
+  cursor = Match__end(tail);
+  Iterator_moveTo(iterator, cursor);
+ }
+
+
+ Match* match = FAILURE;
+ if (head != NULL && !cut) {
+  reference->children = head;
+  reference->length = cursor;
+  axiom->length = cursor;
+  match = axiom;
+ } else {
+  Iterator_moveTo(iterator, 0);
+ }
+ context->stats->parseTime = ((double)clock() - (double)t1) / CLOCKS_PER_SEC;
+ context->stats->bytesRead = iterator->offset;
+ if (this->stats != NULL) {ParsingStats_merge(this->stats, context->stats);}
+ return ParsingResult_new(match, context);
+}
+typedef struct ParsingProgramFrame {
+ int ret;
+ Element* element;
+ size_t offset;
+ ParsingArenaMark mark;
+ Match* result;
+ Match* tail;
+ int count;
+ size_t iteration;
+ size_t endOffset;
+ Reference** candidates;
+ Reference* next;
+ 
+_Bool 
+                  filtered;
+ 
+_Bool 
+                  retried;
+ int cut;
+ 
+_Bool 
+                  committed;
+} ParsingProgramFrame;
+
+static int ParsingProgram__emit( ParsingProgram* this, char op, int a, int b, void* element ) {
+ if (this->length == this->capacity) {
+  this->capacity *= 2;
+  this->code=gc_realloc(this->code,(size_t)this->capacity * sizeof(ParsingInstruction)); ;
+ }
+ ParsingInstruction* instruction = &this->code[this->length];
+ instruction->op = op;
+ instruction->a = a;
+ instruction->b = b;
+ instruction->element = element;
+ return this->length++;
+}
+
+
+
+static inline 
+             _Bool 
+                  ParsingProgram__isBlock( ParsingElement* element ) {
+ return (element->type == 'G' && element->recognize == Group_recognize)
+     || (element->type == 'R' && element->recognize == Rule_recognize);
+}
+
+static void ParsingProgram__emitElement( ParsingProgram* this, ParsingElement* element ) {
+ if (ParsingProgram__isBlock(element) && element->id >= 0 && element->id < this->count) {
+  ParsingProgram__emit(this, 1, element->id, 0, element);
+ } else {
+  ParsingProgram__emit(this, 2, 0, 0, element);
+ }
+}
+
+
+
+static void ParsingProgram__emitReference( ParsingProgram* this, Reference* reference ) {
+ ParsingProgram__emit(this, 4, 0, 0, reference);
+ int loop = ParsingProgram__emit(this, 5, 0, 0, reference);
+ ParsingProgram__emitElement(this, reference->element);
+ int step = ParsingProgram__emit(this, 6, loop, 0, reference);
+ int exit = ParsingProgram__emit(this, 7, 0, 0, reference);
+ this->code[loop].a = exit;
+ this->code[step].b = exit;
+}
+
+static void ParsingProgram__emitGroup( ParsingProgram* this, ParsingElement* group ) {
+ ParsingProgram__emit(this, 8, 0, 0, group);
+
+
+ int commits = -1;
+ for (Reference* child = group->children ; child != NULL ; child = child->next) {
+  int choice = ParsingProgram__emit(this, 9, 0, 0, child);
+  ParsingProgram__emitReference(this, child);
+  commits = ParsingProgram__emit(this, 10, commits, 0, group);
+  this->code[choice].a = this->length;
+ }
+ int fail = ParsingProgram__emit(this, 11, 0, 0, group);
+ int end = ParsingProgram__emit(this, 3, 0, 0, group);
+ while (commits >= 0) {
+  int previous = this->code[commits].a;
+  this->code[commits].a = end;
+  this->code[commits].b = fail;
+  commits = previous;
+ }
+}
+
+static void ParsingProgram__emitRule( ParsingProgram* this, ParsingElement* rule ) {
+ ParsingProgram__emit(this, 12, 0, 0, rule);
+
+
+ int steps = -1;
+ for (Reference* child = rule->children ; child != NULL ; child = child->next) {
+  int start = this->length;
+  ParsingProgram__emitReference(this, child);
+  steps = ParsingProgram__emit(this, 13, start, steps, rule);
+ }
+
+ int success = rule->children == NULL ? -1 : ParsingProgram__emit(this, 14, 0, 0, rule);
+ int failure = ParsingProgram__emit(this, 15, 0, 0, rule);
+ int end = ParsingProgram__emit(this, 3, 0, 0, rule);
+ if (success >= 0) {this->code[success].a = end;}
+ while (steps >= 0) {
+  int previous = this->code[steps].b;
+  this->code[steps].b = failure;
+  steps = previous;
+ }
+}
+
+ParsingProgram* ParsingProgram_new( Grammar* grammar ) {
+ ParsingProgram* this = (ParsingProgram*) gc_new(sizeof(ParsingProgram)); assert (this!=NULL); ;
+ ParsingInstruction* code = (ParsingInstruction*) gc_calloc(256, sizeof(ParsingInstruction)) ; assert (code!=NULL); ;
+ this->code = code;
+ this->length = 0;
+ this->capacity = 256;
+ this->count = grammar->axiomCount + grammar->skipCount + 1;
+ int* entries = (int*) gc_calloc((size_t)this->count, sizeof(int)) ; assert (entries!=NULL); ;
+ this->entries = entries;
+ for (int i=0 ; i<this->count ; i++) {
+  this->entries[i] = -1;
+ }
+
+
+ ParsingProgram__emitElement(this, grammar->axiom);
+ ParsingProgram__emit(this, 0, 0, 0, NULL);
+ for (int i=0 ; i<this->count ; i++) {
+  Element* e = grammar->elements[i];
+  if (e == NULL || !ParsingElement_Is(e) || !ParsingProgram__isBlock((ParsingElement*)e)) {continue;}
+  this->entries[i] = this->length;
+  if (e->type == 'G') {
+   ParsingProgram__emitGroup(this, (ParsingElement*)e);
+  } else {
+   ParsingProgram__emitRule(this, (ParsingElement*)e);
+  }
+ }
+
+ for (int i=0 ; i<this->length ; i++) {
+  if (this->code[i].op == 1 && this->entries[this->code[i].a] < 0) {
+   this->code[i].op = 2;
+  }
+ }
+ return this;
+}
+
+void ParsingProgram_free( ParsingProgram* this ) {
+ if (this != NULL) {
+  if (this->code!=NULL) {; gc_free(this->code); } ;
+  if (this->entries!=NULL) {; gc_free(this->entries); } ;
+ }
+ if (this!=NULL) {; gc_free(this); } ;
+}
+
+
+
+
+
+Match* ParsingProgram_run( ParsingProgram* this, ParsingContext* context ) {
+ Iterator* iterator = context->iterator;
+ ParsingMemo* memo = context->memo;
+ int capacity = 256;
+ int top = 0;
+ ParsingProgramFrame* stack = (ParsingProgramFrame*) gc_calloc((size_t)capacity, sizeof(ParsingProgramFrame)) ; assert (stack!=NULL); ;
+ ParsingProgramFrame* frame = NULL;
+ Match* match = FAILURE;
+ int pc = 0;
+
+
+
+
+
+
+
+ while (1) {
+  ParsingInstruction* instruction = &this->code[pc];
+  switch (instruction->op) {
+
+  case 0:
+   if (stack!=NULL) {; gc_free(stack); } ;
+   return match;
+
+  case 2:
+   match = ParsingElement_recognize((ParsingElement*)instruction->element, context);
+   pc++;
+   break;
+
+  case 1: {
+   ParsingElement* element = (ParsingElement*)instruction->element;
+   if (memo != NULL && ParsingElement_isMemoizable(element)) {
+    ParsingMemoEntry* entry = ParsingMemo_get(memo, element->id, iterator->offset);
+    if (entry != NULL) {
+     if (entry->match == NULL) {
+      match = FAILURE;
+     } else {
+      match = Match__share(entry->match, context->arena);
+      if (entry->end != iterator->offset) {Iterator_moveTo(iterator, entry->end);}
+     }
+     match = ParsingContext_registerMatch(context, (Element*)element, match);
+     pc++;
+     break;
+    }
+   }
+   if (top == capacity) {capacity *= 2; stack=gc_realloc(stack,(size_t)capacity * sizeof(ParsingProgramFrame)); ;} frame = &stack[top++];
+   frame->ret = pc + 1;
+   frame->element = (Element*)element;
+   frame->offset = iterator->offset;
+   frame->mark = ParsingArena_mark(context->arena);
+   pc = this->entries[instruction->a];
+   break;
+  }
+
+  case 3: {
+   ParsingElement* element = (ParsingElement*)frame->element;
+   if (!Match_isSuccess(match)) {ParsingArena_rewind(context->arena, frame->mark);}
+   if (memo != NULL && ParsingElement_isMemoizable(element) && (Match_isSuccess(match) || !(element->flags & 0x4))) {
+    ParsingMemo_set(memo, element->id, frame->offset, iterator->offset, match);
+   }
+   pc = frame->ret;
+   top--; frame = top > 0 ? &stack[top - 1] : NULL;
+   break;
+  }
+
+  case 4:
+   if (top == capacity) {capacity *= 2; stack=gc_realloc(stack,(size_t)capacity * sizeof(ParsingProgramFrame)); ;} frame = &stack[top++];
+   frame->element = (Element*)instruction->element;
+   frame->offset = iterator->offset;
+   frame->result = FAILURE;
+   frame->tail = NULL;
+   frame->count = 0;
+   frame->endOffset = iterator->offset;
+   frame->committed = 0;
+   pc++;
+   break;
+
+  case 5: {
+   Reference* reference = (Reference*)frame->element;
+   char type = reference->element->type;
+   if (Iterator_hasMore(iterator) || type == 'p' || type == 'c') {
+    frame->iteration = iterator->offset;
+    if (reference->cardinality != '1') {frame->cut = ParsingContext__enterChoice(context);}
+    pc++;
+   } else {
+    pc = instruction->a;
+   }
+   break;
+  }
+
+  case 6: {
+   Reference* reference = (Reference*)frame->element;
+   size_t parsed = iterator->offset - frame->iteration;
+   pc = instruction->a;
+   if (reference->cardinality != '1' && ParsingContext__leaveChoice(context, frame->cut) && !Match_isSuccess(match)) {
+    match = Match_free(match);
+    frame->committed = 1;
+    pc = instruction->b;
+    break;
+   }
+   if (Match_isSuccess(match)) {
+    frame->endOffset = match->offset + match->length;
+    if (frame->count == 0) {
+     frame->result = frame->tail = match;
+     if (parsed == 0 || reference->cardinality == '1' || reference->cardinality == '?') {
+      pc = instruction->b;
+     }
+     frame->count++;
+    } else {
+     frame->tail = frame->tail->next = match;
+     if (parsed == 0) {
+      pc = instruction->b;
+     } else {
+      frame->count++;
+     }
+    }
+   } else {
+    match = Match_free(match);
+    if (ParsingElement_skip((ParsingElement*)reference, context) == 0) {
+     pc = instruction->b;
+    }
+   }
+   if (frame->offset == iterator->offset) {pc = instruction->b;}
+   break;
+  }
+
+  case 7: {
+   Reference* reference = (Reference*)frame->element;
+   Match* result = frame->result;
+   if (iterator->offset != frame->endOffset) {
+    Iterator_backtrack(iterator, frame->endOffset);
+   }
+   
+  _Bool 
+       is_success = Match_isSuccess(result) ? 1 : 0;
+   switch (reference->cardinality) {
+    case '1':
+    case '+':
+     break;
+    case '?':
+    case '*':
+     is_success = 1;
+     break;
+    case '=':
+     if (is_success && result->length == 0) {is_success = 0;}
+     break;
+    default:
+     fprintf(stderr, "ERR ");fprintf(stderr, "Unsupported cardinality %c", reference->cardinality);fprintf(stderr, "\n");;
+     is_success = 0;
+   }
+   if (frame->committed) {is_success = 0;}
+   if (is_success) {
+    Match* m = Match_SuccessFromReference(iterator->offset - frame->offset, reference, context);
+    m->children = result == FAILURE ? NULL : result;
+    m->offset = frame->offset;
+    match = ParsingContext_registerMatch(context, (Element*)reference, m);
+   } else {
+    Match_fail(result);
+    match = ParsingContext_registerMatch(context, (Element*)reference, FAILURE);
+   }
+   top--; frame = top > 0 ? &stack[top - 1] : NULL;
+   pc++;
+   break;
+  }
+
+  case 8: {
+   GroupConfig* config = (GroupConfig*)((ParsingElement*)frame->element)->config;
+   frame->filtered = 0;
+   frame->candidates = NULL;
+   frame->next = NULL;
+   if (config != NULL && Iterator_hasMore(iterator)) {
+    Reference** candidates = config->dispatch[(unsigned char)(*iterator->current)];
+    if (candidates != NULL) {
+     frame->filtered = 1;
+     if (config->words != NULL) {
+      frame->next = WordTrie_match(config->words, iterator->current, Iterator_remaining(iterator));
+     } else {
+      frame->next = *candidates;
+      frame->candidates = candidates;
+     }
+    }
+   }
+   pc++;
+   break;
+  }
+
+  case 9:
+   if (frame->filtered) {
+    if (frame->next != (Reference*)instruction->element) {
+     pc = instruction->a;
+     break;
+    }
+    frame->next = frame->candidates != NULL ? *(++frame->candidates) : NULL;
+   }
+   frame->cut = ParsingContext__enterChoice(context);
+   pc++;
+   break;
+
+  case 10: {
+   
+  _Bool 
+       committed = ParsingContext__leaveChoice(context, frame->cut);
+   if (Match_isSuccess(match)) {
+    ParsingElement* group = (ParsingElement*)frame->element;
+    Match* result = Match_Success(match->length, group, context);
+    result->offset = frame->offset;
+    result->children = match;
+    match = ParsingContext_registerMatch(context, (Element*)group, result);
+    pc = instruction->a;
+   } else {
+    match = Match_free(match);
+    pc = committed ? instruction->b : pc + 1;
+   }
+   break;
+  }
+
+  case 11:
+   if (iterator->offset != frame->offset) {
+    Iterator_backtrack(iterator, frame->offset);
+   }
+   match = ParsingContext_registerMatch(context, frame->element, FAILURE);
+   pc++;
+   break;
+
+  case 12:
+   if (!(((ParsingElement*)frame->element)->flags & 0x20)) {ParsingContext_push(context);}
+   frame->result = FAILURE;
+   frame->tail = NULL;
+   frame->retried = 0;
+   pc++;
+   break;
+
+  case 13: {
+   ParsingElement* rule = (ParsingElement*)frame->element;
+   if (!Match_isSuccess(match)) {
+
+
+    match = Match_free(match);
+    if (!frame->retried && ParsingElement_skip(rule, context) > 0) {
+     frame->retried = 1;
+     pc = instruction->a;
+    } else {
+     pc = instruction->b;
+    }
+    break;
+   }
+   if (frame->tail == NULL) {
+    frame->result = Match_Success(match->length, rule, context);
+    frame->result->offset = frame->offset;
+    frame->result->children = frame->tail = match;
+   } else {
+    frame->tail = frame->tail->next = match;
+   }
+   frame->retried = 0;
+   pc++;
+   break;
+  }
+
+  case 14: {
+   if (!(((ParsingElement*)frame->element)->flags & 0x20)) {ParsingContext_pop(context);}
+   Match* result = frame->result;
+   result->length = frame->tail->offset - result->offset + frame->tail->length;
+   match = ParsingContext_registerMatch(context, frame->element, result);
+   pc = instruction->a;
+   break;
+  }
+
+  case 15:
+   if (!(((ParsingElement*)frame->element)->flags & 0x20)) {ParsingContext_pop(context);}
+   Match_fail(frame->result);
+   if (iterator->offset != frame->offset) {
+    Iterator_backtrack(iterator, frame->offset);
+   }
+   match = ParsingContext_registerMatch(context, frame->element, FAILURE);
+   pc++;
+   break;
+
+  default:
+   fprintf(stderr, "ERR ");fprintf(stderr, "ParsingProgram_run: unknown opcode %d at %d", instruction->op, pc);fprintf(stderr, "\n");;
+   if (stack!=NULL) {; gc_free(stack); } ;
+   return FAILURE;
+  }
+ }
+
+
+
+}
+
+
+
+
+
+
+
+Processor* Processor_new() {
+ Processor* this = (Processor*) gc_new(sizeof(Processor)); assert (this!=NULL); ;
+ this->callbacksCount = 100;
+ ProcessorCallback* callbacks = (ProcessorCallback*) gc_calloc((size_t)this->callbacksCount, sizeof(ProcessorCallback)) ; assert (callbacks!=NULL); ;
+ ProcessorNodeCallback* nodeCallbacks = (ProcessorNodeCallback*) gc_calloc((size_t)this->callbacksCount, sizeof(ProcessorNodeCallback)) ; assert (nodeCallbacks!=NULL); ;
+ this->callbacks = callbacks;
+ this->nodeCallbacks = nodeCallbacks;
+ this->fallback = NULL;
+ return this;
+}
+
+void Processor_free(Processor* this) {
+ if (this != NULL) {
+  if (this->callbacks!=NULL) {; gc_free(this->callbacks); } ;
+  if (this->nodeCallbacks!=NULL) {; gc_free(this->nodeCallbacks); } ;
+ }
+ if (this!=NULL) {; gc_free(this); } ;
+}
+
+static void Processor__reserve (Processor* this, int symbolID) {
+ if (this->callbacksCount < (symbolID + 1)) {
+  int cur_count = this->callbacksCount;
+  int new_count = symbolID + 100;
+  this->callbacks=gc_realloc(this->callbacks,new_count * sizeof(ProcessorCallback)); ;
+  this->nodeCallbacks=gc_realloc(this->nodeCallbacks,new_count * sizeof(ProcessorNodeCallback)); ;
+  this->callbacksCount = new_count;
+
+  while (cur_count < new_count) {
+   this->callbacks[cur_count] = NULL;
+   this->nodeCallbacks[cur_count] = NULL;
+   cur_count++;
+  }
+ }
+}
+
+void Processor_register (Processor* this, int symbolID, ProcessorCallback callback ) {
+ Processor__reserve(this, symbolID);
+ this->callbacks[symbolID] = callback;
+}
+
+void Processor_registerNode (Processor* this, int symbolID, ProcessorNodeCallback callback ) {
+ Processor__reserve(this, symbolID);
+ this->nodeCallbacks[symbolID] = callback;
+}
+
+int Processor_process (Processor* this, Match* match, int step) {
+ ProcessorCallback handler = this->fallback;
+ if (ParsingElement_Is(match->element)) {
+  int element_id = ((ParsingElement*)match->element)->id;
+  if (element_id >= 0 && element_id < this->callbacksCount) {
+   handler = this->callbacks[element_id];
+  }
+ }
+ if (handler != NULL) {
+  handler (this, match);
+ } else {
+  Match* child = match->children;
+  while (child) {
+   step = Processor_process(this, child, step);
+   child = child->next;
+  }
+ }
+ return step;
+}
+
+int Processor_processTree (Processor* this, MatchTree* tree, int node, int step) {
+ ProcessorNodeCallback handler = NULL;
+ int element_id = tree->elements[node];
+ if (element_id < this->callbacksCount && ParsingElement_Is(tree->grammar->elements[element_id])) {
+  handler = this->nodeCallbacks[element_id];
+ }
+ if (handler != NULL) {
+  handler (this, tree, node);
+ } else {
+  int child = tree->children[node];
+  while (child >= 0) {
+   step = Processor_processTree(this, tree, child, step);
+   child = tree->next[child];
   }
  }
  return step;
@@ -2,6 +2,14 @@
 
 typedef char bool;
 
+/* The system headers that the sources leave out with WITH_CFFI, and that
+   Python.h does not include */
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <pthread.h>
+#include <time.h>
+
 /* PCRE */
 #define PCRE_CASELESS           0x00000001  /* C1       */
 #define PCRE_MULTILINE          0x00000002  /* C1       */
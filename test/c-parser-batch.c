@@ -0,0 +1,94 @@
+#include "parsing.h"
+#include "testing.h"
+
+/**
+ * This test case exercises the following:
+ *
+ * - A batch of files parsed by threads sharing the grammar yields the
+ *   same results as parsing the files one after the other
+ * - The results are in the order of the paths, whatever the number of
+ *   threads, and a path that can't be opened yields NULL
+ * - The stats of a profiled batch are merged into the grammar
+*/
+
+#define FILES 16
+
+Grammar* createGrammar() {
+	Grammar* g = Grammar_new();
+
+	SYMBOL (WS,             TOKEN("\\s+"));
+	SYMBOL (NUMBER,         TOKEN("\\d+"));
+	SYMBOL (NAME,           TOKEN("\\w+"));
+	SYMBOL (EQUAL,          WORD("="));
+	SYMBOL (SEMICOLON,      WORD(";"));
+	SYMBOL (Value,          GROUP( _S(NUMBER), _S(NAME)));
+	SYMBOL (Assignment,     RULE ( _S(NAME), _S(EQUAL), _S(Value), _S(SEMICOLON)));
+	SYMBOL (Assignments,    RULE ( _MO(Assignment)));
+
+	AXIOM(Assignments);
+	SKIP(WS);
+
+	return g;
+}
+
+bool ParsingResult_isSame(ParsingResult* a, ParsingResult* b) {
+	return a != NULL && b != NULL
+		&& a->status == b->status
+		&& a->context->iterator->offset == b->context->iterator->offset
+		&& Match_countAll(a->match) == Match_countAll(b->match);
+}
+
+int main (int argc, char** argv) {
+	Grammar* g = createGrammar();
+
+	// We write files of different sizes, every third one being invalid
+	char  paths[FILES + 1][64];
+	const char* batch[FILES + 1];
+	for (int i=0 ; i<FILES ; i++) {
+		snprintf(paths[i], 64, "/tmp/libparsing-batch-%d-%d.txt", (int)getpid(), i);
+		FILE* f = fopen(paths[i], "w");
+		for (int j=0 ; j<(i + 1) * 100 ; j++) {fprintf(f, "%sa%d = %d;", j == 0 ? "" : "\n", j, i * j);}
+		if (i % 3 == 2) {fprintf(f, " invalid");}
+		fclose(f);
+		batch[i] = paths[i];
+	}
+	snprintf(paths[FILES], 64, "/tmp/libparsing-batch-%d-missing.txt", (int)getpid());
+	batch[FILES] = paths[FILES];
+
+	ParsingResult* expected[FILES];
+	for (int i=0 ; i<FILES ; i++) {
+		expected[i] = Grammar_parsePath(g, paths[i]);
+		TEST_TRUE((expected[i] != NULL));
+		TEST_TRUE((expected[i]->status == (i % 3 == 2 ? STATUS_PARTIAL : STATUS_SUCCESS)));
+	}
+
+	int threads[] = {1, 4, 0, 64};
+	for (int t=0 ; t<4 ; t++) {
+		ParsingResult** results = Grammar_parseBatch(g, batch, FILES + 1, threads[t]);
+		for (int i=0 ; i<FILES ; i++) {
+			TEST_TRUE(ParsingResult_isSame(results[i], expected[i]));
+		}
+		TEST_TRUE((results[FILES] == NULL));
+		ParsingResult_freeBatch(results, FILES + 1);
+	}
+
+	// An empty batch
+	ParsingResult_freeBatch(Grammar_parseBatch(g, batch, 0, 0), 0);
+
+	// The stats of each parse are merged into the grammar
+	Grammar_enableProfiling(g);
+	ParsingResult** results = Grammar_parseBatch(g, batch, FILES, 4);
+	size_t bytes = 0;
+	for (int i=0 ; i<FILES ; i++) {bytes += results[i]->context->iterator->offset;}
+	TEST_TRUE((g->stats->bytesRead == bytes));
+	ParsingResult_freeBatch(results, FILES);
+	Grammar_disableProfiling(g);
+
+	for (int i=0 ; i<FILES ; i++) {
+		ParsingResult_free(expected[i]);
+		unlink(paths[i]);
+	}
+	Grammar_free(g);
+	TEST_SUCCEED;
+	return 0;
+}
@@ -0,0 +1,213 @@
+#include "parsing.h"
+#include "testing.h"
+
+/**
+ * This test case exercises the following:
+ *
+ * - A match tree written in the binary format is read back as the same
+ *   tree, with the same token groups, from memory or from a mapped file
+ * - A `MatchReader` goes through the nodes in pre-order
+ * - Data that is corrupted, or written for another grammar, is rejected
+ * - Nodes past the input, groups past their node, and groups on other
+ *   elements than tokens are rejected
+*/
+
+#define VALUES 2000
+
+Grammar* createGrammar(const char* pairName) {
+	Grammar* g = Grammar_new();
+
+	SYMBOL (WS,             TOKEN("\\s+"));
+	SYMBOL (NUMBER,         TOKEN("\\d+"));
+	SYMBOL (STRING,         TOKEN("'([^']*)'"));
+	SYMBOL (PAIR,           TOKEN("(\\w+):(\\w+)?"));
+	SYMBOL (TRUE_,          WORD("true"));
+	SYMBOL (Value,          GROUP( _S(NUMBER), _S(STRING), _S(PAIR), _S(TRUE_)));
+	SYMBOL (Values,         RULE ( _AS(_MO(Value), "values")));
+
+	ParsingElement_name(s_PAIR, pairName);
+	AXIOM(Values);
+	SKIP(WS);
+
+	return g;
+}
+
+Writer* Match_toJSON(Match* match) {
+	Writer* writer = Writer_new();
+	Match_dumpJSON(match, writer);
+	return writer;
+}
+
+bool Match_isSameJSON(Match* a, Match* b) {
+	Writer* wa = Match_toJSON(a);
+	Writer* wb = Match_toJSON(b);
+	bool same  = wa->length == wb->length && memcmp(wa->data, wb->data, wa->length) == 0;
+	Writer_free(wa);
+	Writer_free(wb);
+	return same;
+}
+
+// Finds the position and element id of the first node of the given type
+bool Binary_findNode(Writer* binary, char type, size_t* position, int* id) {
+	MatchReader* reader = MatchReader_new(binary->data, binary->length);
+	MatchNode    node;
+	bool         found  = FALSE;
+	*position = reader->position;
+	while (!found && MatchReader_next(reader, &node)) {
+		if (node.type == type) {
+			*id   = node.id;
+			found = TRUE;
+		} else {
+			*position = reader->position;
+		}
+	}
+	MatchReader_free(reader);
+	return found;
+}
+
+// Finds the first match of a token with the given number of groups
+Match* Match_findToken(Match* match, int groups) {
+	for ( ; match != NULL ; match = match->next) {
+		if (match->element != NULL && match->element->type == TYPE_TOKEN && TokenMatch_count(match) == groups) {return match;}
+		Match* found = Match_findToken(match->children, groups);
+		if (found != NULL) {return found;}
+	}
+	return NULL;
+}
+
+bool Grammar_readsBinary(Grammar* g, const char* text, Writer* binary) {
+	Iterator*      iterator = Iterator_FromString(text);
+	ParsingResult* r        = Grammar_readBinary(g, iterator, binary->data, binary->length);
+	bool           read     = r != NULL;
+	if (r != NULL) {ParsingResult_free(r);}
+	Iterator_free(iterator);
+	return read;
+}
+
+int main (int argc, char** argv) {
+	Grammar* g = createGrammar("PAIR");
+	Writer* input = Writer_new();
+	for (int i=0 ; i<VALUES ; i++) {
+		Writer_printf(input, "%s%d 'value %d' key%d:%s true", i == 0 ? "" : " ", i, i, i, i % 2 ? "v" : "");
+	}
+	ParsingResult* r = Grammar_parseString(g, input->data);
+	TEST_TRUE((r->status == STATUS_SUCCESS));
+
+	Writer* binary = Writer_new();
+	Match_writeBinary(r->match, binary);
+	Writer* json   = Match_toJSON(r->match);
+	TEST_TRUE((binary->length * 4 < json->length));
+	Writer_free(json);
+
+	// The tree is read back for the same input
+	ParsingResult* copy = Grammar_readBinary(g, Iterator_FromString(input->data), binary->data, binary->length);
+	copy->context->freeIterator = TRUE;
+	TEST_TRUE((copy->status == r->status));
+	TEST_TRUE(Match_isSame(r->match, copy->match));
+	TEST_TRUE(Match_isSameJSON(r->match, copy->match));
+	ParsingResult_free(copy);
+
+	// The reader goes through the nodes in pre-order
+	MatchReader* reader = MatchReader_new(binary->data, binary->length);
+	MatchNode    node;
+	size_t       nodes   = 0;
+	size_t       tokens  = 0;
+	size_t       pending = 1;
+	while (MatchReader_next(reader, &node)) {
+		if (nodes == 0) {TEST_TRUE((strcmp(node.name, "Values") == 0 && node.offset == 0));}
+		if (node.type == TYPE_TOKEN) {
+			tokens++;
+			TEST_TRUE((node.groups >= 1 && node.spans[0] == 0 && node.spans[1] == (int)node.length));
+		}
+		pending += node.children - 1;
+		nodes++;
+	}
+	TEST_TRUE((nodes == reader->count && pending == 0));
+	TEST_TRUE((tokens == VALUES * 3));
+	MatchReader_free(reader);
+
+	// From a mapped file
+	FILE* file = tmpfile();
+	Writer* stream = Writer_FromFile(file);
+	Match_writeBinary(r->match, stream);
+	Writer_free(stream);
+	fflush(file);
+	char* data = (char*)mmap(NULL, binary->length, PROT_READ, MAP_PRIVATE, fileno(file), 0);
+	TEST_TRUE((data != MAP_FAILED));
+	copy = Grammar_readBinary(g, Iterator_FromString(input->data), data, binary->length);
+	copy->context->freeIterator = TRUE;
+	TEST_TRUE(Match_isSame(r->match, copy->match));
+	ParsingResult_free(copy);
+	munmap(data, binary->length);
+	fclose(file);
+
+	// Corrupted and truncated data, and data for another grammar
+	Iterator* iterator = Iterator_FromString(input->data);
+	TEST_TRUE((Grammar_readBinary(g, iterator, binary->data, binary->length - 1) == NULL));
+	TEST_TRUE((Grammar_readBinary(g, iterator, binary->data + 1, binary->length - 1) == NULL));
+	binary->data[binary->length / 2] ^= 0x55;
+	ParsingResult* corrupted = Grammar_readBinary(g, iterator, binary->data, binary->length);
+	if (corrupted != NULL) {ParsingResult_free(corrupted);}
+	binary->data[binary->length / 2] ^= 0x55;
+	Grammar* other = createGrammar("ITEM");
+	TEST_TRUE((Grammar_readBinary(other, iterator, binary->data, binary->length) == NULL));
+	Grammar_free(other);
+
+	// Nodes that are past the input, like the ones written for a longer one
+	const char* text = "1 'a' true";
+	ParsingResult* small = Grammar_parseString(g, text);
+	Writer* tree = Writer_new();
+	Match_writeBinary(small->match, tree);
+	TEST_TRUE(Grammar_readsBinary(g, text, tree));
+	TEST_FALSE(Grammar_readsBinary(g, "1 'a'", tree));
+
+	// Token groups that are past their node
+	Match* found = Match_findToken(small->match, 2);
+	TEST_TRUE((found != NULL && found->offset == 2));
+	TokenMatch* string = (TokenMatch*)found->data;
+	string->spans[3] += 10;
+	Writer_free(tree);
+	tree = Writer_new();
+	Match_writeBinary(small->match, tree);
+	string->spans[3] -= 10;
+	TEST_FALSE(Grammar_readsBinary(g, text, tree));
+	Writer_free(tree);
+	tree = Writer_new();
+	Match_writeBinary(small->match, tree);
+
+	// A token without groups, and a word with groups, by swapping the
+	// (single byte) ids of a token node and of a word node
+	size_t tokenAt = 0;
+	size_t wordAt  = 0;
+	int    token   = 0;
+	int    word    = 0;
+	TEST_TRUE((Binary_findNode(tree, TYPE_TOKEN, &tokenAt, &token) && token < 128));
+	TEST_TRUE((Binary_findNode(tree, TYPE_WORD,  &wordAt,  &word)  && word  < 128));
+	tree->data[wordAt] = (char)token;
+	TEST_FALSE(Grammar_readsBinary(g, text, tree));
+	tree->data[wordAt]  = (char)word;
+	tree->data[tokenAt] = (char)word;
+	TEST_FALSE(Grammar_readsBinary(g, text, tree));
+	tree->data[tokenAt] = (char)token;
+	TEST_TRUE(Grammar_readsBinary(g, text, tree));
+	Writer_free(tree);
+	ParsingResult_free(small);
+
+	// A failed parse, where the values match nothing
+	ParsingResult* failed = Grammar_parseString(g, "+");
+	Writer* empty = Writer_new();
+	Match_writeBinary(failed->match, empty);
+	copy = Grammar_readBinary(g, iterator, empty->data, empty->length);
+	TEST_TRUE((copy != NULL && copy->status == STATUS_FAILED && Match_isSame(copy->match, failed->match)));
+	ParsingResult_free(copy);
+	ParsingResult_free(failed);
+	Writer_free(empty);
+	Iterator_free(iterator);
+
+	Writer_free(binary);
+	Writer_free(input);
+	ParsingResult_free(r);
+	Grammar_free(g);
+	TEST_SUCCEED;
+	return 0;
+}
@@ -0,0 +1,105 @@
+#include "parsing.h"
+#include "testing.h"
+
+/**
+ * This test case exercises the following:
+ *
+ * - A match buffer has a record for each match, in pre-order, with the
+ *   same values as the match and links to its parent and next sibling
+ * - The spans of token groups are the ones of the tokens, as offsets in
+ *   the input
+ * - The records and spans are contiguous in the buffer's data
+*/
+
+#define VALUES 3000
+
+Grammar* createGrammar() {
+	Grammar* g = Grammar_new();
+
+	SYMBOL (WS,             TOKEN("\\s+"));
+	SYMBOL (PAIR,           TOKEN("(\\w+)(:(\\d+))?"));
+	SYMBOL (COMMA,          WORD(","));
+	SYMBOL (LP,             WORD("("));
+	SYMBOL (RP,             WORD(")"));
+	SYMBOL (Rest,           RULE ( _S(COMMA), _S(PAIR)));
+	SYMBOL (List,           RULE ( _S(LP), _S(PAIR), _MO(Rest), _S(RP)));
+	SYMBOL (Lists,          RULE ( _MO(List)));
+
+	AXIOM(Lists);
+	SKIP(WS);
+
+	return g;
+}
+
+// Tells if the records from the given one are the same as the matches,
+// returning the index of the record that follows them, or -1.
+int MatchBuffer_isSame(MatchBuffer* buffer, int index, int parent, Match* match) {
+	int previous = -1;
+	while (match != NULL) {
+		if (index < 0 || index >= buffer->count) {return -1;}
+		MatchRecord* record = &buffer->records[index];
+		if (record->type   != match->element->type
+		||  record->id     != match->element->id
+		||  record->offset != Match_getOffset(match)
+		||  record->length != Match_getLength(match)
+		||  record->parent != parent) {
+			return -1;
+		}
+		if (previous >= 0 && buffer->records[previous].next != index) {return -1;}
+		if (match->element->type == TYPE_TOKEN) {
+			TokenMatch* token = (TokenMatch*)match->data;
+			if (record->groups != token->count) {return -1;}
+			for (int i=0 ; i<token->count ; i++) {
+				int start = buffer->spans[record->spans + i * 2];
+				int end   = buffer->spans[record->spans + i * 2 + 1];
+				if (token->spans[i * 2] < 0 ? start != -1 : start != record->offset + token->spans[i * 2] || end != record->offset + token->spans[i * 2 + 1]) {
+					return -1;
+				}
+			}
+		} else if (record->groups != 0) {
+			return -1;
+		}
+		previous = index;
+		index    = MatchBuffer_isSame(buffer, index + 1, index, match->children);
+		// The root's siblings are not part of the buffer
+		match    = parent < 0 ? NULL : match->next;
+	}
+	if (previous >= 0 && buffer->records[previous].next != -1) {return -1;}
+	return index;
+}
+
+int main (int argc, char** argv) {
+	Grammar* g = createGrammar();
+	Writer* input = Writer_new();
+	for (int i=0 ; i<VALUES ; i++) {
+		Writer_printf(input, "%s(a%d, b:%d, c)", i == 0 ? "" : "\n", i, i * 7);
+	}
+	ParsingResult* r = Grammar_parseString(g, input->data);
+	TEST_TRUE((r->status == STATUS_SUCCESS));
+
+	MatchBuffer* buffer = MatchBuffer_new(r->match);
+	TEST_TRUE((buffer != NULL));
+	TEST_TRUE((buffer->count == Match_countAll(r->match) + 1));
+	TEST_TRUE((MatchBuffer_isSame(buffer, 0, -1, r->match) == buffer->count));
+	// Tokens only have the groups up to the last one that matched
+	TEST_TRUE((buffer->spansCount == VALUES * (2 + 4 + 2) * 2));
+	TEST_TRUE((sizeof(MatchRecord) == sizeof(int32_t) * MATCH_RECORD_FIELDS));
+	TEST_TRUE((buffer->size == sizeof(int32_t) * (size_t)(buffer->count * MATCH_RECORD_FIELDS + buffer->spansCount)));
+	TEST_TRUE(((char*)buffer->records == buffer->data && buffer->spans == (int32_t*)buffer->data + buffer->count * MATCH_RECORD_FIELDS));
+
+	// The number of the first `b:0` pair, in its last group
+	char* b = strstr(input->data, "b:0");
+	int   i = 0;
+	while (buffer->records[i].type != TYPE_TOKEN || buffer->records[i].offset != b - input->data) {i++;}
+	TEST_TRUE((buffer->records[i].groups == 4 && buffer->spans[buffer->records[i].spans + 6] == b + 2 - input->data));
+	MatchBuffer_free(buffer);
+
+	// Failed matches have no buffer
+	TEST_TRUE((MatchBuffer_new(FAILURE) == NULL));
+
+	ParsingResult_free(r);
+	Writer_free(input);
+	Grammar_free(g);
+	TEST_SUCCEED;
+	return 0;
+}
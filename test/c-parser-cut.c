@@ -0,0 +1,87 @@
+#include "parsing.h"
+#include "testing.h"
+
+/**
+ * This test case exercises the following:
+ *
+ * - A group fails instead of trying its next alternative once a cut
+ *   was passed in the failing alternative
+ * - The virtual machine commits choices like the recursive engine
+ * - The memoization table drops the entries that precede a cut
+*/
+#define STATEMENTS 20000
+
+Grammar* createGrammar(bool cut) {
+	Grammar* g = Grammar_new();
+
+	SYMBOL (WS,             TOKEN("\\s+"));
+	SYMBOL (NAME,           TOKEN("[a-z]+"));
+	SYMBOL (NUMBER,         TOKEN("\\d+"));
+	SYMBOL (LET,            WORD("let"));
+	SYMBOL (EQUALS,         WORD("="));
+	SYMBOL (SEMICOLON,      WORD(";"));
+	SYMBOL (Let,            cut
+		? RULE ( _S(LET), CUT(), _S(NAME), _S(EQUALS), _S(NUMBER), _S(SEMICOLON))
+		: RULE ( _S(LET),        _S(NAME), _S(EQUALS), _S(NUMBER), _S(SEMICOLON)));
+	SYMBOL (Expression,     RULE ( _S(NAME), _S(SEMICOLON)));
+	SYMBOL (Statement,      GROUP( _S(Let), _S(Expression)));
+	SYMBOL (Item,           RULE ( _S(Statement), CUT()));
+	SYMBOL (Statements,     RULE ( _MO(Item)));
+
+	AXIOM(Statements);
+	SKIP(WS);
+
+	return g;
+}
+
+bool Grammar_parses(Grammar* g, const char* text) {
+	ParsingResult* r = Grammar_parseString(g, text);
+	bool parsed = ParsingResult_isSuccess(r) && r->match->length == strlen(text);
+	ParsingResult_free(r);
+	return parsed;
+}
+
+int main (int argc, char** argv) {
+	Grammar* g = createGrammar(TRUE);
+	Grammar* h = createGrammar(FALSE);
+
+	// The `let` statement is committed after its keyword
+	TEST_TRUE( Grammar_parses(g, "a; let x = 1; b;"));
+	TEST_TRUE( Grammar_parses(h, "a; let x = 1; b;"));
+	TEST_TRUE(!Grammar_parses(g, "a; let;"));
+	TEST_TRUE( Grammar_parses(h, "a; let;"));
+
+	const char* texts[] = {
+		"a; let x = 1; b;",
+		"a; let;",
+		"a; let x = ; b;",
+		"",
+		NULL
+	};
+	for (int i=0 ; texts[i] != NULL ; i++) {
+		TEST_TRUE(Grammar_isSame(g, texts[i]));
+		Grammar_enableMemoize(g);
+		TEST_TRUE(Grammar_isSame(g, texts[i]));
+		Grammar_disableMemoize(g);
+	}
+
+	// Each statement is cut in the repetition, so the memoization table
+	// doesn't grow with the input.
+	char* text = calloc(STATEMENTS * 16 + 1, sizeof(char));
+	char* end  = text;
+	for (int i=0 ; i<STATEMENTS ; i++) {
+		end += sprintf(end, i % 2 ? "let v = %d;\n" : "v;\n", i);
+	}
+	*(--end) = '\0';
+	Grammar_enableMemoize(g);
+	ParsingResult* r = Grammar_parseString(g, text);
+	TEST_TRUE(ParsingResult_isSuccess(r));
+	TEST_TRUE((r->match->length == strlen(text)));
+	TEST_TRUE((r->context->memo->capacity <= 4096));
+	ParsingResult_free(r);
+	free(text);
+
+	Grammar_free(g);
+	Grammar_free(h);
+	TEST_SUCCEED;
+}
@@ -0,0 +1,64 @@
+#include "parsing.h"
+#include "testing.h"
+
+/**
+ * This test case exercises the following:
+ *
+ * - Data given with its length is parsed like the same text given as a
+ *   string, without being copied
+ * - The bytes that follow the data are never read, even when they would
+ *   complete a word or a token
+*/
+
+#define VALUES 2000
+
+Grammar* createGrammar() {
+	Grammar* g = Grammar_new();
+
+	SYMBOL (WS,             TOKEN("\\s+"));
+	SYMBOL (NUMBER,         TOKEN("\\d+"));
+	SYMBOL (END,            WORD("end"));
+	SYMBOL (Value,          GROUP( _S(NUMBER), _S(END)));
+	SYMBOL (Values,         RULE ( _MO(Value)));
+
+	AXIOM(Values);
+	SKIP(WS);
+
+	return g;
+}
+
+int main (int argc, char** argv) {
+	Grammar* g = createGrammar();
+	Writer* input = Writer_new();
+	for (int i=0 ; i<VALUES ; i++) {
+		Writer_printf(input, "%s%d end", i == 0 ? "" : " ", i);
+	}
+
+	ParsingResult* text   = Grammar_parseString(g, input->data);
+	ParsingResult* buffer = Grammar_parseBuffer(g, input->data, input->length);
+	TEST_TRUE((text->status == STATUS_SUCCESS && buffer->status == STATUS_SUCCESS));
+	TEST_TRUE((buffer->context->iterator->buffer == input->data));
+	TEST_TRUE((Match_countAll(text->match) == Match_countAll(buffer->match)));
+	TEST_TRUE((buffer->context->iterator->offset == input->length));
+	ParsingResult_free(text);
+	ParsingResult_free(buffer);
+
+	// The data stops within a word, and then within a number
+	size_t length = strstr(input->data, "10 end") - input->data;
+	buffer = Grammar_parseBuffer(g, input->data, length + 5);
+	TEST_TRUE((buffer->status == STATUS_PARTIAL && buffer->context->iterator->offset == length + 2));
+	ParsingResult_free(buffer);
+	buffer = Grammar_parseBuffer(g, input->data, length + 1);
+	TEST_TRUE((buffer->status == STATUS_SUCCESS && buffer->context->iterator->offset == length + 1));
+	ParsingResult_free(buffer);
+
+	// Nothing at all
+	buffer = Grammar_parseBuffer(g, input->data, 0);
+	TEST_TRUE((buffer->status != STATUS_SUCCESS && buffer->context->iterator->offset == 0));
+	ParsingResult_free(buffer);
+
+	Writer_free(input);
+	Grammar_free(g);
+	TEST_SUCCEED;
+	return 0;
+}
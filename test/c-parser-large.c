@@ -0,0 +1,73 @@
+#include "parsing.h"
+#include "testing.h"
+#include <fcntl.h>
+
+/**
+ * This test case exercises the following:
+ *
+ * - Files larger than what an `int` holds are mapped and parsed, even
+ *   though PCRE takes the length of the text as an `int`
+ * - The iterator moves to offsets that are further than an `int` away
+ * - Tokens are recognized past the first `INT_MAX` bytes
+*/
+#define SIZE ((size_t)3 * 1024 * 1024 * 1024)
+
+Grammar* createGrammar() {
+	Grammar* g = Grammar_new();
+
+	SYMBOL (ABC,            TOKEN("abc"));
+	SYMBOL (XYZ,            TOKEN("xyz"));
+	SYMBOL (Value,          GROUP( _S(ABC), _S(XYZ)));
+	SYMBOL (Values,         RULE ( _S(Value)));
+
+	AXIOM(Values);
+
+	return g;
+}
+
+// Writes a sparse file of `SIZE` bytes that starts with `abc` and ends with
+// `xyz`, with zeros in between.
+bool writeLargeFile(const char* path) {
+	int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+	if (fd < 0) {return FALSE;}
+	bool written = ftruncate(fd, SIZE) == 0
+		&& pwrite(fd, "abc\n", 4, 0) == 4
+		&& pwrite(fd, "xyz\n", 4, SIZE - 4) == 4;
+	close(fd);
+	return written;
+}
+
+int main (int argc, char** argv) {
+	Grammar* g = createGrammar();
+	char path[64];
+	snprintf(path, 64, "/tmp/libparsing-large-%d.txt", (int)getpid());
+	TEST_TRUE(writeLargeFile(path));
+
+	// The start of the file is parsed, and the rest is left
+	ParsingResult* r = Grammar_parsePath(g, path);
+	TEST_TRUE((r->status == STATUS_PARTIAL));
+	TEST_TRUE((r->context->iterator->offset == 3));
+	TEST_TRUE((ParsingResult_remaining(r) == SIZE - 3));
+	ParsingResult_free(r);
+
+	// The end of the file is reached and parsed
+	Iterator* iterator = Iterator_Open(path);
+	TEST_TRUE(Iterator_moveTo(iterator, SIZE - 4));
+	TEST_TRUE((iterator->offset == SIZE - 4));
+	TEST_TRUE((Iterator_remaining(iterator) == 4));
+	r = Grammar_parseIterator(g, iterator);
+	TEST_TRUE((r->status == STATUS_PARTIAL));
+	TEST_TRUE((r->match->offset == SIZE - 4 && r->match->length == 3));
+	TEST_TRUE((Iterator_remaining(iterator) == 1));
+	ParsingResult_free(r);
+
+	// And the iterator moves back to the start
+	TEST_TRUE(Iterator_moveTo(iterator, 0));
+	TEST_TRUE((iterator->offset == 0 && Iterator_remaining(iterator) == SIZE));
+	Iterator_free(iterator);
+
+	unlink(path);
+	Grammar_free(g);
+	TEST_SUCCEED;
+	return 0;
+}
@@ -0,0 +1,91 @@
+#include "parsing.h"
+#include "testing.h"
+
+/**
+ * This test case exercises the following:
+ *
+ * - Grammars that are neither verbose nor profiled use the lean
+ *   recognizers, and the others the tracing ones
+ * - Both variants yield the same matches
+ * - Both variants register the same deepest match, which is what the
+ *   errors are reported from
+*/
+
+Grammar* createGrammar() {
+	Grammar* g = Grammar_new();
+
+	SYMBOL (WS,             WORD(" "));
+	SYMBOL (A,              WORD("a"));
+	SYMBOL (B,              WORD("b"));
+	SYMBOL (PLUS,           WORD("+"));
+	SYMBOL (LPAREN,         WORD("("));
+	SYMBOL (RPAREN,         WORD(")"));
+	SYMBOL (SEMICOLON,      WORD(";"));
+	SYMBOL (Expression,     GROUP( _S(A), _S(B)));
+	SYMBOL (Value,          GROUP( _S(Expression)));
+	SYMBOL (Parens,         RULE ( _S(LPAREN), _S(Value), _MO(Value), _S(RPAREN)));
+	SYMBOL (Operand,        GROUP( _S(Parens), _S(Value)));
+	SYMBOL (Sum,            RULE ( _S(Operand), _O(PLUS), _MO(Operand)));
+	SYMBOL (Statement,      RULE ( _S(Sum), _S(SEMICOLON)));
+	SYMBOL (Statements,     RULE ( _MO(Statement)));
+
+	AXIOM(Statements);
+	SKIP(WS);
+
+	return g;
+}
+
+// Tells if the text is parsed the same by the lean and the tracing
+// recognizers, down to the deepest match.
+bool Grammar_isSameWhenTracing(Grammar* g, const char* text) {
+	ParsingResult* lean    = Grammar_parseString(g, text);
+	Grammar_setVerbose(g);
+	ParsingResult* tracing = Grammar_parseString(g, text);
+	Grammar_setSilent(g);
+	bool same = lean->status == tracing->status
+		&& Match_isSame(lean->match, tracing->match)
+		&& lean->context->lastMatchOffset    == tracing->context->lastMatchOffset
+		&& lean->context->lastMatchLength    == tracing->context->lastMatchLength
+		&& lean->context->lastMatchElementID == tracing->context->lastMatchElementID;
+	ParsingResult_free(lean);
+	ParsingResult_free(tracing);
+	return same;
+}
+
+int main (int argc, char** argv) {
+	Grammar* g = createGrammar();
+
+	// Only verbose or profiled grammars trace
+	ParsingResult* r = Grammar_parseString(g, "a;");
+	TEST_FALSE((HAS_FLAG(r->context->flags, FLAG_TRACING) ? TRUE : FALSE));
+	ParsingResult_free(r);
+	Grammar_enableProfiling(g);
+	r = Grammar_parseString(g, "a;");
+	TEST_TRUE((HAS_FLAG(r->context->flags, FLAG_TRACING) ? TRUE : FALSE));
+	ParsingResult_free(r);
+	Grammar_disableProfiling(g);
+
+	const char* texts[] = {
+		"a;",
+		"a + b; (a b) + a;",
+		"a b (a) + b a;",
+		"a + (a b b) ;; b",
+		"a + (a b",
+		"(a + b);",
+		"",
+		NULL
+	};
+	for (int i=0 ; texts[i] != NULL ; i++) {
+		TEST_TRUE(Grammar_isSameWhenTracing(g, texts[i]));
+	}
+
+	// The deepest match of a failed parse is its last terminal
+	r = Grammar_parseString(g, "a + (a b");
+	TEST_TRUE((r->context->lastMatchOffset == 7));
+	TEST_TRUE((r->context->lastMatchLength == 1));
+	ParsingResult_free(r);
+
+	Grammar_free(g);
+	TEST_SUCCEED;
+	return 0;
+}
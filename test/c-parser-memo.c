@@ -0,0 +1,114 @@
+#include "parsing.h"
+#include "testing.h"
+
+/**
+ * This test case exercises the following:
+ *
+ * - Memoized and non-memoized parsing yield the same match tree
+ * - A grammar that backtracks over the same prefix hits the memo
+ * - Elements can opt out of memoization
+ * - A memoized right-recursive list is stored and restored as it is,
+ *   without copying its items, and so in linear time
+*/
+#define ITEMS 4000
+
+ParsingElement* value = NULL;
+
+Grammar* createGrammar() {
+	Grammar* g = Grammar_new();
+
+	SYMBOL (WS,             TOKEN("\\s+"));
+	SYMBOL (NUMBER,         TOKEN("\\d+(\\.\\d+)?"));
+	SYMBOL (VARIABLE,       TOKEN("\\w+"));
+	SYMBOL (PLUS,           WORD("+"));
+	SYMBOL (MINUS,          WORD("-"));
+
+	SYMBOL (Value,          GROUP( _S(NUMBER), _S(VARIABLE)));
+	SYMBOL (Expression,     GROUP(NULL));
+	SYMBOL (Addition,       RULE ( _S(Value), _S(PLUS),  _S(Expression)));
+	SYMBOL (Substraction,   RULE ( _S(Value), _S(MINUS), _S(Expression)));
+	// Each alternative of the expression re-parses the leading value,
+	// which is what memoization is supposed to save.
+	ParsingElement_add(s_Expression, _S(Addition));
+	ParsingElement_add(s_Expression, _S(Substraction));
+	ParsingElement_add(s_Expression, _S(Value));
+
+	value = s_Value;
+	AXIOM(Expression);
+	SKIP(WS);
+
+	return g;
+}
+
+Grammar* createListGrammar() {
+	Grammar* g = Grammar_new();
+
+	SYMBOL (WS,             TOKEN("\\s+"));
+	SYMBOL (ITEM,           TOKEN("\\w+"));
+	SYMBOL (COMMA,          WORD(","));
+	SYMBOL (SEMICOLON,      WORD(";"));
+
+	SYMBOL (List,           RULE ( _S(ITEM)));
+	SYMBOL (Rest,           RULE ( _S(COMMA), _S(List)));
+	ParsingElement_add(s_List, _O(Rest));
+	// The whole list is recognized by the statement, which then fails,
+	// and restored from the memo by the second alternative.
+	SYMBOL (Statement,      RULE ( _S(List), _S(SEMICOLON)));
+	SYMBOL (Items,          GROUP( _S(Statement), _S(List)));
+
+	AXIOM(Items);
+	SKIP(WS);
+
+	return g;
+}
+
+int main (int argc, char** argv) {
+	const char* text = "1 - 2 + x - 3 + 4.5 - 6 - y + 7";
+	Grammar* g = createGrammar();
+
+	// Memoization is enabled on demand
+	TEST_TRUE((g->isMemoized == FALSE));
+	Grammar_enableMemoize(g);
+	ParsingResult* memoized = Grammar_parseString(g, text);
+	TEST_TRUE(ParsingResult_isSuccess(memoized));
+	TEST_TRUE((memoized->context->memo != NULL));
+	TEST_TRUE((memoized->context->memo->hits > 0));
+
+	Grammar_disableMemoize(g);
+	ParsingResult* plain = Grammar_parseString(g, text);
+	TEST_TRUE(ParsingResult_isSuccess(plain));
+	TEST_TRUE((plain->context->memo == NULL));
+	TEST_TRUE((ParsingResult_textOffset(memoized) == ParsingResult_textOffset(plain)));
+	TEST_TRUE(Match_isSame(memoized->match, plain->match));
+	ParsingResult_free(plain);
+
+	// Opting out the shared value means the memo is never hit for it
+	Grammar_enableMemoize(g);
+	ParsingElement_disableMemoize(value);
+	ParsingResult* optout = Grammar_parseString(g, text);
+	TEST_TRUE(ParsingResult_isSuccess(optout));
+	TEST_TRUE(Match_isSame(memoized->match, optout->match));
+	ParsingResult_free(optout);
+
+	ParsingResult_free(memoized);
+	Grammar_free(g);
+
+	Writer* list = Writer_new();
+	for (int i=0 ; i<ITEMS ; i++) {
+		Writer_printf(list, "%sitem%d", i == 0 ? "" : ", ", i);
+	}
+	g = createListGrammar();
+	Grammar_enableMemoize(g);
+	memoized = Grammar_parseString(g, list->data);
+	TEST_TRUE(ParsingResult_isSuccess(memoized));
+	TEST_TRUE((memoized->context->iterator->offset == list->length));
+	TEST_TRUE((memoized->context->memo->hits > 0));
+	Grammar_disableMemoize(g);
+	plain = Grammar_parseString(g, list->data);
+	TEST_TRUE(Match_isSame(memoized->match, plain->match));
+	ParsingResult_free(plain);
+	ParsingResult_free(memoized);
+	Grammar_free(g);
+	Writer_free(list);
+	TEST_SUCCEED;
+}
@@ -0,0 +1,129 @@
+#include "parsing.h"
+#include "testing.h"
+#include <fcntl.h>
+
+/**
+ * This test case exercises the following:
+ *
+ * - A file parsed in chunks by several threads yields the same result as
+ *   a sequential parse, with the offsets of the file
+ * - Records that span chunk boundaries make the next chunk be parsed
+ *   again, whatever the boundary callback
+ * - Failures within a chunk stop the parse where a sequential parse would
+ * - Small files and other axioms fall back to a sequential parse
+ * - Files larger than what an `int` holds are parsed in chunks too
+*/
+
+#define RECORDS 12000
+
+Grammar* createGrammar() {
+	Grammar* g = Grammar_new();
+
+	SYMBOL (WS,             TOKEN("\\s+"));
+	SYMBOL (NUMBER,         TOKEN("\\d+"));
+	SYMBOL (NAME,           TOKEN("[a-z]\\w*"));
+	SYMBOL (EQUAL,          WORD("="));
+	SYMBOL (SEMICOLON,      WORD(";"));
+	SYMBOL (Value,          GROUP( _S(NUMBER), _S(NAME)));
+	SYMBOL (Record,         RULE ( _S(NAME), _S(EQUAL), _MO(Value), _S(SEMICOLON)));
+	SYMBOL (Records,        RULE ( _MO(Record)));
+
+	AXIOM(Records);
+	SKIP(WS);
+
+	return g;
+}
+
+// Writes records of one line, or of several lines every `multiline`
+// records, with an invalid record at `invalid`.
+void writeRecords(const char* path, int count, int multiline, int invalid) {
+	FILE* f = fopen(path, "w");
+	for (int i=0 ; i<count ; i++) {
+		if (i > 0) {fprintf(f, "\n");}
+		if (i == invalid) {
+			fprintf(f, "a%d = %d", i, i);
+		} else if (multiline > 0 && i % multiline == 0) {
+			fprintf(f, "a%d = %d\n  b%d\n  c%d\n  %d;", i, i, i, i, i);
+		} else {
+			fprintf(f, "a%d = %d b%d;", i, i, i);
+		}
+	}
+	fclose(f);
+}
+
+// Writes a sparse file of `size` bytes that starts with a record, with
+// zeros after it, and with lines ending where the chunks of `threads`
+// threads would, so that their boundaries are found right away.
+bool writeLargeRecords(const char* path, size_t size, int threads) {
+	int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+	if (fd < 0) {return FALSE;}
+	bool written = ftruncate(fd, size) == 0 && pwrite(fd, "a = 1;\n", 7, 0) == 7;
+	for (int i=1 ; i<threads ; i++) {
+		written = written && pwrite(fd, "\n", 1, size / threads * i - 1) == 1;
+	}
+	close(fd);
+	return written;
+}
+
+bool Grammar_isSameInParallel(Grammar* g, const char* path, BoundaryCallback isBoundary, int threads) {
+	ParsingResult* sequential = Grammar_parsePath(g, path);
+	ParsingResult* parallel   = Grammar_parseParallel(g, path, g->axiom->children->element, isBoundary, threads);
+	bool same = sequential->status == parallel->status
+		&& sequential->context->iterator->offset == parallel->context->iterator->offset
+		&& Match_isSame(sequential->match, parallel->match)
+		&& sequential->context->lastMatchOffset == parallel->context->lastMatchOffset;
+	ParsingResult_free(sequential);
+	ParsingResult_free(parallel);
+	return same;
+}
+
+int main (int argc, char** argv) {
+	Grammar* g = createGrammar();
+	char path[64];
+	snprintf(path, 64, "/tmp/libparsing-parallel-%d.txt", (int)getpid());
+
+	// Records of one line, whose boundaries are always right
+	writeRecords(path, RECORDS, 0, -1);
+	ParsingResult* r = Grammar_parseParallel(g, path, g->axiom->children->element, NULL, 4);
+	TEST_TRUE((r->status == STATUS_SUCCESS));
+	TEST_TRUE((r->context->parts != NULL));
+	TEST_TRUE((Match_countChildren(r->match->children) == RECORDS));
+	ParsingResult_free(r);
+	TEST_TRUE(Grammar_isSameInParallel(g, path, NULL, 4));
+	TEST_TRUE(Grammar_isSameInParallel(g, path, NULL, 0));
+
+	// Records over several lines, where lines are wrong boundaries
+	writeRecords(path, RECORDS, 3, -1);
+	TEST_TRUE(Grammar_isSameInParallel(g, path, Boundary_Line, 4));
+	TEST_TRUE(Grammar_isSameInParallel(g, path, Boundary_Unindented, 4));
+
+	// An invalid record in the last chunk, and in the first one
+	writeRecords(path, RECORDS, 3, RECORDS - 100);
+	TEST_TRUE(Grammar_isSameInParallel(g, path, Boundary_Unindented, 4));
+	writeRecords(path, RECORDS, 3, 100);
+	TEST_TRUE(Grammar_isSameInParallel(g, path, Boundary_Unindented, 4));
+
+	// Files over 2GiB are parsed in chunks, which stop where a sequential
+	// parse would
+	TEST_TRUE(writeLargeRecords(path, (size_t)3 * 1024 * 1024 * 1024, 4));
+	r = Grammar_parseParallel(g, path, g->axiom->children->element, NULL, 4);
+	TEST_TRUE((r->status == STATUS_PARTIAL));
+	TEST_TRUE((r->context->parts != NULL));
+	TEST_TRUE((Match_countChildren(r->match->children) == 1));
+	ParsingResult_free(r);
+	TEST_TRUE(Grammar_isSameInParallel(g, path, NULL, 4));
+
+	// Small files are parsed sequentially
+	writeRecords(path, 10, 3, -1);
+	r = Grammar_parseParallel(g, path, g->axiom->children->element, NULL, 4);
+	TEST_TRUE((r->status == STATUS_SUCCESS));
+	TEST_TRUE((r->context->parts == NULL));
+	ParsingResult_free(r);
+
+	unlink(path);
+	TEST_TRUE((Grammar_parseParallel(g, path, g->axiom->children->element, NULL, 4) == NULL));
+
+	Grammar_free(g);
+	TEST_SUCCEED;
+	return 0;
+}
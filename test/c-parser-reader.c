@@ -0,0 +1,154 @@
+#include "parsing.h"
+#include "testing.h"
+#include <sys/wait.h>
+
+/**
+ * This test case exercises the following:
+ *
+ * - Parsing the input read from a file descriptor and from a callback
+ *   gives the same matches as parsing the same text as a string
+ * - Short reads are completed until there is enough input ahead
+ * - The buffer only keeps the input that was not released when streaming
+ * - A failed read ends the input, keeping its error
+*/
+
+// The records that are parsed at once, and streamed
+#define RECORDS         20000
+#define STREAM_RECORDS  500000
+
+Grammar* createGrammar(bool stream) {
+	Grammar* g = Grammar_new();
+
+	SYMBOL (WS,             TOKEN("\\s+"));
+	SYMBOL (KEY,            TOKEN("[a-z]+"));
+	SYMBOL (VALUE,          TOKEN("\\d+"));
+	SYMBOL (EQUALS,         WORD("="));
+	SYMBOL (Record,         RULE ( _S(KEY), _S(EQUALS), _S(VALUE)));
+
+	if (stream) {
+		AXIOM(Record);
+	} else {
+		SYMBOL (Records,    RULE ( _MO(Record)));
+		AXIOM(Records);
+	}
+	SKIP(WS);
+
+	return g;
+}
+
+// Gives the data in reads of varying, small sizes, failing with `EIO`
+// once `failAt` bytes were read, when set.
+typedef struct Source {
+	const char* data;
+	size_t      length;
+	size_t      offset;
+	size_t      failAt;
+	int         reads;
+} Source;
+
+ssize_t readSource(char* data, size_t length, void* context) {
+	Source* source = (Source*)context;
+	if (source->failAt > 0 && source->offset >= source->failAt) {
+		errno = EIO;
+		return -1;
+	}
+	size_t end   = source->failAt > 0 ? source->failAt : source->length;
+	size_t count = MIN(length, MIN(1 + source->reads % 4093, end - source->offset));
+	memcpy(data, source->data + source->offset, count);
+	source->offset += count;
+	source->reads  += 1;
+	return (ssize_t)count;
+}
+
+typedef struct Totals {
+	int    count;
+	long   sum;
+	size_t capacity;
+} Totals;
+
+int onRecord(Match* match, int step, void* data) {
+	Totals*   totals   = (Totals*)data;
+	Match*    value    = match->children->next->next->children;
+	Iterator* iterator = ((TokenMatch*)value->data)->iterator;
+	totals->count   += 1;
+	totals->sum     += atol(TokenMatch_group(value, 0));
+	totals->capacity = MAX(totals->capacity, iterator->capacity);
+	return step;
+}
+
+int main (int argc, char** argv) {
+	Grammar* g      = createGrammar(FALSE);
+	Grammar* stream = createGrammar(TRUE);
+	Writer*  input  = Writer_new();
+	long     sum    = 0;
+	for (int i=0 ; i<STREAM_RECORDS ; i++) {
+		Writer_printf(input, "key=%d\n", i % 1000);
+		sum += i % 1000;
+	}
+	// The first records are parsed at once
+	size_t   length = strstr(input->data, "\nkey=0\n") - input->data + 1;
+	for (int i=1000 ; i<RECORDS ; i+=1000) {length = strstr(input->data + length, "\nkey=0\n") - input->data + 1;}
+	// The last newline would be left after the records
+	length -= 1;
+	char*    records = strndup(input->data, length);
+	ParsingResult* text  = Grammar_parseString(g, records);
+	TEST_TRUE((text->status == STATUS_SUCCESS));
+
+	// A pipe, fed by another process
+	int fds[2];
+	TEST_TRUE((pipe(fds) == 0));
+	pid_t writer = fork();
+	if (writer == 0) {
+		close(fds[0]);
+		for (size_t o=0 ; o<length ;) {o += write(fds[1], records + o, length - o);}
+		_exit(0);
+	}
+	close(fds[1]);
+	Iterator* iterator = Iterator_FromFD(fds[0], TRUE);
+	ParsingResult* r   = Grammar_parseIterator(g, iterator);
+	TEST_TRUE((r->status == STATUS_SUCCESS));
+	TEST_TRUE((Match_countAll(r->match) == Match_countAll(text->match)));
+	TEST_TRUE((iterator->offset == length && ((ReaderInput*)iterator->input)->error == 0));
+	ParsingResult_free(r);
+	Iterator_free(iterator);
+	waitpid(writer, NULL, 0);
+
+	// A callback giving short reads
+	Source source = {records, length, 0, 0, 0};
+	iterator = Iterator_FromReader(readSource, &source);
+	r = Grammar_parseIterator(g, iterator);
+	TEST_TRUE((r->status == STATUS_SUCCESS));
+	TEST_TRUE((Match_countAll(r->match) == Match_countAll(text->match)));
+	TEST_TRUE((iterator->offset == length && source.reads > RECORDS / 1000 && ((ReaderInput*)iterator->input)->error == 0));
+	ParsingResult_free(r);
+	Iterator_free(iterator);
+
+	// Streamed, the released input is dropped from the buffer
+	Totals totals = {0, 0, 0};
+	source   = (Source){input->data, input->length, 0, 0, 0};
+	iterator = Iterator_FromReader(readSource, &source);
+	r = Grammar_parseStream(stream, iterator, onRecord, &totals);
+	TEST_TRUE((ParsingResult_isSuccess(r)));
+	TEST_TRUE((totals.count == STREAM_RECORDS && totals.sum == sum));
+	TEST_TRUE((totals.capacity <= READER_INPUT_CHUNK * 2 && input->length > READER_INPUT_CHUNK * 2));
+	ParsingResult_free(r);
+	Iterator_free(iterator);
+
+	// A read that fails ends the input with the records read so far
+	totals   = (Totals){0, 0, 0};
+	source   = (Source){input->data, input->length, 0, strstr(input->data, "\nkey=0\n") - input->data + 1, 0};
+	iterator = Iterator_FromReader(readSource, &source);
+	r = Grammar_parseStream(stream, iterator, onRecord, &totals);
+	TEST_TRUE((totals.count == 1000));
+	TEST_TRUE((((ReaderInput*)iterator->input)->error == EIO));
+	ParsingResult_free(r);
+	Iterator_free(iterator);
+
+	ParsingResult_free(text);
+	free(records);
+	Writer_free(input);
+	Grammar_free(g);
+	Grammar_free(stream);
+	TEST_SUCCEED;
+	return 0;
+}
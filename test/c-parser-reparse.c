@@ -0,0 +1,155 @@
+#include "parsing.h"
+#include "testing.h"
+
+/**
+ * This test case exercises the following:
+ *
+ * - A result parsed again after an edit is the same as the one of parsing
+ *   the edited text, for edits before, within, across and after records
+ * - Edits that make the parse fail, or succeed again, are handled
+ * - Tokens of the records that are reused read the edited text
+ * - Grammars that don't repeat records are parsed again as a whole
+ * - Memoized matches that share their children are only shifted once
+*/
+
+#define RECORDS 2000
+
+Grammar* createGrammar(bool repeated) {
+	Grammar* g = Grammar_new();
+
+	SYMBOL (WS,             TOKEN("\\s+"));
+	SYMBOL (NUMBER,         TOKEN("\\d+"));
+	SYMBOL (NAME,           TOKEN("[a-z]\\w*"));
+	SYMBOL (EQUAL,          WORD("="));
+	SYMBOL (SEMICOLON,      WORD(";"));
+	SYMBOL (STAR,           WORD("*"));
+	SYMBOL (Value,          GROUP( _S(NUMBER), _S(NAME)));
+	// The second note is the memoized match of the first one, when the
+	// memo is on, as both are empty.
+	SYMBOL (Note,           RULE ( _O(STAR)));
+	SYMBOL (Record,         RULE ( _S(NAME), _S(Note), _S(Note), _S(EQUAL), _MO(Value), _S(SEMICOLON)));
+	if (repeated) {
+		SYMBOL (Records,    RULE ( _MO(Record)));
+		AXIOM(Records);
+	} else {
+		SYMBOL (Statements, RULE ( _MO(Record), _O(SEMICOLON)));
+		AXIOM(Statements);
+	}
+	SKIP(WS);
+
+	return g;
+}
+
+// The text being edited, along with its result
+char*          text   = NULL;
+ParsingResult* result = NULL;
+
+// Applies the edit to the text and to the result, telling if the result
+// is the same as the one of parsing the edited text.
+bool edit(Grammar* g, size_t offset, size_t removed, const char* inserted) {
+	size_t length = strlen(text);
+	size_t added  = strlen(inserted);
+	char*  edited = malloc(length - removed + added + 1);
+	memcpy(edited, text, offset);
+	memcpy(edited + offset, inserted, added);
+	strcpy(edited + offset + added, text + offset + removed);
+	// The result has its own copy of the edited text
+	result = Grammar_reparse(g, result, offset, removed, inserted);
+	free(text);
+	text   = edited;
+	ParsingResult* expected = Grammar_parseString(g, text);
+	bool same = result != NULL
+		&& strcmp(result->context->iterator->buffer, text) == 0
+		&& result->status == expected->status
+		&& result->context->iterator->offset == expected->context->iterator->offset
+		&& (result->status == STATUS_FAILED || Match_isSame(result->match, expected->match))
+		&& result->context->lastMatchOffset + result->context->lastMatchLength == expected->context->lastMatchOffset + expected->context->lastMatchLength;
+	ParsingResult_free(expected);
+	return same;
+}
+
+int main (int argc, char** argv) {
+	Grammar* g = createGrammar(TRUE);
+	Writer* input = Writer_new();
+	for (int i=0 ; i<RECORDS ; i++) {
+		Writer_printf(input, "%sa%d = %d b%d;", i == 0 ? "" : "\n", i, i, i);
+	}
+	text   = strdup(input->data);
+	result = Grammar_parseString(g, text);
+	TEST_TRUE((result->status == STATUS_SUCCESS));
+	Writer_free(input);
+
+	// Within a record, across records, and at both ends
+	Match* last   = result->match->children->children;
+	while (last->next != NULL) {last = last->next;}
+	char*  middle = strstr(text, "a1000 ");
+	TEST_TRUE(edit(g, middle - text + 12, 0, " 42"));
+	TEST_TRUE((result->status == STATUS_SUCCESS));
+	// The records after the edit are reused
+	Match* reused = result->match->children->children;
+	while (reused->next != NULL) {reused = reused->next;}
+	// Records start with the newline skipped before them
+	TEST_TRUE((reused == last && reused->offset == (size_t)(strstr(text, "a1999 ") - text) - 1));
+	middle = strstr(text, "b1200;");
+	TEST_TRUE(edit(g, middle - text, 5, "c"));
+	middle = strstr(text, "a1300 ");
+	TEST_TRUE(edit(g, middle - text, strstr(text, "a1310 ") - middle, "x = 1 2 3;\n"));
+	TEST_TRUE(edit(g, 0, 0, "  start = 0;\n"));
+	TEST_TRUE(edit(g, 2, 5, "first"));
+	TEST_TRUE(edit(g, strlen(text), 0, "\nend = 1;"));
+	TEST_TRUE(edit(g, strlen(text) - 2, 1, "2"));
+
+	// An edit that breaks a record, and one that fixes it
+	size_t broken = strstr(text, "a1500 ") - text + 6;
+	TEST_TRUE(edit(g, broken, 1, ":"));
+	TEST_TRUE((result->status == STATUS_PARTIAL));
+	TEST_TRUE(edit(g, broken, 1, "="));
+	TEST_TRUE((result->status == STATUS_SUCCESS));
+
+	// The tokens after the edit read the new text
+	TEST_TRUE(edit(g, 0, strstr(text, "a10 ") - text, ""));
+	last = result->match->children->children;
+	while (last->next != NULL) {last = last->next;}
+	TEST_TRUE((strcmp(TokenMatch_group(last->children->children, 0), "end") == 0));
+
+	// Edits past the input leave the result as it is
+	ParsingResult* previous = result;
+	TEST_TRUE((Grammar_reparse(g, previous, strlen(text), 1, "") == NULL));
+	TEST_TRUE((result->status == STATUS_SUCCESS));
+
+	// The whole text removed
+	TEST_TRUE(edit(g, 0, strlen(text), ""));
+	TEST_TRUE((result->status == STATUS_FAILED));
+	TEST_TRUE(edit(g, 0, 0, "a = 1;"));
+	TEST_TRUE((result->status == STATUS_SUCCESS));
+	ParsingResult_free(result);
+	Grammar_free(g);
+
+	// Memoized
+	g = createGrammar(TRUE);
+	Grammar_enableMemoize(g);
+	free(text);
+	text   = strdup("a = 1; b = 2;\nc = 3; d = 4;");
+	result = Grammar_parseString(g, text);
+	TEST_TRUE((result->status == STATUS_SUCCESS && result->context->memo->hits > 0));
+	TEST_TRUE(edit(g, 4, 0, " 0"));
+	TEST_TRUE(edit(g, 0, 0, "z = 0;\n"));
+	TEST_TRUE(edit(g, 7, 1, "y"));
+	TEST_TRUE((result->status == STATUS_SUCCESS));
+	ParsingResult_free(result);
+	Grammar_free(g);
+
+	// Another axiom
+	g = createGrammar(FALSE);
+	free(text);
+	text   = strdup("a = 1 2; b = 3;");
+	result = Grammar_parseString(g, text);
+	TEST_TRUE(edit(g, 4, 1, "b"));
+	TEST_TRUE(edit(g, 8, 0, " c = d;"));
+	TEST_TRUE((result->status == STATUS_SUCCESS));
+	ParsingResult_free(result);
+	free(text);
+	Grammar_free(g);
+	TEST_SUCCEED;
+	return 0;
+}
@@ -0,0 +1,76 @@
+#include "parsing.h"
+#include "testing.h"
+
+/**
+ * This test case exercises the following:
+ *
+ * - The per-symbol counters are only kept when the grammar is profiled
+ * - Each attempt is either a success or a failure, and the axiom consumes
+ *   the whole input
+ * - The grammar's counters accumulate across parses, including the ones
+ *   of grammars that run the virtual machine
+*/
+
+Grammar* createGrammar() {
+	Grammar* g = Grammar_new();
+
+	SYMBOL (WS,             TOKEN("\\s+"));
+	SYMBOL (NUMBER,         TOKEN("\\d+"));
+	SYMBOL (NAME,           TOKEN("[a-z]+"));
+	SYMBOL (OPERATOR,       TOKEN("[\\+\\-\\*/]"));
+	SYMBOL (Value,          GROUP( _S(NUMBER), _S(NAME)));
+	SYMBOL (Suffix,         RULE ( _S(OPERATOR), _S(Value)));
+	SYMBOL (Expression,     RULE ( _S(Value), _MO(Suffix)));
+
+	AXIOM(Expression);
+	SKIP(WS);
+
+	return g;
+}
+
+int main (int argc, char** argv) {
+	Grammar*    g    = createGrammar();
+	const char* text = "10 + 20 / a\n- b * 3";
+
+	// Without profiling, there are no counters
+	ParsingResult* r = Grammar_parseString(g, text);
+	TEST_TRUE(ParsingResult_isSuccess(r));
+	TEST_TRUE((r->context->stats->symbolsCount == 0));
+	TEST_TRUE((g->stats == NULL));
+	ParsingResult_free(r);
+
+	Grammar_enableProfiling(g);
+	r = Grammar_parseString(g, text);
+	TEST_TRUE(ParsingResult_isSuccess(r));
+	ParsingStats* stats = r->context->stats;
+	size_t attempts = 0;
+	TEST_TRUE((stats->symbolsCount == (size_t)Grammar_symbolsCount(g) + 1));
+	for (size_t i=0 ; i<stats->symbolsCount ; i++) {
+		TEST_TRUE((stats->attemptsBySymbol[i] == stats->successBySymbol[i] + stats->failureBySymbol[i]));
+		attempts += stats->attemptsBySymbol[i];
+	}
+	int axiom = g->axiom->id;
+	TEST_TRUE((attempts > 0));
+	TEST_TRUE((stats->attemptsBySymbol[axiom] == 1));
+	TEST_TRUE((stats->bytesBySymbol[axiom] == strlen(text)));
+	TEST_TRUE((stats->timeBySymbol[axiom] > 0));
+	ParsingResult_free(r);
+
+	// The grammar accumulates the counters, and the virtual machine is
+	// bypassed so that rules and groups are counted too.
+	Grammar_enableVM(g);
+	r = Grammar_parseString(g, text);
+	ParsingResult_free(r);
+	TEST_TRUE((g->stats->attemptsBySymbol[axiom] == 2));
+	TEST_TRUE((g->stats->bytesBySymbol[axiom] == 2 * strlen(text)));
+	size_t total = 0;
+	for (size_t i=0 ; i<g->stats->symbolsCount ; i++) {
+		total += g->stats->attemptsBySymbol[i];
+	}
+	TEST_TRUE((total == 2 * attempts));
+
+	Grammar_disableProfiling(g);
+	TEST_TRUE((g->stats == NULL));
+	Grammar_free(g);
+	TEST_SUCCEED;
+}
@@ -0,0 +1,113 @@
+#include "parsing.h"
+#include "testing.h"
+#include <sys/wait.h>
+
+/**
+ * This test case exercises the following:
+ *
+ * - Streaming the records of a mapped file and of a pipe
+ * - The pipe's buffer only keeps the input that was not released
+ * - The text of the records is available in the callback
+ * - The line of each record is known, even once the input is released
+ * - The memoized matches are forgotten along with each record
+*/
+#define RECORDS   100000
+#define FILE_PATH "/tmp/libparsing-c-parser-stream.txt"
+#define FIFO_PATH "/tmp/libparsing-c-parser-stream.fifo"
+
+Grammar* createGrammar() {
+	Grammar* g = Grammar_new();
+
+	SYMBOL (WS,             TOKEN("\\s+"));
+	SYMBOL (KEY,            TOKEN("[a-z]+"));
+	SYMBOL (VALUE,          TOKEN("\\d+"));
+	SYMBOL (EQUALS,         WORD("="));
+	SYMBOL (Record,         RULE ( _S(KEY), _S(EQUALS), _S(VALUE)));
+
+	AXIOM(Record);
+	SKIP(WS);
+
+	return g;
+}
+
+typedef struct Totals {
+	int    count;
+	long   sum;
+	size_t capacity;
+	int    misplaced;
+} Totals;
+
+int onRecord(Match* match, int step, void* data) {
+	Totals* totals   = (Totals*)data;
+	Match*  key      = match->children->children;
+	Match*  value    = match->children->next->next->children;
+	Iterator* iterator = ((TokenMatch*)value->data)->iterator;
+	if (Iterator_lineAt(iterator, key->offset) != (size_t)totals->count) {totals->misplaced += 1;}
+	totals->count   += 1;
+	totals->sum     += atol(TokenMatch_group(value, 0));
+	totals->capacity = MAX(totals->capacity, iterator->capacity);
+	return step;
+}
+
+void writeRecords(const char* path) {
+	FILE* f = fopen(path, "w");
+	for (int i=0 ; i<RECORDS ; i++) {
+		fprintf(f, "key=%d\n", i % 1000);
+	}
+	fclose(f);
+}
+
+int main (int argc, char** argv) {
+	Grammar* g = createGrammar();
+	long sum   = 0;
+	for (int i=0 ; i<RECORDS ; i++) {sum += i % 1000;}
+
+	// A regular file is mapped
+	writeRecords(FILE_PATH);
+	Totals mapped = {0, 0, 0, 0};
+	Iterator* iterator = Iterator_Open(FILE_PATH);
+	ParsingResult* r = Grammar_parseStream(g, iterator, onRecord, &mapped);
+	TEST_TRUE(ParsingResult_isSuccess(r));
+	TEST_TRUE((mapped.count == RECORDS));
+	TEST_TRUE((mapped.sum == sum));
+	TEST_TRUE((mapped.misplaced == 0));
+	ParsingResult_free(r);
+	Iterator_free(iterator);
+
+	// The memoized matches go along with each record
+	Grammar_enableMemoize(g);
+	Totals memoized = {0, 0, 0, 0};
+	iterator = Iterator_Open(FILE_PATH);
+	r = Grammar_parseStream(g, iterator, onRecord, &memoized);
+	TEST_TRUE(ParsingResult_isSuccess(r));
+	TEST_TRUE((memoized.count == RECORDS && memoized.sum == sum));
+	TEST_TRUE((r->context->memo->hits > 0 && r->context->memo->capacity <= 4096));
+	ParsingResult_free(r);
+	Iterator_free(iterator);
+	Grammar_disableMemoize(g);
+	unlink(FILE_PATH);
+
+	// A pipe is read, and the released input is dropped from the buffer
+	unlink(FIFO_PATH);
+	mkfifo(FIFO_PATH, 0600);
+	pid_t writer = fork();
+	if (writer == 0) {
+		writeRecords(FIFO_PATH);
+		exit(0);
+	}
+	Totals piped = {0, 0, 0, 0};
+	iterator = Iterator_Open(FIFO_PATH);
+	r = Grammar_parseStream(g, iterator, onRecord, &piped);
+	TEST_TRUE(ParsingResult_isSuccess(r));
+	TEST_TRUE((piped.count == RECORDS));
+	TEST_TRUE((piped.sum == sum));
+	TEST_TRUE((piped.misplaced == 0));
+	TEST_TRUE((piped.capacity <= ITERATOR_BUFFER_AHEAD * 4));
+	ParsingResult_free(r);
+	Iterator_free(iterator);
+	waitpid(writer, NULL, 0);
+	unlink(FIFO_PATH);
+
+	Grammar_free(g);
+	TEST_SUCCEED;
+}
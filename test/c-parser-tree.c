@@ -0,0 +1,116 @@
+#include "parsing.h"
+#include "testing.h"
+
+/**
+ * This test case exercises the following:
+ *
+ * - A compact tree has the same nodes as the matches it was built from,
+ *   and its accessors give the same values as the match accessors
+ * - A processor goes through a compact tree like it goes through matches
+ * - Compacting a result releases its matches, but not a failed result's
+*/
+
+#define VALUES 3000
+
+ParsingElement* VALUE = NULL;
+
+Grammar* createGrammar() {
+	Grammar* g = Grammar_new();
+
+	SYMBOL (WS,             TOKEN("\\s+"));
+	SYMBOL (NUMBER,         TOKEN("\\d+"));
+	SYMBOL (NAME,           TOKEN("\\w+"));
+	SYMBOL (COMMA,          WORD(","));
+	SYMBOL (LP,             WORD("("));
+	SYMBOL (RP,             WORD(")"));
+	SYMBOL (Value,          GROUP( _S(NUMBER), _S(NAME)));
+	SYMBOL (Rest,           RULE ( _S(COMMA), _S(Value)));
+	SYMBOL (List,           RULE ( _S(LP), _AS(_S(Value), "head"), _MO(Rest), _S(RP)));
+	SYMBOL (Lists,          RULE ( _MO(List)));
+
+	AXIOM(Lists);
+	SKIP(WS);
+	VALUE = s_Value;
+
+	return g;
+}
+
+bool MatchTree_isSame(MatchTree* tree, int node, Match* match) {
+	while (node >= 0 && match != NULL) {
+		if (MatchTree_getOffset(tree, node)      != Match_getOffset(match)
+		||  MatchTree_getLength(tree, node)      != Match_getLength(match)
+		||  MatchTree_getElementID(tree, node)   != Match_getElementID(match)
+		||  MatchTree_getElement(tree, node)     != match->element
+		||  MatchTree_getParsingElement(tree, node) != Match_getParsingElement(match)
+		||  MatchTree_countChildren(tree, node)  != Match_countChildren(match)
+		||  MatchTree_getElementName(tree, node) != Match_getElementName(match)) {
+			return FALSE;
+		}
+		if (!MatchTree_isSame(tree, MatchTree_getChildren(tree, node), match->children)) {return FALSE;}
+		node  = MatchTree_getNext(tree, node);
+		match = match->next;
+	}
+	return node < 0 && match == NULL;
+}
+
+int matchesCount = 0;
+int nodesCount   = 0;
+
+void Processor__onValue(Processor* processor, Match* match) {
+	matchesCount += Match_getLength(match);
+}
+
+void Processor__onValueNode(Processor* processor, MatchTree* tree, int node) {
+	nodesCount += MatchTree_getLength(tree, node);
+}
+
+int main (int argc, char** argv) {
+	Grammar* g = createGrammar();
+	Writer* input = Writer_new();
+	for (int i=0 ; i<VALUES ; i++) {
+		Writer_printf(input, "%s(%d, a%d, %d)", i == 0 ? "" : "\n", i, i, i * 7);
+	}
+	ParsingResult* r = Grammar_parseString(g, input->data);
+	TEST_TRUE((r->status == STATUS_SUCCESS));
+
+	MatchTree* tree = MatchTree_new(r->match, g);
+	TEST_TRUE((tree != NULL));
+	TEST_TRUE((tree->count == Match_countAll(r->match) + 1));
+	TEST_TRUE(MatchTree_isSame(tree, 0, r->match));
+	TEST_TRUE((MatchTree_countChildren(tree, 0) == 1 && MatchTree_countChildren(tree, 1) == VALUES));
+	TEST_TRUE((MatchTree_getEndOffset(tree, 0) == (int)input->length));
+	TEST_TRUE((!MatchTree_hasNext(tree, 0) && MatchTree_hasChildren(tree, 0)));
+	TEST_TRUE((MatchTree_getChildren(tree, 0) == 1));
+	TEST_TRUE((MatchTree_getOffset(tree, -1) == -1 && MatchTree_getElement(tree, -1) == NULL));
+
+	// The processor calls the same callbacks on the tree as on the matches
+	Processor* processor = Processor_new();
+	Processor_register(processor, VALUE->id, Processor__onValue);
+	Processor_registerNode(processor, VALUE->id, Processor__onValueNode);
+	Processor_process(processor, r->match, 0);
+	Processor_processTree(processor, tree, 0, 0);
+	TEST_TRUE((matchesCount > 0 && matchesCount == nodesCount));
+	Processor_free(processor);
+	MatchTree_free(tree);
+
+	// Compacting the result releases its matches
+	TEST_TRUE((r->context->arena->allocated > 0));
+	tree = ParsingResult_compact(r);
+	TEST_TRUE((tree != NULL && r->tree == tree && r->match == NULL));
+	TEST_TRUE((r->context->arena->allocated == 0));
+	TEST_TRUE((MatchTree_countChildren(tree, 0) == 1 && MatchTree_countChildren(tree, 1) == VALUES));
+	TEST_TRUE((ParsingResult_compact(r) == tree));
+	ParsingResult_free(r);
+
+	// Failed results keep their match
+	r = Grammar_parseString(g, ")");
+	Match* match = r->match;
+	TEST_TRUE((ParsingResult_compact(r) == NULL && r->match == match && r->tree == NULL));
+	TEST_TRUE((MatchTree_new(FAILURE, g) == NULL));
+	ParsingResult_free(r);
+
+	Writer_free(input);
+	Grammar_free(g);
+	TEST_SUCCEED;
+	return 0;
+}
@@ -0,0 +1,63 @@
+#include "parsing.h"
+#include "testing.h"
+
+/**
+ * This test case exercises the following:
+ *
+ * - Groups of words are matched with a trie, which finds the first child
+ *   whose word starts the input, rather than the longest word
+ * - An empty word matches without consuming input when no other word does
+ * - The recursive engine and the virtual machine agree on both
+*/
+
+ParsingElement* KEYWORD_IN    = NULL;
+ParsingElement* KEYWORD_EMPTY = NULL;
+
+Grammar* createGrammar(bool empty) {
+	Grammar* g = Grammar_new();
+
+	SYMBOL (WORD_IN,        WORD("in"));
+	SYMBOL (WORD_INT,       WORD("int"));
+	SYMBOL (WORD_INTEGER,   WORD("integer"));
+	SYMBOL (WORD_EMPTY,     WORD(""));
+	SYMBOL (Keyword,        GROUP( _S(WORD_INTEGER), _S(WORD_IN), _S(WORD_INT)));
+	if (empty) {ParsingElement_add(s_Keyword, _S(WORD_EMPTY));}
+	else       {ParsingElement_free(s_WORD_EMPTY);}
+
+	KEYWORD_IN    = s_WORD_IN;
+	KEYWORD_EMPTY = s_WORD_EMPTY;
+	AXIOM(Keyword);
+
+	return g;
+}
+
+// Returns the word element that the keyword matched, or NULL
+ParsingElement* Keyword_parse(Grammar* g, const char* text, size_t* length) {
+	ParsingResult*  r    = Grammar_parseString(g, text);
+	ParsingElement* word = NULL;
+	if (Match_isSuccess(r->match)) {
+		word    = ((Reference*)r->match->children->element)->element;
+		*length = r->match->length;
+	}
+	ParsingResult_free(r);
+	return word;
+}
+
+int main (int argc, char** argv) {
+	for (int vm=0 ; vm<2 ; vm++) {
+		size_t   length = 0;
+		Grammar* g      = createGrammar(FALSE);
+		if (vm) {Grammar_enableVM(g);}
+		TEST_TRUE((Keyword_parse(g, "integer", &length) != KEYWORD_IN && length == 7));
+		TEST_TRUE((Keyword_parse(g, "intern",  &length) == KEYWORD_IN && length == 2));
+		TEST_TRUE((Keyword_parse(g, "x",       &length) == NULL));
+		Grammar_free(g);
+
+		g = createGrammar(TRUE);
+		if (vm) {Grammar_enableVM(g);}
+		TEST_TRUE((Keyword_parse(g, "intern",  &length) == KEYWORD_IN && length == 2));
+		TEST_TRUE((Keyword_parse(g, "x",       &length) == KEYWORD_EMPTY && length == 0));
+		Grammar_free(g);
+	}
+	TEST_SUCCEED;
+}
@@ -0,0 +1,77 @@
+#include "parsing.h"
+#include "testing.h"
+
+/**
+ * This test case exercises the following:
+ *
+ * - The virtual machine yields the same match tree as the recursive engine,
+ *   with and without memoization
+ * - The virtual machine parses deeply nested input without using the C stack
+*/
+#define DEPTH 100000
+
+Grammar* createGrammar() {
+	Grammar* g = Grammar_new();
+
+	SYMBOL (WS,             TOKEN("\\s+"));
+	SYMBOL (NUMBER,         TOKEN("\\d+(\\.\\d+)?"));
+	SYMBOL (VARIABLE,       TOKEN("\\w+"));
+	SYMBOL (LP,             WORD("("));
+	SYMBOL (RP,             WORD(")"));
+	SYMBOL (PLUS,           WORD("+"));
+	SYMBOL (MINUS,          WORD("-"));
+	SYMBOL (Operator,       GROUP( _S(PLUS), _S(MINUS)));
+
+	SYMBOL (Value,          GROUP(NULL));
+	SYMBOL (Parens,         RULE ( _S(LP), _O(Value), _MO(Value), _S(RP)));
+	SYMBOL (Suffix,         RULE ( _S(Operator), _S(Value)));
+	SYMBOL (Expression,     RULE ( _S(Value), _MO(Suffix)));
+	ParsingElement_add(s_Value, _S(NUMBER));
+	ParsingElement_add(s_Value, _S(VARIABLE));
+	ParsingElement_add(s_Value, _S(Parens));
+
+	AXIOM(Expression);
+	SKIP(WS);
+
+	return g;
+}
+
+int main (int argc, char** argv) {
+	Grammar* g = createGrammar();
+	const char* texts[] = {
+		"1 - 2 + x - 3 + 4.5 - 6 - y + 7",
+		"(1 + (2 3) - (x (y)) ) + ( )",
+		"1 + ( 2 - ",
+		"  ",
+		NULL
+	};
+
+	for (int i=0 ; texts[i] != NULL ; i++) {
+		Grammar_enableMemoize(g);
+		TEST_TRUE(Grammar_isSame(g, texts[i]));
+		Grammar_disableMemoize(g);
+		TEST_TRUE(Grammar_isSame(g, texts[i]));
+	}
+
+	// The deep nesting is parsed with the memo too, as its matches are
+	// restored without copying their children.
+	char* nested = calloc(DEPTH * 2 + 2, sizeof(char));
+	for (int i=0 ; i<DEPTH ; i++) {
+		nested[i]             = '(';
+		nested[DEPTH * 2 - i] = ')';
+	}
+	nested[DEPTH] = '1';
+	Grammar_enableVM(g);
+	for (int memoize=0 ; memoize<2 ; memoize++) {
+		if (memoize) {Grammar_enableMemoize(g);} else {Grammar_disableMemoize(g);}
+		ParsingResult* r = Grammar_parseString(g, nested);
+		TEST_TRUE(ParsingResult_isSuccess(r));
+		TEST_TRUE((r->match->length == DEPTH * 2 + 1));
+		TEST_TRUE((memoize ? r->context->memo->hits > 0 : r->context->memo == NULL));
+		ParsingResult_free(r);
+	}
+	free(nested);
+
+	Grammar_free(g);
+	TEST_SUCCEED;
+}
@@ -0,0 +1,126 @@
+#include "parsing.h"
+#include "testing.h"
+
+/**
+ * This test case exercises the following:
+ *
+ * - Matches serialized to an in-memory writer, a callback, a `FILE*` or a
+ *   file descriptor yield the same output
+ * - Outputs larger than the writer's buffer are flushed, or grow the
+ *   buffer of in-memory writers
+ * - Strings are escaped in JSON
+*/
+
+#define VALUES 5000
+
+Grammar* createGrammar() {
+	Grammar* g = Grammar_new();
+
+	SYMBOL (WS,             TOKEN("\\s+"));
+	SYMBOL (NUMBER,         TOKEN("\\d+"));
+	SYMBOL (STRING,         TOKEN("'([^']*)'"));
+	SYMBOL (PAIR,           TOKEN("(\\w+):(\\w+)"));
+	SYMBOL (TRUE_,          WORD("true"));
+	SYMBOL (Value,          GROUP( _S(NUMBER), _S(STRING), _S(PAIR), _S(TRUE_)));
+	SYMBOL (Values,         RULE ( _MO(Value)));
+
+	AXIOM(Values);
+	SKIP(WS);
+
+	return g;
+}
+
+bool Writer__append( const char* data, size_t length, void* context ) {
+	Writer_write((Writer*)context, data, length);
+	return TRUE;
+}
+
+bool Writer_isSame( Writer* a, Writer* b ) {
+	return a->length == b->length && memcmp(a->data, b->data, a->length) == 0;
+}
+
+// Reads the whole file back in an in-memory writer
+Writer* Writer_read( FILE* file ) {
+	Writer* writer = Writer_new();
+	char    buffer[4096];
+	size_t  read   = 0;
+	fflush(file);
+	rewind(file);
+	while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+		Writer_write(writer, buffer, read);
+	}
+	return writer;
+}
+
+int main (int argc, char** argv) {
+	Grammar* g = createGrammar();
+
+	// The escaped characters of strings
+	ParsingResult* r = Grammar_parseString(g, "'a\"b\\c\td' true");
+	Writer* memory = Writer_new();
+	Match_dumpJSON(r->match, memory);
+	TEST_TRUE((strstr(memory->data, "\"'a\\\"b\\\\c\\td'\"") != NULL));
+	TEST_TRUE((strstr(memory->data, "{\"name\":\"TRUE_\",\"value\":\"true\"}") != NULL));
+	TEST_TRUE((strlen(memory->data) == memory->length));
+	Writer_free(memory);
+	ParsingResult_free(r);
+
+	// An output bigger than the writer's buffer
+	Writer* input = Writer_new();
+	for (int i=0 ; i<VALUES ; i++) {
+		Writer_printf(input, "%s%d 'value %d' key%d:%d true", i == 0 ? "" : " ", i, i, i, i);
+	}
+	r = Grammar_parseString(g, input->data);
+	TEST_TRUE((r->status == STATUS_SUCCESS));
+
+	for (int xml=0 ; xml<2 ; xml++) {
+		memory = Writer_new();
+		xml ? Match_dumpXML(r->match, memory) : Match_dumpJSON(r->match, memory);
+		TEST_TRUE((memory->length > WRITER_CAPACITY));
+		TEST_TRUE((memory->capacity >= memory->length));
+
+		// Through a callback, which gets the buffer whenever it's full
+		Writer* copy     = Writer_new();
+		Writer* callback = Writer_FromCallback(Writer__append, copy);
+		xml ? Match_dumpXML(r->match, callback) : Match_dumpJSON(r->match, callback);
+		TEST_TRUE((callback->capacity == WRITER_CAPACITY));
+		Writer_free(callback);
+		TEST_TRUE(Writer_isSame(memory, copy));
+		Writer_free(copy);
+
+		// Through a `FILE*`, and through a file descriptor
+		FILE* file = tmpfile();
+		Writer* stream = Writer_FromFile(file);
+		xml ? Match_dumpXML(r->match, stream) : Match_dumpJSON(r->match, stream);
+		TEST_TRUE(Writer_flush(stream));
+		copy = Writer_read(file);
+		TEST_TRUE(Writer_isSame(memory, copy));
+		Writer_free(copy);
+		Writer_free(stream);
+		fclose(file);
+
+		file = tmpfile();
+		xml ? Match_writeXML(r->match, fileno(file)) : Match_writeJSON(r->match, fileno(file));
+		copy = Writer_read(file);
+		TEST_TRUE(Writer_isSame(memory, copy));
+		Writer_free(copy);
+		fclose(file);
+
+		Writer_free(memory);
+	}
+
+	// Formatted text longer than the buffer
+	memory = Writer_new();
+	Writer_print(memory, "<");
+	Writer_printf(memory, "%s%s", input->data, input->data);
+	TEST_TRUE((memory->length == 1 + input->length * 2));
+	TEST_TRUE((memory->data[0] == '<' && memory->data[memory->length] == '\0'));
+	TEST_TRUE((memcmp(memory->data + 1 + input->length, input->data, input->length) == 0));
+	Writer_free(memory);
+
+	Writer_free(input);
+	ParsingResult_free(r);
+	Grammar_free(g);
+	TEST_SUCCEED;
+	return 0;
+}
@@ -211,6 +211,30 @@ class TestProcessor(unittest.TestCase):
 		self.assertEqual(p.process(g.parseString("hello"   )), [["hello"]])
 		self.assertEqual(p.process(g.parseString("1"  )),      [["1"]])
 
+	def assertSame( self, flat, match ):
+		self.assertEqual(flat.element, match.element)
+		self.assertEqual(flat.line,    match.line)
+		self.assertEqual(flat.toJSON(),   match.toJSON())
+		self.assertEqual(flat.toXML(),    match.toXML())
+		self.assertEqual(flat.toBinary(), match.toBinary())
+		for f, m in zip(flat, match):
+			self.assertSame(f, m)
+
+	def testFlatten( self ):
+		"""Ensures that the matches exported with `flatten` are processed
+		like the matches themselves, with both strategies."""
+		g = grammar()
+		for i in range(len(EXAMPLES) // 2):
+			source = EXAMPLES[i * 2]
+			result = EXAMPLES[i * 2 + 1]
+			r = g.parseString(source)
+			b = r.flatten()
+			self.assertEqual(b.root.range, r.match.range)
+			self.assertSame(b.root, r.match)
+			self.assertEqual(P1(g).asEager().process(b), result)
+			self.assertEqual(P1(g).asLazy().process(b),  result)
+		self.assertEqual(g.parseString("(").flatten(), None)
+
 if __name__ == "__main__":
 	unittest.main()
 